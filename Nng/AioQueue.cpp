@@ -0,0 +1,262 @@
+/*
+Nng wrapper
+
+Native completion queue for Aio. This file is compiled without /clr (see Nng.vcxproj),
+because <atomic> and <mutex> are not available to managed code, and because the nng
+callback below must not cross into managed code at all.
+
+The nng callback only pushes the aio's node into an intrusive MPSC queue (Vyukov). Every
+queue has exactly one dispatcher thread, so popping needs no lock. The mutex and condition
+variable are only touched when the dispatcher has nothing to do and went to sleep.
+
+Node states, because an Aio may be freed while its completion is still queued or running:
+QUEUED  pushed by the nng callback, not yet popped
+RUNNING popped, the managed callback is being called
+DEAD    the Aio is freed, whoever clears the last of the other bits deletes the node
+
+Every queue keeps a list of the nodes bound to it. aio_queue_unbind sends them back to the direct
+callback before the queue is freed, and waits for an nng callback which already picked up the
+queue and is still pushing. The node stays alive meanwhile, nng_aio_free waits for its callback.
+*/
+
+#include "AioQueue.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace Nng {
+
+	enum : int {
+		NODE_QUEUED = 1,
+		NODE_RUNNING = 2,
+		NODE_DEAD = 4
+	};
+
+	struct aio_queue_node {
+		std::atomic<aio_queue_node*> next{ nullptr };
+		std::atomic<aio_queue*> queue{ nullptr };
+		std::atomic<int> state{ 0 };
+		std::atomic<aio_queue*> runningOn{ nullptr };
+		std::atomic<int> calling{ 0 };  // in aio_queue_callback
+		aio_queue_node* boundPrev = nullptr; // list of the nodes bound to queue, under bindLock
+		aio_queue_node* boundNext = nullptr;
+		void* owner;
+		aio_direct_callback callback;
+	};
+
+	struct aio_queue {
+		std::atomic<aio_queue_node*> head;
+		aio_queue_node* tail;
+		aio_queue_node stub;
+		std::atomic<int> pending{ 0 };
+		std::atomic<bool> sleeping{ false };
+		std::atomic<bool> shutdown{ false };
+		std::mutex mtx;
+		std::condition_variable cv;
+		aio_queue_node* bound = nullptr; // under bindLock
+		bool unbound = false;            // further binds go to the direct callback
+	};
+
+	static std::mutex bindLock; // binding is rare, one lock for all queues
+
+	// under bindLock
+	static void unlinkBound(aio_queue_node* node)
+	{
+		aio_queue* queue = node->queue.load(std::memory_order_relaxed);
+		if (queue == nullptr) return;
+		if (node->boundPrev != nullptr) node->boundPrev->boundNext = node->boundNext;
+		else queue->bound = node->boundNext;
+		if (node->boundNext != nullptr) node->boundNext->boundPrev = node->boundPrev;
+		node->boundPrev = node->boundNext = nullptr;
+	}
+
+	aio_queue* aio_queue_alloc()
+	{
+		auto queue = new (std::nothrow) aio_queue();
+		if (queue == nullptr) return nullptr;
+		queue->head.store(&queue->stub);
+		queue->tail = &queue->stub;
+		return queue;
+	}
+
+	void aio_queue_shutdown(aio_queue* queue)
+	{
+		std::lock_guard<std::mutex> lock(queue->mtx);
+		queue->shutdown.store(true);
+		queue->cv.notify_all();
+	}
+
+	void aio_queue_unbind(aio_queue* queue)
+	{
+		std::lock_guard<std::mutex> lock(bindLock);
+		queue->unbound = true;
+		while (queue->bound != nullptr) {
+			aio_queue_node* node = queue->bound;
+			queue->bound = node->boundNext;
+			node->boundPrev = node->boundNext = nullptr;
+			node->queue.store(nullptr, std::memory_order_seq_cst);
+			// a callback which saw the queue before the store is still pushing, one after it calls directly
+			while (node->calling.load(std::memory_order_seq_cst) != 0) std::this_thread::yield();
+		}
+	}
+
+	void aio_queue_free(aio_queue* queue)
+	{
+		delete queue;
+	}
+
+	static void queue_push(aio_queue* queue, aio_queue_node* node)
+	{
+		node->next.store(nullptr, std::memory_order_relaxed);
+		aio_queue_node* prev = queue->head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	// single consumer. nullptr if empty, or if a producer is between its two stores
+	static aio_queue_node* queue_pop(aio_queue* queue)
+	{
+		aio_queue_node* tail = queue->tail;
+		aio_queue_node* next = tail->next.load(std::memory_order_acquire);
+		if (tail == &queue->stub) {
+			if (next == nullptr) return nullptr;
+			queue->tail = next;
+			tail = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+		if (next != nullptr) {
+			queue->tail = next;
+			return tail;
+		}
+		if (tail != queue->head.load(std::memory_order_acquire)) return nullptr;
+		queue_push(queue, &queue->stub);
+		next = tail->next.load(std::memory_order_acquire);
+		if (next != nullptr) {
+			queue->tail = next;
+			return tail;
+		}
+		return nullptr;
+	}
+
+	void __cdecl aio_queue_callback(void* arg)
+	{
+		auto node = static_cast<aio_queue_node*>(arg);
+		node->calling.fetch_add(1, std::memory_order_seq_cst);
+		aio_queue* queue = node->queue.load(std::memory_order_seq_cst);
+		if (queue == nullptr) {
+			node->calling.fetch_sub(1, std::memory_order_seq_cst);
+			node->callback(); // the classic way, straight into managed code
+			return;
+		}
+		node->state.fetch_or(NODE_QUEUED);
+		queue_push(queue, node);
+		queue->pending.fetch_add(1);
+		if (queue->sleeping.load()) {
+			std::lock_guard<std::mutex> lock(queue->mtx);
+			queue->cv.notify_one();
+		}
+		node->calling.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	int aio_queue_pop(aio_queue* queue, aio_queue_node** nodes, void** owners, int max, int timeout)
+	{
+		if (queue->pending.load() == 0 && timeout != 0) {
+			std::unique_lock<std::mutex> lock(queue->mtx);
+			queue->sleeping.store(true);
+			auto ready = [queue] { return queue->pending.load() > 0 || queue->shutdown.load(); };
+			if (timeout < 0) {
+				queue->cv.wait(lock, ready);
+			}
+			else {
+				queue->cv.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+			}
+			queue->sleeping.store(false);
+		}
+
+		int count = 0;
+		while (count < max && queue->pending.load() > 0) {
+			aio_queue_node* node = queue_pop(queue);
+			if (node == nullptr) { // a producer is half way through its push
+				if (count > 0) break;
+				std::this_thread::yield();
+				continue;
+			}
+			queue->pending.fetch_sub(1);
+
+			int state = node->state.load();
+			int newState;
+			do {
+				newState = (state & NODE_DEAD) ? state & ~NODE_QUEUED : (state & ~NODE_QUEUED) | NODE_RUNNING;
+			} while (!node->state.compare_exchange_weak(state, newState));
+			if (state & NODE_DEAD) { // freed while queued, nobody else will touch it
+				delete node;
+				continue;
+			}
+			node->runningOn = queue;
+			nodes[count] = node;
+			owners[count] = node->owner;
+			count++;
+		}
+		return count;
+	}
+
+	void aio_queue_end(aio_queue_node** nodes, int count)
+	{
+		for (int i = 0; i < count; i++) {
+			aio_queue_node* node = nodes[i];
+			node->runningOn = nullptr;
+			int old = node->state.fetch_and(~NODE_RUNNING);
+			if ((old & NODE_DEAD) && !(old & NODE_QUEUED)) delete node;
+		}
+	}
+
+	aio_queue_node* aio_queue_node_alloc(void* owner, aio_direct_callback callback)
+	{
+		auto node = new (std::nothrow) aio_queue_node();
+		if (node == nullptr) return nullptr;
+		node->owner = owner;
+		node->callback = callback;
+		return node;
+	}
+
+	void aio_queue_node_bind(aio_queue_node* node, aio_queue* queue)
+	{
+		std::lock_guard<std::mutex> lock(bindLock);
+		unlinkBound(node);
+		if (queue != nullptr && queue->unbound) queue = nullptr;
+		if (queue != nullptr) {
+			node->boundNext = queue->bound;
+			if (queue->bound != nullptr) queue->bound->boundPrev = node;
+			queue->bound = node;
+		}
+		node->queue.store(queue, std::memory_order_seq_cst);
+	}
+
+	aio_queue* aio_queue_node_queue(aio_queue_node* node)
+	{
+		return node->queue.load(std::memory_order_acquire);
+	}
+
+	void aio_queue_node_release(aio_queue_node* node, aio_queue* caller)
+	{
+		{
+			std::lock_guard<std::mutex> lock(bindLock);
+			unlinkBound(node);
+			node->queue.store(nullptr, std::memory_order_relaxed);
+		}
+		int state = node->state.load();
+		for (;;) {
+			if ((state & NODE_RUNNING) && (caller == nullptr || node->runningOn != caller)) {
+				// another dispatcher is in the callback, wait like nng_aio_free() would
+				std::this_thread::yield();
+				state = node->state.load();
+				continue;
+			}
+			if (node->state.compare_exchange_weak(state, state | NODE_DEAD)) break;
+		}
+		// queued: the dispatcher deletes it when popped. running: we are inside the callback, aio_queue_end deletes it
+		if ((state & (NODE_QUEUED | NODE_RUNNING)) == 0) delete node;
+	}
+}
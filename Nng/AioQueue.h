@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+Nng wrapper
+
+Native completion queue for Aio, see AioQueue.cpp. This header is included from both
+managed and native files, so it must not pull in anything /clr can't compile.
+*/
+
+namespace Nng {
+
+	struct aio_queue;
+	struct aio_queue_node;
+
+	// the function pointer marshalled from the Aio delegate, used when no queue is bound
+	typedef void(__stdcall *aio_direct_callback)(void);
+
+	aio_queue* aio_queue_alloc();
+	// wakes up all waiting poppers, further pops return 0 at once
+	void aio_queue_shutdown(aio_queue* queue);
+	// sends the nodes bound to the queue back to their direct callback, later binds too. Returns once
+	// no nng callback pushes to the queue anymore
+	void aio_queue_unbind(aio_queue* queue);
+	// only after unbind and shutdown, once its dispatcher is done
+	void aio_queue_free(aio_queue* queue);
+
+	// Pops up to max completions, waits up to timeout ms (-1 forever) if the queue is empty.
+	// The returned nodes are marked running, owners[i] is the value given to aio_queue_node_alloc.
+	int  aio_queue_pop(aio_queue* queue, aio_queue_node** nodes, void** owners, int max, int timeout);
+	// ends the running state of nodes returned by aio_queue_pop
+	void aio_queue_end(aio_queue_node** nodes, int count);
+
+	aio_queue_node* aio_queue_node_alloc(void* owner, aio_direct_callback callback);
+	// nullptr switches back to calling the callback directly on the nng thread
+	void aio_queue_node_bind(aio_queue_node* node, aio_queue* queue);
+	aio_queue* aio_queue_node_queue(aio_queue_node* node);
+	// After nng_aio_free(). Waits while the node is dispatched by another thread, caller is the
+	// queue the calling thread dispatches (nullptr if none). The node is gone afterwards.
+	void aio_queue_node_release(aio_queue_node* node, aio_queue* caller);
+
+	// the nng aio callback, its argument is the node
+	void __cdecl aio_queue_callback(void* node);
+}
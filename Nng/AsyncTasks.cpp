@@ -0,0 +1,206 @@
+/*
+Nng wrapper
+
+Task based SendAsync and ReceiveAsync
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <msclr/lock.h>
+
+using namespace System::Threading;
+using namespace System::Threading::Tasks;
+
+namespace Nng {
+
+	/*
+	Every pending SendAsync/ReceiveAsync needs an Aio. Allocating one per operation would cost a native
+	helper, a delegate and an nng_aio each time, so the operations are recycled: an AsyncOperation owns
+	one Aio for its whole life and goes back to a bounded pool when its callback has finished.
+
+	.NET Framework has no reusable task sources (IValueTaskSource), so the TaskCompletionSource and its
+	Task are the only allocations per operation, besides the message itself. A CancellationToken which
+	can actually be cancelled adds its registration.
+
+	The operation is returned to the pool before the task is completed, and continuations run
+	asynchronously, so user code never runs on nng's threads and never sees a recycled operation.
+	*/
+
+	private ref class AsyncOperation {
+	internal:
+		Aio^ aio;
+		Msg^ sendMsg;
+		TaskCompletionSource<Msg^>^ receiveSource;
+		TaskCompletionSource<Errno>^ sendSource;
+		CancellationToken cancellationToken;
+		CancellationTokenRegistration registration;
+		bool started;
+		bool cancelPending;
+		Int32 rental; // counts the recycles, Start leaves an op alone that completed and was rented again
+
+		static array<AsyncOperation^>^ pool = gcnew array<AsyncOperation^>(256);
+		static Int32 pooled = 0;
+		static Object^ poolLock = gcnew Object();
+		static Action<Object^>^ cancelAction = gcnew Action<Object^>(&AsyncOperation::Cancel);
+
+		static Errno Rent([Out] AsyncOperation^% op)
+		{
+			{
+				msclr::lock l(poolLock);
+				if (pooled > 0) {
+					op = pool[--pooled];
+					pool[pooled] = nullptr;
+					return Errno::ok;
+				}
+			}
+			op = gcnew AsyncOperation();
+			Errno err = Aio::Alloc(op->aio, gcnew Action<Object^>(op, &AsyncOperation::Completed), nullptr);
+			if (err != Errno::ok) {
+				if (op->aio != nullptr) op->aio->Free();
+				op = nullptr;
+			}
+			return err;
+		}
+
+		void Return()
+		{
+			this->sendMsg = nullptr;
+			this->receiveSource = nullptr;
+			this->sendSource = nullptr;
+			this->cancellationToken = CancellationToken::None;
+			this->registration = CancellationTokenRegistration();
+			{
+				msclr::lock l(poolLock);
+				if (pooled < pool->Length) {
+					pool[pooled++] = this;
+					return;
+				}
+			}
+			this->aio->Free(); // pool is full. We are in the callback of the Aio, it is freed once that returns
+		}
+
+		// Completed is done with the op. Start may still be behind Launch, the lock waits for it
+		void Recycle()
+		{
+			msclr::lock l(this);
+			this->rental++;
+			Return();
+		}
+
+		void Launch(Socket^ socket)
+		{
+			if (this->sendMsg != nullptr) {
+				this->aio->SetMsg(this->sendMsg);
+				socket->Send(this->aio);
+			}
+			else {
+				socket->Receive(this->aio);
+			}
+		}
+
+		void Start(Socket^ socket, Nullable<Int32> timeout, Nullable<CancellationToken> token)
+		{
+			this->aio->SetTimeout(timeout.HasValue ? (Int32)timeout : NNG_DURATION_DEFAULT);
+			if (!token.HasValue || !((CancellationToken)token).CanBeCanceled) {
+				Launch(socket);
+				return;
+			}
+
+			// The token may fire before the aio is started, nng would ignore that cancel.
+			// The lock makes sure it is either seen here or applied to the running aio
+			this->cancellationToken = (CancellationToken)token;
+			this->started = false;
+			this->cancelPending = false;
+			this->registration = this->cancellationToken.Register(cancelAction, this);
+			msclr::lock l(this);
+			Int32 rental = this->rental;
+			Launch(socket);
+			if (this->rental != rental) return; // completed on this thread already, maybe rented again
+			this->started = true;
+			if (this->cancelPending) this->aio->Cancel();
+		}
+
+		static void Cancel(Object^ state)
+		{
+			auto op = safe_cast<AsyncOperation^>(state);
+			msclr::lock l(op);
+			if (op->started) op->aio->Cancel();
+			else op->cancelPending = true;
+		}
+
+		void Completed(Object^)
+		{
+			// after Dispose the cancel callback can't run anymore, so the Aio may be reused
+			this->registration.Dispose();
+			Errno result = this->aio->Result();
+			bool canceled = (result == Errno::canceled && this->cancellationToken.IsCancellationRequested);
+
+			if (this->receiveSource != nullptr) {
+				auto source = this->receiveSource;
+				Msg^ msg = (result == Errno::ok) ? this->aio->GetMsg() : nullptr;
+				Recycle();
+				if (result == Errno::ok) source->SetResult(msg);
+				else if (canceled) source->SetCanceled();
+				else source->SetException(gcnew NngException(result));
+			}
+			else {
+				auto source = this->sendSource;
+				if (result == Errno::ok) {
+					// nng owns the message now, like in Socket::Send(Msg^)
+					this->sendMsg->InvalidateViews();
+					this->sendMsg->msg = System::UIntPtr::Zero;
+				}
+				Recycle();
+				if (canceled) source->SetCanceled();
+				else source->SetResult(result);
+			}
+		}
+	};
+
+	Task<Msg^>^ Socket::ReceiveAsync([Optional] Nullable<Int32> timeout, [Optional] Nullable<CancellationToken> cancellationToken)
+	{
+		if (cancellationToken.HasValue && ((CancellationToken)cancellationToken).IsCancellationRequested) {
+			auto source = gcnew TaskCompletionSource<Msg^>();
+			source->SetCanceled();
+			return source->Task;
+		}
+		AsyncOperation^ op;
+		Errno err = AsyncOperation::Rent(op);
+		if (err != Errno::ok) {
+			auto source = gcnew TaskCompletionSource<Msg^>();
+			source->SetException(gcnew NngException(err));
+			return source->Task;
+		}
+		op->receiveSource = gcnew TaskCompletionSource<Msg^>(TaskCreationOptions::RunContinuationsAsynchronously);
+		auto task = op->receiveSource->Task; // op may be recycled as soon as it is started
+		op->Start(this, timeout, cancellationToken);
+		return task;
+	}
+
+	Task<Errno>^ Socket::SendAsync(Msg^ msg, [Optional] Nullable<Int32> timeout, [Optional] Nullable<CancellationToken> cancellationToken)
+	{
+		if (msg == nullptr || msg->msg == System::UIntPtr::Zero) {
+			return Task::FromResult<Errno>(Errno::inval);
+		}
+		if (cancellationToken.HasValue && ((CancellationToken)cancellationToken).IsCancellationRequested) {
+			auto source = gcnew TaskCompletionSource<Errno>();
+			source->SetCanceled();
+			return source->Task;
+		}
+		AsyncOperation^ op;
+		Errno err = AsyncOperation::Rent(op);
+		if (err != Errno::ok) {
+			return Task::FromResult<Errno>(err);
+		}
+		op->sendMsg = msg;
+		op->sendSource = gcnew TaskCompletionSource<Errno>(TaskCreationOptions::RunContinuationsAsynchronously);
+		auto task = op->sendSource->Task;
+		op->Start(this, timeout, cancellationToken);
+		return task;
+	}
+}
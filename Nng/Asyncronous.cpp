@@ -13,6 +13,8 @@ aio
 #include "NngInternal.h"
 #include <cstring>
 #include <vcclr.h>
+#include "AioQueue.h"
+#include <msclr/lock.h>
 #include "protocol/reqrep0/req.h"
 #include "protocol/reqrep0/rep.h"
 
@@ -41,25 +43,40 @@ namespace Nng {
 	struct aio_help_object {
 		gcroot<Aio^> managedAio; // do not access this while in a callback and still on the native side!
 		nng_aio* unmanagedAio;
+		nngc_aio coreAio; // the core's handle, its nng_aio is unmanagedAio
 		void (__stdcall *callback)(void); // The wrapper is __stdcall
+		aio_queue_node* node; // the nng callback argument, see AioQueue.cpp
 	};
 
-	// forward the callback, from native to managed, call will end up in Aio::CallbackEntry
-	static void __cdecl aioCallbackFunction(void* context) {
-		aio_help_object* aioHelper = static_cast<aio_help_object*>(context);
-		aioHelper->callback();
-	}
+	/*
+	The nng callback is aio_queue_callback() in AioQueue.cpp, which is native code. Without a completion
+	queue bound it calls aio_help_object::callback, ending up in Aio::CallbackEntry just like before.
+	With a queue it only enqueues the node, and an AioCompletionQueue thread calls the .NET callback later,
+	a whole batch per native -> managed transition. That thread runs in the AppDomain which created the
+	AioCompletionQueue, so the queue and its Aios must come from the same AppDomain.
+	*/
 
 	void Aio::CallbackEntry(void)
 	{
 		// We are in managed code, in the correct AppDomain!
-		this->dotNetCallback(this->dotNetCallbackContext);
+		Aio^ outer = calling;
+		calling = this;
+		try {
+			this->dotNetCallback(this->dotNetCallbackContext);
+		}
+		finally {
+			calling = outer;
+		}
 	}
 
 	extern nng_aio* getNativeAio(Aio^ aio) {
 		aio_help_object* helpPtr = reinterpret_cast<aio_help_object*>(aio->aio.ToPointer());
 		return helpPtr->unmanagedAio;
 	}
+	extern nngc_aio coreAio(Aio^ aio) {
+		aio_help_object* helpPtr = reinterpret_cast<aio_help_object*>(aio->aio.ToPointer());
+		return helpPtr->coreAio;
+	}
 	extern nng_msg* getNativeMsg(Msg^ msg) {
 		return reinterpret_cast<nng_msg*>(msg->msg.ToPointer());
 	}
@@ -85,18 +102,26 @@ namespace Nng {
 		// create a delegate on the managed heap, it must have a long lifetime
 		aio->callbackDelegate = gcnew CallbackEntryDelegate(aio, &CallbackEntry);
 
-		nng_aio * newAio;
-		int result = ::nng_aio_alloc(&newAio, aioCallbackFunction, aioHelper);
+		// And now for the magic trick. Retrieve a C++ function pointer which will do the actual
+		// unmanaged -> managed jump, including the AppDomain change
+		aioHelper->callback = (void(*)(void)) Marshal::GetFunctionPointerForDelegate(aio->callbackDelegate).ToPointer();
+		aioHelper->node = aio_queue_node_alloc(aioHelper, aioHelper->callback);
+		if (aioHelper->node == nullptr) {
+			aio->aio = UIntPtr::Zero;
+			delete aioHelper;
+			return Errno::nomem;
+		}
+
+		nngc_aio newAio;
+		int result = ::nngc_aio_alloc(aio_queue_callback, aioHelper->node, &newAio);
 		if (result == 0) {
-			aioHelper->unmanagedAio = newAio;
+			aioHelper->coreAio = newAio;
+			aioHelper->unmanagedAio = static_cast<nng_aio*>(::nngc_aio_native(newAio));
 			aioHelper->managedAio = aio; // this is just to prevent gc. We don't access it from unmanaged code
-
-			// And now for the magic trick. Retrieve a C++ function pointer which will do the actual
-			// unmanaged -> managed jump, including the AppDomain change
-			aioHelper->callback = (void(*)(void)) Marshal::GetFunctionPointerForDelegate(aio->callbackDelegate).ToPointer();
 		}
 		else {
-			aio = nullptr;
+			aio_queue_node_release(aioHelper->node, nullptr);
+			aio->aio = UIntPtr::Zero;
 			delete aioHelper;
 		}
 		return static_cast<Errno>(result);
@@ -116,11 +141,23 @@ namespace Nng {
 		return err;
 	}
 
+	void Aio::FreeLater(Object^)
+	{
+		Free();
+	}
+
 	void Aio::Free()
 	{
+		if (this->aio != UIntPtr::Zero && calling == this) {
+			// nng_aio_free waits for the running callback, in its own one it would wait for itself
+			System::Threading::ThreadPool::QueueUserWorkItem(gcnew System::Threading::WaitCallback(this, &Aio::FreeLater));
+			return;
+		}
 		if (this->aio != UIntPtr::Zero) { // UIntPtr is a value class
 			aio_help_object* helpPtr = reinterpret_cast<aio_help_object*>(this->aio.ToPointer());
-			::nng_aio_free(helpPtr->unmanagedAio);
+			::nngc_aio_free(coreAio(this));
+			// waits if a completion queue thread is in our callback, unless it is this thread
+			aio_queue_node_release(helpPtr->node, static_cast<aio_queue*>(AioCompletionQueue::currentQueue.ToPointer()));
 			delete helpPtr; // this also decreases the ref count on the managed heap, as the gcroot is destroyed
 			this->callbackDelegate = nullptr; // I don't think this actually does anything useful
 			this->aio = UIntPtr::Zero; // mark the aio as unused
@@ -129,31 +166,311 @@ namespace Nng {
 
 	Msg^ Aio::GetMsg()
 	{
-		aio_help_object* helpPtr = reinterpret_cast<aio_help_object*>(this->aio.ToPointer());
-		nng_msg* newMsg = ::nng_aio_get_msg(helpPtr->unmanagedAio);
+		nngc_msg newMsg = ::nngc_aio_get_msg(coreAio(this));
 		auto retVal = gcnew Msg(System::UIntPtr(newMsg));
 		return retVal;
 	}
 
 	void Aio::Stop()
 	{
-		::nng_aio_stop(getNativeAio(this));
+		::nngc_aio_stop(coreAio(this));
 	}
 	void Aio::Cancel()
 	{
-		::nng_aio_cancel(getNativeAio(this));
+		::nngc_aio_cancel(coreAio(this));
 	}
 	void Aio::Wait()
 	{
-		::nng_aio_wait(getNativeAio(this));
+		::nngc_aio_wait(coreAio(this));
 	}
 	void Aio::SetMsg(Msg^ msg)
 	{
-		::nng_aio_set_msg(getNativeAio(this), getNativeMsg(msg));
+		// the message is about to be sent, a shared one needs its own copy. Without one the send fails
+		nngc_msg native = (msg->Unshare() == Errno::ok) ? coreMsg(msg) : 0;
+		::nngc_aio_set_msg(coreAio(this), native);
+	}
+	AioCompletionQueue^ Aio::CompletionQueue::get()
+	{
+		return this->boundQueue;
+	}
+
+	void Aio::CompletionQueue::set(AioCompletionQueue^ queue)
+	{
+		this->boundQueue = queue;
+		this->followedQueue = nullptr;
+		BindQueue(queue);
+	}
+
+	void Aio::BindQueue(AioCompletionQueue^ queue)
+	{
+		aio_help_object* helpPtr = reinterpret_cast<aio_help_object*>(this->aio.ToPointer());
+		if (queue == nullptr) {
+			aio_queue_node_bind(helpPtr->node, nullptr);
+			return;
+		}
+		// Close doesn't free the native queue in between, after Close Pick gives none
+		msclr::lock l(queue);
+		aio_queue_node_bind(helpPtr->node, static_cast<aio_queue*>(queue->Pick().ToPointer()));
+	}
+
+	// called by Socket::Send/Receive(Aio^), an Aio without a queue of its own uses the one of the socket
+	void Aio::FollowQueue(AioCompletionQueue^ queue)
+	{
+		if (this->boundQueue != nullptr || this->followedQueue == queue) return;
+		this->followedQueue = queue;
+		BindQueue(queue);
+	}
+
+	void Aio::Rebind(System::Action<System::Object^>^ callback, System::Object^ object)
+	{
+		this->dotNetCallback = callback;
+		this->dotNetCallbackContext = object;
+	}
+
+	// AioPool
+
+	AioPool::AioPool()
+	{
+	}
+
+	AioPool::AioPool(Int32 initial, Int32 maximum)
+	{
+		Errno err = Initialize(this, initial, maximum);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno AioPool::Alloc([Out] AioPool^% pool, Int32 initial, Int32 maximum)
+	{
+		pool = gcnew AioPool();
+		Errno err = Initialize(pool, initial, maximum);
+		if (err != Errno::ok) pool = nullptr;
+		return err;
+	}
+
+	Errno AioPool::Initialize(AioPool^ pool, Int32 initial, Int32 maximum)
+	{
+		if (initial < 0 || maximum < 0 || initial > maximum) return Errno::inval;
+		pool->idle = gcnew array<Aio^>(maximum);
+		for (int i = 0; i < initial; i++) {
+			Aio^ aio;
+			Errno err = Aio::Alloc(aio, nullptr, nullptr);
+			if (err != Errno::ok) {
+				if (aio != nullptr) aio->Free();
+				pool->Close();
+				return err;
+			}
+			pool->idle[pool->count++] = aio;
+		}
+		return Errno::ok;
 	}
+
+	Errno AioPool::Rent([Out] Aio^% aio, System::Action<System::Object^>^ callback, System::Object^ object)
+	{
+		{
+			msclr::lock l(this->idle);
+			if (this->count > 0) {
+				aio = this->idle[--this->count];
+				this->idle[this->count] = nullptr;
+			}
+			else {
+				aio = nullptr;
+			}
+		}
+		if (aio != nullptr) {
+			aio->Rebind(callback, object);
+			aio->rentedFrom = this;
+			return Errno::ok;
+		}
+		System::Threading::Interlocked::Increment(this->misses);
+		Errno err = Aio::Alloc(aio, callback, object);
+		if (err != Errno::ok) {
+			if (aio != nullptr) aio->Free();
+			aio = nullptr;
+			return err;
+		}
+		aio->rentedFrom = this;
+		return Errno::ok;
+	}
+
+	Errno AioPool::Return(Aio^ aio)
+	{
+		if (aio == nullptr || aio->aio == UIntPtr::Zero) return Errno::inval;
+		// only once, twice in the idle array it would be rented out to two callers
+		if (System::Threading::Interlocked::CompareExchange<AioPool^>(aio->rentedFrom, nullptr, this) != this) return Errno::state;
+		// the next renter must not get the completion of an operation still pending. In its own callback the
+		// operation is over, and nngc_aio_stop would wait for the callback to return
+		if (Aio::calling != aio) ::nngc_aio_stop(coreAio(aio));
+		aio->Rebind(nullptr, nullptr); // don't keep the caller's objects alive
+		::nngc_aio_set_msg(coreAio(aio), 0);
+		::nngc_aio_set_timeout(coreAio(aio), NNG_DURATION_DEFAULT);
+		aio->CompletionQueue = nullptr;
+		{
+			msclr::lock l(this->idle);
+			if (!this->closed && this->count < this->idle->Length) {
+				this->idle[this->count++] = aio;
+				return Errno::ok;
+			}
+		}
+		aio->Free();
+		return Errno::ok;
+	}
+
+	Int32 AioPool::Available::get()
+	{
+		return this->count;
+	}
+
+	Int64 AioPool::Misses::get()
+	{
+		return System::Threading::Interlocked::Read(this->misses);
+	}
+
+	void AioPool::Close()
+	{
+		if (this->idle == nullptr) return;
+		msclr::lock l(this->idle);
+		this->closed = true;
+		for (int i = 0; i < this->count; i++) {
+			this->idle[i]->Free();
+			this->idle[i] = nullptr;
+		}
+		this->count = 0;
+	}
+
+	AioPool::~AioPool()
+	{
+		Close();
+	}
+
+	// AioCompletionQueue
+
+	AioCompletionQueue::AioCompletionQueue()
+	{
+	}
+
+	AioCompletionQueue::AioCompletionQueue(Int32 dispatchers, Int32 batchSize)
+	{
+		Errno err = Initialize(this, dispatchers, batchSize);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno AioCompletionQueue::Alloc([Out] AioCompletionQueue^% queue, Int32 dispatchers, Int32 batchSize)
+	{
+		queue = gcnew AioCompletionQueue();
+		Errno err = Initialize(queue, dispatchers, batchSize);
+		if (err != Errno::ok) queue = nullptr;
+		return err;
+	}
+
+	Errno AioCompletionQueue::Initialize(AioCompletionQueue^ queue, Int32 dispatchers, Int32 batchSize)
+	{
+		if (dispatchers < 1 || batchSize < 1) return Errno::inval;
+		queue->batchSize = batchSize;
+		queue->queues = gcnew array<UIntPtr>(dispatchers);
+		for (int i = 0; i < dispatchers; i++) {
+			aio_queue* native = aio_queue_alloc();
+			if (native == nullptr) {
+				queue->Close();
+				return Errno::nomem;
+			}
+			queue->queues[i] = UIntPtr(native);
+		}
+		queue->threads = gcnew array<System::Threading::Thread^>(dispatchers);
+		for (int i = 0; i < dispatchers; i++) {
+			auto thread = gcnew System::Threading::Thread(gcnew System::Threading::ParameterizedThreadStart(queue, &AioCompletionQueue::Dispatch));
+			thread->IsBackground = true;
+			thread->Name = "Nng AioCompletionQueue " + i;
+			queue->threads[i] = thread;
+			thread->Start(queue->queues[i]);
+		}
+		return Errno::ok;
+	}
+
+	UIntPtr AioCompletionQueue::Pick()
+	{
+		if (this->queues == nullptr) return UIntPtr::Zero;
+		int n = System::Threading::Interlocked::Increment(this->next);
+		return this->queues[static_cast<unsigned int>(n) % static_cast<unsigned int>(this->queues->Length)];
+	}
+
+	void AioCompletionQueue::Dispatch(Object^ native)
+	{
+		aio_queue* queue = static_cast<aio_queue*>(safe_cast<UIntPtr>(native).ToPointer());
+		currentQueue = UIntPtr(queue);
+		int batch = this->batchSize;
+		aio_queue_node** nodes = new aio_queue_node*[batch];
+		void** owners = new void*[batch];
+		auto aios = gcnew array<Aio^>(batch);
+
+		for (;;) {
+			int n = aio_queue_pop(queue, nodes, owners, batch, -1);
+			if (n == 0) {
+				if (this->closing) break;
+				continue;
+			}
+			// Collect first: a callback may free another Aio of this batch, and its helper with it
+			for (int i = 0; i < n; i++) {
+				aios[i] = static_cast<aio_help_object*>(owners[i])->managedAio;
+			}
+			for (int i = 0; i < n; i++) {
+				Aio^ aio = aios[i];
+				aios[i] = nullptr;
+				if (aio->aio == UIntPtr::Zero) continue; // freed by an earlier callback of this batch
+				aio->dotNetCallback(aio->dotNetCallbackContext);
+			}
+			aio_queue_end(nodes, n);
+			System::Threading::Interlocked::Add(this->completions, n);
+			System::Threading::Interlocked::Increment(this->batches);
+		}
+		delete[] nodes;
+		delete[] owners;
+		currentQueue = UIntPtr::Zero;
+	}
+
+	Int64 AioCompletionQueue::Completions::get() { return System::Threading::Interlocked::Read(this->completions); }
+	Int64 AioCompletionQueue::Batches::get() { return System::Threading::Interlocked::Read(this->batches); }
+
+	void AioCompletionQueue::Close()
+	{
+		array<UIntPtr>^ queues;
+		{
+			msclr::lock l(this);
+			if (this->queues == nullptr) return;
+			queues = this->queues;
+			this->queues = nullptr;
+			this->closing = true;
+			// Aios still bound call back directly from now on, nothing pushes to the queues anymore
+			for (int i = 0; i < queues->Length; i++) {
+				if (queues[i] != UIntPtr::Zero) aio_queue_unbind(static_cast<aio_queue*>(queues[i].ToPointer()));
+			}
+		}
+		for (int i = 0; i < queues->Length; i++) {
+			if (queues[i] != UIntPtr::Zero) aio_queue_shutdown(static_cast<aio_queue*>(queues[i].ToPointer()));
+		}
+		bool fromCallback = false;
+		if (this->threads != nullptr) {
+			for (int i = 0; i < this->threads->Length; i++) {
+				if (this->threads[i] == System::Threading::Thread::CurrentThread) fromCallback = true;
+				else if (this->threads[i] != nullptr) this->threads[i]->Join();
+			}
+		}
+		// closed from one of our own callbacks, that thread still needs its queue. Leak the queues instead
+		if (!fromCallback) {
+			for (int i = 0; i < queues->Length; i++) {
+				if (queues[i] != UIntPtr::Zero) aio_queue_free(static_cast<aio_queue*>(queues[i].ToPointer()));
+			}
+		}
+		this->threads = nullptr;
+	}
+
+	AioCompletionQueue::~AioCompletionQueue()
+	{
+		Close();
+	}
+
 	void Aio::SetTimeout(Int32 duration)
 	{
-		::nng_aio_set_timeout(getNativeAio(this), duration);
+		::nngc_aio_set_timeout(coreAio(this), duration);
 	}
 	Aio::~Aio()
 	{
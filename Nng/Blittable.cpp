@@ -0,0 +1,356 @@
+/*
+Nng wrapper
+
+Blittable value types straight into and out of messages: Msg::Write/Read<T> and Socket::Send/Receive<T>.
+A generic can't take the address of a T in C++/CLI, so the copies are small dynamic methods emitted
+once per type (stobj/ldobj for one value, cpblk for a range of an array), each one unaligned copy
+between the managed value and the body of the native message.
+
+In network order every field wider than a byte is reversed in the message, as found by reflection.
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <cstring>
+
+using namespace System::Collections::Generic;
+using namespace System::Reflection;
+using namespace System::Reflection::Emit;
+using namespace System::Runtime::CompilerServices;
+using namespace System::Runtime::InteropServices;
+
+namespace Nng {
+
+	// width of a primitive field, 0 for one that has no fixed layout
+	static Int32 primitiveSize(Type^ type)
+	{
+		if (type->IsEnum) type = Enum::GetUnderlyingType(type);
+		if (type == IntPtr::typeid || type == UIntPtr::typeid) return IntPtr::Size;
+		switch (Type::GetTypeCode(type)) {
+		case TypeCode::Byte: case TypeCode::SByte: return 1;
+		case TypeCode::Int16: case TypeCode::UInt16: return 2;
+		case TypeCode::Int32: case TypeCode::UInt32: case TypeCode::Single: return 4;
+		case TypeCode::Int64: case TypeCode::UInt64: case TypeCode::Double: return 8;
+		default: return 0; // bool and char are laid out differently by the marshaler
+		}
+	}
+
+	// offset and size of every field to reverse, false if the layout can't be told
+	static bool findSwaps(Type^ type, Int32 base, List<Int32>^ swaps)
+	{
+		if (type->IsPrimitive || type->IsEnum) {
+			Int32 size = primitiveSize(type);
+			if (size == 0) return false;
+			if (size > 1) {
+				swaps->Add(base);
+				swaps->Add(size);
+			}
+			return true;
+		}
+		for each (FieldInfo^ field in type->GetFields(BindingFlags::Instance | BindingFlags::Public | BindingFlags::NonPublic)) {
+			Int32 offset = base + Marshal::OffsetOf(type, field->Name).ToInt32();
+			auto fixed = safe_cast<FixedBufferAttribute^>(Attribute::GetCustomAttribute(field, FixedBufferAttribute::typeid));
+			if (fixed == nullptr) {
+				if (!findSwaps(field->FieldType, offset, swaps)) return false;
+				continue;
+			}
+			Int32 size = primitiveSize(fixed->ElementType);
+			if (size == 0) return false;
+			for (Int32 i = 0; size > 1 && i < fixed->Length; i++) {
+				swaps->Add(offset + i * size);
+				swaps->Add(size);
+			}
+		}
+		return true;
+	}
+
+	static void swapFields(unsigned char* p, array<Int32>^ swaps, Int64 count, Int32 stride)
+	{
+		for (Int64 e = 0; e < count; e++, p += stride) {
+			for (Int32 i = 0; i < swaps->Length; i += 2) {
+				unsigned char* a = p + swaps[i];
+				unsigned char* b = a + swaps[i + 1] - 1;
+				for (; a < b; a++, b--) {
+					unsigned char t = *a;
+					*a = *b;
+					*b = t;
+				}
+			}
+		}
+	}
+
+	// What is known about T, worked out once by the static constructor
+	generic <typename T> where T : value class
+	private ref class Blittable abstract sealed {
+	public:
+		delegate void StoreDelegate(T value, IntPtr destination);
+		delegate T LoadDelegate(IntPtr source);
+		delegate void CopyOutDelegate(array<T>^ values, Int32 index, IntPtr destination, UInt32 bytes);
+		delegate void CopyInDelegate(IntPtr source, array<T>^ values, Int32 index, UInt32 bytes);
+
+		static initonly bool Valid;         // no references in T, its bytes can be copied
+		static initonly Int32 Size;         // sizeof(T) in managed memory
+		static initonly array<Int32>^ Swaps; // offset and size pairs, nullptr if network order isn't known
+		static initonly StoreDelegate^ Store;
+		static initonly LoadDelegate^ Load;
+		static initonly CopyOutDelegate^ CopyOut;
+		static initonly CopyInDelegate^ CopyIn;
+
+		static Blittable()
+		{
+			try {
+				// refused for a T holding references
+				GCHandle::Alloc(T(), GCHandleType::Pinned).Free();
+			}
+			catch (ArgumentException^) {
+				return;
+			}
+			Module^ module = Msg::typeid->Module;
+
+			auto size = gcnew DynamicMethod("Size", Int32::typeid, Type::EmptyTypes, module, true);
+			ILGenerator^ il = size->GetILGenerator();
+			il->Emit(OpCodes::Sizeof, T::typeid);
+			il->Emit(OpCodes::Ret);
+			Size = safe_cast<Func<Int32>^>(size->CreateDelegate(Func<Int32>::typeid))();
+
+			auto store = gcnew DynamicMethod("Store", nullptr, gcnew array<Type^>{ T::typeid, IntPtr::typeid }, module, true);
+			il = store->GetILGenerator();
+			il->Emit(OpCodes::Ldarg_1);
+			il->Emit(OpCodes::Ldarg_0);
+			il->Emit(OpCodes::Unaligned, static_cast<Byte>(1));
+			il->Emit(OpCodes::Stobj, T::typeid);
+			il->Emit(OpCodes::Ret);
+			Store = safe_cast<StoreDelegate^>(store->CreateDelegate(StoreDelegate::typeid));
+
+			auto load = gcnew DynamicMethod("Load", T::typeid, gcnew array<Type^>{ IntPtr::typeid }, module, true);
+			il = load->GetILGenerator();
+			il->Emit(OpCodes::Ldarg_0);
+			il->Emit(OpCodes::Unaligned, static_cast<Byte>(1));
+			il->Emit(OpCodes::Ldobj, T::typeid);
+			il->Emit(OpCodes::Ret);
+			Load = safe_cast<LoadDelegate^>(load->CreateDelegate(LoadDelegate::typeid));
+
+			// cpblk takes the managed address of the element, the GC keeps track of it meanwhile
+			auto copyOut = gcnew DynamicMethod("CopyOut", nullptr, gcnew array<Type^>{ array<T>::typeid, Int32::typeid, IntPtr::typeid, UInt32::typeid }, module, true);
+			il = copyOut->GetILGenerator();
+			il->Emit(OpCodes::Ldarg_2);
+			il->Emit(OpCodes::Ldarg_0);
+			il->Emit(OpCodes::Ldarg_1);
+			il->Emit(OpCodes::Ldelema, T::typeid);
+			il->Emit(OpCodes::Ldarg_3);
+			il->Emit(OpCodes::Unaligned, static_cast<Byte>(1));
+			il->Emit(OpCodes::Cpblk);
+			il->Emit(OpCodes::Ret);
+			CopyOut = safe_cast<CopyOutDelegate^>(copyOut->CreateDelegate(CopyOutDelegate::typeid));
+
+			auto copyIn = gcnew DynamicMethod("CopyIn", nullptr, gcnew array<Type^>{ IntPtr::typeid, array<T>::typeid, Int32::typeid, UInt32::typeid }, module, true);
+			il = copyIn->GetILGenerator();
+			il->Emit(OpCodes::Ldarg_1);
+			il->Emit(OpCodes::Ldarg_2);
+			il->Emit(OpCodes::Ldelema, T::typeid);
+			il->Emit(OpCodes::Ldarg_0);
+			il->Emit(OpCodes::Ldarg_3);
+			il->Emit(OpCodes::Unaligned, static_cast<Byte>(1));
+			il->Emit(OpCodes::Cpblk);
+			il->Emit(OpCodes::Ret);
+			CopyIn = safe_cast<CopyInDelegate^>(copyIn->CreateDelegate(CopyInDelegate::typeid));
+
+			try {
+				auto swaps = gcnew List<Int32>();
+				// the marshaler's offsets are the real ones only where it lays T out the same way
+				if ((T::typeid->IsPrimitive || T::typeid->IsEnum || Marshal::SizeOf(T::typeid) == Size) && findSwaps(T::typeid, 0, swaps)) {
+					Swaps = swaps->ToArray();
+				}
+			}
+			catch (ArgumentException^) {
+				// generic structs have no marshaled layout
+			}
+			Valid = true;
+		}
+
+		// Errno::notsup if T can't be copied, or has no known network order
+		static Errno Check(bool networkOrder)
+		{
+			if (!Valid) return Errno::notsup;
+			if (networkOrder && Swaps == nullptr) return Errno::notsup;
+			return Errno::ok;
+		}
+
+		// between host and network order, in place
+		static void Swap(void* p, Int64 count, bool networkOrder)
+		{
+			if (networkOrder && BitConverter::IsLittleEndian) swapFields(static_cast<unsigned char*>(p), Swaps, count, Size);
+		}
+	};
+
+	// Msg
+
+	generic <typename T> where T : value class
+	Errno Msg::Write(T value, [Optional] Nullable<bool> networkOrder)
+	{
+		bool network = networkOrder.HasValue && networkOrder.Value;
+		Errno err = Blittable<T>::Check(network);
+		if (err != Errno::ok) return err;
+		if (this->msg == System::UIntPtr::Zero) return Errno::inval;
+		if ((err = Unshare()) != Errno::ok) return err;
+		InvalidateViews();
+		nngc_msg m = coreMsg(this);
+		size_t len = ::nngc_msg_len(m);
+		int result = ::nngc_msg_realloc(m, len + Blittable<T>::Size);
+		if (result != 0) return static_cast<Errno>(result);
+		unsigned char* p = static_cast<unsigned char*>(::nngc_msg_body(m)) + len;
+		Blittable<T>::Store(value, IntPtr(p));
+		Blittable<T>::Swap(p, 1, network);
+		return Errno::ok;
+	}
+
+	generic <typename T> where T : value class
+	Errno Msg::Write(array<T>^ values, Int32 offset, Int32 count, [Optional] Nullable<bool> networkOrder)
+	{
+		bool network = networkOrder.HasValue && networkOrder.Value;
+		Errno err = Blittable<T>::Check(network);
+		if (err != Errno::ok) return err;
+		if (values == nullptr || offset < 0 || count < 0 || offset > values->Length - count) return Errno::inval;
+		if (this->msg == System::UIntPtr::Zero) return Errno::inval;
+		if (count == 0) return Errno::ok;
+		if ((err = Unshare()) != Errno::ok) return err;
+		InvalidateViews();
+		nngc_msg m = coreMsg(this);
+		size_t len = ::nngc_msg_len(m);
+		size_t bytes = static_cast<size_t>(count) * Blittable<T>::Size;
+		if (bytes > UINT32_MAX) return Errno::msgsize;
+		int result = ::nngc_msg_realloc(m, len + bytes);
+		if (result != 0) return static_cast<Errno>(result);
+		unsigned char* p = static_cast<unsigned char*>(::nngc_msg_body(m)) + len;
+		Blittable<T>::CopyOut(values, offset, IntPtr(p), static_cast<UInt32>(bytes));
+		Blittable<T>::Swap(p, count, network);
+		return Errno::ok;
+	}
+
+	generic <typename T> where T : value class
+	Errno Msg::Read([Out] T% value, [Optional] Nullable<bool> networkOrder)
+	{
+		value = T();
+		bool network = networkOrder.HasValue && networkOrder.Value;
+		Errno err = Blittable<T>::Check(network);
+		if (err != Errno::ok) return err;
+		if (this->msg == System::UIntPtr::Zero) return Errno::inval;
+		if ((err = Unshare()) != Errno::ok) return err;
+		nngc_msg m = coreMsg(this);
+		// like nng_msg_trim_u32, too short is Errno::inval
+		if (::nngc_msg_len(m) < static_cast<size_t>(Blittable<T>::Size)) return Errno::inval;
+		InvalidateViews();
+		void* p = ::nngc_msg_body(m);
+		Blittable<T>::Swap(p, 1, network);
+		value = Blittable<T>::Load(IntPtr(p));
+		return static_cast<Errno>(::nngc_msg_trim(m, Blittable<T>::Size));
+	}
+
+	generic <typename T> where T : value class
+	Errno Msg::Read(array<T>^ values, Int32 offset, Int32 count, [Optional] Nullable<bool> networkOrder)
+	{
+		bool network = networkOrder.HasValue && networkOrder.Value;
+		Errno err = Blittable<T>::Check(network);
+		if (err != Errno::ok) return err;
+		if (values == nullptr || offset < 0 || count < 0 || offset > values->Length - count) return Errno::inval;
+		if (this->msg == System::UIntPtr::Zero) return Errno::inval;
+		if (count == 0) return Errno::ok;
+		if ((err = Unshare()) != Errno::ok) return err;
+		nngc_msg m = coreMsg(this);
+		size_t bytes = static_cast<size_t>(count) * Blittable<T>::Size;
+		if (::nngc_msg_len(m) < bytes || bytes > UINT32_MAX) return Errno::inval;
+		InvalidateViews();
+		void* p = ::nngc_msg_body(m);
+		Blittable<T>::Swap(p, count, network);
+		Blittable<T>::CopyIn(IntPtr(p), values, offset, static_cast<UInt32>(bytes));
+		return static_cast<Errno>(::nngc_msg_trim(m, bytes));
+	}
+
+	// Socket, one message per call
+
+	generic <typename T> where T : value class
+	Errno Socket::Send(T value, [Optional] Nullable<Flag> flags, [Optional] Nullable<bool> networkOrder)
+	{
+		bool network = networkOrder.HasValue && networkOrder.Value;
+		Errno err = Blittable<T>::Check(network);
+		if (err != Errno::ok) return err;
+		nngc_msg m;
+		int result = ::nngc_msg_alloc(&m, Blittable<T>::Size);
+		if (result != 0) return static_cast<Errno>(result);
+		void* p = ::nngc_msg_body(m);
+		Blittable<T>::Store(value, IntPtr(p));
+		Blittable<T>::Swap(p, 1, network);
+		result = ::nngc_sendmsg(this->NngSocket, m, (flags.HasValue ? (int)(Flag)flags : NNG_FLAG_NONBLOCK));
+		if (result != 0) ::nngc_msg_free(m);
+		return static_cast<Errno>(result);
+	}
+
+	generic <typename T> where T : value class
+	Errno Socket::Send(array<T>^ values, Int32 offset, Int32 count, [Optional] Nullable<Flag> flags, [Optional] Nullable<bool> networkOrder)
+	{
+		bool network = networkOrder.HasValue && networkOrder.Value;
+		Errno err = Blittable<T>::Check(network);
+		if (err != Errno::ok) return err;
+		if (values == nullptr || offset < 0 || count < 0 || offset > values->Length - count) return Errno::inval;
+		size_t bytes = static_cast<size_t>(count) * Blittable<T>::Size;
+		if (bytes > UINT32_MAX) return Errno::msgsize;
+		nngc_msg m;
+		int result = ::nngc_msg_alloc(&m, bytes);
+		if (result != 0) return static_cast<Errno>(result);
+		void* p = ::nngc_msg_body(m);
+		if (count > 0) Blittable<T>::CopyOut(values, offset, IntPtr(p), static_cast<UInt32>(bytes));
+		Blittable<T>::Swap(p, count, network);
+		result = ::nngc_sendmsg(this->NngSocket, m, (flags.HasValue ? (int)(Flag)flags : NNG_FLAG_NONBLOCK));
+		if (result != 0) ::nngc_msg_free(m);
+		return static_cast<Errno>(result);
+	}
+
+	generic <typename T> where T : value class
+	Errno Socket::Receive([Out] T% value, [Optional] Nullable<Flag> flags, [Optional] Nullable<bool> networkOrder)
+	{
+		value = T();
+		bool network = networkOrder.HasValue && networkOrder.Value;
+		Errno err = Blittable<T>::Check(network);
+		if (err != Errno::ok) return err;
+		nngc_msg m;
+		int result = ::nngc_recvmsg(this->NngSocket, &m, (flags.HasValue ? (int)(Flag)flags : 0));
+		if (result != 0) return static_cast<Errno>(result);
+		void* p = ::nngc_msg_body(m);
+		if (::nngc_msg_len(m) != static_cast<size_t>(Blittable<T>::Size)) {
+			result = NNG_EMSGSIZE;
+		}
+		else {
+			Blittable<T>::Swap(p, 1, network);
+			value = Blittable<T>::Load(IntPtr(p));
+		}
+		::nngc_msg_free(m);
+		return static_cast<Errno>(result);
+	}
+
+	generic <typename T> where T : value class
+	Errno Socket::Receive(array<T>^ values, Int32 offset, Int32 count, [Out] Int32% received, [Optional] Nullable<Flag> flags, [Optional] Nullable<bool> networkOrder)
+	{
+		received = 0;
+		bool network = networkOrder.HasValue && networkOrder.Value;
+		Errno err = Blittable<T>::Check(network);
+		if (err != Errno::ok) return err;
+		if (values == nullptr || offset < 0 || count < 0 || offset > values->Length - count) return Errno::inval;
+		nngc_msg m;
+		int result = ::nngc_recvmsg(this->NngSocket, &m, (flags.HasValue ? (int)(Flag)flags : 0));
+		if (result != 0) return static_cast<Errno>(result);
+		void* p = ::nngc_msg_body(m);
+		size_t len = ::nngc_msg_len(m);
+		size_t n = len / Blittable<T>::Size;
+		if (len % Blittable<T>::Size != 0 || n > static_cast<size_t>(count)) {
+			result = NNG_EMSGSIZE;
+		}
+		else {
+			Blittable<T>::Swap(p, static_cast<Int64>(n), network);
+			if (n > 0) Blittable<T>::CopyIn(IntPtr(p), values, offset, static_cast<UInt32>(len));
+			received = static_cast<Int32>(n);
+		}
+		::nngc_msg_free(m);
+		return static_cast<Errno>(result);
+	}
+}
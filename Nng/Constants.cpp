@@ -12,39 +12,79 @@ Error strings and option strings
 #include "nng.h"
 #include "NngInternal.h"
 #include <cstring>
+#include <vcclr.h>
 
 namespace Nng {
 
 	System::String^ Constants::StrError(Errno error)
 	{
-		char* s = (char*) ::nng_strerror((int)error);
+		char* s = (char*) ::nngc_strerror((int)error);
 		if (s == nullptr) return nullptr;
 		return System::Text::Encoding::UTF8->GetString((unsigned char*)s, (long) ::strlen(s));
 	}
 	System::String^ Constants::Option(Nng::Option option)
 	{
-		switch (option) {
-
-		    case Option::sockname:   return "socket-name";
-				case Option::domain:		 return "compat:domain";
-				case Option::raw:				 return "raw";
-				case Option::linger:		 return "linger";
-				case Option::recvbuf:		 return "recv-buffer";
-				case Option::sendbuf:		 return "send-buffer";
-				case Option::recvfd:		 return "recv-fd";
-				case Option::sendfd:		 return "send-fd";
-				case Option::recvtimeo:	 return "recv-timeout";
-				case Option::sendtimeo:	 return "send-timeout";
-				case Option::locaddr:		 return "local-address";
-				case Option::remaddr:		 return "remote-address";
-				case Option::url:				 return "url";
-				case Option::maxttl:		 return "ttl-max";
-				case Option::protocol:	 return "protocol";
-				case Option::transport:	 return "transport";
-				case Option::recvmaxsz:	 return "recv-size-max";
-				case Option::reconnmint: return "reconnect-time-min";
-				case Option::reconnmaxt: return "reconnect-time-max";
-				default: return "";
+		const char* s = nativeOptionName(option);
+		if (s == nullptr) return "";
+		return gcnew System::String(s);
+	}
+
+	// the table is in the core, NngCore/CoreSocket.cpp, its numbers are the ones of Nng::Option
+	const char* nativeOptionName(Nng::Option option)
+	{
+		return ::nngc_option_name(static_cast<int>(option));
+	}
+
+	/*
+	Option names and URLs are few and used over and over, so they are converted to UTF-8 only once and
+	kept for the life of the process. The table is bounded, names beyond it are converted per call.
+	*/
+	static const int maxInternedStrings = 4096;
+
+	private ref class InternedStrings abstract sealed {
+	internal:
+		static System::Collections::Concurrent::ConcurrentDictionary<System::String^, IntPtr>^ table =
+			gcnew System::Collections::Concurrent::ConcurrentDictionary<System::String^, IntPtr>(System::StringComparer::Ordinal);
+	};
+
+	static char* toUtf8(System::String^ str)
+	{
+		pin_ptr<const wchar_t> chars = PtrToStringChars(str);
+		wchar_t* p = const_cast<wchar_t*>(static_cast<const wchar_t*>(chars));
+		int len = System::Text::Encoding::UTF8->GetByteCount(p, str->Length);
+		char* s = new char[len + 1];
+		System::Text::Encoding::UTF8->GetBytes(p, str->Length, reinterpret_cast<unsigned char*>(s), len);
+		s[len] = 0;
+		return s;
+	}
+
+	NativeString::NativeString(System::String^ str, bool intern)
+	{
+		this->owned = nullptr;
+		if (str == nullptr) {
+			this->str = "";
+			return;
+		}
+		if (intern) {
+			IntPtr found;
+			if (InternedStrings::table->TryGetValue(str, found)) {
+				this->str = static_cast<const char*>(found.ToPointer());
+				return;
+			}
+			if (InternedStrings::table->Count < maxInternedStrings) {
+				char* s = toUtf8(str);
+				found = InternedStrings::table->GetOrAdd(str, IntPtr(s));
+				if (found.ToPointer() != s) delete[] s; // another thread was faster
+				this->str = static_cast<const char*>(found.ToPointer());
+				return;
+			}
 		}
+		this->owned = toUtf8(str);
+		this->str = this->owned;
+	}
+
+	NativeString::~NativeString()
+	{
+		delete[] this->owned;
 	}
 }
\ No newline at end of file
@@ -20,9 +20,11 @@ namespace Nng {
 	Msg::Msg(size_t size)
 	{
 		nng_msg* newMsg;
-		int result = ::nng_msg_alloc(&newMsg, size);
-		this->msg = System::UIntPtr(newMsg);
+		int sizeClass;
+		int result = msgPoolAlloc(&newMsg, size, &sizeClass);
 		if (result != 0) throw gcnew NngException(Errno::nomem);
+		this->msg = System::UIntPtr(newMsg);
+		this->poolClass = sizeClass;
 	}
 
 	Msg::Msg(System::UIntPtr ptr)
@@ -33,16 +35,18 @@ namespace Nng {
 	Msg::~Msg()
 	{
 		if (this->msg != System::UIntPtr::Zero) {
-			::nng_msg_free(getNativeMsg(this));
+			Free();
 		}
 	}
 
 	Errno Msg::Alloc([Out] Msg^% msg, size_t size)
 	{
 		nng_msg* newMsg;
-		int result = ::nng_msg_alloc(&newMsg, size);
+		int sizeClass;
+		int result = msgPoolAlloc(&newMsg, size, &sizeClass);
 		if (result == 0) {
 			msg = gcnew Msg(System::UIntPtr(newMsg));
+			msg->poolClass = sizeClass;
 		}
 		else {
 			msg = nullptr;
@@ -52,20 +56,31 @@ namespace Nng {
 
 	void Msg::Free()
 	{
-		::nng_msg_free(getNativeMsg(this));
+		InvalidateViews();
+		if (this->shared != nullptr) {
+			ReleaseShared();
+			this->msg = System::UIntPtr::Zero;
+			return;
+		}
+		if (this->msg != System::UIntPtr::Zero) {
+			msgPoolFree(getNativeMsg(this), this->poolClass);
+		}
 		this->msg = System::UIntPtr::Zero;
+		this->poolClass = 0;
 	}
 
 	Errno  Msg::Realloc(size_t size)
 	{
-		return static_cast<Errno>(::nng_msg_realloc(getNativeMsg(this), size));
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
+		return static_cast<Errno>(::nngc_msg_realloc(coreMsg(this), size));
 	}
 
 	Errno  Msg::Dup([Out] Msg^% msgOut)
 	{
-		nng_msg* msgPtr = getNativeMsg(this);
-		nng_msg* newMsg;
-		int result = ::nng_msg_dup(&newMsg, msgPtr);
+		nngc_msg newMsg;
+		int result = ::nngc_msg_dup(&newMsg, coreMsg(this));
 		if (result == 0) {
 			msgOut = gcnew Msg(System::UIntPtr(newMsg));
 		}
@@ -76,13 +91,174 @@ namespace Nng {
 	}
 
 
+	/*
+	Shared messages. DupShared hands out further Msg objects on the same nng_msg, counted by a
+	SharedPayload. Reading works on the common nng_msg. Anything that would change it, and sending,
+	which gives it to nng, first calls Unshare: the last holder simply takes the nng_msg over, any
+	other gets its own copy. nng frees every message it sends, so each send still needs a message of
+	its own, but the copies are made one at a time right before they are handed over instead of all
+	at once, and never for copies which are only read or freed.
+	*/
+
+	private ref class SharedPayload {
+	internal:
+		UIntPtr msg;
+		Int32 poolClass;
+		Int32 refs;
+	};
+
+	Errno Msg::DupShared([Out] Msg^% msgOut)
+	{
+		msgOut = nullptr;
+		if (this->msg == System::UIntPtr::Zero) return Errno::inval;
+		if (this->shared == nullptr) {
+			auto payload = gcnew SharedPayload();
+			payload->msg = this->msg;
+			payload->poolClass = this->poolClass;
+			payload->refs = 1;
+			this->shared = payload;
+			this->poolClass = 0;
+		}
+		System::Threading::Interlocked::Increment(this->shared->refs);
+		msgOut = gcnew Msg(this->msg);
+		msgOut->shared = this->shared;
+		return Errno::ok;
+	}
+
+	bool Msg::IsShared::get()
+	{
+		return this->shared != nullptr && System::Threading::Interlocked::CompareExchange(this->shared->refs, 0, 0) > 1;
+	}
+
+	Errno Msg::Unshare()
+	{
+		if (this->shared == nullptr) return Errno::ok;
+		if (System::Threading::Interlocked::CompareExchange(this->shared->refs, 0, 0) == 1) {
+			// the last holder, nobody else can add a reference anymore
+			this->poolClass = this->shared->poolClass;
+			this->shared = nullptr;
+			return Errno::ok;
+		}
+		nngc_msg copy;
+		int result = ::nngc_msg_dup(&copy, coreMsg(this)); // copy before releasing, the others may free it then
+		if (result != 0) return static_cast<Errno>(result);
+		InvalidateViews();
+		ReleaseShared();
+		this->msg = System::UIntPtr(copy);
+		return Errno::ok;
+	}
+
+	void Msg::ReleaseShared()
+	{
+		SharedPayload^ payload = this->shared;
+		this->shared = nullptr;
+		this->poolClass = 0;
+		if (System::Threading::Interlocked::Decrement(payload->refs) == 0) {
+			msgPoolFree(reinterpret_cast<nng_msg*>(payload->msg.ToPointer()), payload->poolClass);
+		}
+	}
+
+	// Views on the native memory. They hand out nng's own buffers, so any operation that may move
+	// or release them has to close the streams first. Raw pointers cannot be tracked, the caller
+	// has to stop using them on its own.
+
+	static unsigned char emptyView; // UnmanagedMemoryStream doesn't like null pointers, even for length 0
+
+	void Msg::InvalidateViews()
+	{
+		this->changes++;
+		if (this->views == nullptr) return;
+		for each (System::IO::UnmanagedMemoryStream^ view in this->views) {
+			view->Close(); // any further access throws ObjectDisposedException
+		}
+		this->views = nullptr;
+	}
+
+	static System::IO::UnmanagedMemoryStream^ msg_view_stream(Msg^ msg, void* data, size_t size)
+	{
+		if (data == nullptr) data = &emptyView;
+		auto view = gcnew System::IO::UnmanagedMemoryStream(static_cast<unsigned char*>(data), static_cast<Int64>(size), static_cast<Int64>(size), System::IO::FileAccess::Read);
+		if (msg->views == nullptr) {
+			msg->views = gcnew System::Collections::Generic::List<System::IO::UnmanagedMemoryStream^>();
+		}
+		else if (msg->views->Count >= 8) {
+			// forget views the caller has already disposed, so a long lived message doesn't collect them
+			for (int i = msg->views->Count - 1; i >= 0; i--) {
+				if (!msg->views[i]->CanRead) msg->views->RemoveAt(i);
+			}
+		}
+		msg->views->Add(view);
+		return view;
+	}
+
+	static Errno msg_view_copy(void* data, size_t size, array<System::Byte>^ dest, Int32 offset)
+	{
+		if (dest == nullptr || offset < 0 || offset > dest->Length) return Errno::inval;
+		if (size > static_cast<size_t>(dest->Length - offset)) return Errno::msgsize;
+		if (size == 0) return Errno::ok;
+		pin_ptr<System::Byte> pin = &dest[offset];
+		memcpy(pin, data, size);
+		return Errno::ok;
+	}
+
+	Errno Msg::BodyView([Out] IntPtr% data, [Out] UInt64% size)
+	{
+		data = IntPtr::Zero;
+		size = 0;
+		if (this->msg == System::UIntPtr::Zero) return Errno::inval;
+		nngc_msg handle = coreMsg(this);
+		data = IntPtr(::nngc_msg_body(handle));
+		size = ::nngc_msg_len(handle);
+		return Errno::ok;
+	}
+
+	System::IO::UnmanagedMemoryStream^ Msg::BodyStream()
+	{
+		if (this->msg == System::UIntPtr::Zero) return nullptr;
+		nngc_msg handle = coreMsg(this);
+		return msg_view_stream(this, ::nngc_msg_body(handle), ::nngc_msg_len(handle));
+	}
+
+	Errno Msg::CopyTo(array<System::Byte>^ dest, Int32 offset)
+	{
+		if (this->msg == System::UIntPtr::Zero) return Errno::inval;
+		nngc_msg handle = coreMsg(this);
+		return msg_view_copy(::nngc_msg_body(handle), ::nngc_msg_len(handle), dest, offset);
+	}
+
+	Errno Msg::HeaderView([Out] IntPtr% data, [Out] UInt64% size)
+	{
+		data = IntPtr::Zero;
+		size = 0;
+		if (this->msg == System::UIntPtr::Zero) return Errno::inval;
+		nngc_msg handle = coreMsg(this);
+		data = IntPtr(::nngc_msg_header(handle));
+		size = ::nngc_msg_header_len(handle);
+		return Errno::ok;
+	}
+
+	System::IO::UnmanagedMemoryStream^ Msg::HeaderStream()
+	{
+		if (this->msg == System::UIntPtr::Zero) return nullptr;
+		nngc_msg handle = coreMsg(this);
+		return msg_view_stream(this, ::nngc_msg_header(handle), ::nngc_msg_header_len(handle));
+	}
+
+	Errno Msg::HeaderCopyTo(array<System::Byte>^ dest, Int32 offset)
+	{
+		if (this->msg == System::UIntPtr::Zero) return Errno::inval;
+		nngc_msg handle = coreMsg(this);
+		return msg_view_copy(::nngc_msg_header(handle), ::nngc_msg_header_len(handle), dest, offset);
+	}
+
+
 	// Concerning the body
 
 
 	array<System::Byte>^ Msg::Body() {
-		nng_msg* msgPtr = getNativeMsg(this);
-		void* data = ::nng_msg_body(msgPtr);
-		size_t size = ::nng_msg_len(msgPtr);
+		nngc_msg handle = coreMsg(this);
+		void* data = ::nngc_msg_body(handle);
+		size_t size = ::nngc_msg_len(handle);
 		if (size > INT32_MAX) throw gcnew OutOfMemoryException();
 		auto retVal = gcnew array<System::Byte>(static_cast<int>(size));
 		pin_ptr<System::Byte> pin = &retVal[0]; // this might or might not be needed, too lazy to research
@@ -92,55 +268,81 @@ namespace Nng {
 
 	Errno Msg::Append(array<System::Byte>^ data)
 	{
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
 		pin_ptr<System::Byte> pin = &data[0]; // this is certainly needed
-		return static_cast<Errno>(::nng_msg_append(getNativeMsg(this), pin, data->Length));
+		return static_cast<Errno>(::nngc_msg_append(coreMsg(this), pin, data->Length));
 	}
 
 	Errno Msg::Insert(array<System::Byte>^ data)
 	{
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
 		pin_ptr<System::Byte> pin = &data[0]; // this is certainly needed
-		return static_cast<Errno>(::nng_msg_insert(getNativeMsg(this), pin, data->Length));
+		return static_cast<Errno>(::nngc_msg_insert(coreMsg(this), pin, data->Length));
 	}
 
 	Errno  Msg::AppendU32(UInt32 value)
 	{
-		return static_cast<Errno>(::nng_msg_append_u32(getNativeMsg(this), value));
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
+		return static_cast<Errno>(::nngc_msg_append_u32(coreMsg(this), value));
 	}
 
 	Errno  Msg::InsertU32(UInt32 value)
 	{
-		return static_cast<Errno>(::nng_msg_insert_u32(getNativeMsg(this), value));
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
+		return static_cast<Errno>(::nngc_msg_insert_u32(coreMsg(this), value));
 	}
 
 	Errno  Msg::TrimU32([Out] UInt32% value)
 	{
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
 		UInt32 tempValue;
-		int retVal = ::nng_msg_trim_u32(getNativeMsg(this), &tempValue);
+		int retVal = ::nngc_msg_trim_u32(coreMsg(this), &tempValue);
 		value = tempValue;
 		return static_cast<Errno>(retVal);
 	}
 
 	Errno  Msg::ChopU32([Out] UInt32% value)
 	{
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
 		UInt32 tempValue;
-		int retVal = ::nng_msg_chop_u32(getNativeMsg(this), &tempValue);
+		int retVal = ::nngc_msg_chop_u32(coreMsg(this), &tempValue);
 		value = tempValue;
 		return static_cast<Errno>(retVal);
 	}
 
 	Errno  Msg::Trim(size_t size)
 	{
-		return static_cast<Errno>(::nng_msg_trim(getNativeMsg(this), size));
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
+		return static_cast<Errno>(::nngc_msg_trim(coreMsg(this), size));
 	}
 
 	Errno  Msg::Chop(size_t size)
 	{
-		return static_cast<Errno>(::nng_msg_chop(getNativeMsg(this), size));
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
+		return static_cast<Errno>(::nngc_msg_chop(coreMsg(this), size));
 	}
 
 	void Msg::Clear()
 	{
-		return ::nng_msg_clear(getNativeMsg(this));
+		if (Unshare() != Errno::ok) return; // the other copies must not see the change
+		InvalidateViews();
+		return ::nngc_msg_clear(coreMsg(this));
 	}
 
 	// concerning the header
@@ -148,9 +350,9 @@ namespace Nng {
 
 	array<System::Byte>^ Msg::Header()
 	{
-		nng_msg* msgPtr = getNativeMsg(this);
-		void* data = ::nng_msg_header(msgPtr);
-		size_t size = ::nng_msg_header_len(msgPtr);
+		nngc_msg handle = coreMsg(this);
+		void* data = ::nngc_msg_header(handle);
+		size_t size = ::nngc_msg_header_len(handle);
 		if (size > INT32_MAX) throw gcnew OutOfMemoryException();
 		auto retVal = gcnew array<System::Byte>(static_cast<int>(size));
 		pin_ptr<System::Byte> pin = &retVal[0]; // this might or might not be needed, too lazy to research
@@ -160,67 +362,94 @@ namespace Nng {
 
 	Errno Msg::HeaderAppend(array<System::Byte>^ data)
 	{
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
 		pin_ptr<System::Byte> pin = &data[0]; // this is certainly needed
-		return static_cast<Errno>(::nng_msg_header_append(getNativeMsg(this), pin, data->Length));
+		return static_cast<Errno>(::nngc_msg_header_append(coreMsg(this), pin, data->Length));
 	}
 
 	Errno Msg::HeaderInsert(array<System::Byte>^ data)
 	{
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
 		pin_ptr<System::Byte> pin = &data[0]; // this is certainly needed
-		return static_cast<Errno>(::nng_msg_header_insert(getNativeMsg(this), pin, data->Length));
+		return static_cast<Errno>(::nngc_msg_header_insert(coreMsg(this), pin, data->Length));
 	}
 
 	Errno  Msg::HeaderAppendU32(UInt32 value)
 	{
-		return static_cast<Errno>(::nng_msg_header_append_u32(getNativeMsg(this), value));
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
+		return static_cast<Errno>(::nngc_msg_header_append_u32(coreMsg(this), value));
 	}
 
 	Errno  Msg::HeaderInsertU32(UInt32 value)
 	{
-		return static_cast<Errno>(::nng_msg_header_insert_u32(getNativeMsg(this), value));
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
+		return static_cast<Errno>(::nngc_msg_header_insert_u32(coreMsg(this), value));
 	}
 
 	Errno  Msg::HeaderTrimU32([Out] UInt32% value)
 	{
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
 		UInt32 tempValue;
-		int retVal = ::nng_msg_header_trim_u32(getNativeMsg(this), &tempValue);
+		int retVal = ::nngc_msg_header_trim_u32(coreMsg(this), &tempValue);
 		value = tempValue;
 		return static_cast<Errno>(retVal);
 	}
 
 	Errno  Msg::HeaderChopU32([Out] UInt32% value)
 	{
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
 		UInt32 tempValue;
-		int retVal = ::nng_msg_header_chop_u32(getNativeMsg(this), &tempValue);
+		int retVal = ::nngc_msg_header_chop_u32(coreMsg(this), &tempValue);
 		value = tempValue;
 		return static_cast<Errno>(retVal);
 	}
 
 	Errno  Msg::HeaderTrim(size_t size)
 	{
-		return static_cast<Errno>(::nng_msg_header_trim(getNativeMsg(this), size));
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
+		return static_cast<Errno>(::nngc_msg_header_trim(coreMsg(this), size));
 	}
 
 	Errno  Msg::HeaderChop(size_t size)
 	{
-		return static_cast<Errno>(::nng_msg_header_chop(getNativeMsg(this), size));
+		Errno err = Unshare();
+		if (err != Errno::ok) return err;
+		InvalidateViews();
+		return static_cast<Errno>(::nngc_msg_header_chop(coreMsg(this), size));
 	}
 
 	void Msg::HeaderClear()
 	{
-		return ::nng_msg_header_clear(getNativeMsg(this));
+		if (Unshare() != Errno::ok) return;
+		InvalidateViews();
+		return ::nngc_msg_header_clear(coreMsg(this));
 	}
 
 	// misc
 
 	int Msg::GetPipe()
 	{
-		return ::nng_msg_get_pipe(getNativeMsg(this));
+		return static_cast<int>(::nngc_msg_get_pipe(coreMsg(this)));
 	}
 
 	void Msg::SetPipe(int pipe)
 	{
-		return ::nng_msg_set_pipe(getNativeMsg(this), pipe);
+		if (Unshare() != Errno::ok) return;
+		::nngc_msg_set_pipe(coreMsg(this), static_cast<uint32_t>(pipe));
 	}
 
 
@@ -0,0 +1,101 @@
+/*
+Nng wrapper
+
+Socket metrics. The counting is done by the core, NngCore/CoreMetrics.cpp, a snapshot is one native call
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+
+namespace Nng {
+
+	Errno Socket::EnableMetrics()
+	{
+		return static_cast<Errno>(::nngc_socket_metrics_enable(this->NngSocket));
+	}
+
+	Errno Socket::GetMetrics([Out] SocketMetrics% metrics)
+	{
+		nngc_socket_metrics m;
+		int result = ::nngc_socket_metrics_read(this->NngSocket, &m);
+		SocketMetrics read;
+		read.MessagesSent = m.msgs_sent;
+		read.BytesSent = m.bytes_sent;
+		read.MessagesReceived = m.msgs_received;
+		read.BytesReceived = m.bytes_received;
+		read.DialerConnects = m.dialer_connects;
+		read.ListenerConnects = m.listener_connects;
+		read.Disconnects = m.disconnects;
+		read.AioCompletions = m.aio_completions;
+		read.Errors = gcnew array<UInt64>(NNGC_METRICS_ERRORS);
+		for (int i = 0; i < NNGC_METRICS_ERRORS; i++) read.Errors[i] = m.errors[i];
+		read.AioLatency = gcnew array<UInt64>(NNGC_METRICS_BUCKETS);
+		for (int i = 0; i < NNGC_METRICS_BUCKETS; i++) read.AioLatency[i] = m.aio_latency[i];
+		metrics = read;
+		return static_cast<Errno>(result);
+	}
+
+	UInt64 SocketMetrics::Again::get()
+	{
+		return ErrorCount(Errno::again);
+	}
+
+	UInt64 SocketMetrics::TimedOut::get()
+	{
+		return ErrorCount(Errno::timedout);
+	}
+
+	UInt64 SocketMetrics::ErrorCount(Errno error)
+	{
+		int i = static_cast<int>(error);
+		if (this->Errors == nullptr || i < 0) return 0;
+		return this->Errors[(i < this->Errors->Length) ? i : this->Errors->Length - 1];
+	}
+
+	Double SocketMetrics::AioLatencyPercentile(Double share)
+	{
+		if (this->AioLatency == nullptr) return 0;
+		UInt64 total = 0;
+		for (int i = 0; i < this->AioLatency->Length; i++) total += this->AioLatency[i];
+		if (total == 0) return 0;
+
+		Double wanted = share * total;
+		UInt64 seen = 0;
+		for (int i = 0; i < this->AioLatency->Length; i++) {
+			seen += this->AioLatency[i];
+			if (seen >= wanted) return (i == 0) ? 1 : System::Math::Pow(2, i);
+		}
+		return System::Math::Pow(2, this->AioLatency->Length - 1);
+	}
+
+	static array<UInt64>^ difference(array<UInt64>^ after, array<UInt64>^ before)
+	{
+		if (after == nullptr) return nullptr;
+		auto d = gcnew array<UInt64>(after->Length);
+		for (int i = 0; i < after->Length; i++) {
+			d[i] = after[i] - ((before != nullptr && i < before->Length) ? before[i] : 0);
+		}
+		return d;
+	}
+
+	SocketMetrics SocketMetrics::operator-(SocketMetrics after, SocketMetrics before)
+	{
+		SocketMetrics d;
+		d.MessagesSent = after.MessagesSent - before.MessagesSent;
+		d.BytesSent = after.BytesSent - before.BytesSent;
+		d.MessagesReceived = after.MessagesReceived - before.MessagesReceived;
+		d.BytesReceived = after.BytesReceived - before.BytesReceived;
+		d.DialerConnects = after.DialerConnects - before.DialerConnects;
+		d.ListenerConnects = after.ListenerConnects - before.ListenerConnects;
+		d.Disconnects = after.Disconnects - before.Disconnects;
+		d.AioCompletions = after.AioCompletions - before.AioCompletions;
+		d.Errors = difference(after.Errors, before.Errors);
+		d.AioLatency = difference(after.AioLatency, before.AioLatency);
+		return d;
+	}
+}
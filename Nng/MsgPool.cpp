@@ -0,0 +1,324 @@
+/*
+Nng wrapper
+
+Class MsgPool, an optional cache of native messages
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <msclr/lock.h>
+
+namespace Nng {
+
+	/*
+	nng has no hook for its message allocator, so the pool keeps whole nng_msg objects instead. A returned
+	message is cleared but keeps its buffer, and nng_msg_realloc() within the old capacity doesn't allocate.
+
+	We don't know the capacity of a message, so it is remembered as a size class in the Msg object:
+	a message allocated from class c holds at least sizeClasses[c] bytes. Messages which didn't come from
+	the pool (received ones for example) are sorted into the largest class not bigger than their length.
+
+	Every thread has its own small cache, reached through a [ThreadStatic] field. Its lock is only ever
+	contended by Disable and Trim, which drain the caches of all threads: every cache is registered in
+	MsgPoolState::caches. When a cache runs empty or full, half a cache is moved from or to the global
+	list in one go. Disable bumps a generation number, a cache of an older generation is empty and no
+	longer registered, its thread gets a new one.
+
+	Locks are taken in the order caches, thread cache, global stack.
+
+	Class numbers handed out to Msg are 1-based, 0 means "not from the pool".
+	*/
+
+	private ref class MsgPoolThreadCache {
+	internal:
+		array<array<UIntPtr>^>^ slots;
+		array<Int32>^ counts;
+		Int32 generation;
+		System::Threading::Thread^ thread; // a dead one's cache is dropped by Trim
+		[ThreadStatic] static MsgPoolThreadCache^ current;
+	};
+
+	private ref class MsgPoolState abstract sealed {
+	internal:
+		static bool enabled = false;
+		static Int32 generation = 0;
+		static array<Int32>^ sizeClasses = gcnew array<Int32>{ 64, 128, 256, 512, 1024, 2048, 4096 };
+		static Int32 threadCacheSize = 32;
+		static Int32 globalSize = 1024;
+		static array<array<UIntPtr>^>^ global; // one stack per size class, each one is also its own lock
+		static array<Int32>^ globalCounts;
+		static Int64 hits;
+		static Int64 misses;
+		static Int64 returns;
+		static Int64 discards;
+		// the caches of all threads, also the lock of enabling, disabling and creating a cache
+		static System::Collections::Generic::List<MsgPoolThreadCache^>^ caches = gcnew System::Collections::Generic::List<MsgPoolThreadCache^>();
+	};
+
+	// smallest class which can hold size bytes, -1 if there is none
+	static int msg_pool_class_above(size_t size)
+	{
+		auto sizeClasses = MsgPoolState::sizeClasses;
+		for (int i = 0; i < sizeClasses->Length; i++) {
+			if (size <= static_cast<size_t>(sizeClasses[i])) return i;
+		}
+		return -1;
+	}
+
+	// largest class not bigger than size, -1 if there is none
+	static int msg_pool_class_below(size_t size)
+	{
+		auto sizeClasses = MsgPoolState::sizeClasses;
+		for (int i = sizeClasses->Length - 1; i >= 0; i--) {
+			if (size >= static_cast<size_t>(sizeClasses[i])) return i;
+		}
+		return -1;
+	}
+
+	// the caller holds the lock of the cache
+	static void msg_pool_release(MsgPoolThreadCache^ cache)
+	{
+		for (int c = 0; c < cache->slots->Length; c++) {
+			for (int i = 0; i < cache->counts[c]; i++) {
+				::nng_msg_free(static_cast<nng_msg*>(cache->slots[c][i].ToPointer()));
+			}
+			cache->counts[c] = 0;
+		}
+	}
+
+	// nullptr if the pool was disabled meanwhile. The caller locks the cache and checks the generation again
+	static MsgPoolThreadCache^ msg_pool_thread_cache()
+	{
+		auto cache = MsgPoolThreadCache::current;
+		if (cache != nullptr && cache->generation == MsgPoolState::generation) return cache;
+
+		// one of an older generation was drained by Disable
+		auto caches = MsgPoolState::caches;
+		msclr::lock l(caches);
+		if (!MsgPoolState::enabled) return nullptr;
+		int classes = MsgPoolState::sizeClasses->Length;
+		cache = gcnew MsgPoolThreadCache();
+		cache->generation = MsgPoolState::generation;
+		cache->thread = System::Threading::Thread::CurrentThread;
+		cache->counts = gcnew array<Int32>(classes);
+		cache->slots = gcnew array<array<UIntPtr>^>(classes);
+		for (int c = 0; c < classes; c++) {
+			cache->slots[c] = gcnew array<UIntPtr>(MsgPoolState::threadCacheSize);
+		}
+		caches->Add(cache);
+		MsgPoolThreadCache::current = cache;
+		return cache;
+	}
+
+	// move up to half a thread cache from the global list
+	static void msg_pool_refill(MsgPoolThreadCache^ cache, int c)
+	{
+		auto stack = MsgPoolState::global[c];
+		msclr::lock l(stack);
+		int n = MsgPoolState::globalCounts[c];
+		int want = cache->slots[c]->Length / 2;
+		if (want < 1) want = 1;
+		if (n < want) want = n;
+		for (int i = 0; i < want; i++) {
+			cache->slots[c][cache->counts[c]++] = stack[--n];
+		}
+		MsgPoolState::globalCounts[c] = n;
+	}
+
+	// move half of a full thread cache to the global list, whatever doesn't fit there is freed
+	static void msg_pool_spill(MsgPoolThreadCache^ cache, int c)
+	{
+		int move = cache->counts[c] / 2;
+		if (move < 1) move = cache->counts[c];
+		{
+			auto stack = MsgPoolState::global[c];
+			msclr::lock l(stack);
+			int n = MsgPoolState::globalCounts[c];
+			while (move > 0 && n < stack->Length) {
+				stack[n++] = cache->slots[c][--cache->counts[c]];
+				move--;
+			}
+			MsgPoolState::globalCounts[c] = n;
+		}
+		for (; move > 0; move--) {
+			::nng_msg_free(static_cast<nng_msg*>(cache->slots[c][--cache->counts[c]].ToPointer()));
+			System::Threading::Interlocked::Increment(MsgPoolState::discards);
+		}
+	}
+
+	int msgPoolAlloc(nng_msg** msg, size_t size, int* sizeClass)
+	{
+		*sizeClass = 0;
+		if (!MsgPoolState::enabled) return ::nng_msg_alloc(msg, size);
+
+		int c = msg_pool_class_above(size);
+		if (c < 0) return ::nng_msg_alloc(msg, size); // too big to be pooled, not counted
+
+		auto cache = msg_pool_thread_cache();
+		if (cache == nullptr) return ::nng_msg_alloc(msg, size);
+		msclr::lock l(cache);
+		// disabled meanwhile, maybe reconfigured and enabled again
+		if (cache->generation != MsgPoolState::generation || c >= cache->slots->Length) return ::nng_msg_alloc(msg, size);
+		if (cache->counts[c] == 0) msg_pool_refill(cache, c);
+		if (cache->counts[c] > 0) {
+			nng_msg* pooled = static_cast<nng_msg*>(cache->slots[c][--cache->counts[c]].ToPointer());
+			int result = ::nng_msg_realloc(pooled, size); // stays within the capacity, no allocation
+			if (result != 0) {
+				::nng_msg_free(pooled);
+				return result;
+			}
+			System::Threading::Interlocked::Increment(MsgPoolState::hits);
+			*msg = pooled;
+			*sizeClass = c + 1;
+			return 0;
+		}
+
+		System::Threading::Interlocked::Increment(MsgPoolState::misses);
+		int result = ::nng_msg_alloc(msg, MsgPoolState::sizeClasses[c]);
+		if (result == 0) {
+			result = ::nng_msg_realloc(*msg, size); // shrinking only sets the length
+			*sizeClass = c + 1;
+		}
+		return result;
+	}
+
+	void msgPoolFree(nng_msg* msg, int sizeClass)
+	{
+		if (!MsgPoolState::enabled) {
+			::nng_msg_free(msg);
+			return;
+		}
+		auto sizeClasses = MsgPoolState::sizeClasses;
+		size_t size = ::nng_msg_len(msg);
+		int c = (sizeClass > 0 && sizeClass <= sizeClasses->Length) ? sizeClass - 1 : -1;
+		int below = msg_pool_class_below(size);
+		if (below > c) c = below;
+		if (c < 0 || size > static_cast<size_t>(sizeClasses[sizeClasses->Length - 1])) {
+			// too small to be useful, or grown so much that it would waste memory in the pool
+			::nng_msg_free(msg);
+			return;
+		}
+
+		::nng_msg_clear(msg);
+		::nng_msg_header_clear(msg);
+		auto cache = msg_pool_thread_cache();
+		if (cache == nullptr) {
+			::nng_msg_free(msg);
+			return;
+		}
+		msclr::lock l(cache);
+		if (cache->generation != MsgPoolState::generation || c >= cache->slots->Length) { // disabled meanwhile
+			::nng_msg_free(msg);
+			return;
+		}
+		if (cache->counts[c] == cache->slots[c]->Length) msg_pool_spill(cache, c);
+		if (cache->counts[c] < cache->slots[c]->Length) {
+			cache->slots[c][cache->counts[c]++] = UIntPtr(msg);
+			System::Threading::Interlocked::Increment(MsgPoolState::returns);
+		}
+		else { // zero sized thread cache
+			::nng_msg_free(msg);
+			System::Threading::Interlocked::Increment(MsgPoolState::discards);
+		}
+	}
+
+	static void msg_pool_free_global()
+	{
+		auto global = MsgPoolState::global;
+		if (global == nullptr) return;
+		for (int c = 0; c < global->Length; c++) {
+			msclr::lock l(global[c]);
+			for (int i = 0; i < MsgPoolState::globalCounts[c]; i++) {
+				::nng_msg_free(static_cast<nng_msg*>(global[c][i].ToPointer()));
+			}
+			MsgPoolState::globalCounts[c] = 0;
+		}
+	}
+
+	// empties the caches of all threads, drop removes them from the list. The caller holds the lock of the list
+	static void msg_pool_drain(bool drop)
+	{
+		auto caches = MsgPoolState::caches;
+		for (int i = caches->Count - 1; i >= 0; i--) {
+			auto cache = caches[i];
+			{
+				msclr::lock l(cache);
+				msg_pool_release(cache);
+			}
+			if (drop || !cache->thread->IsAlive) caches->RemoveAt(i);
+		}
+	}
+
+	Errno MsgPool::Configure(array<Int32>^ sizeClasses, Int32 threadCacheSize, Int32 globalSize)
+	{
+		msclr::lock l(MsgPoolState::caches);
+		if (MsgPoolState::enabled) return Errno::busy;
+		if (threadCacheSize < 0 || globalSize < 0) return Errno::inval;
+		if (sizeClasses != nullptr) {
+			if (sizeClasses->Length == 0) return Errno::inval;
+			for (int i = 0; i < sizeClasses->Length; i++) {
+				if (sizeClasses[i] <= 0 || (i > 0 && sizeClasses[i] <= sizeClasses[i - 1])) return Errno::inval;
+			}
+			MsgPoolState::sizeClasses = safe_cast<array<Int32>^>(sizeClasses->Clone());
+		}
+		MsgPoolState::threadCacheSize = threadCacheSize;
+		MsgPoolState::globalSize = globalSize;
+		return Errno::ok;
+	}
+
+	void MsgPool::Enable()
+	{
+		msclr::lock l(MsgPoolState::caches);
+		if (MsgPoolState::enabled) return;
+		int classes = MsgPoolState::sizeClasses->Length;
+		auto global = gcnew array<array<UIntPtr>^>(classes);
+		for (int c = 0; c < classes; c++) {
+			global[c] = gcnew array<UIntPtr>(MsgPoolState::globalSize);
+		}
+		MsgPoolState::globalCounts = gcnew array<Int32>(classes);
+		MsgPoolState::global = global;
+		System::Threading::Interlocked::Increment(MsgPoolState::generation);
+		MsgPoolState::enabled = true;
+	}
+
+	void MsgPool::Disable()
+	{
+		msclr::lock l(MsgPoolState::caches);
+		if (!MsgPoolState::enabled) return;
+		MsgPoolState::enabled = false;
+		// a thread which locks its cache after this sees the new generation and leaves it alone
+		System::Threading::Interlocked::Increment(MsgPoolState::generation);
+		msg_pool_drain(true);
+		msg_pool_free_global(); // after the caches, they may still spill into it until they are drained
+	}
+
+	bool MsgPool::Enabled::get()
+	{
+		return MsgPoolState::enabled;
+	}
+
+	void MsgPool::Trim()
+	{
+		msclr::lock l(MsgPoolState::caches);
+		msg_pool_drain(false);
+		msg_pool_free_global();
+	}
+
+	Int64 MsgPool::Hits::get() { return System::Threading::Interlocked::Read(MsgPoolState::hits); }
+	Int64 MsgPool::Misses::get() { return System::Threading::Interlocked::Read(MsgPoolState::misses); }
+	Int64 MsgPool::Returns::get() { return System::Threading::Interlocked::Read(MsgPoolState::returns); }
+	Int64 MsgPool::Discards::get() { return System::Threading::Interlocked::Read(MsgPoolState::discards); }
+
+	void MsgPool::ResetCounters()
+	{
+		System::Threading::Interlocked::Exchange(MsgPoolState::hits, 0);
+		System::Threading::Interlocked::Exchange(MsgPoolState::misses, 0);
+		System::Threading::Interlocked::Exchange(MsgPoolState::returns, 0);
+		System::Threading::Interlocked::Exchange(MsgPoolState::discards, 0);
+	}
+}
@@ -0,0 +1,240 @@
+/*
+Nng wrapper
+
+Class MsgReader, decodes fields from a Msg without changing it
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <cstring>
+#include <cstdlib>
+
+// The reader takes the pointer and length of the body or header once, every read afterwards is a
+// bounds check and a memory access in managed code. Nothing is trimmed, moved or copied.
+#pragma managed(push, off)
+
+static void msg_reader_open(nng_msg* msg, bool header, const unsigned char** data, size_t* size)
+{
+	if (header) {
+		*data = static_cast<const unsigned char*>(::nng_msg_header(msg));
+		*size = ::nng_msg_header_len(msg);
+	}
+	else {
+		*data = static_cast<const unsigned char*>(::nng_msg_body(msg));
+		*size = ::nng_msg_len(msg);
+	}
+}
+
+#pragma managed(pop)
+
+namespace Nng {
+
+	MsgReader::MsgReader()
+	{
+	}
+
+	MsgReader::MsgReader(Msg^ msg, [Optional] Nullable<bool> header)
+	{
+		Errno err = Initialize(this, msg, header.HasValue && (bool)header);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno MsgReader::Open([Out] MsgReader^% reader, Msg^ msg, [Optional] Nullable<bool> header)
+	{
+		reader = gcnew MsgReader();
+		Errno err = Initialize(reader, msg, header.HasValue && (bool)header);
+		if (err != Errno::ok) reader = nullptr;
+		return err;
+	}
+
+	Errno MsgReader::Initialize(MsgReader^ reader, Msg^ msg, bool header)
+	{
+		if (msg == nullptr || msg->msg == System::UIntPtr::Zero) return Errno::inval;
+		const unsigned char* data;
+		size_t size;
+		msg_reader_open(getNativeMsg(msg), header, &data, &size);
+		reader->target = msg;
+		reader->native = getNativeMsg(msg);
+		reader->changes = msg->changes;
+		reader->data = data;
+		reader->size = size;
+		reader->pos = 0;
+		return Errno::ok;
+	}
+
+	// Freeing, sending or changing the message goes through InvalidateViews, after that data may be gone.
+	// A shared payload stays too: target holds a reference to it until it is freed or unshared
+	bool MsgReader::Valid()
+	{
+		return getNativeMsg(this->target) == this->native && this->target->changes == this->changes;
+	}
+
+	// like nng_msg_trim_u32, reading past the end is Errno::inval and doesn't move the cursor
+	Errno MsgReader::Take(size_t size, const unsigned char*& p)
+	{
+		if (!Valid()) return Errno::state;
+		if (size > this->size - this->pos) return Errno::inval;
+		p = this->data + this->pos;
+		this->pos += size;
+		return Errno::ok;
+	}
+
+	// Windows is little endian, so only big endian values are swapped
+
+	Errno MsgReader::ReadU8([Out] Byte% value)
+	{
+		const unsigned char* p;
+		Errno err = Take(1, p);
+		value = (err == Errno::ok) ? *p : 0;
+		return err;
+	}
+
+	Errno MsgReader::ReadU16([Out] UInt16% value)
+	{
+		const unsigned char* p;
+		unsigned short v = 0;
+		Errno err = Take(2, p);
+		if (err == Errno::ok) {
+			::memcpy(&v, p, 2);
+			if (!this->LittleEndian) v = _byteswap_ushort(v);
+		}
+		value = v;
+		return err;
+	}
+
+	Errno MsgReader::ReadU32([Out] UInt32% value)
+	{
+		const unsigned char* p;
+		unsigned long v = 0;
+		Errno err = Take(4, p);
+		if (err == Errno::ok) {
+			::memcpy(&v, p, 4);
+			if (!this->LittleEndian) v = _byteswap_ulong(v);
+		}
+		value = v;
+		return err;
+	}
+
+	Errno MsgReader::ReadU64([Out] UInt64% value)
+	{
+		const unsigned char* p;
+		unsigned __int64 v = 0;
+		Errno err = Take(8, p);
+		if (err == Errno::ok) {
+			::memcpy(&v, p, 8);
+			if (!this->LittleEndian) v = _byteswap_uint64(v);
+		}
+		value = v;
+		return err;
+	}
+
+	Errno MsgReader::ReadFloat([Out] Single% value)
+	{
+		UInt32 bits;
+		Errno err = ReadU32(bits);
+		float v;
+		::memcpy(&v, &bits, 4);
+		value = v;
+		return err;
+	}
+
+	Errno MsgReader::ReadDouble([Out] Double% value)
+	{
+		UInt64 bits;
+		Errno err = ReadU64(bits);
+		double v;
+		::memcpy(&v, &bits, 8);
+		value = v;
+		return err;
+	}
+
+	Errno MsgReader::ReadVarint([Out] UInt64% value)
+	{
+		value = 0;
+		if (!Valid()) return Errno::state;
+		UInt64 v = 0;
+		size_t i = this->pos;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (i >= this->size) return Errno::inval;
+			unsigned char b = this->data[i++];
+			v |= static_cast<UInt64>(b & 0x7F) << shift;
+			if ((b & 0x80) == 0) {
+				this->pos = i;
+				value = v;
+				return Errno::ok;
+			}
+		}
+		return Errno::proto; // more than 10 bytes, not written by MsgWriter
+	}
+
+	Errno MsgReader::ReadVarintSigned([Out] Int64% value)
+	{
+		UInt64 v;
+		Errno err = ReadVarint(v);
+		value = static_cast<Int64>(v >> 1) ^ -static_cast<Int64>(v & 1); // zigzag
+		return err;
+	}
+
+	Errno MsgReader::ReadString([Out] System::String^% value)
+	{
+		value = nullptr;
+		size_t start = this->pos;
+		UInt64 count;
+		Errno err = ReadVarint(count);
+		if (err != Errno::ok) return err;
+		const unsigned char* p;
+		if (count > static_cast<UInt64>(Int32::MaxValue)) err = Errno::inval;
+		else err = Take(static_cast<size_t>(count), p);
+		if (err != Errno::ok) {
+			this->pos = start;
+			return err;
+		}
+		value = System::Text::Encoding::UTF8->GetString(const_cast<unsigned char*>(p), static_cast<int>(count));
+		return Errno::ok;
+	}
+
+	Errno MsgReader::Read(array<Byte>^ dest, Int32 offset, Int32 count)
+	{
+		if (dest == nullptr || offset < 0 || count < 0 || offset > dest->Length - count) return Errno::inval;
+		const unsigned char* p;
+		Errno err = Take(count, p);
+		if (err != Errno::ok || count == 0) return err;
+		pin_ptr<Byte> d = &dest[offset];
+		::memcpy(d, p, count);
+		return Errno::ok;
+	}
+
+	Errno MsgReader::Slice(size_t size, [Out] IntPtr% data)
+	{
+		const unsigned char* p;
+		Errno err = Take(size, p);
+		data = (err == Errno::ok) ? IntPtr(const_cast<unsigned char*>(p)) : IntPtr::Zero;
+		return err;
+	}
+
+	Errno MsgReader::Skip(size_t size)
+	{
+		const unsigned char* p;
+		return Take(size, p);
+	}
+
+	UInt64 MsgReader::Position::get()
+	{
+		return this->pos;
+	}
+
+	void MsgReader::Position::set(UInt64 position)
+	{
+		this->pos = position < this->size ? static_cast<size_t>(position) : this->size;
+	}
+
+	UInt64 MsgReader::Remaining::get()
+	{
+		return this->size - this->pos;
+	}
+}
@@ -0,0 +1,237 @@
+/*
+Nng wrapper
+
+Class MsgWriter, encodes fields straight into the body of a Msg
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <cstring>
+#include <cstdlib>
+#include <vcclr.h>
+
+// A writer grows the body once by the reserved capacity and hands out its native memory; the fields
+// are then stored with plain memory writes. Only growing beyond the reserve and the final Commit call
+// into nng, and each of those is one native function.
+#pragma managed(push, off)
+
+// grows the body by size bytes, *start is the length before
+static int msg_writer_grow(nng_msg* msg, size_t size, unsigned char** body, size_t* start)
+{
+	size_t len = ::nng_msg_len(msg);
+	int result = ::nng_msg_realloc(msg, len + size);
+	if (result != 0) return result;
+	*body = static_cast<unsigned char*>(::nng_msg_body(msg));
+	*start = len;
+	return 0;
+}
+
+#pragma managed(pop)
+
+namespace Nng {
+
+	MsgWriter::MsgWriter()
+	{
+	}
+
+	MsgWriter::MsgWriter(Msg^ msg, size_t capacity)
+	{
+		Errno err = Initialize(this, msg, capacity);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno MsgWriter::Begin([Out] MsgWriter^% writer, Msg^ msg, size_t capacity)
+	{
+		writer = gcnew MsgWriter();
+		Errno err = Initialize(writer, msg, capacity);
+		if (err != Errno::ok) writer = nullptr;
+		return err;
+	}
+
+	Errno MsgWriter::Initialize(MsgWriter^ writer, Msg^ msg, size_t capacity)
+	{
+		if (msg == nullptr || msg->msg == System::UIntPtr::Zero) return Errno::inval;
+		Errno err = msg->Unshare();
+		if (err != Errno::ok) return err;
+		msg->InvalidateViews();
+		nng_msg* native = getNativeMsg(msg);
+		unsigned char* body;
+		size_t start;
+		int result = msg_writer_grow(native, capacity, &body, &start);
+		if (result != 0) return static_cast<Errno>(result);
+		writer->target = msg;
+		writer->native = native;
+		writer->body = body;
+		writer->pos = start;
+		writer->end = start + capacity;
+		writer->start = start;
+		return Errno::ok;
+	}
+
+	Errno MsgWriter::Reserve(size_t size, unsigned char*& p)
+	{
+		if (this->native == nullptr) return Errno::state;
+		// the message must not have been sent or freed while the writer was open, body would be gone with it
+		if (getNativeMsg(this->target) != this->native) return Errno::state;
+		if (size > this->end - this->pos) {
+			size_t more = this->end - this->start; // double what was written and reserved so far
+			if (more < size) more = size;
+			this->target->InvalidateViews();
+			unsigned char* body;
+			size_t len;
+			int result = msg_writer_grow(static_cast<nng_msg*>(this->native), more, &body, &len);
+			if (result != 0) return static_cast<Errno>(result);
+			this->body = body;
+			this->end = len + more;
+		}
+		p = this->body + this->pos;
+		this->pos += size;
+		return Errno::ok;
+	}
+
+	// Windows is little endian, so only big endian values are swapped
+
+	Errno MsgWriter::WriteU8(Byte value)
+	{
+		unsigned char* p;
+		Errno err = Reserve(1, p);
+		if (err != Errno::ok) return err;
+		*p = value;
+		return Errno::ok;
+	}
+
+	Errno MsgWriter::WriteU16(UInt16 value)
+	{
+		unsigned char* p;
+		Errno err = Reserve(2, p);
+		if (err != Errno::ok) return err;
+		unsigned short v = this->LittleEndian ? value : _byteswap_ushort(value);
+		::memcpy(p, &v, 2);
+		return Errno::ok;
+	}
+
+	Errno MsgWriter::WriteU32(UInt32 value)
+	{
+		unsigned char* p;
+		Errno err = Reserve(4, p);
+		if (err != Errno::ok) return err;
+		unsigned long v = this->LittleEndian ? value : _byteswap_ulong(value);
+		::memcpy(p, &v, 4);
+		return Errno::ok;
+	}
+
+	Errno MsgWriter::WriteU64(UInt64 value)
+	{
+		unsigned char* p;
+		Errno err = Reserve(8, p);
+		if (err != Errno::ok) return err;
+		unsigned __int64 v = this->LittleEndian ? value : _byteswap_uint64(value);
+		::memcpy(p, &v, 8);
+		return Errno::ok;
+	}
+
+	Errno MsgWriter::WriteFloat(Single value)
+	{
+		UInt32 bits;
+		::memcpy(&bits, &value, 4);
+		return WriteU32(bits);
+	}
+
+	Errno MsgWriter::WriteDouble(Double value)
+	{
+		UInt64 bits;
+		::memcpy(&bits, &value, 8);
+		return WriteU64(bits);
+	}
+
+	static size_t varint_size(UInt64 value)
+	{
+		size_t n = 1;
+		while (value >= 0x80) {
+			value >>= 7;
+			n++;
+		}
+		return n;
+	}
+
+	static void varint_put(unsigned char* p, UInt64 value)
+	{
+		while (value >= 0x80) {
+			*p++ = static_cast<unsigned char>(value | 0x80);
+			value >>= 7;
+		}
+		*p = static_cast<unsigned char>(value);
+	}
+
+	Errno MsgWriter::WriteVarint(UInt64 value)
+	{
+		unsigned char* p;
+		Errno err = Reserve(varint_size(value), p);
+		if (err != Errno::ok) return err;
+		varint_put(p, value);
+		return Errno::ok;
+	}
+
+	Errno MsgWriter::WriteVarintSigned(Int64 value)
+	{
+		return WriteVarint((static_cast<UInt64>(value) << 1) ^ static_cast<UInt64>(value >> 63)); // zigzag
+	}
+
+	Errno MsgWriter::Write(array<Byte>^ data, Int32 offset, Int32 count)
+	{
+		if (data == nullptr || offset < 0 || count < 0 || offset > data->Length - count) return Errno::inval;
+		unsigned char* p;
+		Errno err = Reserve(count, p);
+		if (err != Errno::ok || count == 0) return err;
+		pin_ptr<Byte> src = &data[offset];
+		::memcpy(p, src, count);
+		return Errno::ok;
+	}
+
+	Errno MsgWriter::Write(IntPtr data, size_t size)
+	{
+		if (data == IntPtr::Zero && size > 0) return Errno::inval;
+		unsigned char* p;
+		Errno err = Reserve(size, p);
+		if (err != Errno::ok || size == 0) return err;
+		::memcpy(p, data.ToPointer(), size);
+		return Errno::ok;
+	}
+
+	Errno MsgWriter::WriteString(System::String^ value)
+	{
+		if (value == nullptr) return Errno::inval;
+		pin_ptr<const wchar_t> chars = PtrToStringChars(value);
+		wchar_t* s = const_cast<wchar_t*>(static_cast<const wchar_t*>(chars));
+		int count = System::Text::Encoding::UTF8->GetByteCount(s, value->Length);
+		size_t prefix = varint_size(count);
+		unsigned char* p;
+		Errno err = Reserve(prefix + count, p);
+		if (err != Errno::ok) return err;
+		varint_put(p, count);
+		if (count > 0) System::Text::Encoding::UTF8->GetBytes(s, value->Length, p + prefix, count);
+		return Errno::ok;
+	}
+
+	UInt64 MsgWriter::Written::get()
+	{
+		return this->pos - this->start;
+	}
+
+	Errno MsgWriter::Commit()
+	{
+		if (this->native == nullptr) return Errno::state;
+		nng_msg* native = static_cast<nng_msg*>(this->native);
+		this->native = nullptr;
+		if (getNativeMsg(this->target) != native) return Errno::state;
+		this->target->InvalidateViews(); // a view taken while writing would show the unused reserve
+		int result = ::nng_msg_chop(native, this->end - this->pos);
+		this->target = nullptr;
+		return static_cast<Errno>(result);
+	}
+}
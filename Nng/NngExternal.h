@@ -18,9 +18,14 @@ using namespace System::Runtime::InteropServices;
 namespace Nng {
 
 	ref class Msg;
+	ref class SharedPayload;
 	ref class Aio;
+	ref class AioCompletionQueue;
+	ref class AioPool;
 	ref class Protocols;
+	ref class SnapShot;
 	enum class Errno : int;
+	enum class Option : int;
 
 	/// <summary>Flags for send and receive operations</summary>
 	[Flags]
@@ -42,6 +47,128 @@ namespace Nng {
 		NngException(Errno errno) { this->errno = errno; }
 	};
 
+	/// <summary>
+	/// A socket configuration, set or read with one call. Only the fields with a value are set,
+	/// reading leaves out the options the protocol doesn't have
+	/// </summary>
+	public value struct SocketOptions {
+		/// <summary>send-buffer, in messages</summary>
+		Nullable<Int32> SendBuffer;
+		/// <summary>recv-buffer, in messages</summary>
+		Nullable<Int32> RecvBuffer;
+		/// <summary>send-timeout, in milliseconds, -1 for none</summary>
+		Nullable<Int32> SendTimeout;
+		/// <summary>recv-timeout, in milliseconds, -1 for none</summary>
+		Nullable<Int32> RecvTimeout;
+		/// <summary>recv-size-max, in bytes, 0 for no limit</summary>
+		Nullable<UInt64> RecvMaxSize;
+		/// <summary>reconnect-time-min, in milliseconds</summary>
+		Nullable<Int32> ReconnectMin;
+		/// <summary>reconnect-time-max, in milliseconds, 0 keeps reconnect-time-min</summary>
+		Nullable<Int32> ReconnectMax;
+		/// <summary>ttl-max, in hops</summary>
+		Nullable<Int32> MaxTtl;
+	};
+
+	/// <summary>
+	/// Counters of a Socket since Socket::EnableMetrics, summed over all threads when read. Bytes are message bodies
+	/// </summary>
+	public value struct SocketMetrics {
+		UInt64 MessagesSent;
+		UInt64 BytesSent;
+		UInt64 MessagesReceived;
+		UInt64 BytesReceived;
+		/// <summary>connections made by dialers of the socket</summary>
+		UInt64 DialerConnects;
+		/// <summary>connections accepted by listeners of the socket</summary>
+		UInt64 ListenerConnects;
+		UInt64 Disconnects;
+		/// <summary>Aio sends and receives completed, failed ones included</summary>
+		UInt64 AioCompletions;
+		/// <summary>failed calls and Aio operations, indexed by Errno. The last entry also counts all larger ones</summary>
+		array<UInt64>^ Errors;
+		/// <summary>Aio completions by latency. Entry 0 took less than a microsecond, entry i from 2^(i-1) up to 2^i microseconds</summary>
+		array<UInt64>^ AioLatency;
+
+		/// <summary>failures with Errno::again, a nonblocking call which couldn't be done right away</summary>
+		property UInt64 Again { UInt64 get(); }
+		/// <summary>failures with Errno::timedout</summary>
+		property UInt64 TimedOut { UInt64 get(); }
+		UInt64 ErrorCount(Errno error);
+		/// <summary>microseconds within which the given share (0 to 1) of the Aio operations completed, rounded up to a power of 2</summary>
+		Double AioLatencyPercentile(Double share);
+		/// <summary>what was counted between two snapshots</summary>
+		static SocketMetrics operator-(SocketMetrics after, SocketMetrics before);
+	};
+
+	/// <summary>
+	/// How a blocking receive of a Socket waits: Spins nonblocking tries, then Yields tries giving up the time slice, then it blocks
+	/// </summary>
+	public value struct ReceiveWaitPolicy {
+		/// <summary>tries with a cpu pause between, skipped on a single core</summary>
+		UInt32 Spins;
+		/// <summary>tries after Thread::Yield, before blocking</summary>
+		UInt32 Yields;
+		/// <summary>block right away while the next message isn't expected before spinning and yielding are over</summary>
+		bool Adaptive;
+	};
+
+	/// <summary>Counters of the ReceiveWaitPolicy of a Socket</summary>
+	public value struct ReceiveWaitStats {
+		/// <summary>receives which got their message while spinning, the first try included</summary>
+		UInt64 SpinHits;
+		/// <summary>receives which got their message while yielding</summary>
+		UInt64 YieldHits;
+		/// <summary>receives which went on to block</summary>
+		UInt64 Blocks;
+		/// <summary>of the Blocks, the ones the adaptive policy sent there right away</summary>
+		UInt64 Skips;
+		/// <summary>tries while spinning and while yielding, over all receives</summary>
+		UInt64 Spins;
+		UInt64 Yields;
+		/// <summary>average microseconds between messages, recent ones weigh most</summary>
+		Double Gap;
+		/// <summary>average microseconds spinning and yielding take when they find nothing</summary>
+		Double Phase;
+	};
+
+	/// <summary>What happened to a pipe, a connection of a Socket</summary>
+	public enum class PipeEventType : int {
+		added = 1,
+		removed = 2
+	};
+
+	/// <summary>
+	/// A pipe was connected or disconnected, see Socket::WatchPipes
+	/// </summary>
+	public value struct PipeEvent {
+		UInt32 Pipe;
+		PipeEventType Type;
+		/// <summary>when nng reported it, UTC</summary>
+		DateTime Time;
+		/// <summary>events lost before this one because the queue of the socket was full</summary>
+		UInt32 Dropped;
+	};
+
+	/// <summary>
+	/// A connected pipe of a watched Socket. The counters come from nng's statistics, 0 if nng was built without
+	/// </summary>
+	public value struct PipeInfo {
+		UInt32 Pipe;
+		/// <summary>the Dialer which made the pipe, 0 if a Listener accepted it</summary>
+		UInt32 Dialer;
+		/// <summary>the Listener which accepted the pipe, 0 if a Dialer made it</summary>
+		UInt32 Listener;
+		/// <summary>UTC</summary>
+		DateTime Connected;
+		UInt64 MessagesSent;
+		UInt64 BytesSent;
+		UInt64 MessagesReceived;
+		UInt64 BytesReceived;
+		/// <summary>inproc name, ipc path or address:port, empty if the transport has none</summary>
+		System::String^ RemoteAddress;
+	};
+
 	/// <summary>
 	/// Socket, the central class of Nng. To construct a socket, use
 	/// a member of the Protocols <see cref="Protocols">class</see>
@@ -87,19 +214,131 @@ namespace Nng {
 		Errno GetOptSize(System::String^ optionName, [Out] UInt64%);
 		/// <summary>Get an option as a uint64 value.</summary>
 		Errno GetOptUInt64(System::String^ optionName, [Out] UInt64%);
+
+		/// <summary>Set an option to a binary/blob value. The Option overloads need no string conversion</summary>
+		Errno SetOpt(Nng::Option option, array<System::Byte>^);
+		/// <summary>Set an option to a bool value</summary>
+		Errno SetOptBool(Nng::Option option, Boolean);
+		/// <summary>Set an option to an integer value</summary>
+		Errno SetOptInt(Nng::Option option, int);
+		/// <summary>Set an option to time value, in milliseconds</summary>
+		Errno SetOptMs(Nng::Option option, Int32);
+		/// <summary>Set an option to a size value</summary>
+		Errno SetOptSize(Nng::Option option, size_t);
+		/// <summary>Set an option to a uint64 value</summary>
+		Errno SetOptUInt64(Nng::Option option, UInt64);
+		/// <summary>Set an option to a string value</summary>
+		Errno SetOptString(Nng::Option option, System::String^);
+
+		/// <summary>Get an option as a binary/blob value.</summary>
+		Errno GetOpt(Nng::Option option, [Out] array<System::Byte>^%);
+		/// <summary>Get an option as an bool value.</summary>
+		Errno GetOptBool(Nng::Option option, [Out] Boolean%);
+		/// <summary>Get an option as an integer value.</summary>
+		Errno GetOptInt(Nng::Option option, [Out] Int32%);
+		/// <summary>Get an option as a time value, in milliseconds.</summary>
+		Errno GetOptMs(Nng::Option option, [Out] Int32%);
+		/// <summary>Get an option as a size value.</summary>
+		Errno GetOptSize(Nng::Option option, [Out] UInt64%);
+		/// <summary>Get an option as a uint64 value.</summary>
+		Errno GetOptUInt64(Nng::Option option, [Out] UInt64%);
+
+		/// <summary>Set all options given in one native call</summary>
+		/// <returns>Errno::ok, or the error of the first option that failed. The ones before it are set</returns>
+		Errno SetOptions(SocketOptions options);
+		/// <summary>Read all options of SocketOptions in one native call</summary>
+		Errno GetOptions([Out] SocketOptions% options);
+		/// <summary>Start counting messages, bytes, errors, Aio latencies and connections, until the socket is closed</summary>
+		/// <returns>Errno::notsup if the assembly was built without metrics (NNGC_NO_METRICS)</returns>
+		Errno EnableMetrics();
+		/// <summary>Snapshot of the counters, senders and receivers are not held up while it is taken</summary>
+		/// <returns>Errno::noent if EnableMetrics wasn't called</returns>
+		Errno GetMetrics([Out] SocketMetrics% metrics);
+		/// <summary>Spin and yield before blocking in Receive without Flag::nonblock, for a consumer on a core of its own. The recv-timeout starts when it blocks</summary>
+		/// <param name="policy">replaces the previous one, without a value receives block right away again</param>
+		Errno SetReceiveWait(Nullable<ReceiveWaitPolicy> policy);
+		/// <returns>Errno::noent if the socket has no ReceiveWaitPolicy</returns>
+		Errno GetReceiveWaitStats([Out] ReceiveWaitStats% stats);
+		/// <summary>Start keeping track of the pipes and queueing their events, until the socket is closed. Call it before dialing or listening</summary>
+		Errno WatchPipes();
+		/// <summary>receive the next pipe event, returns immediately, read it with Aio::GetPipeEvent in the callback</summary>
+		void  ReceivePipeEvent(Aio^ aio);
+		/// <summary>The pipes connected now</summary>
+		/// <returns>Errno::state if WatchPipes wasn't called</returns>
+		Errno GetPipes([Out] array<PipeInfo>^% pipes);
+		/// <summary>send to one pipe, only on a polyamorous Pair1 socket</summary><param name="flags">defaults to nonblock</param>
+		/// <returns>Errno::notsup on other sockets, where nng picks the pipe</returns>
+		Errno SendTo(Msg^ msg, UInt32 pipe, [Optional] Nullable<Flag> flags);
+		/// <summary>Disconnect one pipe. A dialer reconnects</summary>
+		static Errno ClosePipe(UInt32 pipe);
 		
 		/// <summary>send some data</summary><param name="flags">defaults to nonblock</param>
 		Errno  Send(array<Byte>^ data, [Optional] Nullable<Flag> flags);
 		/// <summary>receive data, blocking</summary><param name="flags">defaults to 0</param>
 		Errno  Receive([Out] array<Byte>^% data, [Optional] Nullable<Flag> flags);
+		/// <summary>receive data into a caller supplied buffer, no managed allocation</summary>
+		/// <param name="received">number of bytes received, or the size of the message if it didn't fit</param>
+		/// <param name="flags">defaults to 0</param>
+		/// <returns>Errno::msgsize if the message was larger than count, it is lost then</returns>
+		Errno  Receive(array<Byte>^ buffer, Int32 offset, Int32 count, [Out] Int32% received, [Optional] Nullable<Flag> flags);
+		/// <summary>receive data into pinned or native memory, no managed allocation</summary>
+		/// <param name="received">number of bytes received, or the size of the message if it didn't fit</param>
+		/// <param name="flags">defaults to 0</param>
+		/// <returns>Errno::msgsize if the message was larger than size, it is lost then</returns>
+		Errno  Receive(IntPtr buffer, size_t size, [Out] UInt64% received, [Optional] Nullable<Flag> flags);
 		/// <summary>send some data</summary><param name="msg">message to be sent</param><param name="flags">defaults to nonblock</param>
 		Errno  Send(Msg^ msg, [Optional] Nullable<Flag> flags);
 		/// <summary>receive data, blocking</summary><param name="flags">defaults to 0</param>
 		Errno  Receive([Out] Msg^% msg, [Optional] Nullable<Flag> flags);
+		/// <summary>
+		/// Send a value type without references as a message of its bytes, see Msg::Write. flags default to nonblock
+		/// </summary>
+		/// <returns>Errno::notsup if T holds references, or its fields can't be told for network order</returns>
+		generic <typename T> where T : value class
+		Errno  Send(T value, [Optional] Nullable<Flag> flags, [Optional] Nullable<bool> networkOrder);
+		generic <typename T> where T : value class
+		Errno  Send(array<T>^ values, Int32 offset, Int32 count, [Optional] Nullable<Flag> flags, [Optional] Nullable<bool> networkOrder);
+		/// <returns>Errno::msgsize if the message isn't one T, it is lost then</returns>
+		generic <typename T> where T : value class
+		Errno  Receive([Out] T% value, [Optional] Nullable<Flag> flags, [Optional] Nullable<bool> networkOrder);
+		/// <param name="received">values, the message must hold a whole number of them</param>
+		/// <returns>Errno::msgsize if the message holds more than count values or a part of one, it is lost then</returns>
+		generic <typename T> where T : value class
+		Errno  Receive(array<T>^ values, Int32 offset, Int32 count, [Out] Int32% received, [Optional] Nullable<Flag> flags, [Optional] Nullable<bool> networkOrder);
+		/// <summary>send several messages in one native call, stops at the first one the socket doesn't accept</summary>
+		/// <param name="sent">number of messages sent, these belong to nng now</param><param name="flags">defaults to nonblock</param>
+		/// <returns>Errno::ok if all were sent, otherwise the error of the first message not sent, usually Errno::again</returns>
+		Errno  SendMany(array<Msg^>^ msgs, [Out] Int32% sent, [Optional] Nullable<Flag> flags);
+		/// <summary>send several buffers in one native call, stops at the first one the socket doesn't accept</summary>
+		/// <param name="sent">number of buffers sent</param><param name="flags">defaults to nonblock</param>
+		/// <returns>Errno::ok if all were sent, otherwise the error of the first buffer not sent, usually Errno::again.
+		/// Errno::msgsize if the buffers together are larger than 2 GB, nothing is sent then</returns>
+		Errno  SendMany(array<array<Byte>^>^ data, [Out] Int32% sent, [Optional] Nullable<Flag> flags);
+		/// <summary>receive up to msgs->Length messages in one native call</summary>
+		/// <param name="timeout">milliseconds to wait for the first message, 0 doesn't wait, -1 waits forever. The rest is only taken if already queued</param>
+		/// <param name="received">number of messages stored at the beginning of msgs</param>
+		Errno  ReceiveMany(array<Msg^>^ msgs, Int32 timeout, [Out] Int32% received);
+		/// <summary>receive up to max messages in one native call</summary>
+		/// <param name="timeout">milliseconds to wait for the first message, 0 doesn't wait, -1 waits forever. The rest is only taken if already queued</param>
+		Errno  ReceiveMany(Int32 max, Int32 timeout, [Out] array<Msg^>^% msgs);
 		/// <summary>send some data, returns immediately, result by callback</summary>
 		void   Send(Aio^ aio);
 		/// <summary>receive some data, returns immediately, result by callback</summary>
 		void   Receive(Aio^ aio);
+		/// <summary>receive a message asynchronously, backed by recycled Aio objects</summary>
+		/// <param name="timeout">milliseconds, defaults to the recv-timeout of the socket</param>
+		/// <returns>The message. Cancelled through the token, faulted with an NngException on any other error</returns>
+		System::Threading::Tasks::Task<Msg^>^ ReceiveAsync([Optional] Nullable<Int32> timeout, [Optional] Nullable<System::Threading::CancellationToken> cancellationToken);
+		/// <summary>send a message asynchronously, backed by recycled Aio objects</summary>
+		/// <param name="timeout">milliseconds, defaults to the send-timeout of the socket</param>
+		/// <returns>Errno::ok if sent, the message belongs to nng then. Otherwise it still belongs to the caller.
+		/// Cancelled through the token</returns>
+		System::Threading::Tasks::Task<Errno>^ SendAsync(Msg^ msg, [Optional] Nullable<Int32> timeout, [Optional] Nullable<System::Threading::CancellationToken> cancellationToken);
+		/// <summary>
+		/// Completion queue for Aios used on this socket which have no queue of their own.
+		/// nullptr (the default) calls the callbacks directly on nng's threads
+		/// </summary>
+		property AioCompletionQueue^ CompletionQueue;
 
 		// This will be converted to IDispose
 		~Socket();
@@ -191,6 +430,18 @@ namespace Nng {
 	internal:
 		property UIntPtr msg;
 		Msg(System::UIntPtr ptr);
+		// streams handed out by BodyStream/HeaderStream, closed as soon as the native memory may move or go away
+		System::Collections::Generic::List<System::IO::UnmanagedMemoryStream^>^ views;
+		void InvalidateViews();
+		// counts InvalidateViews, a MsgReader notices by it that the memory it reads may have moved
+		Int32 changes;
+		// MsgPool size class + 1 of the native message, 0 if it wasn't allocated from the pool
+		Int32 poolClass;
+		// set while other Msg objects may use the same nng_msg, see DupShared
+		SharedPayload^ shared;
+		// gives this Msg its own nng_msg before it is changed or sent
+		Errno Unshare();
+		void ReleaseShared();
 	public:
 		/// <summary>
 		/// Allocates a message already with space for data
@@ -221,12 +472,37 @@ namespace Nng {
 		/// </summary>
 		/// <returns>Errno::ok on success</returns>
 		Errno Dup([Out] Msg^% msgOut);
+		/// <summary>
+		/// Duplicates a message without copying it. The copies share one native message until one of them
+		/// is changed or sent, that one gets its own copy then. The last one doesn't need to copy anymore
+		/// </summary>
+		/// <returns>Errno::ok on success, Errno::inval if the message is already freed or sent</returns>
+		Errno DupShared([Out] Msg^% msgOut);
+		/// <summary>
+		/// True while other copies from DupShared use the same native message
+		/// </summary>
+		property bool IsShared { bool get(); }
 
 		/// <summary>
 		/// Returns the entire body of the message
 		/// </summary>
 		array<System::Byte>^ Body();
 		/// <summary>
+		/// Returns a pointer to the body, without copying. Only valid until the message is changed, sent or freed
+		/// </summary>
+		/// <returns>Errno::ok on success, Errno::inval if the message is already freed or sent</returns>
+		Errno BodyView([Out] IntPtr% data, [Out] UInt64% size);
+		/// <summary>
+		/// Returns a read only stream on the body, without copying. The stream is closed when the message is changed, sent or freed
+		/// </summary>
+		/// <returns>nullptr if the message is already freed or sent</returns>
+		System::IO::UnmanagedMemoryStream^ BodyStream();
+		/// <summary>
+		/// Copies the entire body into an existing array
+		/// </summary>
+		/// <returns>Errno::ok on success, Errno::msgsize if the body doesn't fit</returns>
+		Errno CopyTo(array<System::Byte>^ dest, Int32 offset);
+		/// <summary>
 		/// Append data to a message
 		/// </summary>
 		/// <returns>Errno::ok on success</returns>
@@ -271,11 +547,44 @@ namespace Nng {
 		/// </summary>
 		void  Clear();
 
+		/// <summary>
+		/// Append the bytes of a value type without references, in one copy. In network order every field wider
+		/// than a byte is stored big endian, otherwise the layout is the one in memory
+		/// </summary>
+		/// <returns>Errno::ok on success, Errno::notsup if T holds references, or its fields can't be told for network order</returns>
+		generic <typename T> where T : value class
+		Errno Write(T value, [Optional] Nullable<bool> networkOrder);
+		/// <summary>Append count values of an array, in one copy</summary>
+		generic <typename T> where T : value class
+		Errno Write(array<T>^ values, Int32 offset, Int32 count, [Optional] Nullable<bool> networkOrder);
+		/// <summary>Remove a value written by Write from the beginning of the body</summary>
+		/// <returns>Errno::ok on success, Errno::inval if the body is shorter</returns>
+		generic <typename T> where T : value class
+		Errno Read([Out] T% value, [Optional] Nullable<bool> networkOrder);
+		/// <summary>Remove count values from the beginning of the body into an array</summary>
+		generic <typename T> where T : value class
+		Errno Read(array<T>^ values, Int32 offset, Int32 count, [Optional] Nullable<bool> networkOrder);
+
 		/// <summary>
 		/// Returns the entire header of the message
 		/// </summary>
 		array<System::Byte>^ Header();
 		/// <summary>
+		/// Returns a pointer to the header, without copying. Only valid until the message is changed, sent or freed
+		/// </summary>
+		/// <returns>Errno::ok on success, Errno::inval if the message is already freed or sent</returns>
+		Errno HeaderView([Out] IntPtr% data, [Out] UInt64% size);
+		/// <summary>
+		/// Returns a read only stream on the header, without copying. The stream is closed when the message is changed, sent or freed
+		/// </summary>
+		/// <returns>nullptr if the message is already freed or sent</returns>
+		System::IO::UnmanagedMemoryStream^ HeaderStream();
+		/// <summary>
+		/// Copies the entire header into an existing array
+		/// </summary>
+		/// <returns>Errno::ok on success, Errno::msgsize if the header doesn't fit</returns>
+		Errno HeaderCopyTo(array<System::Byte>^ dest, Int32 offset);
+		/// <summary>
 		/// Append data to a header
 		/// </summary>
 		/// <returns>Errno::ok on success</returns>
@@ -321,11 +630,11 @@ namespace Nng {
 		void  HeaderClear();
 
 		/// <summary>
-		/// Pipe number (do not use this function)
+		/// Pipe the message was received from
 		/// </summary>
 		int   GetPipe();
 		/// <summary>
-		/// set pipe number (do not use this function)
+		/// set pipe number, see Socket::SendTo for sending to a pipe
 		/// </summary>
 		void  SetPipe(int pipe);
 
@@ -333,19 +642,333 @@ namespace Nng {
 		~Msg();
 	};
 
-	public ref class SnapShot {
+	/// <summary>
+	/// Writes fields straight into the body of a Msg, after what is already there. Capacity is reserved
+	/// up front and grows when needed, Commit cuts the body to what was written. Don't use the message
+	/// otherwise until Commit. Integers are big endian (network order) unless LittleEndian is set
+	/// </summary>
+	public ref class MsgWriter {
 	public:
-		property UIntPtr snapShot;
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Begin"/></exception>
+		MsgWriter(Msg^ msg, size_t capacity);
+		/// <returns>Errno::ok on success, Errno::inval if the message is already freed or sent</returns>
+		static Errno Begin([Out] MsgWriter^% writer, Msg^ msg, size_t capacity);
+		/// <summary>Byte order of the integers and floats written from now on</summary>
+		property bool LittleEndian;
+		/// <summary>Bytes written so far</summary>
+		property UInt64 Written { UInt64 get(); }
+		Errno WriteU8(Byte value);
+		Errno WriteU16(UInt16 value);
+		Errno WriteU32(UInt32 value);
+		Errno WriteU64(UInt64 value);
+		Errno WriteFloat(Single value);
+		Errno WriteDouble(Double value);
+		/// <summary>Unsigned LEB128, 1 to 10 bytes</summary>
+		Errno WriteVarint(UInt64 value);
+		/// <summary>Zigzag encoded LEB128, small negative numbers stay short</summary>
+		Errno WriteVarintSigned(Int64 value);
+		Errno Write(array<Byte>^ data, Int32 offset, Int32 count);
+		Errno Write(IntPtr data, size_t size);
+		/// <summary>UTF-8, preceded by its length in bytes as varint</summary>
+		Errno WriteString(System::String^ value);
+		/// <summary>Ends writing, the writer can't be used anymore</summary>
+		/// <returns>Errno::state if already committed, or if the message was sent or freed meanwhile</returns>
+		Errno Commit();
+	private:
+		MsgWriter();
+		static Errno Initialize(MsgWriter^ writer, Msg^ msg, size_t capacity);
+		Errno Reserve(size_t size, unsigned char*& p);
+		Msg^ target;
+		void* native; // nng_msg, nullptr after Commit
+		unsigned char* body;
+		size_t start;
+		size_t pos;
+		size_t end;
+	};
+
+	/// <summary>
+	/// Reads fields from the body or header of a Msg with a cursor, without trimming or copying the message.
+	/// Like BodyView, only valid until the message is changed, sent or freed, reads return Errno::state after that. Integers are big endian
+	/// (network order) unless LittleEndian is set. Reading past the end returns Errno::inval and leaves the
+	/// cursor where it was
+	/// </summary>
+	public ref class MsgReader {
+	public:
+		/// <param name="header">read the header instead of the body</param>
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Open"/></exception>
+		MsgReader(Msg^ msg, [Optional] Nullable<bool> header);
+		/// <param name="header">read the header instead of the body</param>
+		/// <returns>Errno::ok on success, Errno::inval if the message is already freed or sent</returns>
+		static Errno Open([Out] MsgReader^% reader, Msg^ msg, [Optional] Nullable<bool> header);
+		/// <summary>Byte order of the integers and floats read from now on</summary>
+		property bool LittleEndian;
+		/// <summary>Offset of the cursor, setting it beyond the end moves it to the end</summary>
+		property UInt64 Position { UInt64 get(); void set(UInt64 position); }
+		/// <summary>Bytes left after the cursor</summary>
+		property UInt64 Remaining { UInt64 get(); }
+		Errno ReadU8([Out] Byte% value);
+		Errno ReadU16([Out] UInt16% value);
+		Errno ReadU32([Out] UInt32% value);
+		Errno ReadU64([Out] UInt64% value);
+		Errno ReadFloat([Out] Single% value);
+		Errno ReadDouble([Out] Double% value);
+		/// <summary>Unsigned LEB128</summary>
+		/// <returns>Errno::proto if longer than 10 bytes</returns>
+		Errno ReadVarint([Out] UInt64% value);
+		/// <summary>Zigzag encoded LEB128</summary>
+		Errno ReadVarintSigned([Out] Int64% value);
+		/// <summary>UTF-8 preceded by its length in bytes as varint, like MsgWriter::WriteString</summary>
+		Errno ReadString([Out] System::String^% value);
+		/// <summary>Copies the next count bytes</summary>
+		Errno Read(array<Byte>^ dest, Int32 offset, Int32 count);
+		/// <summary>Pointer to the next size bytes inside the message, without copying</summary>
+		Errno Slice(size_t size, [Out] IntPtr% data);
+		Errno Skip(size_t size);
+	private:
+		MsgReader();
+		static Errno Initialize(MsgReader^ reader, Msg^ msg, bool header);
+		bool  Valid();
+		Errno Take(size_t size, const unsigned char*& p);
+		Msg^ target;
+		void* native; // nng_msg of target when opened
+		Int32 changes; // of target when data and size were taken
+		const unsigned char* data;
+		size_t size;
+		size_t pos;
+	};
+
+	/// <summary>
+	/// Optional pool of native messages, sorted into size classes. When enabled, Msg(size), Msg::Alloc
+	/// reuse messages returned by Msg::Free and Dispose, instead of allocating new ones. Every thread
+	/// has a small cache of its own, overflow goes to a global list. A pooled message is not cleared
+	/// beyond its length, like fresh memory it may contain old data.
+	/// </summary>
+	public ref class MsgPool abstract sealed {
+	public:
+		/// <summary>
+		/// Sets the size classes (ascending, null keeps the current ones), the number of messages per class
+		/// cached per thread, and the number of messages per class on the global list
+		/// </summary>
+		/// <returns>Errno::ok on success, Errno::busy while the pool is enabled</returns>
+		static Errno Configure(array<Int32>^ sizeClasses, Int32 threadCacheSize, Int32 globalSize);
+		/// <summary>Start pooling</summary>
+		static void Enable();
+		/// <summary>Stop pooling and free the pooled messages, those in the caches of all threads too</summary>
+		static void Disable();
+		static property bool Enabled { bool get(); }
+		/// <summary>Free the pooled messages, of the global list and the caches of all threads, and keep pooling</summary>
+		static void Trim();
+		/// <summary>Allocations served from the pool</summary>
+		static property Int64 Hits { Int64 get(); }
+		/// <summary>Allocations of a pooled size that had to go to nng</summary>
+		static property Int64 Misses { Int64 get(); }
+		/// <summary>Messages taken back into the pool</summary>
+		static property Int64 Returns { Int64 get(); }
+		/// <summary>Messages freed because the pool was full</summary>
+		static property Int64 Discards { Int64 get(); }
+		static void ResetCounters();
 	};
+
+	/// <summary>Readiness of a socket in a Poller</summary>
+	[Flags]
+	public enum class PollEvents : int {
+		none = 0,
+		receive = 1,
+		send = 2
+	};
+
+	/// <summary>
+	/// Waits for many sockets at once on their recv-fd and send-fd, so one thread can serve thousands of sockets
+	/// with nonblocking Receive and Send. Readiness is level triggered, a socket stays ready until it is drained.
+	/// One thread waits at a time, Add and Remove may be called from others
+	/// </summary>
+	public ref class Poller : IDisposable {
+	public:
+		/// <param name="batch">ready sockets returned by one Wait at most</param>
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Open"/></exception>
+		Poller(Int32 batch);
+		/// <returns>Errno::ok on success</returns>
+		static Errno Open([Out] Poller^% poller, Int32 batch);
+		/// <summary>Add a socket or change its events. Closing the socket removes it</summary>
+		/// <returns>Errno::notsup for events the protocol doesn't have, like receive on Push0</returns>
+		Errno Add(Socket^ socket, PollEvents events);
+		Errno Remove(Socket^ socket);
+		property Int32 Count { Int32 get(); }
+		/// <summary>Wait until at least one socket is ready</summary>
+		/// <param name="timeout">milliseconds, -1 waits forever</param>
+		/// <param name="count">ready sockets, see Ready and ReadyEvents. 0 on timeout or Wake</param>
+		Errno Wait(Int32 timeout, [Out] Int32% count);
+		/// <summary>The sockets of the last Wait. Reused by every Wait, only the first count entries are valid</summary>
+		property array<Socket^>^ Ready { array<Socket^>^ get(); }
+		/// <summary>What the sockets in Ready are ready for</summary>
+		property array<PollEvents>^ ReadyEvents { array<PollEvents>^ get(); }
+		/// <summary>Wait until at least one socket is ready, ready is a new array of them. Empty on timeout or Wake</summary>
+		Errno WaitAny(Int32 timeout, [Out] array<Socket^>^% ready);
+		/// <summary>Wait until every one of sockets was ready for one of events at least once. They must have been added</summary>
+		/// <returns>Errno::timedout if not all of them were ready in time</returns>
+		Errno WaitAll(array<Socket^>^ sockets, PollEvents events, Int32 timeout);
+		/// <summary>End a Wait in progress, from another thread</summary>
+		void Wake();
+		/// <summary>Free the poller, once no thread waits anymore. The sockets stay open. Same as Dispose</summary>
+		void Close();
+		~Poller();
+	private:
+		Poller();
+		static Errno Initialize(Poller^ poller, Int32 batch);
+		UInt64 poller;  // nngc_poller
+		UIntPtr events; // nngc_poll_event[batch]
+		array<Socket^>^ ready;
+		array<PollEvents>^ readyEvents;
+		System::Collections::Generic::Dictionary<UInt32, Socket^>^ sockets;
+	};
+
+	/// <summary>Kind of a Stat, the same values as nng's NNG_STAT_</summary>
+	public enum class StatType : int {
+		scope = 0,
+		level = 1,
+		counter = 2,
+		text = 3,
+		boolean = 4,
+		id = 5
+	};
+
+	/// <summary>Unit of a Stat, the same values as nng's NNG_UNIT_</summary>
+	public enum class StatUnit : int {
+		none = 0,
+		bytes = 1,
+		messages = 2,
+		millis = 3,
+		events = 4
+	};
+
+	/// <summary>
+	/// One statistic of a SnapShot. A scope (the root, a socket, dialer, listener or pipe) holds other statistics.
+	/// Only valid while its SnapShot is not freed
+	/// </summary>
 	public ref class Stat {
 	public:
 		property UIntPtr stat;
+		property String^ Name { String^ get(); }
+		property String^ Description { String^ get(); }
+		property StatType Type { StatType get(); }
+		property StatUnit Unit { StatUnit get(); }
+		/// <summary>of levels, counters, booleans and ids</summary>
+		property UInt64 Value { UInt64 get(); }
+		/// <summary>of strings, nullptr for the others</summary>
+		property String^ Text { String^ get(); }
+		/// <summary>when the value was taken, in milliseconds</summary>
+		property UInt64 Timestamp { UInt64 get(); }
+		/// <summary>names from the root down, separated by '/'. Scopes with an id are written name#id, like socket#1/rx_msgs</summary>
+		property String^ Path { String^ get(); }
+		/// <summary>hash of Path, the same for the same statistic in every SnapShot</summary>
+		property UInt64 Key { UInt64 get(); }
+		/// <summary>the id of a socket, dialer, listener or pipe scope, 0 for the others</summary>
+		property UInt32 ScopeId { UInt32 get(); }
+		/// <summary>the enclosing scope, nullptr for the root</summary>
+		property Stat^ Parent { Stat^ get(); }
+		/// <summary>the statistics of a scope, an empty array for the others</summary>
+		array<Stat^>^ Children();
+		/// <summary>a child by name, nullptr if there is none</summary>
+		Stat^ Child(String^ name);
+	internal:
+		Stat(SnapShot^ snapShot, Int32 index);
+		SnapShot^ snapShot;
+		Int32 index;
 	};
-	private ref class Pipe { // not currently used
+
+	/// <summary>The change of one counter or level between two SnapShots</summary>
+	public value struct StatDelta {
+		String^ Path;
+		UInt64 Key;
+		StatType Type;
+		StatUnit Unit;
+		UInt64 Before;
+		UInt64 After;
+		/// <summary>After - Before</summary>
+		Int64 Delta;
+	};
+
+	/// <summary>
+	/// nng's statistics of all sockets, dialers, listeners and pipes, taken at one point in time
+	/// </summary>
+	public ref class SnapShot : IDisposable {
+	public:
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Take"/></exception>
+		SnapShot();
+		/// <returns>Errno::ok on success</returns>
+		static Errno Take([Out] SnapShot^% snapShot);
+		property UIntPtr snapShot;
+		/// <summary>nullptr once freed</summary>
+		property Stat^ Root { Stat^ get(); }
+		/// <summary>every statistic, parents before their children</summary>
+		array<Stat^>^ All();
+		/// <summary>a statistic by Path, nullptr if there is none</summary>
+		Stat^ Find(String^ path);
+		/// <summary>the scope of a socket, nullptr if there is none</summary>
+		Stat^ Find(Socket^ socket);
+		/// <summary>counters and levels which changed from before to after, ones new in after count from 0</summary>
+		static array<StatDelta>^ Diff(SnapShot^ before, SnapShot^ after);
+		/// <summary>Free the native snapshot. Same as Dispose</summary>
+		void Free();
+		~SnapShot();
+	internal:
+		Stat^ At(Int32 index);
+		String^ PathOf(Int32 index);
+		array<Stat^>^ stats; // flattened, index 0 is the root, created when asked for
+		array<String^>^ paths;
+		UIntPtr entries;     // nngc_stat_entry[], parallel to stats
+	private:
+		static Errno Initialize(SnapShot^ snapShot);
+		SnapShot(bool);
+	};
+
+	/// <summary>
+	/// Called by a StatPoller with the counters and levels which changed since the last poll.
+	/// deltas is reused, only the first count entries are valid and only during the call
+	/// </summary>
+	public delegate void StatDeltaHandler(array<StatDelta>^ deltas, Int32 count);
+
+	/// <summary>
+	/// Takes a SnapShot at a fixed interval on its own thread and hands the changes to a handler.
+	/// Buffers and paths are kept from poll to poll, a poll only allocates for statistics it hasn't seen before
+	/// </summary>
+	public ref class StatPoller : IDisposable {
 	public:
-		property UInt32 pipe;
+		/// <param name="interval">milliseconds between polls</param>
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Open"/></exception>
+		StatPoller(Int32 interval, StatDeltaHandler^ handler);
+		/// <returns>Errno::ok on success</returns>
+		static Errno Open([Out] StatPoller^% poller, Int32 interval, StatDeltaHandler^ handler);
+		/// <summary>polls done, the first one only takes the baseline</summary>
+		property Int64 Polls { Int64 get(); }
+		/// <summary>the result of the last snapshot, Errno::ok if it worked</summary>
+		property Errno LastError { Errno get(); }
+		/// <summary>Handlers which threw an exception</summary>
+		property Int64 HandlerErrors { Int64 get(); }
+		/// <summary>Stops polling, waits for a running handler unless called from it. Same as Dispose</summary>
+		void Close();
+		~StatPoller();
+	private:
+		StatPoller();
+		static Errno Initialize(StatPoller^ poller, Int32 interval, StatDeltaHandler^ handler);
+		void Run();
+		void Poll();
+		StatDeltaHandler^ handler;
+		Int32 interval;
+		System::Threading::Thread^ thread;
+		System::Threading::ManualResetEvent^ stop;
+		UIntPtr entries;  // nngc_stat_entry[capacity]
+		Int32 capacity;
+		System::Collections::Generic::Dictionary<UInt64, UInt64>^ values;
+		System::Collections::Generic::Dictionary<UInt64, UInt64>^ previousValues;
+		System::Collections::Generic::Dictionary<UInt64, String^>^ paths;
+		System::Collections::Generic::Dictionary<UInt64, String^>^ previousPaths;
+		array<StatDelta>^ deltas;
+		Int64 polls;
+		Int64 handlerErrors;
+		Errno lastError;
+		bool closed;
 	};
-	
 	public ref class Aio : IDisposable {
 	internal:
 		property UIntPtr aio;
@@ -354,6 +977,7 @@ namespace Nng {
 	public:
 		Aio(System::Action<System::Object^>^ callback, Object^ object); // throws
 		static Errno Alloc([Out] Aio^% aio, System::Action<System::Object^>^ callback, Object^ object);
+		/// <summary>Frees the native aio. From its own callback the freeing is done by a thread pool thread afterwards</summary>
 		void  Free();
 		Errno Result();
 		void  Stop();
@@ -362,13 +986,384 @@ namespace Nng {
 		void  SetMsg(Msg^ msg);
 		Msg^  GetMsg();
 		void  SetTimeout(Int32 duration);
+		/// <summary>The event of a completed Socket::ReceivePipeEvent</summary>
+		Errno GetPipeEvent([Out] PipeEvent% pipeEvent);
+		/// <summary>
+		/// Deliver completions through this queue instead of calling back on nng's threads.
+		/// nullptr (the default) follows the CompletionQueue of the Socket the Aio is used on
+		/// </summary>
+		property AioCompletionQueue^ CompletionQueue { AioCompletionQueue^ get(); void set(AioCompletionQueue^ queue); }
+		/// <summary>
+		/// Replace callback and context without reallocating anything. Only while no operation is pending
+		/// </summary>
+		void  Rebind(System::Action<System::Object^>^ callback, Object^ object);
 		~Aio();
+	internal:
+		void  FollowQueue(AioCompletionQueue^ queue);
+		AioPool^ rentedFrom; // while it is rented out of an AioPool
+		[ThreadStatic] static Aio^ calling; // whose callback this thread is in
 	private:
 		Aio();
 		static Errno Initialize(Aio^ aio, System::Action<System::Object^>^ callback, System::Object^ object);
 		void  CallbackEntry(void);
+		void  FreeLater(Object^);
+		void  BindQueue(AioCompletionQueue^ queue);
 		delegate void CallbackEntryDelegate(void);
 		CallbackEntryDelegate^ callbackDelegate;
+		AioCompletionQueue^ boundQueue;
+		AioCompletionQueue^ followedQueue;
+	};
+
+	ref class RpcRequest;
+
+	/// <summary>
+	/// Concurrent RPC client on a raw Req0 socket. Any number of threads may have requests in flight,
+	/// replies are matched by request ID through a hash table and complete a Task.
+	/// Dial the server with RequestSocket
+	/// </summary>
+	public ref class RpcClient : IDisposable {
+	public:
+		/// <param name="receivers">number of receive Aios, more than one only helps with slow continuations</param>
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Open"/></exception>
+		RpcClient(Int32 receivers);
+		/// <returns>Errno::ok on success</returns>
+		static Errno Open([Out] RpcClient^% client, Int32 receivers);
+		/// <summary>
+		/// Send a request. The header of the message is used for the request ID, the body is sent as it is.
+		/// The message belongs to nng once it is sent
+		/// </summary>
+		/// <param name="timeout">milliseconds until the task fails with Errno::timedout, defaults to DefaultTimeout</param>
+		/// <returns>The reply. Cancelled through the token, faulted with an NngException on any other error</returns>
+		System::Threading::Tasks::Task<Msg^>^ RequestAsync(Msg^ request, [Optional] Nullable<Int32> timeout, [Optional] Nullable<System::Threading::CancellationToken> cancellationToken);
+		/// <summary>Timeout in milliseconds for requests without one of their own, -1 (the default) waits forever</summary>
+		property Int32 DefaultTimeout;
+		/// <summary>Requests waiting for a reply</summary>
+		property Int32 Pending { Int32 get(); }
+		/// <summary>The raw Req0 socket, to dial and to set options on</summary>
+		property Socket^ RequestSocket { Socket^ get(); }
+		/// <summary>Closes the socket, pending requests fail with Errno::closed. Same as Dispose</summary>
+		void Close();
+		~RpcClient();
+	internal:
+		static void Cancel(Object^ state);
+	private:
+		RpcClient();
+		static Errno Initialize(RpcClient^ client, Int32 receivers);
+		Int64 CurrentTick();
+		RpcRequest^ Remove(UInt32 id);
+		void Fail(RpcRequest^ request, Errno err);
+		void Received(Object^ index);
+		void Tick(Object^ state);
+		Socket^ socket;
+		array<Aio^>^ receivers;
+		array<System::Collections::Generic::Dictionary<UInt32, RpcRequest^>^>^ stripes;
+		array<System::Collections::Generic::List<UInt32>^>^ wheel;
+		System::Diagnostics::Stopwatch^ clock;
+		System::Threading::Timer^ timer;
+		Int64 processedTick;
+		Int32 nextId;
+		Int32 pending;
+		bool closed;
+	};
+
+	/// <summary>
+	/// Sub0 socket with bulk subscriptions. nng passes every message, they are matched against a native
+	/// prefix trie, so the cost of a match depends on the length of the topic, not on the number of
+	/// subscriptions. A message matches if any subscribed topic is a prefix of its body, like in nng.
+	/// Dial with SubscribeSocket
+	/// </summary>
+	public ref class Subscriber : IDisposable {
+	public:
+		/// <param name="topics">initial subscriptions, UTF-8 encoded, may be nullptr</param>
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Open"/></exception>
+		Subscriber(array<System::String^>^ topics);
+		/// <param name="topics">initial subscriptions, UTF-8 encoded, may be nullptr</param>
+		/// <returns>Errno::ok on success</returns>
+		static Errno Open([Out] Subscriber^% subscriber, array<System::String^>^ topics);
+		/// <summary>Subscribe to UTF-8 encoded topics</summary>
+		/// <param name="added">number of topics not subscribed before</param>
+		Errno Subscribe(array<System::String^>^ topics, [Out] Int32% added);
+		/// <summary>Subscribe to binary topics</summary>
+		/// <param name="added">number of topics not subscribed before</param>
+		Errno Subscribe(array<array<Byte>^>^ topics, [Out] Int32% added);
+		/// <param name="removed">number of topics which were subscribed</param>
+		Errno Unsubscribe(array<System::String^>^ topics, [Out] Int32% removed);
+		/// <param name="removed">number of topics which were subscribed</param>
+		Errno Unsubscribe(array<array<Byte>^>^ topics, [Out] Int32% removed);
+		void  UnsubscribeAll();
+		/// <summary>Number of subscribed topics</summary>
+		property Int32 Count { Int32 get(); }
+		/// <summary>True if the message matches a subscription, counts the match for every subscription it matches</summary>
+		bool  Match(Msg^ msg);
+		/// <summary>Receives the next matching message, the others are dropped</summary>
+		/// <param name="flags">defaults to 0</param>
+		Errno Receive([Out] Msg^% msg, [Optional] Nullable<Flag> flags);
+		/// <summary>Messages matched by this topic since it was subscribed, -1 if it isn't subscribed</summary>
+		Int64 MatchCount(System::String^ topic);
+		/// <summary>Messages matched by this topic since it was subscribed, -1 if it isn't subscribed</summary>
+		Int64 MatchCount(array<Byte>^ topic);
+		/// <summary>Messages Receive dropped because they didn't match</summary>
+		property Int64 Dropped { Int64 get(); }
+		/// <summary>The Sub0 socket, to dial and to set options on. Don't subscribe on it directly</summary>
+		property Socket^ SubscribeSocket { Socket^ get(); }
+		/// <summary>Closes the socket, receivers return Errno::closed. The subscriptions go when the last call using them returns. Same as Dispose</summary>
+		void  Close();
+		~Subscriber();
+	private:
+		Subscriber();
+		static Errno Initialize(Subscriber^ subscriber, array<System::String^>^ topics);
+		void* Enter(); // the trie, nullptr once closed
+		void  Leave();
+		Socket^ socket;
+		void* trie; // topic_trie
+		Int32 calls; // using the trie, see Enter
+		Int64 dropped;
+	};
+
+	/// <summary>
+	/// Transfers of any size, beyond the 2 GB of a managed array, over a Pair0 or Pair1 socket. The data goes in chunks
+	/// which the receiver acknowledges, at most Window chunks are on the way, so each side holds about MemoryBound
+	/// bytes however large the transfer is. Sender and receiver wait as long as the recv-timeout of their socket.
+	/// One transfer at a time per object
+	/// </summary>
+	public ref class StreamTransfer {
+	public:
+		/// <param name="chunkSize">bytes per message. With the 32 byte chunk header it has to fit Option::recvmaxsz of this socket
+		/// and of the peer's, which is 1 MB on tcp and ipc unless set. Only the local one is checked, the peer drops larger chunks</param>
+		/// <param name="window">chunks sent before waiting for an acknowledgement</param>
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Open"/></exception>
+		StreamTransfer(Socket^ socket, Int32 chunkSize, Int32 window);
+		/// <returns>Errno::ok on success, Errno::msgsize if a chunk exceeds the recvmaxsz of the socket</returns>
+		static Errno Open([Out] StreamTransfer^% transfer, Socket^ socket, Int32 chunkSize, Int32 window);
+		/// <summary>send the rest of a Stream. Its length is announced if it can seek</summary>
+		Errno Send(System::IO::Stream^ source, [Out] UInt64% sent);
+		/// <summary>send a file, read through a memory mapping</summary>
+		Errno SendFile(System::String^ path, [Out] UInt64% sent);
+		/// <summary>receive the next transfer into a Stream, at its position</summary>
+		/// <returns>Errno::connaborted if the sender gave up, Errno::proto if chunks were lost</returns>
+		Errno Receive(System::IO::Stream^ target, [Out] UInt64% received);
+		/// <summary>receive the next transfer into a file, written through a memory mapping. The file is replaced</summary>
+		/// <returns>Errno::notsup if the sender didn't know the size, Errno::connaborted if it gave up</returns>
+		Errno ReceiveFile(System::String^ path, [Out] UInt64% received);
+		property Int32 ChunkSize { Int32 get(); }
+		property Int32 Window { Int32 get(); }
+		/// <summary>ChunkSize times Window</summary>
+		property Int64 MemoryBound { Int64 get(); }
+		property Socket^ StreamSocket { Socket^ get(); }
+		/// <summary>What the Stream or file threw when a transfer returned Errno::internal</summary>
+		property System::Exception^ LastException { System::Exception^ get(); }
+	private:
+		StreamTransfer();
+		static Errno Initialize(StreamTransfer^ transfer, Socket^ socket, Int32 chunkSize, Int32 window);
+		[System::Runtime::InteropServices::UnmanagedFunctionPointer(System::Runtime::InteropServices::CallingConvention::Cdecl)]
+		delegate int ReadDelegate(void* arg, void* buffer, size_t capacity, size_t* size);
+		[System::Runtime::InteropServices::UnmanagedFunctionPointer(System::Runtime::InteropServices::CallingConvention::Cdecl)]
+		delegate int BeginDelegate(void* arg, UInt64 total);
+		[System::Runtime::InteropServices::UnmanagedFunctionPointer(System::Runtime::InteropServices::CallingConvention::Cdecl)]
+		delegate int WriteDelegate(void* arg, UInt64 offset, const void* data, size_t size);
+		int ReadStream(void* arg, void* buffer, size_t capacity, size_t* size);
+		int WriteStream(void* arg, UInt64 offset, const void* data, size_t size);
+		int ReadMapped(void* arg, void* buffer, size_t capacity, size_t* size);
+		int BeginMapped(void* arg, UInt64 total);
+		int WriteMapped(void* arg, UInt64 offset, const void* data, size_t size);
+		unsigned char* Map(Int64 offset, [Out] Int64% available);
+		void Unmap();
+		Errno Finish(int result);
+		Socket^ socket;
+		array<Byte>^ buffer;
+		Int32 window;
+		System::IO::Stream^ stream;
+		System::String^ path;
+		System::IO::MemoryMappedFiles::MemoryMappedFile^ mapped;
+		System::IO::MemoryMappedFiles::MemoryMappedViewAccessor^ view;
+		bool writable;
+		Int64 viewStart;
+		Int64 viewLength;
+		unsigned char* viewPointer;
+		Int64 position;
+		Int64 length;
+		System::Exception^ lastException;
+		ReadDelegate^ readStream;
+		WriteDelegate^ writeStream;
+		ReadDelegate^ readMapped;
+		BeginDelegate^ beginMapped;
+		WriteDelegate^ writeMapped;
+	};
+
+	/// <summary>
+	/// A channel to one other process on the same host through shared memory, at a url shm://name. A message is written
+	/// into a ring once and read from it in place, no copy goes through the kernel as with ipc://. The listener creates
+	/// the memory and removes its name when it is closed, one dialer connects to it. One thread sends and one receives
+	/// at a time. Timeouts are in milliseconds, -1 (the default) waits forever, 0 returns Errno::again right away
+	/// </summary>
+	public ref class ShmChannel : IDisposable {
+	public:
+		/// <param name="listen">create the channel, otherwise dial it</param><param name="capacity">bytes per direction of a listener, rounded up to a power of 2, defaults to 1 MB</param>
+		/// <exception cref="NngException">Throws exceptions, non-throwing variants are avalable <see cref="Listen"/> <see cref="Dial"/></exception>
+		ShmChannel(System::String^ url, bool listen, [Optional] Nullable<Int32> capacity);
+		/// <returns>Errno::addrinuse if the name is taken</returns>
+		static Errno Listen([Out] ShmChannel^% channel, System::String^ url, [Optional] Nullable<Int32> capacity);
+		/// <returns>Errno::connrefused if nobody listens on the name, Errno::busy if another dialer connected</returns>
+		static Errno Dial([Out] ShmChannel^% channel, System::String^ url);
+		/// <summary>Remove the name of a channel whose listener crashed, so Listen can take it again. Dialed channels keep working</summary>
+		/// <returns>Errno::noent if there is none, always on Windows, where the system removes it with the last handle</returns>
+		static Errno Unlink(System::String^ url);
+		/// <returns>Errno::msgsize if data is larger than MaxMessageSize, Errno::closed if the peer is gone</returns>
+		Errno Send(array<Byte>^ data, [Optional] Nullable<Int32> timeout);
+		Errno Send(array<Byte>^ data, Int32 offset, Int32 count, [Optional] Nullable<Int32> timeout);
+		Errno Send(IntPtr data, UInt64 size, [Optional] Nullable<Int32> timeout);
+		/// <summary>Reserve size bytes in the ring and write the message there, SendEnd sends it</summary>
+		Errno SendBegin(Int32 size, [Out] IntPtr% buffer, [Optional] Nullable<Int32> timeout);
+		/// <summary>Send what SendBegin reserved, size may be less than reserved</summary>
+		Errno SendEnd(Int32 size);
+		/// <returns>Errno::closed once the peer is gone and everything it sent was received</returns>
+		Errno Receive([Out] array<Byte>^% data, [Optional] Nullable<Int32> timeout);
+		/// <returns>Errno::msgsize if the message is larger than count, it stays in the channel and received is its size</returns>
+		Errno Receive(array<Byte>^ buffer, Int32 offset, Int32 count, [Out] Int32% received, [Optional] Nullable<Int32> timeout);
+		/// <summary>The next message in place, without copying. data is valid until ReceiveEnd</summary>
+		Errno ReceiveBegin([Out] IntPtr% data, [Out] Int32% size, [Optional] Nullable<Int32> timeout);
+		Errno ReceiveEnd();
+		/// <summary>half the capacity less 8 bytes</summary>
+		property Int32 MaxMessageSize { Int32 get(); }
+		property System::String^ Url { System::String^ get(); }
+		/// <summary>Ends sends and receives in progress with Errno::closed, calls after it return Errno::closed too. Same as Dispose</summary>
+		void Close();
+		~ShmChannel();
+	private:
+		ShmChannel();
+		static Errno Initialize(ShmChannel^ channel, System::String^ url, bool listen, Nullable<Int32> capacity);
+		UInt64 shm; // nngc_shm
+		System::String^ url;
+	};
+
+	ref class RepContext;
+
+	/// <summary>Handles one request of a RepServer. Return the reply, or nullptr to not answer at all</summary>
+	public delegate Msg^ RequestHandler(Msg^ request);
+
+	/// <summary>Statistics of one RepServer context</summary>
+	public value struct RepContextStats {
+		/// <summary>requests handled</summary>
+		Int64 Requests;
+		/// <summary>time from receiving a request until its reply was sent, summed up</summary>
+		Double BusySeconds;
+		/// <summary>share of the time since the server was opened this context was busy, 0 to 1</summary>
+		Double Utilization;
+	};
+
+	/// <summary>
+	/// Rep0 server handling several requests at once. It opens a number of nng contexts on one Rep0 socket,
+	/// each with its own receive/send loop, and runs the handler on a fixed number of worker threads.
+	/// Listen with ReplySocket
+	/// </summary>
+	public ref class RepServer : IDisposable {
+	public:
+		/// <param name="contexts">requests in progress at most</param>
+		/// <param name="workers">threads calling the handler</param>
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Open"/></exception>
+		RepServer(RequestHandler^ handler, Int32 contexts, Int32 workers);
+		/// <returns>Errno::ok on success</returns>
+		static Errno Open([Out] RepServer^% server, RequestHandler^ handler, Int32 contexts, Int32 workers);
+		/// <summary>The Rep0 socket, to listen and to set options on</summary>
+		property Socket^ ReplySocket { Socket^ get(); }
+		/// <summary>Requests received and waiting for a worker</summary>
+		property Int32 QueueDepth { Int32 get(); }
+		/// <summary>Handlers which threw an exception, their requests were not answered</summary>
+		property Int64 HandlerErrors { Int64 get(); }
+		/// <summary>Per context statistics since the server was opened</summary>
+		array<RepContextStats>^ ContextStats();
+		/// <summary>Stops the workers and closes the socket. Same as Dispose</summary>
+		void Close();
+		~RepServer();
+	internal:
+		Socket^ socket;
+		System::Collections::Concurrent::BlockingCollection<RepContext^>^ queue;
+		bool closed;
+	private:
+		RepServer();
+		static Errno Initialize(RepServer^ server, RequestHandler^ handler, Int32 contexts, Int32 workers);
+		void Work();
+		RequestHandler^ handler;
+		array<RepContext^>^ contexts;
+		array<System::Threading::Thread^>^ workers;
+		Int64 startedAt;
+		Int64 handlerErrors;
+	};
+
+	/// <summary>
+	/// Pool of ready to use Aio objects, for servers which would otherwise allocate one per request.
+	/// Rent creates a new Aio only when the pool is empty, Return frees it if the pool already holds
+	/// maximum idle Aios, so bursts don't leave a big pool behind.
+	/// </summary>
+	public ref class AioPool : IDisposable {
+	public:
+		/// <param name="initial">number of Aios created at once</param>
+		/// <param name="maximum">number of idle Aios kept at most</param>
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Alloc"/></exception>
+		AioPool(Int32 initial, Int32 maximum);
+		/// <returns>Errno::ok on success</returns>
+		static Errno Alloc([Out] AioPool^% pool, Int32 initial, Int32 maximum);
+		/// <summary>Take an Aio from the pool and bind callback and context to it</summary>
+		/// <returns>Errno::ok on success</returns>
+		Errno Rent([Out] Aio^% aio, System::Action<System::Object^>^ callback, Object^ object);
+		/// <summary>
+		/// Give an Aio back. An operation still pending is stopped, returning it from its own callback is fine,
+		/// also into a full pool. Timeout, message and completion queue are reset
+		/// </summary>
+		/// <returns>Errno::ok on success, Errno::state if the Aio isn't rented from this pool (or was given back already)</returns>
+		Errno Return(Aio^ aio);
+		/// <summary>Idle Aios in the pool</summary>
+		property Int32 Available { Int32 get(); }
+		/// <summary>Aios created by Rent because the pool was empty</summary>
+		property Int64 Misses { Int64 get(); }
+		/// <summary>Frees all idle Aios. Same as Dispose</summary>
+		void  Close();
+		~AioPool();
+	private:
+		AioPool();
+		static Errno Initialize(AioPool^ pool, Int32 initial, Int32 maximum);
+		array<Aio^>^ idle;
+		Int32 count;
+		Int64 misses;
+		bool closed;
+	};
+
+	/// <summary>
+	/// Completion queue for Aio, an alternative to callbacks on nng's own threads. The nng threads only
+	/// enqueue finished Aios, dedicated dispatcher threads call the .NET callbacks in batches.
+	/// Every Aio sticks to one dispatcher, so its callbacks are never concurrent.
+	/// Free the Aios using the queue (or set their CompletionQueue to nullptr) before closing it.
+	/// </summary>
+	public ref class AioCompletionQueue : IDisposable {
+	internal:
+		array<UIntPtr>^ queues; // native aio_queue*, one per dispatcher thread
+		UIntPtr Pick();
+		[ThreadStatic] static UIntPtr currentQueue; // the native queue this thread dispatches
+	public:
+		/// <exception cref="NngException">Throws exceptions, a non-throwing variant is avalable <see cref="Alloc"/></exception>
+		AioCompletionQueue(Int32 dispatchers, Int32 batchSize);
+		AioCompletionQueue(Int32 dispatchers) : AioCompletionQueue(dispatchers, 64) {};
+		/// <param name="dispatchers">number of dispatcher threads</param>
+		/// <param name="batchSize">maximum number of completions handled per native call</param>
+		/// <returns>Errno::ok on success</returns>
+		static Errno Alloc([Out] AioCompletionQueue^% queue, Int32 dispatchers, Int32 batchSize);
+		/// <summary>Callbacks called so far</summary>
+		property Int64 Completions { Int64 get(); }
+		/// <summary>Batches taken from the native queues so far</summary>
+		property Int64 Batches { Int64 get(); }
+		/// <summary>Stops the dispatcher threads. Same as Dispose</summary>
+		void Close();
+		~AioCompletionQueue();
+	private:
+		AioCompletionQueue();
+		static Errno Initialize(AioCompletionQueue^ queue, Int32 dispatchers, Int32 batchSize);
+		void Dispatch(Object^ native);
+		array<System::Threading::Thread^>^ threads;
+		Int32 batchSize;
+		Int32 next;
+		Int64 completions;
+		Int64 batches;
+		bool closing;
 	};
 
 	/// <summary>
@@ -377,7 +1372,8 @@ namespace Nng {
 	public ref class Protocols abstract sealed {
 		public:
 	  /// <summary>The client side on an RPC pattern. Should dial. Multiple dialers are supported</summary>
-		static Errno Req0([Out] Socket^% socket);
+		/// <param name="raw">defaults to false. A raw socket leaves request IDs and resends to the caller, see RpcClient</param>
+		static Errno Req0([Out] Socket^% socket, [Optional] Nullable<bool> raw);
 		/// <summary>The server side on an RPC pattern. Should listen. Multiple listeners are supported</summary>
 		static Errno Rep0([Out] Socket^% socket);
 		/// <summary>A bus sends messages to all directly connected peers. Can listen and dial, also mixed</summary>
@@ -396,6 +1392,9 @@ namespace Nng {
 		static Errno Respondent0([Out] Socket^% socket);
 		/// <summary>The server side on an voting pattern. Should listen</summary>
 		static Errno Surveyor0([Out] Socket^% socket);
+		/// <summary>A bidirectional connection. Polyamorous, it takes many peers and Socket::SendTo picks one</summary>
+		/// <param name="polyamorous">defaults to false</param>
+		static Errno Pair1([Out] Socket^% socket, [Optional] Nullable<bool> polyamorous);
 	};
 
 	/// <summary>The errors</summary>
@@ -433,8 +1432,8 @@ namespace Nng {
 		tranerr = 0x20000000,
 	};
 
-	/// <summary>The options. The options are not really thought through, currently you have to retrieve the string for an options and use the string</summary>
-	public enum class Option {
+	/// <summary>The options. Socket has overloads taking them directly, without any string conversion</summary>
+	public enum class Option : int {
 		sockname,
 		domain,
 		raw,
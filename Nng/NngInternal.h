@@ -1,6 +1,29 @@
 #pragma once
 
+#include "../NngCore/nngcore.h"
+
 namespace Nng {
 	extern nng_aio* getNativeAio(Aio^ aio);
 	extern nng_msg* getNativeMsg(Msg^ msg);
+	// the same as handles of the core, see NngCore/nngcore.h
+	extern nngc_aio coreAio(Aio^ aio);
+	inline nngc_msg coreMsg(Msg^ msg) { return msg->msg.ToUInt64(); }
+	extern int msgPoolAlloc(nng_msg** msg, size_t size, int* sizeClass);
+	extern void msgPoolFree(nng_msg* msg, int sizeClass);
+	// static UTF-8 name of an option, nullptr if there is none
+	extern const char* nativeOptionName(Option option);
+
+	// A String as zero terminated UTF-8 for the duration of a call. Interned strings (option names, URLs)
+	// are converted once and looked up afterwards, others are converted into a temporary buffer
+	class NativeString {
+	public:
+		NativeString(System::String^ str, bool intern);
+		~NativeString();
+		operator const char*() const { return this->str; }
+	private:
+		NativeString(const NativeString&) = delete;
+		NativeString& operator=(const NativeString&) = delete;
+		const char* str;
+		char* owned;
+	};
 }
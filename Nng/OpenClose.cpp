@@ -13,17 +13,6 @@
 #include "nng.h"
 #include "NngInternal.h"
 #include <cstring>
-#include "protocol/reqrep0/req.h"
-#include "protocol/reqrep0/rep.h"
-#include "protocol/bus0/bus.h"
-#include "protocol/pair0/pair.h"
-#include "protocol/pipeline0/pull.h"
-#include "protocol/pipeline0/push.h"
-#include "protocol/pubsub0/pub.h"
-#include "protocol/pubsub0/sub.h"
-#include "protocol/survey0/respond.h"
-#include "protocol/survey0/survey.h"
-
 
 
 namespace Nng {
@@ -35,18 +24,18 @@ namespace Nng {
 	}
 
 	void Socket::Fini(void) {
-		return ::nng_fini();
+		return ::nngc_fini();
 	}
 
 	Errno Socket::Close() {
 		IsClosed = true;
-		return static_cast<Errno>(::nng_close(this->NngSocket));
+		return static_cast<Errno>(::nngc_socket_close(this->NngSocket));
 	}
 
    // Note that CloseAll is a function only to be used in very rare circumstances
 	void Socket::CloseAll(void)
 	{
-		return ::nng_closeall();
+		return ::nngc_closeall();
 	}
 
    // The destructor will not be directly used, as .NET languages doen't have destructors, but it will be automatically converted to
@@ -58,114 +47,290 @@ namespace Nng {
 		}
 	}
 
-// deal with UTF-16. Declare a "const char *a" pointing to string bafter a conversion to UTF-8
-#define DECLARE_CONST_STRING(a,b) \
-	array<System::Byte>^ a##bytes; \
-  {\
-		long len = 4*b->Length; /*System::Text::Encoding::UTF8->GetByteCount(b); Faster to allocate just the maximum, 4 bytes per char */ \
-	  a##bytes = gcnew array<System::Byte>(len + 1); \
-		len = System::Text::Encoding::UTF8->GetBytes(b, 0, b->Length, a##bytes, 0); \
-		a##bytes[len] = 0; \
-	}\
-	pin_ptr<System::Byte> a##pin = &a##bytes[0]; \
-  const char* a = (const char*) a##pin;
+	// The option functions of the String overloads. The Option overloads go to the core by number
+
+	static Errno socket_setopt(UInt32 socket, const char* name, array<System::Byte>^ a)
+	{
+		if (name == nullptr) return Errno::notsup;
+		if (a == nullptr || a->Length == 0) return static_cast<Errno>(::nng_setopt(socket, name, nullptr, 0));
+		pin_ptr<System::Byte> p = &a[0];
+		return static_cast<Errno>(::nng_setopt(socket, name, (void*)p, a->Length));
+	}
+
+	static Errno socket_setopt_bool(UInt32 socket, const char* name, Boolean b)
+	{
+		if (name == nullptr) return Errno::notsup;
+		return static_cast<Errno>(::nng_setopt_bool(socket, name, b));
+	}
+
+	static Errno socket_setopt_int(UInt32 socket, const char* name, int i)
+	{
+		if (name == nullptr) return Errno::notsup;
+		return static_cast<Errno>(::nng_setopt_int(socket, name, i));
+	}
+
+	static Errno socket_setopt_ms(UInt32 socket, const char* name, Int32 i)
+	{
+		if (name == nullptr) return Errno::notsup;
+		return static_cast<Errno>(::nng_setopt_ms(socket, name, i));
+	}
+
+	static Errno socket_setopt_size(UInt32 socket, const char* name, size_t i)
+	{
+		if (name == nullptr) return Errno::notsup;
+		return static_cast<Errno>(::nng_setopt_size(socket, name, i));
+	}
+
+	static Errno socket_setopt_uint64(UInt32 socket, const char* name, UInt64 i)
+	{
+		if (name == nullptr) return Errno::notsup;
+		return static_cast<Errno>(::nng_setopt_uint64(socket, name, i));
+	}
+
+	static Errno socket_setopt_string(UInt32 socket, const char* name, System::String^ str)
+	{
+		if (name == nullptr) return Errno::notsup;
+		NativeString s(str, false); // values are not interned
+		return static_cast<Errno>(::nng_setopt_string(socket, name, s));
+	}
+
+	static Errno socket_getopt(UInt32 socket, const char* name, [Out] array<System::Byte>^% b)
+	{
+		b = nullptr;
+		if (name == nullptr) return Errno::notsup;
+		// most values fit, larger ones are read a second time into an array of the size nng reported
+		unsigned char small[256];
+		size_t size = sizeof(small);
+		int result = ::nng_getopt(socket, name, small, &size);
+		if (result != 0) return static_cast<Errno>(result);
+		if (size <= sizeof(small)) {
+			b = gcnew array<System::Byte>(static_cast<int>(size));
+			if (size > 0) Marshal::Copy(IntPtr(small), b, 0, static_cast<int>(size));
+			return Errno::ok;
+		}
+		auto large = gcnew array<System::Byte>(static_cast<int>(size));
+		pin_ptr<System::Byte> p = &large[0];
+		result = ::nng_getopt(socket, name, p, &size);
+		if (result != 0) return static_cast<Errno>(result);
+		if (size < static_cast<size_t>(large->Length)) System::Array::Resize(large, static_cast<int>(size));
+		b = large;
+		return Errno::ok;
+	}
+
+	static Errno socket_getopt_bool(UInt32 socket, const char* name, [Out] Boolean% b)
+	{
+		bool b2 = false;
+		int result = (name == nullptr) ? NNG_ENOTSUP : ::nng_getopt_bool(socket, name, &b2);
+		b = b2;
+		return static_cast<Errno>(result);
+	}
+
+	static Errno socket_getopt_int(UInt32 socket, const char* name, [Out] Int32% i)
+	{
+		Int32 i2 = 0;
+		int result = (name == nullptr) ? NNG_ENOTSUP : ::nng_getopt_int(socket, name, &i2);
+		i = i2;
+		return static_cast<Errno>(result);
+	}
+
+	static Errno socket_getopt_ms(UInt32 socket, const char* name, [Out] Int32% i)
+	{
+		Int32 i2 = 0;
+		int result = (name == nullptr) ? NNG_ENOTSUP : ::nng_getopt_ms(socket, name, &i2);
+		i = i2;
+		return static_cast<Errno>(result);
+	}
+
+	static Errno socket_getopt_size(UInt32 socket, const char* name, [Out] UInt64% i)
+	{
+		size_t i2 = 0;
+		int result = (name == nullptr) ? NNG_ENOTSUP : ::nng_getopt_size(socket, name, &i2);
+		i = i2;
+		return static_cast<Errno>(result);
+	}
+
+	static Errno socket_getopt_uint64(UInt32 socket, const char* name, [Out] UInt64% i)
+	{
+		UInt64 i2 = 0;
+		int result = (name == nullptr) ? NNG_ENOTSUP : ::nng_getopt_uint64(socket, name, &i2);
+		i = i2;
+		return static_cast<Errno>(result);
+	}
 
 	Errno Socket::SetOpt(System::String^ str, array<System::Byte>^ a)
 	{
-		DECLARE_CONST_STRING(ip1, str);
-		pin_ptr<System::Byte> ip2 = &a[0];
-		return static_cast<Errno>(::nng_setopt(this->NngSocket, (const char*)ip1, (void*)ip2, a->Length));
+		NativeString s(str, true);
+		return socket_setopt(this->NngSocket, s, a);
+	}
+	Errno Socket::SetOpt(Nng::Option option, array<System::Byte>^ a)
+	{
+		if (a == nullptr || a->Length == 0) return static_cast<Errno>(::nngc_socket_set(this->NngSocket, static_cast<int>(option), nullptr, 0));
+		pin_ptr<System::Byte> p = &a[0];
+		return static_cast<Errno>(::nngc_socket_set(this->NngSocket, static_cast<int>(option), p, a->Length));
+	}
+
+	Errno Socket::SetOptBool(System::String^ str, Boolean b)
+	{
+		NativeString s(str, true);
+		return socket_setopt_bool(this->NngSocket, s, b);
+	}
+	Errno Socket::SetOptBool(Nng::Option option, Boolean b)
+	{
+		return static_cast<Errno>(::nngc_socket_set_bool(this->NngSocket, static_cast<int>(option), b));
 	}
-   Errno Socket::SetOptBool(System::String^ str, Boolean b)
-   {
-      DECLARE_CONST_STRING(s, str);
-      return static_cast<Errno>(::nng_setopt_bool(this->NngSocket, s, b));
-   }
 
 	Errno Socket::SetOptInt(System::String^ str, int i) {
-		DECLARE_CONST_STRING(s, str);
-		return static_cast<Errno>(::nng_setopt_int(this->NngSocket, s, i));
+		NativeString s(str, true);
+		return socket_setopt_int(this->NngSocket, s, i);
+	}
+	Errno Socket::SetOptInt(Nng::Option option, int i) {
+		return static_cast<Errno>(::nngc_socket_set_int(this->NngSocket, static_cast<int>(option), i));
 	}
 
 	Errno Socket::SetOptMs(System::String^ str, Int32 i) {
-		DECLARE_CONST_STRING(s, str);
-		return static_cast<Errno>(::nng_setopt_ms(this->NngSocket, s, i));
+		NativeString s(str, true);
+		return socket_setopt_ms(this->NngSocket, s, i);
+	}
+	Errno Socket::SetOptMs(Nng::Option option, Int32 i) {
+		return static_cast<Errno>(::nngc_socket_set_ms(this->NngSocket, static_cast<int>(option), i));
 	}
 
 	Errno Socket::SetOptSize(System::String^ str, size_t i) {
-		DECLARE_CONST_STRING(s, str);
-		return static_cast<Errno>(::nng_setopt_size(this->NngSocket, s, i));
+		NativeString s(str, true);
+		return socket_setopt_size(this->NngSocket, s, i);
+	}
+	Errno Socket::SetOptSize(Nng::Option option, size_t i) {
+		return static_cast<Errno>(::nngc_socket_set_size(this->NngSocket, static_cast<int>(option), i));
 	}
+
 	Errno Socket::SetOptUInt64(System::String^ str, UInt64 i) {
-		DECLARE_CONST_STRING(s, str);
-		return static_cast<Errno>(::nng_setopt_uint64(this->NngSocket, s, i));
+		NativeString s(str, true);
+		return socket_setopt_uint64(this->NngSocket, s, i);
+	}
+	Errno Socket::SetOptUInt64(Nng::Option option, UInt64 i) {
+		return static_cast<Errno>(::nngc_socket_set_uint64(this->NngSocket, static_cast<int>(option), i));
 	}
 
 	Errno Socket::SetOptString(System::String^ str, System::String^ str2) {
-		DECLARE_CONST_STRING(s, str);
-		DECLARE_CONST_STRING(s2, str2);
-		return static_cast<Errno>(::nng_setopt_string(this->NngSocket, s, s2));
+		NativeString s(str, true);
+		return socket_setopt_string(this->NngSocket, s, str2);
+	}
+	Errno Socket::SetOptString(Nng::Option option, System::String^ str2) {
+		NativeString s(str2, false); // values are not interned
+		const char* value = s;
+		return static_cast<Errno>(::nngc_socket_set_string(this->NngSocket, static_cast<int>(option), value, strlen(value)));
 	}
 
 	Errno Socket::GetOpt(System::String^ str, [Out] array<System::Byte>^% b) {
-		DECLARE_CONST_STRING(s, str);
-		return Errno::ok;
+		NativeString s(str, true);
+		return socket_getopt(this->NngSocket, s, b);
+	}
+	Errno Socket::GetOpt(Nng::Option option, [Out] array<System::Byte>^% b) {
+		return socket_getopt(this->NngSocket, nativeOptionName(option), b); // the name from the core's table
 	}
 
-   Errno Socket::GetOptBool(System::String^ str, [Out] Boolean% b) {
-      DECLARE_CONST_STRING(s, str);
-      bool b2;
-      int result = ::nng_getopt_bool(this->NngSocket, s, &b2);
-      b = b2;
-      return static_cast<Errno>(result);
-   }
+	Errno Socket::GetOptBool(System::String^ str, [Out] Boolean% b) {
+		NativeString s(str, true);
+		return socket_getopt_bool(this->NngSocket, s, b);
+	}
+	Errno Socket::GetOptBool(Nng::Option option, [Out] Boolean% b) {
+		int b2;
+		int result = ::nngc_socket_get_bool(this->NngSocket, static_cast<int>(option), &b2);
+		b = (b2 != 0);
+		return static_cast<Errno>(result);
+	}
 
 	Errno Socket::GetOptInt(System::String^ str, [Out] Int32% i) {
-		DECLARE_CONST_STRING(s, str);
-		Int32 i2;
-		int result = ::nng_getopt_int(this->NngSocket, s, &i2);
+		NativeString s(str, true);
+		return socket_getopt_int(this->NngSocket, s, i);
+	}
+	Errno Socket::GetOptInt(Nng::Option option, [Out] Int32% i) {
+		int32_t i2;
+		int result = ::nngc_socket_get_int(this->NngSocket, static_cast<int>(option), &i2);
 		i = i2;
 		return static_cast<Errno>(result);
 	}
 
 	Errno Socket::GetOptMs(System::String^ str, [Out] Int32% i) {
-		DECLARE_CONST_STRING(s, str);
-		Int32 i2;
-		int result = ::nng_getopt_ms(this->NngSocket, s, &i2);
+		NativeString s(str, true);
+		return socket_getopt_ms(this->NngSocket, s, i);
+	}
+	Errno Socket::GetOptMs(Nng::Option option, [Out] Int32% i) {
+		int32_t i2;
+		int result = ::nngc_socket_get_ms(this->NngSocket, static_cast<int>(option), &i2);
 		i = i2;
 		return static_cast<Errno>(result);
 	}
 
 	Errno Socket::GetOptSize(System::String^ str, [Out] UInt64% i) {
-		DECLARE_CONST_STRING(s, str);
-		UInt64 i2;
-		int result = ::nng_getopt_size(this->NngSocket, s, &i2);
+		NativeString s(str, true);
+		return socket_getopt_size(this->NngSocket, s, i);
+	}
+	Errno Socket::GetOptSize(Nng::Option option, [Out] UInt64% i) {
+		uint64_t i2;
+		int result = ::nngc_socket_get_size(this->NngSocket, static_cast<int>(option), &i2);
 		i = i2;
 		return static_cast<Errno>(result);
-
 	}
+
 	Errno Socket::GetOptUInt64(System::String^ str, [Out] UInt64% i) {
-		DECLARE_CONST_STRING(s, str);
-		UInt64 i2;
-		int result = ::nng_getopt_uint64(this->NngSocket, s, &i2);
+		NativeString s(str, true);
+		return socket_getopt_uint64(this->NngSocket, s, i);
+	}
+	Errno Socket::GetOptUInt64(Nng::Option option, [Out] UInt64% i) {
+		uint64_t i2;
+		int result = ::nngc_socket_get_uint64(this->NngSocket, static_cast<int>(option), &i2);
 		i = i2;
 		return static_cast<Errno>(result);
 	}
 
+	Errno Socket::SetOptions(SocketOptions options)
+	{
+		nngc_socket_options o = {};
+		if (options.SendBuffer.HasValue) { o.set |= NNGC_SOCKOPT_SENDBUF; o.sendbuf = options.SendBuffer.Value; }
+		if (options.RecvBuffer.HasValue) { o.set |= NNGC_SOCKOPT_RECVBUF; o.recvbuf = options.RecvBuffer.Value; }
+		if (options.SendTimeout.HasValue) { o.set |= NNGC_SOCKOPT_SENDTIMEO; o.sendtimeo = options.SendTimeout.Value; }
+		if (options.RecvTimeout.HasValue) { o.set |= NNGC_SOCKOPT_RECVTIMEO; o.recvtimeo = options.RecvTimeout.Value; }
+		if (options.RecvMaxSize.HasValue) { o.set |= NNGC_SOCKOPT_RECVMAXSZ; o.recvmaxsz = options.RecvMaxSize.Value; }
+		if (options.ReconnectMin.HasValue) { o.set |= NNGC_SOCKOPT_RECONNMINT; o.reconnmint = options.ReconnectMin.Value; }
+		if (options.ReconnectMax.HasValue) { o.set |= NNGC_SOCKOPT_RECONNMAXT; o.reconnmaxt = options.ReconnectMax.Value; }
+		if (options.MaxTtl.HasValue) { o.set |= NNGC_SOCKOPT_MAXTTL; o.maxttl = options.MaxTtl.Value; }
+		return static_cast<Errno>(::nngc_socket_options_apply(this->NngSocket, &o));
+	}
+
+	Errno Socket::GetOptions([Out] SocketOptions% options)
+	{
+		nngc_socket_options o = {};
+		int result = ::nngc_socket_options_read(this->NngSocket, &o);
+		SocketOptions read;
+		if (o.set & NNGC_SOCKOPT_SENDBUF) read.SendBuffer = Nullable<Int32>(o.sendbuf);
+		if (o.set & NNGC_SOCKOPT_RECVBUF) read.RecvBuffer = Nullable<Int32>(o.recvbuf);
+		if (o.set & NNGC_SOCKOPT_SENDTIMEO) read.SendTimeout = Nullable<Int32>(o.sendtimeo);
+		if (o.set & NNGC_SOCKOPT_RECVTIMEO) read.RecvTimeout = Nullable<Int32>(o.recvtimeo);
+		if (o.set & NNGC_SOCKOPT_RECVMAXSZ) read.RecvMaxSize = Nullable<UInt64>(o.recvmaxsz);
+		if (o.set & NNGC_SOCKOPT_RECONNMINT) read.ReconnectMin = Nullable<Int32>(o.reconnmint);
+		if (o.set & NNGC_SOCKOPT_RECONNMAXT) read.ReconnectMax = Nullable<Int32>(o.reconnmaxt);
+		if (o.set & NNGC_SOCKOPT_MAXTTL) read.MaxTtl = Nullable<Int32>(o.maxttl);
+		options = read;
+		return static_cast<Errno>(result);
+	}
+
 	Listener::Listener(Socket^ sock, System::String^ str, [Optional] Nullable<Flag> flags)
 	{
-		DECLARE_CONST_STRING(s, str);
-		::nng_listener l;
-		int result = ::nng_listen(sock->NngSocket, s, &l, (flags.HasValue ? (int)(Flag)flags : 0));
+		NativeString s(str, true);
+		const char* url = s;
+		nngc_listener l;
+		int result = ::nngc_listen(sock->NngSocket, url, strlen(url), &l, (flags.HasValue ? (int)(Flag)flags : 0));
 		if (result != 0) throw gcnew NngException(static_cast<Errno>(result));
 		this->NngListener = l;
 	}
 
 	Errno Listener::Listen(Socket^ sock, System::String^ str, [Out] Listener^% listener, [Optional] Nullable<Flag> flags)
 	{
-		DECLARE_CONST_STRING(s, str);
-		::nng_listener l;
-		int result = ::nng_listen(sock->NngSocket, s, &l, (flags.HasValue ? (int)(Flag)flags : 0));
+		NativeString s(str, true);
+		const char* url = s;
+		nngc_listener l;
+		int result = ::nngc_listen(sock->NngSocket, url, strlen(url), &l, (flags.HasValue ? (int)(Flag)flags : 0));
 		listener = gcnew Listener();
 		listener->NngListener = l;
 		return static_cast<Errno>(result);
@@ -173,17 +338,19 @@ namespace Nng {
 
 	Dialer::Dialer(Socket^ sock, System::String^ str, [Optional] Nullable<int> flags)
 	{
-		DECLARE_CONST_STRING(s, str);
-		::nng_dialer d;
-		int result = ::nng_dial(sock->NngSocket, s, &d, (flags.HasValue ? (int)flags : 0));
+		NativeString s(str, true);
+		const char* url = s;
+		nngc_dialer d;
+		int result = ::nngc_dial(sock->NngSocket, url, strlen(url), &d, (flags.HasValue ? (int)flags : 0));
 		if (result != 0) throw gcnew NngException(static_cast<Errno>(result));
 		this->NngDialer = d;
 	}
 	Errno Dialer::Dial(Socket^ sock, System::String^ str, [Out] Dialer^% dialer, [Optional] Nullable<Flag> flags)
 	{
-		DECLARE_CONST_STRING(s, str);
-		::nng_dialer d;
-		int result = ::nng_dial(sock->NngSocket, s, &d, (flags.HasValue ? (int)(Flag)flags : 0));
+		NativeString s(str, true);
+		const char* url = s;
+		nngc_dialer d;
+		int result = ::nngc_dial(sock->NngSocket, url, strlen(url), &d, (flags.HasValue ? (int)(Flag)flags : 0));
 		dialer = gcnew Dialer();
 		dialer->NngDialer = d;
 		return static_cast<Errno>(result);
@@ -192,7 +359,7 @@ namespace Nng {
 	Errno Dialer::Close()
 	{
 		IsClosed = true;
-		return static_cast<Errno>(::nng_dialer_close(this->NngDialer));
+		return static_cast<Errno>(::nngc_dialer_close(this->NngDialer));
 	}
 
 	Dialer::Dialer()
@@ -215,7 +382,7 @@ namespace Nng {
 	Errno Listener::Close()
 	{
 		IsClosed = true;
-		return static_cast<Errno>(::nng_listener_close(this->NngListener));
+		return static_cast<Errno>(::nngc_listener_close(this->NngListener));
 	}
 
 	Listener::~Listener()
@@ -227,18 +394,20 @@ namespace Nng {
 
 	Errno Dialer::Create([Out] Dialer^% dialer, Socket^ socket, System::String^ url)
 	{
-		DECLARE_CONST_STRING(s, url);
-		::nng_dialer d;
-		int result = ::nng_dialer_create(&d, socket->NngSocket, s);
+		NativeString s(url, true);
+		const char* url2 = s;
+		nngc_dialer d;
+		int result = ::nngc_dialer_create(socket->NngSocket, url2, strlen(url2), &d);
 		dialer = gcnew Dialer();
 		dialer->NngDialer = d;
 		return static_cast<Errno>(result);
 	}
 
 	Errno Listener::Create([Out] Listener^% listener, Socket^ socket, System::String^ url) {
-		DECLARE_CONST_STRING(s, url);
-		::nng_listener l;
-		int result = ::nng_listener_create(&l, socket->NngSocket, s);
+		NativeString s(url, true);
+		const char* url2 = s;
+		nngc_listener l;
+		int result = ::nngc_listener_create(socket->NngSocket, url2, strlen(url2), &l);
 		listener = gcnew Listener();
 		listener->NngListener = l;
 		return static_cast<Errno>(result);
@@ -246,20 +415,20 @@ namespace Nng {
 
 	Errno Dialer::Start([Optional] Nullable<Flag> flags)
 	{
-		return static_cast<Errno>(::nng_dialer_start(this->NngDialer, (flags.HasValue ? (int)(Flag)flags : 0)));
+		return static_cast<Errno>(::nngc_dialer_start(this->NngDialer, (flags.HasValue ? (int)(Flag)flags : 0)));
 	}
 
 	Errno Listener::Start([Optional] Nullable<Flag> flags)
 	{
-		return static_cast<Errno>(::nng_listener_start(this->NngListener, (flags.HasValue ? (int)(Flag)flags : 0)));
+		return static_cast<Errno>(::nngc_listener_start(this->NngListener, (flags.HasValue ? (int)(Flag)flags : 0)));
 	}
 
 
-	static int nng_any_open([Out] Socket^% socket, int(*func)(::nng_socket*))
+	static int nng_any_open([Out] Socket^% socket, int protocol)
 	{
-		::nng_socket sock;
+		nngc_socket sock;
 		socket = nullptr;
-		int result = func(&sock);
+		int result = ::nngc_socket_open(protocol, &sock);
 		if (result == 0) {
 			socket = gcnew Socket();
 			socket->NngSocket = sock;
@@ -269,43 +438,50 @@ namespace Nng {
 
 	Errno Protocols::Rep0([Out] Socket^% socket)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_rep0_open));
+		return static_cast<Errno>(nng_any_open(socket, NNGC_PROTO_REP0));
 	}
-	Errno Protocols::Req0([Out] Socket^% socket)
+	Errno Protocols::Req0([Out] Socket^% socket, [Optional] Nullable<bool> raw)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_req0_open));
+		bool r = raw.HasValue && raw.Value;
+		return static_cast<Errno>(nng_any_open(socket, r ? NNGC_PROTO_REQ0_RAW : NNGC_PROTO_REQ0));
 	}
 	Errno Protocols::Bus0([Out] Socket^% socket)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_bus0_open));
+		return static_cast<Errno>(nng_any_open(socket, NNGC_PROTO_BUS0));
 	}
 	Errno Protocols::Pair0([Out] Socket^% socket)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_pair0_open));
+		return static_cast<Errno>(nng_any_open(socket, NNGC_PROTO_PAIR0));
 	}
 	Errno Protocols::Pull0([Out] Socket^% socket)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_pull0_open));
+		return static_cast<Errno>(nng_any_open(socket, NNGC_PROTO_PULL0));
 	}
 	Errno Protocols::Push0([Out] Socket^% socket)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_push0_open));
+		return static_cast<Errno>(nng_any_open(socket, NNGC_PROTO_PUSH0));
 	}
 	Errno Protocols::Pub0([Out] Socket^% socket)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_pub0_open));
+		return static_cast<Errno>(nng_any_open(socket, NNGC_PROTO_PUB0));
 	}
 	Errno Protocols::Sub0([Out] Socket^% socket)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_sub0_open));
+		return static_cast<Errno>(nng_any_open(socket, NNGC_PROTO_SUB0));
 	}
 	Errno Protocols::Respondent0([Out] Socket^% socket)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_respondent0_open));
+		return static_cast<Errno>(nng_any_open(socket, NNGC_PROTO_RESPONDENT0));
 	}
 	Errno Protocols::Surveyor0([Out] Socket^% socket)
 	{
-		return static_cast<Errno>(nng_any_open(socket, ::nng_surveyor0_open));
+		return static_cast<Errno>(nng_any_open(socket, NNGC_PROTO_SURVEYOR0));
+	}
+
+	Errno Protocols::Pair1([Out] Socket^% socket, [Optional] Nullable<bool> polyamorous)
+	{
+		bool poly = polyamorous.HasValue && polyamorous.Value;
+		return static_cast<Errno>(nng_any_open(socket, poly ? NNGC_PROTO_PAIR1_POLY : NNGC_PROTO_PAIR1));
 	}
 
 }
\ No newline at end of file
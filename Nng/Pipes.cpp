@@ -0,0 +1,103 @@
+/*
+Nng wrapper
+
+Pipes, the connections of a socket. Events and the table of connected pipes are kept by the core,
+NngCore/CorePipes.cpp, which completes the Aio of ReceivePipeEvent itself.
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <new>
+
+namespace Nng {
+
+	// the core counts milliseconds since 1970
+	static DateTime fromUnixMilliseconds(uint64_t milliseconds)
+	{
+		return DateTime(1970, 1, 1, 0, 0, 0, DateTimeKind::Utc).AddMilliseconds(static_cast<Double>(milliseconds));
+	}
+
+	Errno Socket::WatchPipes()
+	{
+		return static_cast<Errno>(::nngc_socket_pipes_watch(this->NngSocket));
+	}
+
+	void Socket::ReceivePipeEvent(Aio^ aio)
+	{
+		aio->FollowQueue(this->CompletionQueue);
+		::nngc_pipe_event_recv(this->NngSocket, coreAio(aio));
+	}
+
+	Errno Aio::GetPipeEvent([Out] PipeEvent% pipeEvent)
+	{
+		nngc_pipe_event e;
+		int result = ::nngc_aio_pipe_event(coreAio(this), &e);
+		PipeEvent read;
+		if (result == 0) {
+			read.Pipe = e.pipe;
+			read.Type = static_cast<PipeEventType>(e.event);
+			read.Time = fromUnixMilliseconds(e.time);
+			read.Dropped = e.dropped;
+		}
+		pipeEvent = read;
+		return static_cast<Errno>(result);
+	}
+
+	Errno Socket::GetPipes([Out] array<PipeInfo>^% pipes)
+	{
+		pipes = nullptr;
+		// pipes may connect between the calls, then once more with room for them
+		int capacity = 16;
+		for (;;) {
+			auto infos = new (std::nothrow) nngc_pipe_info[capacity];
+			if (infos == nullptr) return Errno::nomem;
+			int count;
+			int result = ::nngc_socket_pipes(this->NngSocket, infos, capacity, &count);
+			if (result == NNG_ENOSPC) {
+				delete[] infos;
+				capacity = count + 16;
+				continue;
+			}
+			if (result == 0) {
+				pipes = gcnew array<PipeInfo>(count);
+				for (int i = 0; i < count; i++) {
+					const nngc_pipe_info& p = infos[i];
+					PipeInfo% info = pipes[i];
+					info.Pipe = p.pipe;
+					info.Dialer = p.dialer;
+					info.Listener = p.listener;
+					info.Connected = fromUnixMilliseconds(p.connected);
+					info.MessagesSent = p.msgs_sent;
+					info.BytesSent = p.bytes_sent;
+					info.MessagesReceived = p.msgs_received;
+					info.BytesReceived = p.bytes_received;
+					info.RemoteAddress = gcnew System::String(p.remote_address);
+				}
+			}
+			delete[] infos;
+			return static_cast<Errno>(result);
+		}
+	}
+
+	Errno Socket::SendTo(Msg^ msg, UInt32 pipe, [Optional] Nullable<Flag> flags)
+	{
+		Errno err = msg->Unshare(); // nng frees the message once it is sent
+		if (err != Errno::ok) return err;
+		int result = ::nngc_sendmsg_to(this->NngSocket, coreMsg(msg), pipe, (flags.HasValue ? (int)(Flag)flags : NNG_FLAG_NONBLOCK));
+		if (result == 0) {
+			msg->InvalidateViews();
+			msg->msg = System::UIntPtr::Zero;
+		}
+		return static_cast<Errno>(result);
+	}
+
+	Errno Socket::ClosePipe(UInt32 pipe)
+	{
+		return static_cast<Errno>(::nngc_pipe_close(pipe));
+	}
+}
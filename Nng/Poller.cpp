@@ -0,0 +1,172 @@
+/*
+Nng wrapper
+
+Poller, readiness of many sockets. The waiting is done by the core (NngCore/CorePoller.cpp),
+the wrapper maps the socket ids it reports back to the Socket objects.
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <msclr/lock.h>
+#include <new>
+
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+
+namespace Nng {
+
+	Poller::Poller()
+	{
+	}
+
+	Errno Poller::Initialize(Poller^ poller, Int32 batch)
+	{
+		if (batch < 1) return Errno::inval;
+		auto events = new (std::nothrow) nngc_poll_event[batch];
+		if (events == nullptr) return Errno::nomem;
+		nngc_poller p;
+		int result = ::nngc_poller_create(&p);
+		if (result != 0) {
+			delete[] events;
+			return static_cast<Errno>(result);
+		}
+		poller->poller = p;
+		poller->events = UIntPtr(events);
+		poller->ready = gcnew array<Socket^>(batch);
+		poller->readyEvents = gcnew array<PollEvents>(batch);
+		poller->sockets = gcnew Dictionary<UInt32, Socket^>();
+		return Errno::ok;
+	}
+
+	Poller::Poller(Int32 batch)
+	{
+		Errno err = Initialize(this, batch);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno Poller::Open([Out] Poller^% poller, Int32 batch)
+	{
+		poller = gcnew Poller();
+		return Initialize(poller, batch);
+	}
+
+	Errno Poller::Add(Socket^ socket, PollEvents events)
+	{
+		if (socket == nullptr || this->poller == 0) return Errno::inval;
+		msclr::lock l(this->sockets);
+		int result = ::nngc_poller_add(this->poller, socket->NngSocket, static_cast<uint32_t>(events));
+		if (result == 0) this->sockets[socket->NngSocket] = socket;
+		return static_cast<Errno>(result);
+	}
+
+	Errno Poller::Remove(Socket^ socket)
+	{
+		if (socket == nullptr || this->poller == 0) return Errno::inval;
+		msclr::lock l(this->sockets);
+		int result = ::nngc_poller_remove(this->poller, socket->NngSocket);
+		this->sockets->Remove(socket->NngSocket);
+		return static_cast<Errno>(result);
+	}
+
+	Int32 Poller::Count::get()
+	{
+		if (this->poller == 0) return 0;
+		return ::nngc_poller_count(this->poller);
+	}
+
+	Errno Poller::Wait(Int32 timeout, [Out] Int32% count)
+	{
+		count = 0;
+		if (this->poller == 0) return Errno::closed;
+		auto events = reinterpret_cast<nngc_poll_event*>(this->events.ToPointer());
+		int n;
+		int result = ::nngc_poller_wait(this->poller, events, this->ready->Length, timeout, &n);
+		if (result != 0) return static_cast<Errno>(result);
+
+		msclr::lock l(this->sockets);
+		int found = 0;
+		for (int i = 0; i < n; i++) {
+			Socket^ socket;
+			if (!this->sockets->TryGetValue(events[i].socket, socket)) continue; // removed in the meantime
+			this->ready[found] = socket;
+			this->readyEvents[found] = static_cast<PollEvents>(events[i].events);
+			found++;
+		}
+		count = found;
+		return Errno::ok;
+	}
+
+	array<Socket^>^ Poller::Ready::get()
+	{
+		return this->ready;
+	}
+
+	array<PollEvents>^ Poller::ReadyEvents::get()
+	{
+		return this->readyEvents;
+	}
+
+	Errno Poller::WaitAny(Int32 timeout, [Out] array<Socket^>^% ready)
+	{
+		ready = nullptr;
+		Int32 count;
+		Errno err = Wait(timeout, count);
+		if (err != Errno::ok) return err;
+		ready = gcnew array<Socket^>(count);
+		System::Array::Copy(this->ready, ready, count);
+		return Errno::ok;
+	}
+
+	Errno Poller::WaitAll(array<Socket^>^ sockets, PollEvents events, Int32 timeout)
+	{
+		if (sockets == nullptr) return Errno::inval;
+		auto pending = gcnew HashSet<Socket^>(sockets);
+		{
+			msclr::lock l(this->sockets);
+			for each (Socket^ socket in pending) {
+				if (socket == nullptr || !this->sockets->ContainsKey(socket->NngSocket)) return Errno::inval;
+			}
+		}
+
+		auto watch = Stopwatch::StartNew();
+		while (pending->Count > 0) {
+			Int32 left = -1;
+			if (timeout >= 0) {
+				left = timeout - static_cast<Int32>(watch->ElapsedMilliseconds);
+				if (left <= 0) return Errno::timedout;
+			}
+			Int32 count;
+			Errno err = Wait(left, count);
+			if (err != Errno::ok) return err;
+			for (int i = 0; i < count; i++) {
+				if ((this->readyEvents[i] & events) != PollEvents::none) pending->Remove(this->ready[i]);
+			}
+		}
+		return Errno::ok;
+	}
+
+	void Poller::Wake()
+	{
+		if (this->poller != 0) ::nngc_poller_wake(this->poller);
+	}
+
+	void Poller::Close()
+	{
+		if (this->poller == 0) return;
+		::nngc_poller_destroy(this->poller);
+		delete[] reinterpret_cast<nngc_poll_event*>(this->events.ToPointer());
+		this->poller = 0;
+		this->events = UIntPtr::Zero;
+		this->sockets->Clear();
+	}
+
+	Poller::~Poller()
+	{
+		Close();
+	}
+}
@@ -0,0 +1,43 @@
+/*
+Nng wrapper
+
+Receive wait policies of a socket. The spinning, yielding and adapting are done by the core
+(NngCore/CoreRecvWait.cpp) inside the receive calls, the wrapper only sets the policy and reads its counters.
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+
+namespace Nng {
+
+	Errno Socket::SetReceiveWait(Nullable<ReceiveWaitPolicy> policy)
+	{
+		if (!policy.HasValue) return static_cast<Errno>(::nngc_socket_recv_wait_set(this->NngSocket, nullptr));
+		nngc_recv_wait p;
+		p.spins = policy.Value.Spins;
+		p.yields = policy.Value.Yields;
+		p.adaptive = policy.Value.Adaptive ? 1 : 0;
+		return static_cast<Errno>(::nngc_socket_recv_wait_set(this->NngSocket, &p));
+	}
+
+	Errno Socket::GetReceiveWaitStats([Out] ReceiveWaitStats% stats)
+	{
+		nngc_recv_wait_stats s;
+		int result = ::nngc_socket_recv_wait_stats(this->NngSocket, &s);
+		ReceiveWaitStats read;
+		read.SpinHits = s.spin_hits;
+		read.YieldHits = s.yield_hits;
+		read.Blocks = s.blocks;
+		read.Skips = s.skips;
+		read.Spins = s.spins;
+		read.Yields = s.yields;
+		read.Gap = s.gap_ns / 1000.0;
+		read.Phase = s.phase_ns / 1000.0;
+		stats = read;
+		return static_cast<Errno>(result);
+	}
+}
@@ -0,0 +1,240 @@
+/*
+Nng wrapper
+
+Class RepServer, a Rep0 server working on several nng contexts at once
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+
+using namespace System::Collections::Concurrent;
+using namespace System::Diagnostics;
+using namespace System::Threading;
+
+namespace Nng {
+
+	/*
+	A cooked Rep0 socket has one implicit context, so a second request can't be received before the
+	first one is answered. nng contexts lift that: every context runs its own receive -> handle -> send
+	loop on one Aio, and nng routes each reply back through the context that received the request.
+
+	The Aio callbacks only move requests to a bounded queue; handlers run on the server's own worker
+	threads, so a slow handler never blocks an nng thread. A context is busy from the moment its request
+	arrives until its reply is sent, that is what the utilization figure measures.
+	*/
+
+	private ref class RepContext {
+	internal:
+		RepServer^ server;
+		UInt32 ctx;
+		Aio^ aio;
+		bool sending;
+		Msg^ request;
+		Int64 receivedAt;
+		Int64 busyTicks;
+		Int64 requests;
+
+		void Receive()
+		{
+			this->sending = false;
+			this->aio->FollowQueue(this->server->socket->CompletionQueue);
+			::nng_ctx_recv(this->ctx, getNativeAio(this->aio));
+		}
+
+		void Reply(Msg^ reply)
+		{
+			if (reply == nullptr) { // no answer, the requester will retry or time out
+				Done();
+				Receive();
+				return;
+			}
+			this->aio->SetMsg(reply);
+			// nng owns the message from here on, a failed send is cleaned up in Completed
+			reply->InvalidateViews();
+			reply->msg = System::UIntPtr::Zero;
+			this->sending = true;
+			this->aio->FollowQueue(this->server->socket->CompletionQueue);
+			::nng_ctx_send(this->ctx, getNativeAio(this->aio));
+		}
+
+		void Done()
+		{
+			Interlocked::Add(this->busyTicks, Stopwatch::GetTimestamp() - this->receivedAt);
+			Interlocked::Increment(this->requests);
+		}
+
+		void Completed(Object^)
+		{
+			Errno result = this->aio->Result();
+			if (this->sending) {
+				if (result != Errno::ok) this->aio->GetMsg()->Free();
+				Done();
+				if (result != Errno::closed) Receive();
+				return;
+			}
+			if (result == Errno::closed) return;
+			if (result != Errno::ok) { // timed out or similar, just keep listening
+				Receive();
+				return;
+			}
+			this->request = this->aio->GetMsg();
+			this->receivedAt = Stopwatch::GetTimestamp();
+			try {
+				if (!this->server->closed) {
+					this->server->queue->Add(this); // never blocks, see RepServer::Initialize
+					return;
+				}
+			}
+			catch (InvalidOperationException^) { // Close() came in between
+			}
+			this->request->Free();
+			this->request = nullptr;
+		}
+	};
+
+	RepServer::RepServer()
+	{
+	}
+
+	RepServer::RepServer(RequestHandler^ handler, Int32 contexts, Int32 workers)
+	{
+		Errno err = Initialize(this, handler, contexts, workers);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno RepServer::Open([Out] RepServer^% server, RequestHandler^ handler, Int32 contexts, Int32 workers)
+	{
+		server = gcnew RepServer();
+		Errno err = Initialize(server, handler, contexts, workers);
+		if (err != Errno::ok) server = nullptr;
+		return err;
+	}
+
+	Errno RepServer::Initialize(RepServer^ server, RequestHandler^ handler, Int32 contexts, Int32 workers)
+	{
+		if (handler == nullptr || contexts < 1 || workers < 1) return Errno::inval;
+		Socket^ socket;
+		Errno err = Protocols::Rep0(socket);
+		if (err != Errno::ok) return err;
+		server->socket = socket;
+		server->handler = handler;
+		server->startedAt = Stopwatch::GetTimestamp();
+		// every context has at most one request queued, so this bound is never hit while running
+		server->queue = gcnew BlockingCollection<RepContext^>(gcnew ConcurrentQueue<RepContext^>(), contexts);
+
+		server->contexts = gcnew array<RepContext^>(contexts);
+		for (int i = 0; i < contexts; i++) {
+			auto context = gcnew RepContext();
+			context->server = server;
+			::nng_ctx ctx;
+			int result = ::nng_ctx_open(&ctx, socket->NngSocket);
+			if (result != 0) {
+				server->Close();
+				return static_cast<Errno>(result);
+			}
+			context->ctx = ctx;
+			server->contexts[i] = context;
+			err = Aio::Alloc(context->aio, gcnew Action<Object^>(context, &RepContext::Completed), nullptr);
+			if (err != Errno::ok) {
+				server->Close();
+				return err;
+			}
+		}
+
+		server->workers = gcnew array<Thread^>(workers);
+		for (int i = 0; i < workers; i++) {
+			auto thread = gcnew Thread(gcnew ThreadStart(server, &RepServer::Work));
+			thread->IsBackground = true;
+			thread->Name = "Nng RepServer worker " + i;
+			server->workers[i] = thread;
+			thread->Start();
+		}
+		for (int i = 0; i < contexts; i++) {
+			server->contexts[i]->Receive();
+		}
+		return Errno::ok;
+	}
+
+	void RepServer::Work()
+	{
+		for each (RepContext^ context in this->queue->GetConsumingEnumerable()) {
+			Msg^ request = context->request;
+			context->request = nullptr;
+			Msg^ reply = nullptr;
+			try {
+				reply = this->handler(request);
+			}
+			catch (Exception^) {
+				// a failing handler drops the request, like a server that doesn't answer
+				Interlocked::Increment(this->handlerErrors);
+			}
+			if (reply != request && request->msg != System::UIntPtr::Zero) request->Free();
+			if (this->closed) {
+				if (reply != nullptr) reply->Free();
+				continue;
+			}
+			context->Reply(reply);
+		}
+	}
+
+	Socket^ RepServer::ReplySocket::get()
+	{
+		return this->socket;
+	}
+
+	Int32 RepServer::QueueDepth::get()
+	{
+		return this->queue->Count;
+	}
+
+	Int64 RepServer::HandlerErrors::get()
+	{
+		return Interlocked::Read(this->handlerErrors);
+	}
+
+	array<RepContextStats>^ RepServer::ContextStats()
+	{
+		Int64 elapsed = Stopwatch::GetTimestamp() - this->startedAt;
+		auto stats = gcnew array<RepContextStats>(this->contexts->Length);
+		for (int i = 0; i < this->contexts->Length; i++) {
+			RepContext^ context = this->contexts[i];
+			if (context == nullptr) continue;
+			Int64 busy = Interlocked::Read(context->busyTicks);
+			stats[i].Requests = Interlocked::Read(context->requests);
+			stats[i].BusySeconds = static_cast<Double>(busy) / Stopwatch::Frequency;
+			stats[i].Utilization = elapsed > 0 ? static_cast<Double>(busy) / elapsed : 0.0;
+		}
+		return stats;
+	}
+
+	void RepServer::Close()
+	{
+		if (this->closed) return;
+		this->closed = true;
+		// workers first, they must not start a send on an Aio freed below
+		if (this->queue != nullptr) {
+			this->queue->CompleteAdding();
+			if (this->workers != nullptr) {
+				for each (Thread^ thread in this->workers) {
+					if (thread != nullptr && thread != Thread::CurrentThread) thread->Join();
+				}
+			}
+		}
+		if (this->socket != nullptr) this->socket->Close(); // closes the contexts and fails their Aios
+		if (this->contexts != nullptr) {
+			for each (RepContext^ context in this->contexts) {
+				if (context != nullptr && context->aio != nullptr) context->aio->Free();
+			}
+		}
+	}
+
+	RepServer::~RepServer()
+	{
+		Close();
+	}
+}
@@ -0,0 +1,300 @@
+/*
+Nng wrapper
+
+Class RpcClient, a multiplexed Req0 client
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <msclr/lock.h>
+
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+using namespace System::Threading::Tasks;
+
+namespace Nng {
+
+	/*
+	The client uses a raw Req0 socket, like UnitTest2 does by hand: every request gets a request ID in
+	its header (high bit set, that is how nng marks the end of the backtrace), and the Rep0 side echoes
+	the header. Replies are matched through a hash table of pending requests instead of a list scan.
+	The table is split into stripes, each with its own lock, so many sending threads don't contend on
+	one lock.
+
+	Timeouts are kept in a timing wheel driven by one timer: a request is put into the slot of its
+	deadline tick, and the timer only looks at the slots which became due. Requests further away than
+	one turn of the wheel simply stay in their slot for another round.
+	*/
+
+	private ref class RpcRequest {
+	internal:
+		RpcClient^ client;
+		UInt32 id;
+		Int64 deadline; // in wheel ticks, Int64::MaxValue for none
+		TaskCompletionSource<Msg^>^ source;
+		CancellationTokenRegistration registration;
+	};
+
+	static const int rpcStripes = 64;
+	static const int rpcWheelSlots = 1024;
+	static const int rpcTickMs = 10;
+
+	RpcClient::RpcClient()
+	{
+	}
+
+	RpcClient::RpcClient(Int32 receivers)
+	{
+		Errno err = Initialize(this, receivers);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno RpcClient::Open([Out] RpcClient^% client, Int32 receivers)
+	{
+		client = gcnew RpcClient();
+		Errno err = Initialize(client, receivers);
+		if (err != Errno::ok) client = nullptr;
+		return err;
+	}
+
+	Errno RpcClient::Initialize(RpcClient^ client, Int32 receivers)
+	{
+		if (receivers < 1) return Errno::inval;
+		Socket^ socket;
+		Errno err = Protocols::Req0(socket, true); // raw, nng 1.x can't switch an open socket
+		if (err != Errno::ok) return err;
+		client->socket = socket;
+		client->DefaultTimeout = -1;
+
+		client->stripes = gcnew array<Dictionary<UInt32, RpcRequest^>^>(rpcStripes);
+		for (int i = 0; i < rpcStripes; i++) {
+			client->stripes[i] = gcnew Dictionary<UInt32, RpcRequest^>();
+		}
+		client->wheel = gcnew array<List<UInt32>^>(rpcWheelSlots);
+		for (int i = 0; i < rpcWheelSlots; i++) {
+			client->wheel[i] = gcnew List<UInt32>();
+		}
+		client->clock = Diagnostics::Stopwatch::StartNew();
+
+		client->receivers = gcnew array<Aio^>(receivers);
+		for (int i = 0; i < receivers; i++) {
+			err = Aio::Alloc(client->receivers[i], gcnew Action<Object^>(client, &RpcClient::Received), i);
+			if (err != Errno::ok) {
+				client->Close();
+				return err;
+			}
+		}
+		for (int i = 0; i < receivers; i++) {
+			socket->Receive(client->receivers[i]);
+		}
+		client->timer = gcnew Timer(gcnew TimerCallback(client, &RpcClient::Tick), nullptr, rpcTickMs, rpcTickMs);
+		return Errno::ok;
+	}
+
+	Int64 RpcClient::CurrentTick()
+	{
+		return this->clock->ElapsedMilliseconds / rpcTickMs;
+	}
+
+	RpcRequest^ RpcClient::Remove(UInt32 id)
+	{
+		auto stripe = this->stripes[id % rpcStripes];
+		msclr::lock l(stripe);
+		RpcRequest^ request;
+		if (!stripe->TryGetValue(id, request)) return nullptr;
+		stripe->Remove(id);
+		System::Threading::Interlocked::Decrement(this->pending);
+		return request;
+	}
+
+	void RpcClient::Fail(RpcRequest^ request, Errno err)
+	{
+		request->registration.Dispose();
+		if (err == Errno::canceled) request->source->TrySetCanceled();
+		else request->source->TrySetException(gcnew NngException(err));
+	}
+
+	void RpcClient::Cancel(Object^ state)
+	{
+		// the registration is disposed by whoever removes the request, so don't touch it here
+		auto request = safe_cast<RpcRequest^>(state);
+		auto client = request->client;
+		auto stripe = client->stripes[request->id % rpcStripes];
+		{
+			msclr::lock l(stripe);
+			RpcRequest^ found;
+			if (!stripe->TryGetValue(request->id, found) || found != request) return;
+			stripe->Remove(request->id);
+		}
+		System::Threading::Interlocked::Decrement(client->pending);
+		request->source->TrySetCanceled();
+	}
+
+	Task<Msg^>^ RpcClient::RequestAsync(Msg^ request, [Optional] Nullable<Int32> timeout, [Optional] Nullable<CancellationToken> cancellationToken)
+	{
+		if (request == nullptr || request->msg == System::UIntPtr::Zero) {
+			auto failed = gcnew TaskCompletionSource<Msg^>();
+			failed->SetException(gcnew NngException(Errno::inval));
+			return failed->Task;
+		}
+
+		auto entry = gcnew RpcRequest();
+		entry->client = this;
+		entry->id = static_cast<UInt32>(System::Threading::Interlocked::Increment(this->nextId)) | 0x80000000u;
+		entry->source = gcnew TaskCompletionSource<Msg^>(TaskCreationOptions::RunContinuationsAsynchronously);
+		entry->deadline = Int64::MaxValue;
+		Int32 ms = timeout.HasValue ? (Int32)timeout : this->DefaultTimeout;
+		if (ms >= 0) entry->deadline = CurrentTick() + (ms + rpcTickMs - 1) / rpcTickMs;
+
+		Errno err = request->HeaderAppendU32(entry->id);
+		if (err != Errno::ok) {
+			entry->source->SetException(gcnew NngException(err));
+			return entry->source->Task;
+		}
+		// register before the entry is visible, a reply may otherwise dispose the registration while it is set
+		bool cancellable = cancellationToken.HasValue && ((CancellationToken)cancellationToken).CanBeCanceled;
+		if (cancellable) {
+			entry->registration = ((CancellationToken)cancellationToken).Register(gcnew Action<Object^>(&RpcClient::Cancel), entry);
+		}
+		{
+			auto stripe = this->stripes[entry->id % rpcStripes];
+			msclr::lock l(stripe);
+			stripe[entry->id] = entry;
+		}
+		System::Threading::Interlocked::Increment(this->pending);
+		if (entry->deadline != Int64::MaxValue) {
+			auto slot = this->wheel[static_cast<int>(entry->deadline % rpcWheelSlots)];
+			msclr::lock l(slot);
+			slot->Add(entry->id);
+		}
+		if (cancellable && ((CancellationToken)cancellationToken).IsCancellationRequested) {
+			Cancel(entry); // fired before the entry was in the table, or while it was put there
+			request->HeaderChop(4); // not sent, the caller still owns the message
+			return entry->source->Task;
+		}
+
+		auto task = entry->source->Task; // a fast reply may complete and drop the entry
+		err = this->socket->Send(request, Flag::none);
+		if (err != Errno::ok) {
+			request->HeaderChop(4); // the caller still owns the message, give it back unchanged
+			RpcRequest^ removed = Remove(entry->id);
+			if (removed != nullptr) Fail(removed, err);
+		}
+		return task;
+	}
+
+	void RpcClient::Received(Object^ index)
+	{
+		Aio^ aio = this->receivers[safe_cast<int>(index)];
+		Errno result = aio->Result();
+		if (result != Errno::ok) {
+			if (result != Errno::closed && !this->closed) this->socket->Receive(aio);
+			return;
+		}
+		Msg^ msg = aio->GetMsg();
+		this->socket->Receive(aio); // get ready to receive again
+
+		UInt32 id;
+		if (msg->HeaderTrimU32(id) != Errno::ok) {
+			msg->Free();
+			return;
+		}
+		RpcRequest^ request = Remove(id);
+		if (request == nullptr) { // timed out or cancelled already
+			msg->Free();
+			return;
+		}
+		request->registration.Dispose();
+		if (!request->source->TrySetResult(msg)) msg->Free();
+	}
+
+	void RpcClient::Tick(Object^)
+	{
+		if (!Monitor::TryEnter(this->wheel)) return; // the previous tick is still running
+		try {
+			Int64 now = CurrentTick();
+			Int64 from = this->processedTick + 1;
+			if (now - from >= rpcWheelSlots) from = now - rpcWheelSlots + 1; // every slot once is enough
+			for (Int64 tick = from; tick <= now; tick++) {
+				auto slot = this->wheel[static_cast<int>(tick % rpcWheelSlots)];
+				msclr::lock l(slot);
+				int kept = 0;
+				for (int i = 0; i < slot->Count; i++) {
+					UInt32 id = slot[i];
+					auto stripe = this->stripes[id % rpcStripes];
+					RpcRequest^ request = nullptr;
+					bool expired = false;
+					{
+						msclr::lock ls(stripe);
+						if (stripe->TryGetValue(id, request)) {
+							expired = (request->deadline <= now);
+							if (expired) stripe->Remove(id);
+						}
+					}
+					if (request == nullptr) continue; // answered already
+					if (expired) {
+						System::Threading::Interlocked::Decrement(this->pending);
+						Fail(request, Errno::timedout);
+					}
+					else {
+						slot[kept++] = id; // due in a later turn of the wheel
+					}
+				}
+				slot->RemoveRange(kept, slot->Count - kept);
+			}
+			this->processedTick = now;
+		}
+		finally {
+			Monitor::Exit(this->wheel);
+		}
+	}
+
+	Int32 RpcClient::Pending::get()
+	{
+		return this->pending;
+	}
+
+	Socket^ RpcClient::RequestSocket::get()
+	{
+		return this->socket;
+	}
+
+	void RpcClient::Close()
+	{
+		if (this->closed) return;
+		this->closed = true;
+		if (this->timer != nullptr) this->timer->Dispose();
+		if (this->socket != nullptr) this->socket->Close();
+		if (this->receivers != nullptr) {
+			for (int i = 0; i < this->receivers->Length; i++) {
+				if (this->receivers[i] != nullptr) this->receivers[i]->Free();
+			}
+		}
+		if (this->stripes != nullptr) {
+			for (int i = 0; i < rpcStripes; i++) {
+				auto stripe = this->stripes[i];
+				array<RpcRequest^>^ left;
+				{
+					msclr::lock l(stripe);
+					left = gcnew array<RpcRequest^>(stripe->Count);
+					stripe->Values->CopyTo(left, 0);
+					stripe->Clear();
+				}
+				for each (RpcRequest^ request in left) {
+					Fail(request, Errno::closed);
+				}
+			}
+		}
+		this->pending = 0;
+	}
+
+	RpcClient::~RpcClient()
+	{
+		Close();
+	}
+}
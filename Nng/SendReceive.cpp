@@ -17,15 +17,40 @@ Sending and receiving data
 extern "C" struct nng_aio {};
 extern "C" struct nng_msg {};
 
+// The work is done by the core (NngCore/CoreSocket.cpp), the batch functions loop in native
+// code there, so a batch costs one managed -> native transition instead of one per message.
+
 namespace Nng {
 
+	// scratch space for the batch functions, per thread so concurrent senders don't share it
+	private ref class BatchScratch abstract sealed {
+	internal:
+		[ThreadStatic] static array<UInt64>^ msgs; // nngc_msg handles, 64 bit on x86 too
+		[ThreadStatic] static array<Byte>^ data;
+		[ThreadStatic] static array<Int32>^ lengths;
+
+		static array<UInt64>^ Msgs(int count) {
+			if (msgs == nullptr || msgs->Length < count) msgs = gcnew array<UInt64>(count < 64 ? 64 : count);
+			return msgs;
+		}
+		static array<Byte>^ Data(Int64 size) {
+			if (size > INT32_MAX) throw gcnew OutOfMemoryException();
+			if (data == nullptr || data->Length < size) data = gcnew array<Byte>(size < 65536 ? 65536 : static_cast<int>(size));
+			return data;
+		}
+		static array<Int32>^ Lengths(int count) {
+			if (lengths == nullptr || lengths->Length < count) lengths = gcnew array<Int32>(count < 64 ? 64 : count);
+			return lengths;
+		}
+	};
+
 	Errno Socket::Send(array<Byte>^ data, [Optional] Nullable<Flag> flags)
 	{
 		pin_ptr<Byte> pin = &data[0];
 		
 		int flags2 = (int) Flag::nonblock; 
 		if (flags.HasValue) flags2 = (int)(Flag)flags;
-		int result = ::nng_send(this->NngSocket, (void*)pin, data->LongLength, flags2);
+		int result = ::nngc_send(this->NngSocket, pin, data->LongLength, flags2);
 		return static_cast<Errno>(result);
 	}
 
@@ -33,17 +58,16 @@ namespace Nng {
 	{
 		int flags2 = 0;
 		if (flags.HasValue) flags2 = (int)(Flag)flags;
-		flags2 |= NNG_FLAG_ALLOC;
 
 		void* buf;
 		size_t size;
-		int result = ::nng_recv(this->NngSocket, &buf, &size, flags2);
+		int result = ::nngc_recv_alloc(this->NngSocket, &buf, &size, flags2);
 		if (result == 0) {
 			if (size > INT32_MAX) throw gcnew OutOfMemoryException();
 			data = gcnew array<Byte>(static_cast<int>(size));
 			pin_ptr<Byte> pin = &data[0];
 			memcpy(pin, buf, size);
-			nng_free(buf, size);
+			::nngc_free(buf, size);
 		}
 		else {
 			data = nullptr;
@@ -51,16 +75,54 @@ namespace Nng {
 		return static_cast<Errno>(result);
 	}
 
+	Errno Socket::Receive(array<Byte>^ buffer, Int32 offset, Int32 count, [Out] Int32% received, [Optional] Nullable<Flag> flags)
+	{
+		received = 0;
+		if (buffer == nullptr || offset < 0 || count < 0 || offset > buffer->Length - count) return Errno::inval;
+
+		int flags2 = (flags.HasValue ? (int)(Flag)flags : 0);
+		size_t size;
+		int result;
+		if (count > 0) {
+			pin_ptr<Byte> pin = &buffer[offset];
+			result = ::nngc_recv_into(this->NngSocket, pin, count, &size, flags2);
+		}
+		else {
+			Byte dummy; // &buffer[offset] would be out of range for an empty slice
+			result = ::nngc_recv_into(this->NngSocket, &dummy, 0, &size, flags2);
+		}
+		received = (size > INT32_MAX) ? INT32_MAX : static_cast<Int32>(size);
+		return static_cast<Errno>(result);
+	}
+
+	Errno Socket::Receive(IntPtr buffer, size_t size, [Out] UInt64% received, [Optional] Nullable<Flag> flags)
+	{
+		received = 0;
+		if (buffer == IntPtr::Zero && size != 0) return Errno::inval;
+
+		size_t size2;
+		int result = ::nngc_recv_into(this->NngSocket, buffer.ToPointer(), size, &size2, (flags.HasValue ? (int)(Flag)flags : 0));
+		received = size2;
+		return static_cast<Errno>(result);
+	}
+
 	Errno Socket::Send(Msg^ msg, [Optional] Nullable<Flag> flags)
 	{
-		nng_msg* msgPtr = reinterpret_cast<nng_msg*>(msg->msg.ToPointer());
-		return static_cast<Errno>(::nng_sendmsg(this->NngSocket, msgPtr, (flags.HasValue ? (int)(Flag)flags : NNG_FLAG_NONBLOCK)));
+		Errno err = msg->Unshare(); // nng frees the message once it is sent
+		if (err != Errno::ok) return err;
+		int result = ::nngc_sendmsg(this->NngSocket, coreMsg(msg), (flags.HasValue ? (int)(Flag)flags : NNG_FLAG_NONBLOCK));
+		if (result == 0) {
+			// nng owns the message now, views on it and a later Free() must not touch it
+			msg->InvalidateViews();
+			msg->msg = System::UIntPtr::Zero;
+		}
+		return static_cast<Errno>(result);
 	}
 
 	Errno Socket::Receive([Out] Msg^% msg, [Optional] Nullable<Flag> flags)
 	{
-		nng_msg* newMsg;
-		int result = ::nng_recvmsg(this->NngSocket, &newMsg, (flags.HasValue ? (int)(Flag)flags : 0));
+		nngc_msg newMsg;
+		int result = ::nngc_recvmsg(this->NngSocket, &newMsg, (flags.HasValue ? (int)(Flag)flags : 0));
 		if (result == 0) {
 			msg = gcnew Msg(System::UIntPtr(newMsg));
 		}
@@ -70,19 +132,125 @@ namespace Nng {
 		return static_cast<Errno>(result);
 	}
 
+	Errno Socket::SendMany(array<Msg^>^ msgs, [Out] Int32% sent, [Optional] Nullable<Flag> flags)
+	{
+		sent = 0;
+		if (msgs == nullptr) return Errno::inval;
+		int count = msgs->Length;
+		if (count == 0) return Errno::ok;
+
+		auto native = BatchScratch::Msgs(count);
+		for (int i = 0; i < count; i++) {
+			if (msgs[i] == nullptr || msgs[i]->msg == System::UIntPtr::Zero) return Errno::inval;
+			Errno err = msgs[i]->Unshare();
+			if (err != Errno::ok) return err;
+			native[i] = msgs[i]->msg.ToUInt64();
+		}
+		pin_ptr<UInt64> pin = &native[0];
+		int sent2;
+		int result = ::nngc_send_many_msgs(this->NngSocket, pin, count,
+			(flags.HasValue ? (int)(Flag)flags : NNG_FLAG_NONBLOCK), &sent2);
+		for (int i = 0; i < sent2; i++) {
+			// nng owns these messages now, like in Send(Msg^)
+			msgs[i]->InvalidateViews();
+			msgs[i]->msg = System::UIntPtr::Zero;
+		}
+		sent = sent2;
+		return static_cast<Errno>(result);
+	}
+
+	Errno Socket::SendMany(array<array<Byte>^>^ data, [Out] Int32% sent, [Optional] Nullable<Flag> flags)
+	{
+		sent = 0;
+		if (data == nullptr) return Errno::inval;
+		int count = data->Length;
+		if (count == 0) return Errno::ok;
+
+		// pinning an unknown number of arrays at once is not possible with pin_ptr, so everything
+		// is packed into one scratch buffer first. That is a managed copy, no transition
+		Int64 total = 0;
+		auto lengths = BatchScratch::Lengths(count);
+		for (int i = 0; i < count; i++) {
+			if (data[i] == nullptr) return Errno::inval;
+			lengths[i] = data[i]->Length;
+			total += data[i]->Length;
+		}
+		if (total > Int32::MaxValue) return Errno::msgsize; // more than one scratch array can hold
+		auto scratch = BatchScratch::Data(total);
+		int offset = 0;
+		for (int i = 0; i < count; i++) {
+			System::Buffer::BlockCopy(data[i], 0, scratch, offset, lengths[i]);
+			offset += lengths[i];
+		}
+		pin_ptr<Byte> pinData = &scratch[0];
+		pin_ptr<Int32> pinLengths = &lengths[0];
+		int sent2;
+		int result = ::nngc_send_many_buffers(this->NngSocket, pinData, pinLengths, count,
+			(flags.HasValue ? (int)(Flag)flags : NNG_FLAG_NONBLOCK), &sent2);
+		sent = sent2;
+		return static_cast<Errno>(result);
+	}
+
+	Errno Socket::ReceiveMany(array<Msg^>^ msgs, Int32 timeout, [Out] Int32% received)
+	{
+		received = 0;
+		if (msgs == nullptr) return Errno::inval;
+		int max = msgs->Length;
+		if (max == 0) return Errno::ok;
+
+		auto native = BatchScratch::Msgs(max);
+		int received2;
+		int result;
+		{
+			pin_ptr<UInt64> pin = &native[0];
+			result = ::nngc_recv_many_msgs(this->NngSocket, pin, max, timeout, &received2);
+		}
+		for (int i = 0; i < received2; i++) {
+			msgs[i] = gcnew Msg(UIntPtr(native[i]));
+		}
+		received = received2;
+		return static_cast<Errno>(result);
+	}
+
+	Errno Socket::ReceiveMany(Int32 max, Int32 timeout, [Out] array<Msg^>^% msgs)
+	{
+		msgs = nullptr;
+		if (max < 0) return Errno::inval;
+
+		auto native = BatchScratch::Msgs(max);
+		int received;
+		int result = 0;
+		if (max > 0) {
+			pin_ptr<UInt64> pin = &native[0];
+			result = ::nngc_recv_many_msgs(this->NngSocket, pin, max, timeout, &received);
+		}
+		else {
+			received = 0;
+		}
+		if (result == 0) {
+			msgs = gcnew array<Msg^>(received);
+			for (int i = 0; i < received; i++) {
+				msgs[i] = gcnew Msg(UIntPtr(native[i]));
+			}
+		}
+		return static_cast<Errno>(result);
+	}
+
 	void Socket::Send(Aio^ aio)
 	{
-		::nng_send_aio(this->NngSocket, getNativeAio(aio));
+		aio->FollowQueue(this->CompletionQueue);
+		::nngc_send_aio(this->NngSocket, coreAio(aio));
 	}
 
 	void Socket::Receive(Aio^ aio)
 	{
-		return ::nng_recv_aio(this->NngSocket, getNativeAio(aio));
+		aio->FollowQueue(this->CompletionQueue);
+		::nngc_recv_aio(this->NngSocket, coreAio(aio));
 	}
 
 	Errno Aio::Result()
 	{
-		return static_cast<Errno>(::nng_aio_result(getNativeAio(this)));
+		return static_cast<Errno>(::nngc_aio_result(coreAio(this)));
 	}
 
 }
\ No newline at end of file
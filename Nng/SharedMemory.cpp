@@ -0,0 +1,194 @@
+/*
+Nng wrapper
+
+Class ShmChannel, messages between two processes on one host through shared memory. The rings, the
+waiting and waking are in the core (NngCore/CoreShm.cpp). SendBegin/SendEnd and ReceiveBegin/ReceiveEnd
+hand out the memory of the ring itself, the other calls copy once, between the ring and an array.
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <cstring>
+
+namespace Nng {
+
+	static inline int32_t timeoutOf(Nullable<Int32> timeout)
+	{
+		return timeout.HasValue ? timeout.Value : -1;
+	}
+
+	ShmChannel::ShmChannel()
+	{
+	}
+
+	Errno ShmChannel::Initialize(ShmChannel^ channel, System::String^ url, bool listen, Nullable<Int32> capacity)
+	{
+		if (url == nullptr || (capacity.HasValue && capacity.Value < 0)) return Errno::inval;
+		NativeString s(url, true);
+		const char* u = s;
+		nngc_shm shm;
+		int result = listen
+			? ::nngc_shm_listen(u, strlen(u), capacity.HasValue ? static_cast<uint32_t>(capacity.Value) : 0, &shm)
+			: ::nngc_shm_dial(u, strlen(u), &shm);
+		if (result != 0) return static_cast<Errno>(result);
+		channel->shm = shm;
+		channel->url = url;
+		return Errno::ok;
+	}
+
+	ShmChannel::ShmChannel(System::String^ url, bool listen, [Optional] Nullable<Int32> capacity)
+	{
+		Errno err = Initialize(this, url, listen, capacity);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno ShmChannel::Listen([Out] ShmChannel^% channel, System::String^ url, [Optional] Nullable<Int32> capacity)
+	{
+		channel = gcnew ShmChannel();
+		return Initialize(channel, url, true, capacity);
+	}
+
+	Errno ShmChannel::Dial([Out] ShmChannel^% channel, System::String^ url)
+	{
+		channel = gcnew ShmChannel();
+		return Initialize(channel, url, false, Nullable<Int32>());
+	}
+
+	Errno ShmChannel::Unlink(System::String^ url)
+	{
+		if (url == nullptr) return Errno::inval;
+		NativeString s(url, true);
+		const char* u = s;
+		return static_cast<Errno>(::nngc_shm_unlink(u, strlen(u)));
+	}
+
+	Int32 ShmChannel::MaxMessageSize::get()
+	{
+		if (this->shm == 0) return 0;
+		size_t max = ::nngc_shm_max_size(this->shm);
+		return (max > INT32_MAX) ? INT32_MAX : static_cast<Int32>(max);
+	}
+
+	System::String^ ShmChannel::Url::get()
+	{
+		return this->url;
+	}
+
+	// Sending
+
+	Errno ShmChannel::Send(array<Byte>^ data, [Optional] Nullable<Int32> timeout)
+	{
+		if (data == nullptr) return Errno::inval;
+		return Send(data, 0, data->Length, timeout);
+	}
+
+	Errno ShmChannel::Send(array<Byte>^ data, Int32 offset, Int32 count, [Optional] Nullable<Int32> timeout)
+	{
+		if (this->shm == 0) return Errno::closed;
+		if (data == nullptr || offset < 0 || count < 0 || offset > data->Length - count) return Errno::inval;
+		if (count == 0) return static_cast<Errno>(::nngc_shm_send(this->shm, nullptr, 0, timeoutOf(timeout)));
+		pin_ptr<Byte> pin = &data[offset];
+		return static_cast<Errno>(::nngc_shm_send(this->shm, pin, count, timeoutOf(timeout)));
+	}
+
+	Errno ShmChannel::Send(IntPtr data, UInt64 size, [Optional] Nullable<Int32> timeout)
+	{
+		if (this->shm == 0) return Errno::closed;
+		if (data == IntPtr::Zero && size != 0) return Errno::inval;
+		return static_cast<Errno>(::nngc_shm_send(this->shm, data.ToPointer(), static_cast<size_t>(size), timeoutOf(timeout)));
+	}
+
+	Errno ShmChannel::SendBegin(Int32 size, [Out] IntPtr% buffer, [Optional] Nullable<Int32> timeout)
+	{
+		buffer = IntPtr::Zero;
+		if (this->shm == 0) return Errno::closed;
+		if (size < 0) return Errno::inval;
+		void* p;
+		int result = ::nngc_shm_send_begin(this->shm, size, &p, timeoutOf(timeout));
+		if (result == 0) buffer = IntPtr(p);
+		return static_cast<Errno>(result);
+	}
+
+	Errno ShmChannel::SendEnd(Int32 size)
+	{
+		if (this->shm == 0) return Errno::closed;
+		if (size < 0) return Errno::inval;
+		return static_cast<Errno>(::nngc_shm_send_end(this->shm, size));
+	}
+
+	// Receiving
+
+	Errno ShmChannel::Receive([Out] array<Byte>^% data, [Optional] Nullable<Int32> timeout)
+	{
+		data = nullptr;
+		if (this->shm == 0) return Errno::closed;
+		const void* p;
+		size_t size;
+		int result = ::nngc_shm_recv_begin(this->shm, &p, &size, timeoutOf(timeout));
+		if (result != 0) return static_cast<Errno>(result);
+		data = gcnew array<Byte>(static_cast<int>(size));
+		if (size > 0) {
+			pin_ptr<Byte> pin = &data[0];
+			memcpy(pin, p, size);
+		}
+		return static_cast<Errno>(::nngc_shm_recv_end(this->shm));
+	}
+
+	Errno ShmChannel::Receive(array<Byte>^ buffer, Int32 offset, Int32 count, [Out] Int32% received, [Optional] Nullable<Int32> timeout)
+	{
+		received = 0;
+		if (this->shm == 0) return Errno::closed;
+		if (buffer == nullptr || offset < 0 || count < 0 || offset > buffer->Length - count) return Errno::inval;
+		size_t size;
+		int result;
+		if (count > 0) {
+			pin_ptr<Byte> pin = &buffer[offset];
+			result = ::nngc_shm_recv_into(this->shm, pin, count, &size, timeoutOf(timeout));
+		}
+		else {
+			result = ::nngc_shm_recv_into(this->shm, nullptr, 0, &size, timeoutOf(timeout));
+		}
+		received = static_cast<Int32>(size);
+		return static_cast<Errno>(result);
+	}
+
+	Errno ShmChannel::ReceiveBegin([Out] IntPtr% data, [Out] Int32% size, [Optional] Nullable<Int32> timeout)
+	{
+		data = IntPtr::Zero;
+		size = 0;
+		if (this->shm == 0) return Errno::closed;
+		const void* p;
+		size_t s;
+		int result = ::nngc_shm_recv_begin(this->shm, &p, &s, timeoutOf(timeout));
+		if (result == 0) {
+			data = IntPtr(const_cast<void*>(p));
+			size = static_cast<Int32>(s);
+		}
+		return static_cast<Errno>(result);
+	}
+
+	Errno ShmChannel::ReceiveEnd()
+	{
+		if (this->shm == 0) return Errno::closed;
+		return static_cast<Errno>(::nngc_shm_recv_end(this->shm));
+	}
+
+	// the core hands out ids, a thread still using the old one gets Errno::closed, and the segment stays
+	// mapped until the last call in progress returns
+	void ShmChannel::Close()
+	{
+		if (this->shm == 0) return;
+		nngc_shm shm = this->shm;
+		this->shm = 0;
+		::nngc_shm_close(shm);
+	}
+
+	ShmChannel::~ShmChannel()
+	{
+		Close();
+	}
+}
@@ -0,0 +1,439 @@
+/*
+Nng wrapper
+
+Statistics: SnapShot, Stat and StatPoller over nng's statistics tree. The tree is read with one
+native call, nngc_stats_flatten (NngCore/CoreStats.cpp), Stat objects are only created when asked for.
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <cstring>
+#include <new>
+
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+
+namespace Nng {
+
+	static String^ fromUtf8(const char* s)
+	{
+		if (s == nullptr) return nullptr;
+		return System::Text::Encoding::UTF8->GetString((unsigned char*)s, (int) ::strlen(s));
+	}
+
+	// the tree of stats as entries, NNG_ENOSPC is handled by growing. *entries is replaced then
+	static int flattenStats(nngc_stat root, nngc_stat_entry** entries, int* capacity, int* count)
+	{
+		for (;;) {
+			int result = ::nngc_stats_flatten(root, *entries, *capacity, count);
+			if (result != NNG_ENOSPC) return result;
+			delete[] *entries;
+			*capacity = *count + *count / 4 + 16; // pipes come and go
+			*entries = new (std::nothrow) nngc_stat_entry[*capacity];
+			if (*entries == nullptr) {
+				*capacity = 0;
+				return NNG_ENOMEM;
+			}
+		}
+	}
+
+	// the root has no name of its own in the path
+	static String^ statPath(const nngc_stat_entry* entries, int index)
+	{
+		String^ path = nullptr;
+		for (int i = index; i >= 0 && entries[i].parent >= 0; i = entries[i].parent) {
+			String^ segment = fromUtf8(::nngc_stat_name(entries[i].stat));
+			if (entries[i].scope_id != 0) segment = segment + "#" + entries[i].scope_id;
+			path = (path == nullptr) ? segment : segment + "/" + path;
+		}
+		return (path == nullptr) ? "" : path;
+	}
+
+	static bool isNumber(int type)
+	{
+		return type == NNGC_STAT_COUNTER || type == NNGC_STAT_LEVEL;
+	}
+
+	// Stat
+
+	Stat::Stat(SnapShot^ snapShot, Int32 index)
+	{
+		this->snapShot = snapShot;
+		this->index = index;
+		this->stat = UIntPtr(reinterpret_cast<nngc_stat_entry*>(snapShot->entries.ToPointer())[index].stat);
+	}
+
+	// nullptr once the snapshot is freed
+	static const nngc_stat_entry* entryOf(SnapShot^ snapShot, Int32 index)
+	{
+		if (snapShot->snapShot == UIntPtr::Zero) return nullptr;
+		return &reinterpret_cast<nngc_stat_entry*>(snapShot->entries.ToPointer())[index];
+	}
+
+	String^ Stat::Name::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr) ? nullptr : fromUtf8(::nngc_stat_name(e->stat));
+	}
+
+	String^ Stat::Description::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr) ? nullptr : fromUtf8(::nngc_stat_desc(e->stat));
+	}
+
+	StatType Stat::Type::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr) ? StatType::scope : static_cast<StatType>(e->type);
+	}
+
+	StatUnit Stat::Unit::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr) ? StatUnit::none : static_cast<StatUnit>(e->unit);
+	}
+
+	UInt64 Stat::Value::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr) ? 0 : e->value;
+	}
+
+	String^ Stat::Text::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr) ? nullptr : fromUtf8(::nngc_stat_string(e->stat));
+	}
+
+	UInt64 Stat::Timestamp::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr) ? 0 : ::nngc_stat_timestamp(e->stat);
+	}
+
+	String^ Stat::Path::get()
+	{
+		return this->snapShot->PathOf(this->index);
+	}
+
+	UInt64 Stat::Key::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr) ? 0 : e->key;
+	}
+
+	UInt32 Stat::ScopeId::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr) ? 0 : e->scope_id;
+	}
+
+	Stat^ Stat::Parent::get()
+	{
+		auto e = entryOf(this->snapShot, this->index);
+		return (e == nullptr || e->parent < 0) ? nullptr : this->snapShot->At(e->parent);
+	}
+
+	array<Stat^>^ Stat::Children()
+	{
+		auto children = gcnew List<Stat^>();
+		auto e = entryOf(this->snapShot, this->index);
+		if (e != nullptr && e->type == NNGC_STAT_SCOPE) {
+			// children follow their scope, up to the next entry with a parent before it
+			auto entries = reinterpret_cast<nngc_stat_entry*>(this->snapShot->entries.ToPointer());
+			for (int i = this->index + 1; i < this->snapShot->stats->Length && entries[i].parent >= this->index; i++) {
+				if (entries[i].parent == this->index) children->Add(this->snapShot->At(i));
+			}
+		}
+		return children->ToArray();
+	}
+
+	Stat^ Stat::Child(String^ name)
+	{
+		for each (Stat^ child in Children()) {
+			if (String::Equals(child->Name, name)) return child;
+		}
+		return nullptr;
+	}
+
+	// SnapShot
+
+	SnapShot::SnapShot(bool)
+	{
+	}
+
+	Errno SnapShot::Initialize(SnapShot^ snapShot)
+	{
+		nngc_stat root;
+		int result = ::nngc_stats_get(&root);
+		if (result != 0) return static_cast<Errno>(result);
+
+		int capacity = 0;
+		int count = 0;
+		nngc_stat_entry* entries = nullptr;
+		result = flattenStats(root, &entries, &capacity, &count);
+		if (result != 0) {
+			delete[] entries;
+			::nngc_stats_free(root);
+			return static_cast<Errno>(result);
+		}
+		snapShot->snapShot = UIntPtr(root);
+		snapShot->entries = UIntPtr(entries);
+		snapShot->stats = gcnew array<Stat^>(count);
+		snapShot->paths = gcnew array<String^>(count);
+		return Errno::ok;
+	}
+
+	SnapShot::SnapShot()
+	{
+		Errno err = Initialize(this);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno SnapShot::Take([Out] SnapShot^% snapShot)
+	{
+		snapShot = gcnew SnapShot(false);
+		return Initialize(snapShot);
+	}
+
+	Stat^ SnapShot::At(Int32 index)
+	{
+		if (this->stats[index] == nullptr) this->stats[index] = gcnew Stat(this, index);
+		return this->stats[index];
+	}
+
+	String^ SnapShot::PathOf(Int32 index)
+	{
+		if (this->snapShot == UIntPtr::Zero) return nullptr;
+		if (this->paths[index] == nullptr) {
+			this->paths[index] = statPath(reinterpret_cast<nngc_stat_entry*>(this->entries.ToPointer()), index);
+		}
+		return this->paths[index];
+	}
+
+	Stat^ SnapShot::Root::get()
+	{
+		if (this->snapShot == UIntPtr::Zero || this->stats->Length == 0) return nullptr;
+		return At(0);
+	}
+
+	array<Stat^>^ SnapShot::All()
+	{
+		if (this->snapShot == UIntPtr::Zero) return gcnew array<Stat^>(0);
+		auto all = gcnew array<Stat^>(this->stats->Length);
+		for (int i = 0; i < all->Length; i++) all[i] = At(i);
+		return all;
+	}
+
+	Stat^ SnapShot::Find(String^ path)
+	{
+		if (this->snapShot == UIntPtr::Zero || path == nullptr) return nullptr;
+		for (int i = 0; i < this->stats->Length; i++) {
+			if (String::Equals(PathOf(i), path)) return At(i);
+		}
+		return nullptr;
+	}
+
+	Stat^ SnapShot::Find(Socket^ socket)
+	{
+		if (this->snapShot == UIntPtr::Zero || socket == nullptr) return nullptr;
+		auto entries = reinterpret_cast<nngc_stat_entry*>(this->entries.ToPointer());
+		for (int i = 0; i < this->stats->Length; i++) {
+			if (entries[i].type == NNGC_STAT_SCOPE && entries[i].parent == 0 && entries[i].scope_id == socket->NngSocket
+				&& ::strcmp(::nngc_stat_name(entries[i].stat), "socket") == 0) {
+				return At(i);
+			}
+		}
+		return nullptr;
+	}
+
+	array<StatDelta>^ SnapShot::Diff(SnapShot^ before, SnapShot^ after)
+	{
+		if (before == nullptr || after == nullptr || before->snapShot == UIntPtr::Zero || after->snapShot == UIntPtr::Zero) return nullptr;
+		auto b = reinterpret_cast<nngc_stat_entry*>(before->entries.ToPointer());
+		auto a = reinterpret_cast<nngc_stat_entry*>(after->entries.ToPointer());
+		auto old = gcnew Dictionary<UInt64, UInt64>(before->stats->Length);
+		for (int i = 0; i < before->stats->Length; i++) {
+			if (isNumber(b[i].type)) old[b[i].key] = b[i].value;
+		}
+		auto deltas = gcnew List<StatDelta>();
+		for (int i = 0; i < after->stats->Length; i++) {
+			if (!isNumber(a[i].type)) continue;
+			UInt64 value = 0;
+			old->TryGetValue(a[i].key, value);
+			if (value == a[i].value) continue;
+			StatDelta d;
+			d.Path = after->PathOf(i);
+			d.Key = a[i].key;
+			d.Type = static_cast<StatType>(a[i].type);
+			d.Unit = static_cast<StatUnit>(a[i].unit);
+			d.Before = value;
+			d.After = a[i].value;
+			d.Delta = static_cast<Int64>(a[i].value - value);
+			deltas->Add(d);
+		}
+		return deltas->ToArray();
+	}
+
+	void SnapShot::Free()
+	{
+		if (this->snapShot == UIntPtr::Zero) return;
+		::nngc_stats_free(this->snapShot.ToUInt64());
+		delete[] reinterpret_cast<nngc_stat_entry*>(this->entries.ToPointer());
+		this->snapShot = UIntPtr::Zero;
+		this->entries = UIntPtr::Zero;
+	}
+
+	SnapShot::~SnapShot()
+	{
+		Free();
+	}
+
+	// StatPoller
+
+	StatPoller::StatPoller()
+	{
+	}
+
+	Errno StatPoller::Initialize(StatPoller^ poller, Int32 interval, StatDeltaHandler^ handler)
+	{
+		if (interval <= 0 || handler == nullptr) return Errno::inval;
+		poller->interval = interval;
+		poller->handler = handler;
+		poller->values = gcnew Dictionary<UInt64, UInt64>();
+		poller->previousValues = gcnew Dictionary<UInt64, UInt64>();
+		poller->paths = gcnew Dictionary<UInt64, String^>();
+		poller->previousPaths = gcnew Dictionary<UInt64, String^>();
+		poller->deltas = gcnew array<StatDelta>(64);
+		poller->stop = gcnew ManualResetEvent(false);
+		poller->thread = gcnew Thread(gcnew ThreadStart(poller, &StatPoller::Run));
+		poller->thread->IsBackground = true;
+		poller->thread->Name = "Nng StatPoller";
+		poller->thread->Start();
+		return Errno::ok;
+	}
+
+	StatPoller::StatPoller(Int32 interval, StatDeltaHandler^ handler)
+	{
+		Errno err = Initialize(this, interval, handler);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno StatPoller::Open([Out] StatPoller^% poller, Int32 interval, StatDeltaHandler^ handler)
+	{
+		poller = gcnew StatPoller();
+		return Initialize(poller, interval, handler);
+	}
+
+	// the thread owns the native buffer, it is freed when the thread ends
+	void StatPoller::Run()
+	{
+		do {
+			Poll();
+		} while (!this->stop->WaitOne(this->interval));
+		delete[] reinterpret_cast<nngc_stat_entry*>(this->entries.ToPointer());
+		this->entries = UIntPtr::Zero;
+		this->capacity = 0;
+	}
+
+	void StatPoller::Poll()
+	{
+		nngc_stat root;
+		int result = ::nngc_stats_get(&root);
+		this->lastError = static_cast<Errno>(result);
+		if (result != 0) return;
+
+		auto entries = reinterpret_cast<nngc_stat_entry*>(this->entries.ToPointer());
+		int capacity = this->capacity;
+		int count = 0;
+		result = flattenStats(root, &entries, &capacity, &count);
+		this->entries = UIntPtr(entries);
+		this->capacity = capacity;
+		if (result != 0) {
+			::nngc_stats_free(root);
+			this->lastError = static_cast<Errno>(result);
+			return;
+		}
+
+		// this poll's values go into the cleared dictionaries of the one before last, no allocation once they are big enough
+		auto swapValues = this->previousValues;
+		this->previousValues = this->values;
+		this->values = swapValues;
+		this->values->Clear();
+		auto swapPaths = this->previousPaths;
+		this->previousPaths = this->paths;
+		this->paths = swapPaths;
+		this->paths->Clear();
+
+		bool baseline = (this->polls == 0);
+		int n = 0;
+		for (int i = 0; i < count; i++) {
+			const nngc_stat_entry& e = entries[i];
+			if (!isNumber(e.type)) continue;
+			UInt64 before;
+			bool known = this->previousValues->TryGetValue(e.key, before);
+			String^ path;
+			if (!this->previousPaths->TryGetValue(e.key, path)) path = statPath(entries, i);
+			this->values[e.key] = e.value;
+			this->paths[e.key] = path;
+			if (baseline) continue;
+			if (!known) before = 0;
+			if (before == e.value) continue;
+
+			if (n == this->deltas->Length) System::Array::Resize(this->deltas, n * 2);
+			StatDelta% d = this->deltas[n++];
+			d.Path = path;
+			d.Key = e.key;
+			d.Type = static_cast<StatType>(e.type);
+			d.Unit = static_cast<StatUnit>(e.unit);
+			d.Before = before;
+			d.After = e.value;
+			d.Delta = static_cast<Int64>(e.value - before);
+		}
+		::nngc_stats_free(root);
+		Interlocked::Increment(this->polls);
+
+		if (baseline) return;
+		try {
+			this->handler(this->deltas, n);
+		}
+		catch (Exception^) {
+			Interlocked::Increment(this->handlerErrors);
+		}
+	}
+
+	Int64 StatPoller::Polls::get()
+	{
+		return Interlocked::Read(this->polls);
+	}
+
+	Errno StatPoller::LastError::get()
+	{
+		return this->lastError;
+	}
+
+	Int64 StatPoller::HandlerErrors::get()
+	{
+		return Interlocked::Read(this->handlerErrors);
+	}
+
+	void StatPoller::Close()
+	{
+		if (this->closed) return;
+		this->closed = true;
+		if (this->stop == nullptr) return;
+		this->stop->Set();
+		if (this->thread != nullptr && this->thread != Thread::CurrentThread) this->thread->Join();
+	}
+
+	StatPoller::~StatPoller()
+	{
+		Close();
+	}
+}
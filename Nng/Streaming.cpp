@@ -0,0 +1,309 @@
+/*
+Nng wrapper
+
+Class StreamTransfer, transfers of any size in chunks. The chunking, flow control and acknowledgements
+are done by the core (NngCore/CoreStream.cpp), which calls back here on the calling thread to read and
+write the data: a Stream goes through one reused buffer of ChunkSize bytes, a file through a memory
+mapping, mapped a segment at a time so the address space doesn't limit the size either.
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include <msclr/lock.h>
+#include <cstring>
+
+using namespace System::IO;
+using namespace System::IO::MemoryMappedFiles;
+using namespace System::Runtime::InteropServices;
+
+namespace Nng {
+
+	static const Int64 segmentSize = 64 * 1024 * 1024; // a multiple of the allocation granularity
+
+	StreamTransfer::StreamTransfer()
+	{
+	}
+
+	Errno StreamTransfer::Initialize(StreamTransfer^ transfer, Socket^ socket, Int32 chunkSize, Int32 window)
+	{
+		if (socket == nullptr || chunkSize <= 0 || window <= 0) return Errno::inval;
+		// nng drops a larger message without a word (recvmaxsz is 1 MB on tcp and ipc by default), the
+		// transfer would only fail on the missing chunk. The peer's limit can't be seen from here
+		UInt64 recvMax;
+		Errno err = socket->GetOptSize(Option::recvmaxsz, recvMax);
+		if (err != Errno::ok) return err;
+		if (recvMax != 0 && static_cast<UInt64>(chunkSize) + NNGC_STREAM_HEADER > recvMax) return Errno::msgsize;
+		transfer->socket = socket;
+		transfer->buffer = gcnew array<Byte>(chunkSize);
+		transfer->window = window;
+		// the core calls these on the thread of the transfer, the delegates keep it in the AppDomain of the caller
+		transfer->readStream = gcnew ReadDelegate(transfer, &StreamTransfer::ReadStream);
+		transfer->writeStream = gcnew WriteDelegate(transfer, &StreamTransfer::WriteStream);
+		transfer->readMapped = gcnew ReadDelegate(transfer, &StreamTransfer::ReadMapped);
+		transfer->beginMapped = gcnew BeginDelegate(transfer, &StreamTransfer::BeginMapped);
+		transfer->writeMapped = gcnew WriteDelegate(transfer, &StreamTransfer::WriteMapped);
+		return Errno::ok;
+	}
+
+	StreamTransfer::StreamTransfer(Socket^ socket, Int32 chunkSize, Int32 window)
+	{
+		Errno err = Initialize(this, socket, chunkSize, window);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno StreamTransfer::Open([Out] StreamTransfer^% transfer, Socket^ socket, Int32 chunkSize, Int32 window)
+	{
+		transfer = gcnew StreamTransfer();
+		Errno err = Initialize(transfer, socket, chunkSize, window);
+		if (err != Errno::ok) transfer = nullptr;
+		return err;
+	}
+
+	Int32 StreamTransfer::ChunkSize::get()
+	{
+		return this->buffer->Length;
+	}
+
+	Int32 StreamTransfer::Window::get()
+	{
+		return this->window;
+	}
+
+	Int64 StreamTransfer::MemoryBound::get()
+	{
+		return static_cast<Int64>(this->buffer->Length) * this->window;
+	}
+
+	Socket^ StreamTransfer::StreamSocket::get()
+	{
+		return this->socket;
+	}
+
+	System::Exception^ StreamTransfer::LastException::get()
+	{
+		return this->lastException;
+	}
+
+	// Streams, through the buffer
+
+	int StreamTransfer::ReadStream(void*, void* buffer, size_t capacity, size_t* size)
+	{
+		*size = 0;
+		try {
+			int want = (capacity < static_cast<size_t>(this->buffer->Length)) ? static_cast<int>(capacity) : this->buffer->Length;
+			int got = 0;
+			int n;
+			// full chunks, a Stream may return less than asked for before its end
+			while (got < want && (n = this->stream->Read(this->buffer, got, want - got)) > 0) got += n;
+			if (got > 0) {
+				pin_ptr<Byte> pin = &this->buffer[0];
+				::memcpy(buffer, pin, got);
+			}
+			*size = got;
+			return 0;
+		}
+		catch (System::Exception^ e) {
+			this->lastException = e;
+			return static_cast<int>(Errno::internal);
+		}
+	}
+
+	int StreamTransfer::WriteStream(void*, UInt64, const void* data, size_t size)
+	{
+		try {
+			auto p = static_cast<const unsigned char*>(data);
+			while (size > 0) {
+				// the sender's chunks may be larger than ours
+				int piece = (size < static_cast<size_t>(this->buffer->Length)) ? static_cast<int>(size) : this->buffer->Length;
+				{
+					pin_ptr<Byte> pin = &this->buffer[0];
+					::memcpy(pin, p, piece);
+				}
+				this->stream->Write(this->buffer, 0, piece);
+				p += piece;
+				size -= piece;
+			}
+			return 0;
+		}
+		catch (System::Exception^ e) {
+			this->lastException = e;
+			return static_cast<int>(Errno::internal);
+		}
+	}
+
+	// Files, through a view of the segment holding offset
+
+	unsigned char* StreamTransfer::Map(Int64 offset, [Out] Int64% available)
+	{
+		if (this->view == nullptr || offset < this->viewStart || offset >= this->viewStart + this->viewLength) {
+			Unmap();
+			this->viewStart = offset - offset % segmentSize;
+			this->viewLength = Math::Min(segmentSize, this->length - this->viewStart);
+			this->view = this->mapped->CreateViewAccessor(this->viewStart, this->viewLength,
+				this->writable ? MemoryMappedFileAccess::ReadWrite : MemoryMappedFileAccess::Read);
+			unsigned char* p = nullptr;
+			this->view->SafeMemoryMappedViewHandle->AcquirePointer(p);
+			this->viewPointer = p + this->view->PointerOffset;
+		}
+		available = this->viewStart + this->viewLength - offset;
+		return this->viewPointer + (offset - this->viewStart);
+	}
+
+	void StreamTransfer::Unmap()
+	{
+		if (this->view == nullptr) return;
+		this->view->SafeMemoryMappedViewHandle->ReleasePointer();
+		delete this->view;
+		this->view = nullptr;
+		this->viewPointer = nullptr;
+	}
+
+	int StreamTransfer::ReadMapped(void*, void* buffer, size_t capacity, size_t* size)
+	{
+		*size = 0;
+		try {
+			auto p = static_cast<unsigned char*>(buffer);
+			Int64 want = Math::Min(static_cast<Int64>(capacity), this->length - this->position);
+			while (want > 0) {
+				Int64 available;
+				unsigned char* from = Map(this->position, available);
+				Int64 piece = Math::Min(want, available);
+				::memcpy(p, from, static_cast<size_t>(piece));
+				p += piece;
+				want -= piece;
+				this->position += piece;
+				*size += static_cast<size_t>(piece);
+			}
+			return 0;
+		}
+		catch (System::Exception^ e) {
+			this->lastException = e;
+			return static_cast<int>(Errno::internal);
+		}
+	}
+
+	int StreamTransfer::BeginMapped(void*, UInt64 total)
+	{
+		if (total == NNGC_STREAM_SIZE_UNKNOWN) return static_cast<int>(Errno::notsup);
+		try {
+			this->length = static_cast<Int64>(total);
+			if (total == 0) {
+				File::Create(this->path)->Close(); // nothing to map
+				return 0;
+			}
+			this->mapped = MemoryMappedFile::CreateFromFile(this->path, FileMode::Create, nullptr, this->length, MemoryMappedFileAccess::ReadWrite);
+			return 0;
+		}
+		catch (System::Exception^ e) {
+			this->lastException = e;
+			return static_cast<int>(Errno::internal);
+		}
+	}
+
+	int StreamTransfer::WriteMapped(void*, UInt64 offset, const void* data, size_t size)
+	{
+		try {
+			auto p = static_cast<const unsigned char*>(data);
+			Int64 at = static_cast<Int64>(offset);
+			if (at + static_cast<Int64>(size) > this->length) return static_cast<int>(Errno::proto); // more than announced
+			while (size > 0) {
+				Int64 available;
+				unsigned char* to = Map(at, available);
+				size_t piece = (static_cast<UInt64>(available) < size) ? static_cast<size_t>(available) : size;
+				::memcpy(to, p, piece);
+				p += piece;
+				at += piece;
+				size -= piece;
+			}
+			return 0;
+		}
+		catch (System::Exception^ e) {
+			this->lastException = e;
+			return static_cast<int>(Errno::internal);
+		}
+	}
+
+	Errno StreamTransfer::Finish(int result)
+	{
+		Unmap();
+		delete this->mapped;
+		this->mapped = nullptr;
+		this->stream = nullptr;
+		this->path = nullptr;
+		return static_cast<Errno>(result);
+	}
+
+	// Transfers
+
+	Errno StreamTransfer::Send(Stream^ source, [Out] UInt64% sent)
+	{
+		sent = 0;
+		if (source == nullptr) return Errno::inval;
+		msclr::lock l(this);
+		this->lastException = nullptr;
+		this->stream = source;
+		UInt64 total = source->CanSeek ? static_cast<UInt64>(source->Length - source->Position) : NNGC_STREAM_SIZE_UNKNOWN;
+		uint64_t count;
+		int result = ::nngc_stream_send(this->socket->NngSocket, this->buffer->Length, this->window, total,
+			reinterpret_cast<nngc_stream_read>(Marshal::GetFunctionPointerForDelegate(this->readStream).ToPointer()), nullptr, &count);
+		sent = count;
+		return Finish(result);
+	}
+
+	Errno StreamTransfer::SendFile(System::String^ path, [Out] UInt64% sent)
+	{
+		sent = 0;
+		if (path == nullptr) return Errno::inval;
+		msclr::lock l(this);
+		this->lastException = nullptr;
+		try {
+			this->length = (gcnew FileInfo(path))->Length;
+			this->position = 0;
+			this->writable = false;
+			// an empty file can't be mapped, the transfer only has its end then
+			if (this->length > 0) this->mapped = MemoryMappedFile::CreateFromFile(path, FileMode::Open, nullptr, 0, MemoryMappedFileAccess::Read);
+		}
+		catch (System::Exception^ e) {
+			this->lastException = e;
+			return Finish(static_cast<int>(Errno::internal));
+		}
+		uint64_t count;
+		int result = ::nngc_stream_send(this->socket->NngSocket, this->buffer->Length, this->window, static_cast<UInt64>(this->length),
+			reinterpret_cast<nngc_stream_read>(Marshal::GetFunctionPointerForDelegate(this->readMapped).ToPointer()), nullptr, &count);
+		sent = count;
+		return Finish(result);
+	}
+
+	Errno StreamTransfer::Receive(Stream^ target, [Out] UInt64% received)
+	{
+		received = 0;
+		if (target == nullptr) return Errno::inval;
+		msclr::lock l(this);
+		this->lastException = nullptr;
+		this->stream = target;
+		uint64_t count;
+		int result = ::nngc_stream_recv(this->socket->NngSocket, nullptr,
+			reinterpret_cast<nngc_stream_write>(Marshal::GetFunctionPointerForDelegate(this->writeStream).ToPointer()), nullptr, &count);
+		received = count;
+		return Finish(result);
+	}
+
+	Errno StreamTransfer::ReceiveFile(System::String^ path, [Out] UInt64% received)
+	{
+		received = 0;
+		if (path == nullptr) return Errno::inval;
+		msclr::lock l(this);
+		this->lastException = nullptr;
+		this->path = path;
+		this->writable = true;
+		uint64_t count;
+		int result = ::nngc_stream_recv(this->socket->NngSocket,
+			reinterpret_cast<nngc_stream_begin>(Marshal::GetFunctionPointerForDelegate(this->beginMapped).ToPointer()),
+			reinterpret_cast<nngc_stream_write>(Marshal::GetFunctionPointerForDelegate(this->writeMapped).ToPointer()), nullptr, &count);
+		received = count;
+		return Finish(result);
+	}
+}
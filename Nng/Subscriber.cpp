@@ -0,0 +1,323 @@
+/*
+Nng wrapper
+
+Class Subscriber, a Sub0 socket with bulk subscriptions matched in a native trie
+
+
+
+
+*/
+
+#include "NngExternal.h"
+#include "nng.h"
+#include "NngInternal.h"
+#include "TopicTrie.h"
+#include "protocol/pubsub0/sub.h"
+
+// nng gets a single empty subscription and passes every message, the trie decides. Matching a
+// message is one native call, whatever the number of subscriptions.
+#pragma managed(push, off)
+
+static int msg_topic_match(Nng::topic_trie* trie, nng_msg* msg)
+{
+	return Nng::topic_trie_match(trie, ::nng_msg_body(msg), ::nng_msg_len(msg));
+}
+
+#pragma managed(pop)
+
+namespace Nng {
+
+	static const Int32 closingCall = 0x40000000; // in Subscriber::calls once it is closed
+
+	// Topics packed for the trie: one buffer, offsets[i] to offsets[i + 1] is topic i
+	static Errno pack_topics(array<System::String^>^ topics, [Out] array<Byte>^% data, [Out] array<UIntPtr>^% offsets)
+	{
+		data = nullptr;
+		offsets = nullptr;
+		if (topics == nullptr) return Errno::inval;
+		Int64 total = 0;
+		for each (System::String^ topic in topics) {
+			if (topic == nullptr) return Errno::inval;
+			total += System::Text::Encoding::UTF8->GetByteCount(topic);
+		}
+		if (total >= Int32::MaxValue) return Errno::nomem;
+		data = gcnew array<Byte>(static_cast<int>(total) + 1); // + 1, so there is always an element to pin
+		offsets = gcnew array<UIntPtr>(topics->Length + 1);
+		int pos = 0;
+		for (int i = 0; i < topics->Length; i++) {
+			offsets[i] = UIntPtr(static_cast<UInt32>(pos));
+			pos += System::Text::Encoding::UTF8->GetBytes(topics[i], 0, topics[i]->Length, data, pos);
+		}
+		offsets[topics->Length] = UIntPtr(static_cast<UInt32>(pos));
+		return Errno::ok;
+	}
+
+	static Errno pack_topics(array<array<Byte>^>^ topics, [Out] array<Byte>^% data, [Out] array<UIntPtr>^% offsets)
+	{
+		data = nullptr;
+		offsets = nullptr;
+		if (topics == nullptr) return Errno::inval;
+		Int64 total = 0;
+		for each (array<Byte>^ topic in topics) {
+			if (topic == nullptr) return Errno::inval;
+			total += topic->Length;
+		}
+		if (total >= Int32::MaxValue) return Errno::nomem;
+		data = gcnew array<Byte>(static_cast<int>(total) + 1);
+		offsets = gcnew array<UIntPtr>(topics->Length + 1);
+		int pos = 0;
+		for (int i = 0; i < topics->Length; i++) {
+			offsets[i] = UIntPtr(static_cast<UInt32>(pos));
+			System::Buffer::BlockCopy(topics[i], 0, data, pos, topics[i]->Length);
+			pos += topics[i]->Length;
+		}
+		offsets[topics->Length] = UIntPtr(static_cast<UInt32>(pos));
+		return Errno::ok;
+	}
+
+	Subscriber::Subscriber()
+	{
+	}
+
+	Subscriber::Subscriber(array<System::String^>^ topics)
+	{
+		Errno err = Initialize(this, topics);
+		if (err != Errno::ok) { throw gcnew NngException(err); }
+	}
+
+	Errno Subscriber::Open([Out] Subscriber^% subscriber, array<System::String^>^ topics)
+	{
+		subscriber = gcnew Subscriber();
+		Errno err = Initialize(subscriber, topics);
+		if (err != Errno::ok) subscriber = nullptr;
+		return err;
+	}
+
+	Errno Subscriber::Initialize(Subscriber^ subscriber, array<System::String^>^ topics)
+	{
+		Socket^ socket;
+		Errno err = Protocols::Sub0(socket);
+		if (err != Errno::ok) return err;
+		int result = ::nng_setopt(socket->NngSocket, NNG_OPT_SUB_SUBSCRIBE, "", 0);
+		if (result != 0) {
+			socket->Close();
+			return static_cast<Errno>(result);
+		}
+		topic_trie* trie = topic_trie_alloc();
+		if (trie == nullptr) {
+			socket->Close();
+			return Errno::nomem;
+		}
+		subscriber->socket = socket;
+		subscriber->trie = trie;
+		if (topics == nullptr) return Errno::ok;
+		Int32 added;
+		err = subscriber->Subscribe(topics, added);
+		if (err != Errno::ok) subscriber->Close();
+		return err;
+	}
+
+	Errno Subscriber::Subscribe(array<System::String^>^ topics, [Out] Int32% added)
+	{
+		added = 0;
+		array<Byte>^ data;
+		array<UIntPtr>^ offsets;
+		Errno err = pack_topics(topics, data, offsets);
+		if (err != Errno::ok) return err;
+		topic_trie* trie = static_cast<topic_trie*>(Enter());
+		if (trie == nullptr) return Errno::closed;
+		try {
+			pin_ptr<Byte> d = &data[0];
+			pin_ptr<UIntPtr> o = &offsets[0];
+			added = topic_trie_add(trie, d, reinterpret_cast<size_t*>(o), topics->Length);
+		}
+		finally {
+			Leave();
+		}
+		return Errno::ok;
+	}
+
+	Errno Subscriber::Subscribe(array<array<Byte>^>^ topics, [Out] Int32% added)
+	{
+		added = 0;
+		array<Byte>^ data;
+		array<UIntPtr>^ offsets;
+		Errno err = pack_topics(topics, data, offsets);
+		if (err != Errno::ok) return err;
+		topic_trie* trie = static_cast<topic_trie*>(Enter());
+		if (trie == nullptr) return Errno::closed;
+		try {
+			pin_ptr<Byte> d = &data[0];
+			pin_ptr<UIntPtr> o = &offsets[0];
+			added = topic_trie_add(trie, d, reinterpret_cast<size_t*>(o), topics->Length);
+		}
+		finally {
+			Leave();
+		}
+		return Errno::ok;
+	}
+
+	Errno Subscriber::Unsubscribe(array<System::String^>^ topics, [Out] Int32% removed)
+	{
+		removed = 0;
+		array<Byte>^ data;
+		array<UIntPtr>^ offsets;
+		Errno err = pack_topics(topics, data, offsets);
+		if (err != Errno::ok) return err;
+		topic_trie* trie = static_cast<topic_trie*>(Enter());
+		if (trie == nullptr) return Errno::closed;
+		try {
+			pin_ptr<Byte> d = &data[0];
+			pin_ptr<UIntPtr> o = &offsets[0];
+			removed = topic_trie_remove(trie, d, reinterpret_cast<size_t*>(o), topics->Length);
+		}
+		finally {
+			Leave();
+		}
+		return Errno::ok;
+	}
+
+	Errno Subscriber::Unsubscribe(array<array<Byte>^>^ topics, [Out] Int32% removed)
+	{
+		removed = 0;
+		array<Byte>^ data;
+		array<UIntPtr>^ offsets;
+		Errno err = pack_topics(topics, data, offsets);
+		if (err != Errno::ok) return err;
+		topic_trie* trie = static_cast<topic_trie*>(Enter());
+		if (trie == nullptr) return Errno::closed;
+		try {
+			pin_ptr<Byte> d = &data[0];
+			pin_ptr<UIntPtr> o = &offsets[0];
+			removed = topic_trie_remove(trie, d, reinterpret_cast<size_t*>(o), topics->Length);
+		}
+		finally {
+			Leave();
+		}
+		return Errno::ok;
+	}
+
+	void Subscriber::UnsubscribeAll()
+	{
+		topic_trie* trie = static_cast<topic_trie*>(Enter());
+		if (trie == nullptr) return;
+		try {
+			topic_trie_clear(trie);
+		}
+		finally {
+			Leave();
+		}
+	}
+
+	Int32 Subscriber::Count::get()
+	{
+		topic_trie* trie = static_cast<topic_trie*>(Enter());
+		if (trie == nullptr) return 0;
+		try {
+			return topic_trie_size(trie);
+		}
+		finally {
+			Leave();
+		}
+	}
+
+	bool Subscriber::Match(Msg^ msg)
+	{
+		if (msg == nullptr || msg->msg == System::UIntPtr::Zero) return false;
+		topic_trie* trie = static_cast<topic_trie*>(Enter());
+		if (trie == nullptr) return false;
+		try {
+			return msg_topic_match(trie, getNativeMsg(msg)) > 0;
+		}
+		finally {
+			Leave();
+		}
+	}
+
+	Errno Subscriber::Receive([Out] Msg^% msg, [Optional] Nullable<Flag> flags)
+	{
+		msg = nullptr;
+		for (;;) {
+			Msg^ received;
+			Errno err = this->socket->Receive(received, flags);
+			if (err != Errno::ok) return err;
+			if (Match(received)) {
+				msg = received;
+				return Errno::ok;
+			}
+			received->Free();
+			System::Threading::Interlocked::Increment(this->dropped);
+		}
+	}
+
+	Int64 Subscriber::MatchCount(System::String^ topic)
+	{
+		if (topic == nullptr) return -1;
+		return MatchCount(System::Text::Encoding::UTF8->GetBytes(topic));
+	}
+
+	Int64 Subscriber::MatchCount(array<Byte>^ topic)
+	{
+		if (topic == nullptr) return -1;
+		topic_trie* trie = static_cast<topic_trie*>(Enter());
+		if (trie == nullptr) return -1;
+		try {
+			if (topic->Length == 0) {
+				unsigned char empty = 0;
+				return topic_trie_matches(trie, &empty, 0);
+			}
+			pin_ptr<Byte> p = &topic[0];
+			return topic_trie_matches(trie, p, topic->Length);
+		}
+		finally {
+			Leave();
+		}
+	}
+
+	Int64 Subscriber::Dropped::get()
+	{
+		return System::Threading::Interlocked::Read(this->dropped);
+	}
+
+	Socket^ Subscriber::SubscribeSocket::get()
+	{
+		return this->socket;
+	}
+
+	// Every use of the trie is a call between Enter and Leave. calls counts them, Close sets closingCall
+	// and whoever ends the last call after that frees the trie, so Close doesn't wait for a Match
+	// running on another thread and never frees the trie under it
+
+	void* Subscriber::Enter()
+	{
+		for (;;) {
+			Int32 calls = this->calls;
+			if ((calls & closingCall) != 0) return nullptr;
+			if (System::Threading::Interlocked::CompareExchange(this->calls, calls + 1, calls) == calls) return this->trie;
+		}
+	}
+
+	void Subscriber::Leave()
+	{
+		if (System::Threading::Interlocked::Decrement(this->calls) == closingCall) topic_trie_free(static_cast<topic_trie*>(this->trie));
+	}
+
+	void Subscriber::Close()
+	{
+		if (this->socket != nullptr) this->socket->Close(); // blocked receivers return, they don't use the trie
+		if (this->trie == nullptr) return;
+		for (;;) {
+			Int32 calls = this->calls;
+			if ((calls & closingCall) != 0) return; // closed before
+			if (System::Threading::Interlocked::CompareExchange(this->calls, calls | closingCall, calls) == calls) {
+				if (calls == 0) topic_trie_free(static_cast<topic_trie*>(this->trie));
+				return;
+			}
+		}
+	}
+
+	Subscriber::~Subscriber()
+	{
+		Close();
+	}
+}
@@ -0,0 +1,148 @@
+/*
+Nng wrapper
+
+Native prefix trie of Sub0 topics. This file is compiled without /clr (see Nng.vcxproj),
+because <atomic> and <shared_mutex> are not available to managed code.
+
+nng's own sub0 filter compares every message with every subscription. Here a message is
+walked byte by byte down the trie, so the cost depends on the length of its topic, not on
+the number of subscriptions. Children are kept sorted in a small vector per node and found
+by binary search, which keeps 100k topics compact.
+
+Matching only takes a shared lock, (un)subscribing an exclusive one. The match counters
+are atomic, so several receivers may match at the same time. Unsubscribed nodes stay in
+the trie until Clear, they are reused if the topic comes back.
+*/
+
+#include "TopicTrie.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+namespace Nng {
+
+	struct trie_node {
+		std::vector<std::pair<unsigned char, uint32_t>> children; // sorted by byte
+		bool subscribed = false;
+		std::atomic<uint64_t> matches{ 0 };
+	};
+
+	struct topic_trie {
+		std::deque<trie_node> nodes; // [0] is the root, the empty topic. A deque never moves its elements
+		int size = 0;
+		std::shared_mutex lock;
+		topic_trie() { nodes.emplace_back(); }
+	};
+
+	static uint32_t find_child(const trie_node& node, unsigned char b)
+	{
+		auto it = std::lower_bound(node.children.begin(), node.children.end(), b,
+			[](const std::pair<unsigned char, uint32_t>& child, unsigned char key) { return child.first < key; });
+		return (it != node.children.end() && it->first == b) ? it->second : 0;
+	}
+
+	// the node of topic, nullptr if there is none and create is false
+	static trie_node* find_node(topic_trie* trie, const unsigned char* topic, size_t size, bool create)
+	{
+		uint32_t index = 0;
+		for (size_t i = 0; i < size; i++) {
+			uint32_t child = find_child(trie->nodes[index], topic[i]);
+			if (child == 0) {
+				if (!create) return nullptr;
+				child = static_cast<uint32_t>(trie->nodes.size());
+				trie->nodes.emplace_back();
+				auto& children = trie->nodes[index].children;
+				auto it = std::lower_bound(children.begin(), children.end(), std::make_pair(topic[i], uint32_t(0)));
+				children.insert(it, std::make_pair(topic[i], child));
+			}
+			index = child;
+		}
+		return &trie->nodes[index];
+	}
+
+	topic_trie* topic_trie_alloc()
+	{
+		return new (std::nothrow) topic_trie();
+	}
+
+	void topic_trie_free(topic_trie* trie)
+	{
+		delete trie;
+	}
+
+	int topic_trie_add(topic_trie* trie, const unsigned char* data, const size_t* offsets, int count)
+	{
+		std::unique_lock<std::shared_mutex> l(trie->lock);
+		int added = 0;
+		for (int i = 0; i < count; i++) {
+			trie_node* node = find_node(trie, data + offsets[i], offsets[i + 1] - offsets[i], true);
+			if (node->subscribed) continue;
+			node->subscribed = true;
+			node->matches.store(0);
+			added++;
+		}
+		trie->size += added;
+		return added;
+	}
+
+	int topic_trie_remove(topic_trie* trie, const unsigned char* data, const size_t* offsets, int count)
+	{
+		std::unique_lock<std::shared_mutex> l(trie->lock);
+		int removed = 0;
+		for (int i = 0; i < count; i++) {
+			trie_node* node = find_node(trie, data + offsets[i], offsets[i + 1] - offsets[i], false);
+			if (node == nullptr || !node->subscribed) continue;
+			node->subscribed = false;
+			removed++;
+		}
+		trie->size -= removed;
+		return removed;
+	}
+
+	void topic_trie_clear(topic_trie* trie)
+	{
+		std::unique_lock<std::shared_mutex> l(trie->lock);
+		trie->nodes.clear();
+		trie->nodes.emplace_back();
+		trie->size = 0;
+	}
+
+	int topic_trie_size(topic_trie* trie)
+	{
+		std::shared_lock<std::shared_mutex> l(trie->lock);
+		return trie->size;
+	}
+
+	int topic_trie_match(topic_trie* trie, const void* data, size_t size)
+	{
+		auto bytes = static_cast<const unsigned char*>(data);
+		std::shared_lock<std::shared_mutex> l(trie->lock);
+		int matched = 0;
+		uint32_t index = 0;
+		for (size_t i = 0;; i++) {
+			trie_node& node = trie->nodes[index];
+			if (node.subscribed) {
+				node.matches.fetch_add(1, std::memory_order_relaxed);
+				matched++;
+			}
+			if (i == size) break;
+			index = find_child(node, bytes[i]);
+			if (index == 0) break;
+		}
+		return matched;
+	}
+
+	long long topic_trie_matches(topic_trie* trie, const unsigned char* topic, size_t size)
+	{
+		std::shared_lock<std::shared_mutex> l(trie->lock);
+		trie_node* node = find_node(trie, topic, size, false);
+		if (node == nullptr || !node->subscribed) return -1;
+		return static_cast<long long>(node->matches.load(std::memory_order_relaxed));
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+Nng wrapper
+
+Native prefix trie of Sub0 topics, see TopicTrie.cpp. This header is included from both
+managed and native files, so it must not pull in anything /clr can't compile.
+*/
+
+#include <stddef.h>
+
+namespace Nng {
+
+	struct topic_trie;
+
+	topic_trie* topic_trie_alloc();
+	void topic_trie_free(topic_trie* trie);
+
+	// Topics are packed one after another into data, topic i starts at offsets[i] and ends at offsets[i + 1].
+	// Both return the number of topics which were actually added or removed
+	int  topic_trie_add(topic_trie* trie, const unsigned char* data, const size_t* offsets, int count);
+	int  topic_trie_remove(topic_trie* trie, const unsigned char* data, const size_t* offsets, int count);
+	void topic_trie_clear(topic_trie* trie);
+	// number of topics subscribed
+	int  topic_trie_size(topic_trie* trie);
+
+	// Counts a match for every subscribed topic which is a prefix of data, returns how many there were
+	int  topic_trie_match(topic_trie* trie, const void* data, size_t size);
+	// matches counted for a topic, -1 if it isn't subscribed
+	long long topic_trie_matches(topic_trie* trie, const unsigned char* topic, size_t size);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+/*
+Nng benchmarks
+
+Latency histogram in the spirit of HdrHistogram: values below 256 are counted exactly, larger
+ones in log-linear buckets of 128 per power of two, so any value is within 1% of the reported
+one. Recording is an index calculation and an increment, histograms of several threads are merged
+at the end.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace NngBench {
+
+	class Histogram {
+	public:
+		Histogram() : counts(bucketCount, 0), total(0), maximum(0) {}
+
+		void record(uint64_t value)
+		{
+			counts[index(value)]++;
+			total++;
+			if (value > maximum) maximum = value;
+		}
+
+		void merge(const Histogram& other)
+		{
+			for (size_t i = 0; i < counts.size(); i++) counts[i] += other.counts[i];
+			total += other.total;
+			if (other.maximum > maximum) maximum = other.maximum;
+		}
+
+		uint64_t count() const { return total; }
+		uint64_t max() const { return maximum; }
+
+		// p in 0..100, the middle of the bucket holding the p-th percentile
+		uint64_t percentile(double p) const
+		{
+			if (total == 0) return 0;
+			uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total) + 0.5);
+			if (rank < 1) rank = 1;
+			if (rank > total) rank = total;
+			uint64_t seen = 0;
+			for (size_t i = 0; i < counts.size(); i++) {
+				seen += counts[i];
+				if (seen >= rank) {
+					uint64_t mid = lowest(static_cast<int>(i)) + width(static_cast<int>(i)) / 2;
+					return mid < maximum ? mid : maximum;
+				}
+			}
+			return maximum;
+		}
+
+	private:
+		static const int exact = 256;
+		static const int half = 128;
+		static const int bucketCount = exact + 56 * half;
+
+		static int msb(uint64_t v)
+		{
+#if defined(_MSC_VER)
+			unsigned long i;
+			_BitScanReverse64(&i, v);
+			return static_cast<int>(i);
+#else
+			return 63 - __builtin_clzll(v);
+#endif
+		}
+
+		static int index(uint64_t v)
+		{
+			if (v < exact) return static_cast<int>(v);
+			int e = msb(v) - 7; // 1..56
+			int sub = static_cast<int>(v >> e); // 128..255
+			return exact + (e - 1) * half + (sub - half);
+		}
+
+		static uint64_t lowest(int i)
+		{
+			if (i < exact) return static_cast<uint64_t>(i);
+			int e = (i - exact) / half + 1;
+			uint64_t sub = static_cast<uint64_t>((i - exact) % half + half);
+			return sub << e;
+		}
+
+		static uint64_t width(int i)
+		{
+			if (i < exact) return 1;
+			return uint64_t(1) << ((i - exact) / half + 1);
+		}
+
+		std::vector<uint64_t> counts;
+		uint64_t total;
+		uint64_t maximum;
+	};
+}
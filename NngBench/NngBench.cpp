@@ -0,0 +1,726 @@
+/*
+Nng benchmarks
+
+Native latency and throughput measurements of the nng calls the wrapper is built on, so they run
+anywhere nng builds, Linux included, and without the .NET test host. Every scenario is a pair of
+sockets per thread, a sender (or client) and a receiver (or server):
+
+	protocols   every protocol of Protocols: req0/rep0 and surveyor0/respondent0 as round trips,
+	            push0/pull0, pair0, bus0 and pub0/sub0 one way
+	transports  inproc, ipc and tcp loopback, and shm, the shared memory channel of NngCore/CoreShm.cpp.
+	            shm isn't an nng transport: it runs pair0 (one way) and req0/rep0 (round trips) only,
+	            alloc copies in and out of the ring with nngc_shm_send/recv_into, msg writes into the
+	            ring and reads in place with nngc_shm_send_begin/recv_begin, aio doesn't apply
+	paths       alloc  nng_send of a buffer, nng_recv with NNG_FLAG_ALLOC plus a copy, like
+	                   Socket::Send/Receive(array<Byte>) in SendReceive.cpp
+	            msg    messages built with nng_msg_append_u32/append and taken apart with
+	                   nng_msg_trim_u32, like Msg in Message.cpp
+	            aio    nng_send_aio/nng_recv_aio, the receiver re-arming itself from its
+	                   callback, like Aio in Asyncronous.cpp
+	sizes       8 bytes to 16 MB
+	threads     1 to N socket pairs in parallel
+
+One way latency is taken from a timestamp in the first 8 bytes of every message, round trips are
+timed by the client. Results go to stdout as one JSON object per line (or CSV), a readable summary
+goes to stderr.
+*/
+
+#include <nng/nng.h>
+#include <nng/protocol/bus0/bus.h>
+#include <nng/protocol/pair0/pair.h>
+#include <nng/protocol/pipeline0/pull.h>
+#include <nng/protocol/pipeline0/push.h>
+#include <nng/protocol/pubsub0/pub.h>
+#include <nng/protocol/pubsub0/sub.h>
+#include <nng/protocol/reqrep0/rep.h>
+#include <nng/protocol/reqrep0/req.h>
+#include <nng/protocol/survey0/respond.h>
+#include <nng/protocol/survey0/survey.h>
+
+#include "Histogram.h"
+#include "nngcore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace NngBench {
+
+	struct Protocol {
+		const char* name;
+		int(*openClient)(nng_socket*); // sends, dials
+		int(*openServer)(nng_socket*); // receives, listens
+		bool roundTrip;
+		bool lossy; // drops messages when the receiver falls behind
+	};
+
+	static const Protocol protocols[] = {
+		{ "req0/rep0", nng_req0_open, nng_rep0_open, true, false },
+		{ "surveyor0/respondent0", nng_surveyor0_open, nng_respondent0_open, true, false },
+		{ "push0/pull0", nng_push0_open, nng_pull0_open, false, false },
+		{ "pair0", nng_pair0_open, nng_pair0_open, false, false },
+		{ "bus0", nng_bus0_open, nng_bus0_open, false, true },
+		{ "pub0/sub0", nng_pub0_open, nng_sub0_open, false, true },
+	};
+
+	enum class Path { alloc, msg, aio };
+
+	static const char* pathName(Path path)
+	{
+		switch (path) {
+		case Path::alloc: return "alloc";
+		case Path::msg:   return "msg";
+		default:          return "aio";
+		}
+	}
+
+	struct Options {
+		std::vector<std::string> protocols;
+		std::vector<std::string> transports{ "inproc", "ipc", "tcp", "shm" };
+		std::vector<std::string> paths{ "alloc", "msg", "aio" };
+		std::vector<size_t> sizes{ 8, 64, 512, 4096, 32768, 262144, 2097152, 16777216 };
+		std::vector<int> threads{ 1, 2, 4 };
+		size_t budget = size_t(64) << 20; // bytes per thread and scenario
+		size_t minMessages = 16;
+		size_t maxMessages = 100000;
+		int tcpPort = 23000;
+		std::string format = "json";
+		std::string out;
+	};
+
+	struct Result {
+		std::string protocol, transport, path;
+		size_t size = 0;
+		int threads = 0;
+		uint64_t sent = 0, received = 0;
+		double seconds = 0;
+		Histogram latency;
+		std::string error;
+	};
+
+	static void check(int rv, const char* what)
+	{
+		if (rv != 0) throw std::runtime_error(std::string(what) + ": " + nng_strerror(rv));
+	}
+
+	static uint64_t now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// one socket pair, closed on scope exit
+	struct SocketPair {
+		nng_socket client{};
+		nng_socket server{};
+		bool clientOpen = false, serverOpen = false;
+
+		SocketPair(const Protocol& protocol, const std::string& url)
+		{
+			check(protocol.openServer(&server), "open server");
+			serverOpen = true;
+			check(protocol.openClient(&client), "open client");
+			clientOpen = true;
+			if (protocol.openServer == nng_sub0_open) {
+				check(nng_setopt(server, NNG_OPT_SUB_SUBSCRIBE, "", 0), "subscribe");
+			}
+			if (protocol.openClient == nng_surveyor0_open) {
+				check(nng_setopt_ms(client, NNG_OPT_SURVEYOR_SURVEYTIME, 60000), "survey time");
+			}
+			check(nng_setopt_size(server, NNG_OPT_RECVMAXSZ, 0), "recv-size-max");
+			check(nng_setopt_size(client, NNG_OPT_RECVMAXSZ, 0), "recv-size-max");
+			// lossy protocols end when nothing arrives anymore
+			check(nng_setopt_ms(server, NNG_OPT_RECVTIMEO, 2000), "recv-timeout");
+			check(nng_setopt_ms(client, NNG_OPT_RECVTIMEO, 10000), "recv-timeout");
+			check(nng_listen(server, url.c_str(), nullptr, 0), "listen");
+			check(nng_dial(client, url.c_str(), nullptr, 0), "dial");
+		}
+
+		~SocketPair()
+		{
+			if (clientOpen) nng_close(client);
+			if (serverOpen) nng_close(server);
+		}
+	};
+
+	// sending side of every path, the timestamp goes first
+
+	static void sendOne(nng_socket s, Path path, std::vector<unsigned char>& payload, nng_aio* aio)
+	{
+		uint64_t t = now();
+		if (path == Path::alloc) {
+			std::memcpy(payload.data(), &t, sizeof(t));
+			check(nng_send(s, payload.data(), payload.size(), 0), "send");
+			return;
+		}
+		nng_msg* msg;
+		check(nng_msg_alloc(&msg, 0), "msg alloc");
+		int rv = nng_msg_append_u32(msg, static_cast<uint32_t>(t >> 32));
+		if (rv == 0) rv = nng_msg_append_u32(msg, static_cast<uint32_t>(t));
+		if (rv == 0) rv = nng_msg_append(msg, payload.data() + 8, payload.size() - 8);
+		if (rv != 0) {
+			nng_msg_free(msg);
+			check(rv, "msg append");
+		}
+		if (path == Path::msg) {
+			rv = nng_sendmsg(s, msg, 0);
+		}
+		else {
+			nng_aio_set_msg(aio, msg);
+			nng_send_aio(s, aio);
+			nng_aio_wait(aio);
+			rv = nng_aio_result(aio);
+		}
+		if (rv != 0) {
+			nng_msg_free(msg);
+			check(rv, "send");
+		}
+	}
+
+	// receiving side of alloc and msg, returns the timestamp
+	static int receiveOne(nng_socket s, Path path, std::vector<unsigned char>& buffer, uint64_t* sentAt)
+	{
+		if (path == Path::alloc) {
+			void* data;
+			size_t size;
+			int rv = nng_recv(s, &data, &size, NNG_FLAG_ALLOC);
+			if (rv != 0) return rv;
+			std::memcpy(buffer.data(), data, std::min(size, buffer.size())); // the copy into a managed array
+			std::memcpy(sentAt, buffer.data(), sizeof(*sentAt));
+			nng_free(data, size);
+			return 0;
+		}
+		nng_msg* msg;
+		int rv = nng_recvmsg(s, &msg, 0);
+		if (rv != 0) return rv;
+		uint32_t hi = 0, lo = 0;
+		nng_msg_trim_u32(msg, &hi);
+		nng_msg_trim_u32(msg, &lo);
+		*sentAt = (static_cast<uint64_t>(hi) << 32) | lo;
+		nng_msg_free(msg);
+		return 0;
+	}
+
+	static uint64_t msgTimestamp(nng_msg* msg)
+	{
+		uint32_t hi = 0, lo = 0;
+		nng_msg_trim_u32(msg, &hi);
+		nng_msg_trim_u32(msg, &lo);
+		return (static_cast<uint64_t>(hi) << 32) | lo;
+	}
+
+	// The aio receiver: the callback records the message and starts the next receive itself
+	struct AioReceiver {
+		nng_socket socket{};
+		nng_aio* aio = nullptr;
+		Histogram* latency = nullptr;
+		uint64_t target = 0;
+		uint64_t received = 0;
+		uint64_t last = 0;
+		std::mutex mtx;
+		std::condition_variable cv;
+		bool done = false;
+
+		static void callback(void* arg)
+		{
+			auto self = static_cast<AioReceiver*>(arg);
+			int rv = nng_aio_result(self->aio);
+			if (rv == 0) {
+				nng_msg* msg = nng_aio_get_msg(self->aio);
+				uint64_t sentAt = msgTimestamp(msg);
+				uint64_t t = now();
+				nng_msg_free(msg);
+				self->latency->record(t - sentAt);
+				self->last = t;
+				if (++self->received < self->target) {
+					nng_recv_aio(self->socket, self->aio);
+					return;
+				}
+			}
+			std::lock_guard<std::mutex> l(self->mtx);
+			self->done = true;
+			self->cv.notify_all();
+		}
+
+		void wait()
+		{
+			std::unique_lock<std::mutex> l(mtx);
+			cv.wait(l, [this] { return done; });
+		}
+	};
+
+	struct ThreadResult {
+		uint64_t sent = 0, received = 0, start = 0, end = 0;
+		Histogram latency;
+		std::string error;
+	};
+
+	static void runOneWay(SocketPair& pair, Path path, size_t size, uint64_t count, ThreadResult& r)
+	{
+		std::vector<unsigned char> payload(size, 0x5A);
+		std::vector<unsigned char> buffer(size);
+		nng_aio* sendAio = nullptr;
+		AioReceiver receiver;
+		std::thread receiving;
+
+		r.start = now();
+		if (path == Path::aio) {
+			check(nng_aio_alloc(&sendAio, nullptr, nullptr), "aio alloc");
+			check(nng_aio_alloc(&receiver.aio, AioReceiver::callback, &receiver), "aio alloc");
+			nng_aio_set_timeout(receiver.aio, 2000);
+			receiver.socket = pair.server;
+			receiver.latency = &r.latency;
+			receiver.target = count;
+			nng_recv_aio(pair.server, receiver.aio);
+		}
+		else {
+			receiving = std::thread([&] {
+				uint64_t sentAt;
+				for (uint64_t i = 0; i < count; i++) {
+					int rv = receiveOne(pair.server, path, buffer, &sentAt);
+					if (rv == NNG_ETIMEDOUT) break; // the rest was dropped
+					if (rv != 0) {
+						r.error = std::string("receive: ") + nng_strerror(rv);
+						break;
+					}
+					r.end = now();
+					r.latency.record(r.end - sentAt);
+					r.received++;
+				}
+			});
+		}
+
+		try {
+			for (uint64_t i = 0; i < count; i++) {
+				sendOne(pair.client, path, payload, sendAio);
+				r.sent++;
+			}
+		}
+		catch (const std::exception& e) {
+			r.error = e.what();
+		}
+
+		if (path == Path::aio) {
+			receiver.wait();
+			r.received = receiver.received;
+			r.end = receiver.last;
+			nng_aio_free(receiver.aio);
+			nng_aio_free(sendAio);
+		}
+		else {
+			receiving.join();
+		}
+	}
+
+	static void runRoundTrip(SocketPair& pair, Path path, size_t size, uint64_t count, ThreadResult& r)
+	{
+		std::atomic<bool> stop{ false };
+		// the server always echoes the message it got, only the client side follows the path
+		std::thread server([&] {
+			while (!stop.load()) {
+				nng_msg* msg;
+				int rv = nng_recvmsg(pair.server, &msg, 0);
+				if (rv == NNG_ETIMEDOUT) continue;
+				if (rv != 0) break;
+				if (nng_sendmsg(pair.server, msg, 0) != 0) nng_msg_free(msg);
+			}
+		});
+
+		std::vector<unsigned char> payload(size, 0x5A);
+		std::vector<unsigned char> buffer(size);
+		nng_aio* aio = nullptr;
+		try {
+			if (path == Path::aio) check(nng_aio_alloc(&aio, nullptr, nullptr), "aio alloc");
+			r.start = now();
+			for (uint64_t i = 0; i < count; i++) {
+				uint64_t t0 = now();
+				sendOne(pair.client, path, payload, aio);
+				r.sent++;
+				uint64_t sentAt;
+				if (path == Path::aio) {
+					nng_recv_aio(pair.client, aio);
+					nng_aio_wait(aio);
+					check(nng_aio_result(aio), "receive");
+					nng_msg* msg = nng_aio_get_msg(aio);
+					sentAt = msgTimestamp(msg);
+					nng_msg_free(msg);
+				}
+				else {
+					check(receiveOne(pair.client, path, buffer, &sentAt), "receive");
+				}
+				r.end = now();
+				r.latency.record(r.end - t0);
+				r.received++;
+			}
+		}
+		catch (const std::exception& e) {
+			r.error = e.what();
+		}
+		if (aio != nullptr) nng_aio_free(aio);
+		stop.store(true);
+		server.join();
+	}
+
+	// Shared memory, a channel per thread instead of a socket pair
+
+	static bool shmApplies(const Protocol& protocol, Path path)
+	{
+		std::string name = protocol.name;
+		return path != Path::aio && (name == "pair0" || name == "req0/rep0");
+	}
+
+	struct ShmPair {
+		nngc_shm client = 0; // dials, sends
+		nngc_shm server = 0; // listens, receives
+
+		ShmPair(const std::string& url, size_t size)
+		{
+			// room for a few messages of the size in each ring
+			uint32_t capacity = 1 << 20;
+			while (capacity < 4 * (size + 8) && capacity < (1u << 30)) capacity <<= 1;
+			check(nngc_shm_listen(url.c_str(), url.size(), capacity, &server), "shm listen");
+			int rv = nngc_shm_dial(url.c_str(), url.size(), &client);
+			if (rv != 0) {
+				nngc_shm_close(server);
+				check(rv, "shm dial");
+			}
+		}
+
+		~ShmPair()
+		{
+			nngc_shm_close(client);
+			nngc_shm_close(server);
+		}
+	};
+
+	static void shmSend(nngc_shm shm, bool inPlace, std::vector<unsigned char>& payload)
+	{
+		uint64_t t = now();
+		if (!inPlace) {
+			std::memcpy(payload.data(), &t, sizeof(t));
+			check(nngc_shm_send(shm, payload.data(), payload.size(), 10000), "send");
+			return;
+		}
+		void* buffer;
+		check(nngc_shm_send_begin(shm, payload.size(), &buffer, 10000), "send");
+		std::memcpy(buffer, &t, sizeof(t));
+		std::memcpy(static_cast<unsigned char*>(buffer) + 8, payload.data() + 8, payload.size() - 8);
+		check(nngc_shm_send_end(shm, payload.size()), "send");
+	}
+
+	static int shmReceive(nngc_shm shm, bool inPlace, std::vector<unsigned char>& buffer, uint64_t* sentAt)
+	{
+		if (!inPlace) {
+			size_t size;
+			int rv = nngc_shm_recv_into(shm, buffer.data(), buffer.size(), &size, 10000);
+			if (rv == 0) std::memcpy(sentAt, buffer.data(), sizeof(*sentAt));
+			return rv;
+		}
+		const void* data;
+		size_t size;
+		int rv = nngc_shm_recv_begin(shm, &data, &size, 10000);
+		if (rv != 0) return rv;
+		std::memcpy(sentAt, data, sizeof(*sentAt));
+		return nngc_shm_recv_end(shm);
+	}
+
+	static void runShmOneWay(ShmPair& pair, bool inPlace, size_t size, uint64_t count, ThreadResult& r)
+	{
+		std::vector<unsigned char> payload(size, 0x5A);
+		std::vector<unsigned char> buffer(size);
+		r.start = now();
+		std::thread receiving([&] {
+			uint64_t sentAt;
+			for (uint64_t i = 0; i < count; i++) {
+				int rv = shmReceive(pair.server, inPlace, buffer, &sentAt);
+				if (rv != 0) {
+					r.error = std::string("receive: ") + nng_strerror(rv);
+					break;
+				}
+				r.end = now();
+				r.latency.record(r.end - sentAt);
+				r.received++;
+			}
+		});
+		try {
+			for (uint64_t i = 0; i < count; i++) {
+				shmSend(pair.client, inPlace, payload);
+				r.sent++;
+			}
+		}
+		catch (const std::exception& e) {
+			r.error = e.what();
+		}
+		receiving.join();
+	}
+
+	static void runShmRoundTrip(ShmPair& pair, bool inPlace, size_t size, uint64_t count, ThreadResult& r)
+	{
+		std::atomic<bool> stop{ false };
+		// the server echoes from the ring it received in to the one it sends in
+		std::thread server([&] {
+			while (!stop.load()) {
+				const void* data;
+				size_t n;
+				int rv = nngc_shm_recv_begin(pair.server, &data, &n, 100);
+				if (rv == NNG_ETIMEDOUT) continue;
+				if (rv != 0) break;
+				void* buffer;
+				if (nngc_shm_send_begin(pair.server, n, &buffer, 10000) == 0) {
+					std::memcpy(buffer, data, n);
+					nngc_shm_send_end(pair.server, n);
+				}
+				nngc_shm_recv_end(pair.server);
+			}
+		});
+
+		std::vector<unsigned char> payload(size, 0x5A);
+		std::vector<unsigned char> buffer(size);
+		try {
+			r.start = now();
+			for (uint64_t i = 0; i < count; i++) {
+				uint64_t t0 = now();
+				shmSend(pair.client, inPlace, payload);
+				r.sent++;
+				uint64_t sentAt;
+				check(shmReceive(pair.client, inPlace, buffer, &sentAt), "receive");
+				r.end = now();
+				r.latency.record(r.end - t0);
+				r.received++;
+			}
+		}
+		catch (const std::exception& e) {
+			r.error = e.what();
+		}
+		stop.store(true);
+		server.join();
+	}
+
+	static std::string url(const std::string& transport, const Options& options, int scenario, int thread)
+	{
+		std::ostringstream s;
+		if (transport == "inproc") s << "inproc://nngbench-" << scenario << "-" << thread;
+		else if (transport == "ipc") s << "ipc:///tmp/nngbench-" << getpid() << "-" << scenario << "-" << thread;
+		else if (transport == "shm") s << "shm://nngbench-" << getpid() << "-" << scenario << "-" << thread;
+		else s << "tcp://127.0.0.1:" << (options.tcpPort + (scenario * 64 + thread) % 20000);
+		return s.str();
+	}
+
+	static Result run(const Protocol& protocol, const std::string& transport, Path path, size_t size, int threads,
+		const Options& options, int scenario)
+	{
+		Result result;
+		result.protocol = protocol.name;
+		result.transport = transport;
+		result.path = pathName(path);
+		result.size = size;
+		result.threads = threads;
+
+		uint64_t count = std::max(options.minMessages, std::min(options.maxMessages, options.budget / size));
+		std::vector<ThreadResult> perThread(threads);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t] {
+				try {
+					if (transport == "shm") {
+						ShmPair pair(url(transport, options, scenario, t), size);
+						if (protocol.roundTrip) runShmRoundTrip(pair, path == Path::msg, size, count, perThread[t]);
+						else runShmOneWay(pair, path == Path::msg, size, count, perThread[t]);
+						return;
+					}
+					SocketPair pair(protocol, url(transport, options, scenario, t));
+					if (protocol.roundTrip) runRoundTrip(pair, path, size, count, perThread[t]);
+					else runOneWay(pair, path, size, count, perThread[t]);
+				}
+				catch (const std::exception& e) {
+					perThread[t].error = e.what();
+				}
+			});
+		}
+		for (auto& w : workers) w.join();
+
+		uint64_t start = UINT64_MAX, end = 0;
+		for (auto& r : perThread) {
+			result.sent += r.sent;
+			result.received += r.received;
+			result.latency.merge(r.latency);
+			if (r.received > 0) {
+				start = std::min(start, r.start);
+				end = std::max(end, r.end);
+			}
+			if (result.error.empty() && !r.error.empty()) result.error = r.error;
+		}
+		if (end > start) result.seconds = (end - start) / 1e9;
+		if (!protocol.lossy && result.error.empty() && result.received < result.sent) {
+			result.error = "messages lost";
+		}
+		return result;
+	}
+
+	static void writeJson(std::ostream& out, const Result& r)
+	{
+		double rate = r.seconds > 0 ? r.received / r.seconds : 0;
+		out << "{\"nng\":\"" << nng_version() << "\""
+			<< ",\"protocol\":\"" << r.protocol << "\""
+			<< ",\"transport\":\"" << r.transport << "\""
+			<< ",\"path\":\"" << r.path << "\""
+			<< ",\"size\":" << r.size
+			<< ",\"threads\":" << r.threads
+			<< ",\"sent\":" << r.sent
+			<< ",\"received\":" << r.received
+			<< ",\"seconds\":" << r.seconds
+			<< ",\"msgs_per_sec\":" << rate
+			<< ",\"mb_per_sec\":" << rate * r.size / 1e6
+			<< ",\"p50_us\":" << r.latency.percentile(50) / 1e3
+			<< ",\"p90_us\":" << r.latency.percentile(90) / 1e3
+			<< ",\"p99_us\":" << r.latency.percentile(99) / 1e3
+			<< ",\"p999_us\":" << r.latency.percentile(99.9) / 1e3
+			<< ",\"max_us\":" << r.latency.max() / 1e3;
+		if (!r.error.empty()) out << ",\"error\":\"" << r.error << "\"";
+		out << "}\n";
+	}
+
+	static void writeCsvHeader(std::ostream& out)
+	{
+		out << "nng,protocol,transport,path,size,threads,sent,received,seconds,msgs_per_sec,mb_per_sec,"
+			"p50_us,p90_us,p99_us,p999_us,max_us,error\n";
+	}
+
+	static void writeCsv(std::ostream& out, const Result& r)
+	{
+		double rate = r.seconds > 0 ? r.received / r.seconds : 0;
+		out << nng_version() << "," << r.protocol << "," << r.transport << "," << r.path << "," << r.size << ","
+			<< r.threads << "," << r.sent << "," << r.received << "," << r.seconds << "," << rate << ","
+			<< rate * r.size / 1e6 << "," << r.latency.percentile(50) / 1e3 << "," << r.latency.percentile(90) / 1e3 << ","
+			<< r.latency.percentile(99) / 1e3 << "," << r.latency.percentile(99.9) / 1e3 << ","
+			<< r.latency.max() / 1e3 << "," << r.error << "\n";
+	}
+
+	static void writeSummary(const Result& r)
+	{
+		double rate = r.seconds > 0 ? r.received / r.seconds : 0;
+		std::fprintf(stderr, "%-22s %-6s %-5s %9zu B %2d thr  %10.0f msg/s  p50 %9.1f us  p99 %9.1f us  p99.9 %9.1f us%s%s\n",
+			r.protocol.c_str(), r.transport.c_str(), r.path.c_str(), r.size, r.threads, rate,
+			r.latency.percentile(50) / 1e3, r.latency.percentile(99) / 1e3, r.latency.percentile(99.9) / 1e3,
+			r.error.empty() ? "" : "  ", r.error.c_str());
+	}
+
+	static std::vector<std::string> split(const std::string& s)
+	{
+		std::vector<std::string> parts;
+		std::stringstream ss(s);
+		std::string part;
+		while (std::getline(ss, part, ',')) {
+			if (!part.empty()) parts.push_back(part);
+		}
+		return parts;
+	}
+
+	static void usage()
+	{
+		std::fprintf(stderr,
+			"usage: nng_bench [options]\n"
+			"  --protocols=LIST   req0/rep0,surveyor0/respondent0,push0/pull0,pair0,bus0,pub0/sub0 (default all)\n"
+			"  --transports=LIST  inproc,ipc,tcp,shm (default all)\n"
+			"  --paths=LIST       alloc,msg,aio (default all)\n"
+			"  --sizes=LIST       message sizes in bytes, 8 at least (default 8 to 16777216)\n"
+			"  --threads=LIST     socket pairs in parallel (default 1,2,4)\n"
+			"  --budget-mb=N      bytes sent per thread and scenario (default 64)\n"
+			"  --max-msgs=N       messages per thread and scenario at most (default 100000)\n"
+			"  --tcp-port=N       first tcp port (default 23000)\n"
+			"  --format=json|csv  machine readable output (default json)\n"
+			"  --out=FILE         write it to FILE instead of stdout\n");
+	}
+
+	static bool parse(int argc, char** argv, Options& o)
+	{
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			size_t eq = arg.find('=');
+			std::string key = arg.substr(0, eq);
+			std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+			if (key == "--protocols") o.protocols = split(value);
+			else if (key == "--transports") o.transports = split(value);
+			else if (key == "--paths") o.paths = split(value);
+			else if (key == "--sizes") {
+				o.sizes.clear();
+				for (auto& s : split(value)) o.sizes.push_back(std::max<size_t>(8, std::strtoull(s.c_str(), nullptr, 10)));
+			}
+			else if (key == "--threads") {
+				o.threads.clear();
+				for (auto& s : split(value)) o.threads.push_back(std::max(1, std::atoi(s.c_str())));
+			}
+			else if (key == "--budget-mb") o.budget = std::strtoull(value.c_str(), nullptr, 10) << 20;
+			else if (key == "--max-msgs") o.maxMessages = std::strtoull(value.c_str(), nullptr, 10);
+			else if (key == "--tcp-port") o.tcpPort = std::atoi(value.c_str());
+			else if (key == "--format" && (value == "json" || value == "csv")) o.format = value;
+			else if (key == "--out") o.out = value;
+			else return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	using namespace NngBench;
+	Options options;
+	if (!parse(argc, argv, options)) {
+		usage();
+		return 2;
+	}
+
+	std::ofstream file;
+	if (!options.out.empty()) {
+		file.open(options.out);
+		if (!file) {
+			std::fprintf(stderr, "cannot write %s\n", options.out.c_str());
+			return 2;
+		}
+	}
+	std::ostream& out = options.out.empty() ? std::cout : file;
+	if (options.format == "csv") writeCsvHeader(out);
+
+	int scenario = 0;
+	int failed = 0;
+	for (const Protocol& protocol : protocols) {
+		if (!options.protocols.empty() &&
+			std::find(options.protocols.begin(), options.protocols.end(), protocol.name) == options.protocols.end()) continue;
+		for (const auto& transport : options.transports) {
+			for (const auto& pathText : options.paths) {
+				Path path = pathText == "alloc" ? Path::alloc : pathText == "msg" ? Path::msg : Path::aio;
+				if (transport == "shm" && !shmApplies(protocol, path)) continue;
+				for (size_t size : options.sizes) {
+					for (int threads : options.threads) {
+						Result r = run(protocol, transport, path, size, threads, options, scenario++);
+						if (!r.error.empty()) failed++;
+						if (options.format == "csv") writeCsv(out, r);
+						else writeJson(out, r);
+						out.flush();
+						writeSummary(r);
+					}
+				}
+			}
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/*
+Nng core
+
+Aio. The callback is a plain C function pointer which nng calls itself, on one of its threads,
+so .NET passes a function pointer to an unmanaged callback and nothing is marshalled per call.
+nng calls aioCallback first, which records the metrics of sends and receives on a counted socket.
+nngc_pipe_event_recv (CorePipes.cpp) completes the same aio itself, as an aio provider.
+
+
+
+
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+#include <new>
+
+#define AIO(a) (nngcAio(a)->aio)
+
+static void aioCallback(void* arg)
+{
+	auto a = static_cast<nngcAioState*>(arg);
+	nngcMetrics* m = a->metrics;
+	if (m != nullptr) {
+		a->metrics = nullptr; // the callback may start the next operation
+		int result = ::nng_aio_result(a->aio);
+		nngcMetricsAio(m, result, nngcMetricsNow() - a->started);
+		if (a->sending) {
+			nngcMetricsSent(m, result, (result == 0) ? 1 : 0, (result == 0) ? a->bytes : 0);
+		}
+		else {
+			nng_msg* msg = (result == 0) ? ::nng_aio_get_msg(a->aio) : nullptr;
+			nngcMetricsReceived(m, result, (msg != nullptr) ? 1 : 0, (msg != nullptr) ? ::nng_msg_len(msg) : 0);
+		}
+	}
+	if (a->pipeHub != nullptr) nngcPipesForget(a); // completed by nng rather than by an event
+	if (a->callback != nullptr) a->callback(a->arg);
+}
+
+extern "C" {
+
+	int nngc_aio_alloc(nngc_callback callback, void* arg, nngc_aio* aio)
+	{
+		*aio = 0;
+		auto a = new (std::nothrow) nngcAioState();
+		if (a == nullptr) return NNG_ENOMEM;
+		a->callback = callback;
+		a->arg = arg;
+		int result = ::nng_aio_alloc(&a->aio, aioCallback, a);
+		if (result != 0) {
+			delete a;
+			return result;
+		}
+		*aio = nngcAioHandle(a);
+		return 0;
+	}
+
+	void nngc_aio_free(nngc_aio aio)
+	{
+		if (aio == 0) return;
+		::nng_aio_free(AIO(aio)); // waits for a running callback
+		delete nngcAio(aio);
+	}
+
+	void nngc_aio_stop(nngc_aio aio)
+	{
+		::nng_aio_stop(AIO(aio));
+	}
+
+	void nngc_aio_cancel(nngc_aio aio)
+	{
+		::nng_aio_cancel(AIO(aio));
+	}
+
+	void nngc_aio_wait(nngc_aio aio)
+	{
+		::nng_aio_wait(AIO(aio));
+	}
+
+	int nngc_aio_result(nngc_aio aio)
+	{
+		return ::nng_aio_result(AIO(aio));
+	}
+
+	void nngc_aio_set_timeout(nngc_aio aio, int32_t timeout)
+	{
+		::nng_aio_set_timeout(AIO(aio), timeout);
+	}
+
+	nngc_msg nngc_aio_get_msg(nngc_aio aio)
+	{
+		return nngcMsgHandle(::nng_aio_get_msg(AIO(aio)));
+	}
+
+	void nngc_aio_set_msg(nngc_aio aio, nngc_msg msg)
+	{
+		::nng_aio_set_msg(AIO(aio), nngcMsg(msg));
+	}
+
+	void nngc_send_aio(nngc_socket socket, nngc_aio aio)
+	{
+		nngcAioState* a = nngcAio(aio);
+		nngcMetrics* m = nngcMetricsFind(socket);
+		if (m != nullptr) {
+			nng_msg* msg = ::nng_aio_get_msg(a->aio);
+			a->bytes = (msg != nullptr) ? ::nng_msg_len(msg) : 0;
+			a->sending = true;
+			a->started = nngcMetricsNow();
+		}
+		a->metrics = m;
+		::nng_send_aio(nngcFromId<nng_socket>(socket), a->aio);
+	}
+
+	void nngc_recv_aio(nngc_socket socket, nngc_aio aio)
+	{
+		nngcAioState* a = nngcAio(aio);
+		nngcMetrics* m = nngcMetricsFind(socket);
+		if (m != nullptr) {
+			a->sending = false;
+			a->started = nngcMetricsNow();
+		}
+		a->metrics = m;
+		::nng_recv_aio(nngcFromId<nng_socket>(socket), a->aio);
+	}
+
+	void* nngc_aio_native(nngc_aio aio)
+	{
+		return AIO(aio);
+	}
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+/*
+Nng core
+
+Conversions between the handles of nngcore.h and nng's types, shared by the Core*.cpp files.
+nng_socket, nng_dialer, nng_listener and nng_pipe are a uint32_t in older nng versions and a
+struct holding one in newer ones, copying the bytes works with both.
+*/
+
+#include <cstdint>
+#include <cstring>
+
+template <typename T>
+static inline T nngcFromId(uint32_t id)
+{
+	static_assert(sizeof(T) == sizeof(uint32_t), "nng ids are 32 bit");
+	T t;
+	std::memcpy(&t, &id, sizeof(t));
+	return t;
+}
+
+template <typename T>
+static inline uint32_t nngcToId(T t)
+{
+	static_assert(sizeof(T) == sizeof(uint32_t), "nng ids are 32 bit");
+	uint32_t id;
+	std::memcpy(&id, &t, sizeof(id));
+	return id;
+}
+
+static inline nng_msg* nngcMsg(nngc_msg msg)
+{
+	return reinterpret_cast<nng_msg*>(static_cast<uintptr_t>(msg));
+}
+
+static inline nngc_msg nngcMsgHandle(nng_msg* msg)
+{
+	return static_cast<nngc_msg>(reinterpret_cast<uintptr_t>(msg));
+}
+
+/*
+Metrics, CoreMetrics.cpp. nngcMetricsFind is a lock free lookup which returns nullptr right away
+while no socket is counted, the callers only record when it found something. Found metrics stay
+valid until nngc_fini, even if the socket is closed in the meantime.
+*/
+struct nngcMetrics;
+
+#if defined(NNGC_NO_METRICS)
+static inline nngcMetrics* nngcMetricsFind(uint32_t) { return nullptr; }
+static inline void nngcMetricsSent(nngcMetrics*, int, uint64_t, uint64_t) {}
+static inline void nngcMetricsReceived(nngcMetrics*, int, uint64_t, uint64_t) {}
+static inline void nngcMetricsAio(nngcMetrics*, int, uint64_t) {}
+static inline void nngcMetricsPipe(nngcMetrics*, bool, bool) {}
+static inline void nngcMetricsClose(uint32_t) {}
+static inline void nngcMetricsFini() {}
+static inline uint64_t nngcMetricsNow() { return 0; }
+#else
+nngcMetrics* nngcMetricsFind(uint32_t socket);
+// msgs messages with bytes bytes went through, result is 0 or the error which ended the call
+void nngcMetricsSent(nngcMetrics* metrics, int result, uint64_t msgs, uint64_t bytes);
+void nngcMetricsReceived(nngcMetrics* metrics, int result, uint64_t msgs, uint64_t bytes);
+// an aio operation completed with result after nanoseconds
+void nngcMetricsAio(nngcMetrics* metrics, int result, uint64_t nanoseconds);
+// a pipe was added (made by a dialer or accepted by a listener) or removed
+void nngcMetricsPipe(nngcMetrics* metrics, bool added, bool dialed);
+void nngcMetricsClose(uint32_t socket);
+void nngcMetricsFini();
+uint64_t nngcMetricsNow(); // nanoseconds, monotonic
+#endif
+
+/*
+Receive waiting, CoreRecvWait.cpp. nngcRecvWaitFind is a lock free lookup like nngcMetricsFind, the
+receive functions hand a socket with a policy a nonblocking try of theirs to nngcRecvWaitReceive.
+*/
+struct nngcRecvWait;
+// one receive with the given flags, NNG_EAGAIN if there is nothing yet
+typedef int (*nngcRecvAttempt)(void* arg, int flags);
+
+nngcRecvWait* nngcRecvWaitFind(uint32_t socket);
+// tries, spinning and yielding, then calls attempt with flags. Only for blocking receives
+int nngcRecvWaitReceive(nngcRecvWait* wait, nngcRecvAttempt attempt, void* arg, int flags);
+void nngcRecvWaitClose(uint32_t socket);
+void nngcRecvWaitFini();
+
+// Pollers, CorePoller.cpp. A socket leaves every poller before nng closes its descriptors
+void nngcPollerClose(uint32_t socket);
+void nngcPollerCloseAll();
+
+// Statistics, CoreStats.cpp. Sockets, dialers, listeners and pipes are scopes with the same name,
+// told apart by their "id" child, 0 if there is none
+uint32_t nngcStatScopeId(nng_stat* scope);
+
+/*
+Pipes, CorePipes.cpp. nng takes one pipe notification callback per socket and event, so all users
+of pipe events (metrics, watched pipes) share one per socket, registered by nngcPipesNotify.
+*/
+struct nngcPipeHub;
+// also hands pipe events to metrics from now on
+int nngcPipesNotify(uint32_t socket, nngcMetrics* metrics);
+void nngcPipesClose(uint32_t socket);
+void nngcPipesFini();
+
+// An nngc_aio points to one of these. nng calls the core, which records the metrics of a measured
+// operation before it calls the callback given to nngc_aio_alloc
+struct nngcAioState {
+	nng_aio* aio;
+	nngc_callback callback;
+	void* arg;
+	nngcMetrics* metrics; // of the operation in progress, nullptr if it isn't measured
+	uint64_t started;
+	uint64_t bytes;       // of a send
+	bool sending;
+	nngc_pipe_event pipeEvent; // of nngc_pipe_event_recv
+	nngcPipeHub* pipeHub;      // waiting in nngc_pipe_event_recv, nullptr otherwise
+};
+
+// the aio completed, if it was waiting for a pipe event it doesn't anymore
+void nngcPipesForget(nngcAioState* aio);
+
+static inline nngcAioState* nngcAio(nngc_aio aio)
+{
+	return reinterpret_cast<nngcAioState*>(static_cast<uintptr_t>(aio));
+}
+
+static inline nngc_aio nngcAioHandle(nngcAioState* aio)
+{
+	return static_cast<nngc_aio>(reinterpret_cast<uintptr_t>(aio));
+}
@@ -0,0 +1,173 @@
+/*
+Nng core
+
+Messages
+
+
+
+
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+
+#define MSG(m) nngcMsg(m)
+
+extern "C" {
+
+	int nngc_msg_alloc(nngc_msg* msg, size_t size)
+	{
+		nng_msg* m = nullptr;
+		int result = ::nng_msg_alloc(&m, size);
+		*msg = (result == 0) ? nngcMsgHandle(m) : 0;
+		return result;
+	}
+
+	void nngc_msg_free(nngc_msg msg)
+	{
+		if (msg != 0) ::nng_msg_free(MSG(msg));
+	}
+
+	int nngc_msg_realloc(nngc_msg msg, size_t size)
+	{
+		return ::nng_msg_realloc(MSG(msg), size);
+	}
+
+	int nngc_msg_dup(nngc_msg* dup, nngc_msg msg)
+	{
+		nng_msg* m = nullptr;
+		int result = ::nng_msg_dup(&m, MSG(msg));
+		*dup = (result == 0) ? nngcMsgHandle(m) : 0;
+		return result;
+	}
+
+	void* nngc_msg_body(nngc_msg msg)
+	{
+		return ::nng_msg_body(MSG(msg));
+	}
+
+	size_t nngc_msg_len(nngc_msg msg)
+	{
+		return ::nng_msg_len(MSG(msg));
+	}
+
+	void* nngc_msg_header(nngc_msg msg)
+	{
+		return ::nng_msg_header(MSG(msg));
+	}
+
+	size_t nngc_msg_header_len(nngc_msg msg)
+	{
+		return ::nng_msg_header_len(MSG(msg));
+	}
+
+	int nngc_msg_append(nngc_msg msg, const void* data, size_t size)
+	{
+		return ::nng_msg_append(MSG(msg), data, size);
+	}
+
+	int nngc_msg_insert(nngc_msg msg, const void* data, size_t size)
+	{
+		return ::nng_msg_insert(MSG(msg), data, size);
+	}
+
+	int nngc_msg_trim(nngc_msg msg, size_t size)
+	{
+		return ::nng_msg_trim(MSG(msg), size);
+	}
+
+	int nngc_msg_chop(nngc_msg msg, size_t size)
+	{
+		return ::nng_msg_chop(MSG(msg), size);
+	}
+
+	int nngc_msg_append_u32(nngc_msg msg, uint32_t value)
+	{
+		return ::nng_msg_append_u32(MSG(msg), value);
+	}
+
+	int nngc_msg_insert_u32(nngc_msg msg, uint32_t value)
+	{
+		return ::nng_msg_insert_u32(MSG(msg), value);
+	}
+
+	int nngc_msg_trim_u32(nngc_msg msg, uint32_t* value)
+	{
+		return ::nng_msg_trim_u32(MSG(msg), value);
+	}
+
+	int nngc_msg_chop_u32(nngc_msg msg, uint32_t* value)
+	{
+		return ::nng_msg_chop_u32(MSG(msg), value);
+	}
+
+	void nngc_msg_clear(nngc_msg msg)
+	{
+		::nng_msg_clear(MSG(msg));
+	}
+
+	int nngc_msg_header_append(nngc_msg msg, const void* data, size_t size)
+	{
+		return ::nng_msg_header_append(MSG(msg), data, size);
+	}
+
+	int nngc_msg_header_insert(nngc_msg msg, const void* data, size_t size)
+	{
+		return ::nng_msg_header_insert(MSG(msg), data, size);
+	}
+
+	int nngc_msg_header_trim(nngc_msg msg, size_t size)
+	{
+		return ::nng_msg_header_trim(MSG(msg), size);
+	}
+
+	int nngc_msg_header_chop(nngc_msg msg, size_t size)
+	{
+		return ::nng_msg_header_chop(MSG(msg), size);
+	}
+
+	int nngc_msg_header_append_u32(nngc_msg msg, uint32_t value)
+	{
+		return ::nng_msg_header_append_u32(MSG(msg), value);
+	}
+
+	int nngc_msg_header_insert_u32(nngc_msg msg, uint32_t value)
+	{
+		return ::nng_msg_header_insert_u32(MSG(msg), value);
+	}
+
+	int nngc_msg_header_trim_u32(nngc_msg msg, uint32_t* value)
+	{
+		return ::nng_msg_header_trim_u32(MSG(msg), value);
+	}
+
+	int nngc_msg_header_chop_u32(nngc_msg msg, uint32_t* value)
+	{
+		return ::nng_msg_header_chop_u32(MSG(msg), value);
+	}
+
+	void nngc_msg_header_clear(nngc_msg msg)
+	{
+		::nng_msg_header_clear(MSG(msg));
+	}
+
+	uint32_t nngc_msg_get_pipe(nngc_msg msg)
+	{
+		return nngcToId(::nng_msg_get_pipe(MSG(msg)));
+	}
+
+	void nngc_msg_set_pipe(nngc_msg msg, uint32_t pipe)
+	{
+		::nng_msg_set_pipe(MSG(msg), nngcFromId<nng_pipe>(pipe));
+	}
+
+	int nngc_msg_copy_body(nngc_msg msg, void* buffer, size_t capacity, size_t* size)
+	{
+		size_t len = ::nng_msg_len(MSG(msg));
+		*size = len;
+		if (len > capacity) return NNG_EMSGSIZE;
+		if (len > 0) std::memcpy(buffer, ::nng_msg_body(MSG(msg)), len);
+		return 0;
+	}
+}
@@ -0,0 +1,223 @@
+/*
+Nng core
+
+Per socket metrics. A counted socket has a number of slots, one cache line each (several with the
+histogram), and every thread adds to the slot it was given the first time it counted something.
+Threads rarely share a slot, so the atomic adds don't bounce cache lines between cores, and a
+reader adds up all slots with plain loads, without any lock.
+
+The sockets are found through a small hash table of chains. Entries are only added and unlinked
+under a lock, and never freed before nngc_fini, so the lookup in the hot path needs no lock and a
+closed socket's metrics stay valid for a thread that is still counting into them.
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+
+#if defined(NNGC_NO_METRICS)
+
+extern "C" {
+
+	int nngc_socket_metrics_enable(nngc_socket)
+	{
+		return NNG_ENOTSUP;
+	}
+
+	int nngc_socket_metrics_read(nngc_socket, nngc_socket_metrics*)
+	{
+		return NNG_ENOTSUP;
+	}
+}
+
+#else
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+
+static const unsigned slotCount = 16;
+static const unsigned tableSize = 256;
+
+struct alignas(64) nngcMetricsSlot {
+	std::atomic<uint64_t> msgsSent;
+	std::atomic<uint64_t> bytesSent;
+	std::atomic<uint64_t> msgsReceived;
+	std::atomic<uint64_t> bytesReceived;
+	std::atomic<uint64_t> dialerConnects;
+	std::atomic<uint64_t> listenerConnects;
+	std::atomic<uint64_t> disconnects;
+	std::atomic<uint64_t> aioCompletions;
+	std::atomic<uint64_t> errors[NNGC_METRICS_ERRORS];
+	std::atomic<uint64_t> aioLatency[NNGC_METRICS_BUCKETS];
+};
+
+struct nngcMetrics {
+	nngcMetricsSlot slots[slotCount];
+	uint32_t socket;
+	std::atomic<nngcMetrics*> next; // chain of the hash table
+	nngcMetrics* retired;           // list of closed sockets, freed by nngc_fini
+};
+
+static std::atomic<nngcMetrics*> table[tableSize];
+static std::atomic<int> counted(0); // sockets in the table, the lookup is skipped while there are none
+static std::atomic<unsigned> nextSlot(0);
+static std::mutex tableLock;        // adding and unlinking only
+static nngcMetrics* retiredList = nullptr;
+
+static inline nngcMetricsSlot& slot(nngcMetrics* m)
+{
+	static thread_local unsigned index = nextSlot.fetch_add(1, std::memory_order_relaxed) % slotCount;
+	return m->slots[index];
+}
+
+static inline void add(std::atomic<uint64_t>& counter, uint64_t value)
+{
+	counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+static inline void error(nngcMetricsSlot& s, int result)
+{
+	if (result == 0) return;
+	unsigned e = static_cast<unsigned>(result);
+	add(s.errors[(e < NNGC_METRICS_ERRORS) ? e : NNGC_METRICS_ERRORS - 1], 1);
+}
+
+nngcMetrics* nngcMetricsFind(uint32_t socket)
+{
+	if (counted.load(std::memory_order_relaxed) == 0) return nullptr;
+	nngcMetrics* m = table[socket % tableSize].load(std::memory_order_acquire);
+	while (m != nullptr && m->socket != socket) m = m->next.load(std::memory_order_acquire);
+	return m;
+}
+
+void nngcMetricsSent(nngcMetrics* m, int result, uint64_t msgs, uint64_t bytes)
+{
+	nngcMetricsSlot& s = slot(m);
+	if (msgs != 0) {
+		add(s.msgsSent, msgs);
+		add(s.bytesSent, bytes);
+	}
+	error(s, result);
+}
+
+void nngcMetricsReceived(nngcMetrics* m, int result, uint64_t msgs, uint64_t bytes)
+{
+	nngcMetricsSlot& s = slot(m);
+	if (msgs != 0) {
+		add(s.msgsReceived, msgs);
+		add(s.bytesReceived, bytes);
+	}
+	error(s, result);
+}
+
+void nngcMetricsAio(nngcMetrics* m, int, uint64_t nanoseconds)
+{
+	// the error is counted by nngcMetricsSent/Received
+	nngcMetricsSlot& s = slot(m);
+	unsigned bucket = 0;
+	for (uint64_t us = nanoseconds / 1000; us != 0 && bucket < NNGC_METRICS_BUCKETS - 1; us >>= 1) bucket++;
+	add(s.aioCompletions, 1);
+	add(s.aioLatency[bucket], 1);
+}
+
+void nngcMetricsPipe(nngcMetrics* m, bool added, bool dialed)
+{
+	nngcMetricsSlot& s = slot(m);
+	if (!added) add(s.disconnects, 1);
+	else add(dialed ? s.dialerConnects : s.listenerConnects, 1);
+}
+
+uint64_t nngcMetricsNow()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// nng may hand out the id again, so the socket leaves the table, but its metrics are kept
+void nngcMetricsClose(uint32_t socket)
+{
+	if (counted.load(std::memory_order_relaxed) == 0) return;
+	std::lock_guard<std::mutex> lock(tableLock);
+	std::atomic<nngcMetrics*>* link = &table[socket % tableSize];
+	nngcMetrics* m;
+	while ((m = link->load(std::memory_order_relaxed)) != nullptr && m->socket != socket) link = &m->next;
+	if (m == nullptr) return;
+	link->store(m->next.load(std::memory_order_relaxed), std::memory_order_release);
+	m->retired = retiredList;
+	retiredList = m;
+	counted.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// after nng_fini, no thread counts anymore
+void nngcMetricsFini()
+{
+	std::lock_guard<std::mutex> lock(tableLock);
+	for (unsigned i = 0; i < tableSize; i++) {
+		nngcMetrics* m = table[i].exchange(nullptr, std::memory_order_relaxed);
+		while (m != nullptr) {
+			nngcMetrics* next = m->next.load(std::memory_order_relaxed);
+			delete m;
+			m = next;
+		}
+	}
+	while (retiredList != nullptr) {
+		nngcMetrics* next = retiredList->retired;
+		delete retiredList;
+		retiredList = next;
+	}
+	counted.store(0, std::memory_order_relaxed);
+}
+
+extern "C" {
+
+	int nngc_socket_metrics_enable(nngc_socket socket)
+	{
+		std::lock_guard<std::mutex> lock(tableLock);
+		std::atomic<nngcMetrics*>& head = table[socket % tableSize];
+		for (nngcMetrics* m = head.load(std::memory_order_relaxed); m != nullptr; m = m->next.load(std::memory_order_relaxed)) {
+			if (m->socket == socket) return 0;
+		}
+
+		auto m = new (std::nothrow) nngcMetrics();
+		if (m == nullptr) return NNG_ENOMEM;
+		m->socket = socket;
+		m->retired = nullptr;
+		// this also tells us whether the socket exists
+		int result = nngcPipesNotify(socket, m);
+		if (result != 0) {
+			delete m;
+			return result;
+		}
+		m->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		head.store(m, std::memory_order_release);
+		counted.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	int nngc_socket_metrics_read(nngc_socket socket, nngc_socket_metrics* metrics)
+	{
+		*metrics = nngc_socket_metrics();
+		nngcMetrics* m = nngcMetricsFind(socket);
+		if (m == nullptr) return NNG_ENOENT;
+		for (unsigned i = 0; i < slotCount; i++) {
+			const nngcMetricsSlot& s = m->slots[i];
+#define SUM(field, counter) metrics->field += s.counter.load(std::memory_order_relaxed)
+			SUM(msgs_sent, msgsSent);
+			SUM(bytes_sent, bytesSent);
+			SUM(msgs_received, msgsReceived);
+			SUM(bytes_received, bytesReceived);
+			SUM(dialer_connects, dialerConnects);
+			SUM(listener_connects, listenerConnects);
+			SUM(disconnects, disconnects);
+			SUM(aio_completions, aioCompletions);
+			for (unsigned e = 0; e < NNGC_METRICS_ERRORS; e++) SUM(errors[e], errors[e]);
+			for (unsigned b = 0; b < NNGC_METRICS_BUCKETS; b++) SUM(aio_latency[b], aioLatency[b]);
+#undef SUM
+		}
+		return 0;
+	}
+}
+
+#endif
@@ -0,0 +1,378 @@
+/*
+Nng core
+
+Pipes. nng takes one pipe notification callback per socket and event, so every socket with a user
+of pipe events has a hub, which gets them and passes them on: to the socket's metrics, and once the
+socket is watched, into the table of its connected pipes and a queue of events.
+
+nngc_pipe_event_recv is an aio operation that the core provides itself: it completes the aio right
+away with a queued event, or defers it until the next event arrives, the socket is closed or the
+operation is canceled. Hubs of closed sockets stay allocated until nngc_fini, nng may still be
+calling them.
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+#include "protocol/pair1/pair.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+
+static const size_t eventLimit = 4096; // queued events, the oldest are dropped beyond
+static const int pair1Protocol = 0x11; // NNG_PAIR1_SELF
+
+namespace {
+
+	struct Pipe {
+		uint32_t dialer;
+		uint32_t listener;
+		uint64_t connected;
+		std::string address;
+	};
+}
+
+struct nngcPipeHub {
+	uint32_t socket;
+	std::atomic<nngcMetrics*> metrics{ nullptr };
+	std::mutex lock; // everything below
+	bool watching = false;
+	bool closed = false;
+	uint32_t dropped = 0;
+	std::unordered_map<uint32_t, Pipe> pipes;
+	std::deque<nngc_pipe_event> events;
+	std::deque<nngcAioState*> waiting;
+	nngcPipeHub* retired = nullptr;
+};
+
+static std::mutex hubsLock;
+static std::unordered_map<uint32_t, nngcPipeHub*> hubs;
+static nngcPipeHub* retiredHubs = nullptr;
+
+static uint64_t nowMilliseconds()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// inproc names and ipc paths as they are, a.b.c.d:port and [v6]:port for tcp
+static std::string remoteAddress(nng_pipe pipe)
+{
+	nng_sockaddr sa;
+	if (::nng_pipe_getopt_sockaddr(pipe, NNG_OPT_REMADDR, &sa) != 0) return std::string();
+	char text[128];
+	switch (sa.s_family) {
+	case NNG_AF_INPROC:
+		return std::string(sa.s_inproc.sa_name);
+	case NNG_AF_IPC:
+		return std::string(sa.s_ipc.sa_path);
+	case NNG_AF_INET: {
+		// address and port are in network byte order
+		auto a = reinterpret_cast<const unsigned char*>(&sa.s_in.sa_addr);
+		auto p = reinterpret_cast<const unsigned char*>(&sa.s_in.sa_port);
+		std::snprintf(text, sizeof(text), "%u.%u.%u.%u:%u", a[0], a[1], a[2], a[3], (p[0] << 8) | p[1]);
+		return std::string(text);
+	}
+	case NNG_AF_INET6: {
+		const uint8_t* a = sa.s_in6.sa_addr;
+		auto p = reinterpret_cast<const unsigned char*>(&sa.s_in6.sa_port);
+		int n = std::snprintf(text, sizeof(text), "[");
+		for (int i = 0; i < 16; i += 2) {
+			n += std::snprintf(text + n, sizeof(text) - n, (i == 0) ? "%x" : ":%x", (a[i] << 8) | a[i + 1]);
+		}
+		std::snprintf(text + n, sizeof(text) - n, "]:%u", (p[0] << 8) | p[1]);
+		return std::string(text);
+	}
+	default:
+		return std::string();
+	}
+}
+
+static void pipeNotify(nng_pipe pipe, nng_pipe_ev ev, void* arg)
+{
+	if (ev != NNG_PIPE_EV_ADD_POST && ev != NNG_PIPE_EV_REM_POST) return;
+	auto hub = static_cast<nngcPipeHub*>(arg);
+	bool added = (ev == NNG_PIPE_EV_ADD_POST);
+	int32_t dialer = static_cast<int32_t>(nngcToId(::nng_pipe_dialer(pipe)));
+	nngcMetrics* m = hub->metrics.load(std::memory_order_acquire);
+	if (m != nullptr) nngcMetricsPipe(m, added, dialer > 0);
+	std::string address = added ? remoteAddress(pipe) : std::string(); // outside the lock, nng asks the transport
+
+	std::unique_lock<std::mutex> lock(hub->lock);
+	if (!hub->watching || hub->closed) return;
+	uint32_t id = nngcToId(pipe);
+	uint64_t now = nowMilliseconds();
+	if (added) {
+		int32_t listener = static_cast<int32_t>(nngcToId(::nng_pipe_listener(pipe)));
+		hub->pipes[id] = Pipe{ (dialer > 0) ? static_cast<uint32_t>(dialer) : 0, (listener > 0) ? static_cast<uint32_t>(listener) : 0, now, std::move(address) };
+	}
+	else {
+		hub->pipes.erase(id);
+	}
+
+	nngc_pipe_event event = { id, added ? NNGC_PIPE_ADDED : NNGC_PIPE_REMOVED, now, 0, 0 };
+	if (hub->waiting.empty()) {
+		if (hub->events.size() == eventLimit) {
+			hub->events.pop_front();
+			hub->dropped++;
+		}
+		hub->events.push_back(event);
+		return;
+	}
+	nngcAioState* a = hub->waiting.front();
+	hub->waiting.pop_front();
+	event.dropped = hub->dropped;
+	hub->dropped = 0;
+	a->pipeEvent = event;
+	a->pipeHub = nullptr;
+	lock.unlock();
+	::nng_aio_finish(a->aio, 0);
+}
+
+// the hub of the socket, registered with nng the first time
+static int hubFor(uint32_t socket, nngcPipeHub** hub)
+{
+	std::lock_guard<std::mutex> lock(hubsLock);
+	auto found = hubs.find(socket);
+	if (found != hubs.end()) {
+		*hub = found->second;
+		return 0;
+	}
+	auto h = new (std::nothrow) nngcPipeHub();
+	if (h == nullptr) return NNG_ENOMEM;
+	h->socket = socket;
+	// this also tells us whether the socket exists
+	nng_socket s = nngcFromId<nng_socket>(socket);
+	int result = ::nng_pipe_notify(s, NNG_PIPE_EV_ADD_POST, pipeNotify, h);
+	if (result == 0) result = ::nng_pipe_notify(s, NNG_PIPE_EV_REM_POST, pipeNotify, h);
+	if (result != 0) {
+		::nng_pipe_notify(s, NNG_PIPE_EV_ADD_POST, nullptr, nullptr);
+		delete h;
+		return result;
+	}
+	hubs[socket] = h;
+	*hub = h;
+	return 0;
+}
+
+static nngcPipeHub* findHub(uint32_t socket)
+{
+	std::lock_guard<std::mutex> lock(hubsLock);
+	auto found = hubs.find(socket);
+	return (found != hubs.end()) ? found->second : nullptr;
+}
+
+// nng cancels a deferred nngc_pipe_event_recv, unless an event or the close took it already
+static void cancelWait(nng_aio* aio, void* arg, int result)
+{
+	auto hub = static_cast<nngcPipeHub*>(arg);
+	{
+		std::lock_guard<std::mutex> lock(hub->lock);
+		auto found = hub->waiting.begin();
+		while (found != hub->waiting.end() && (*found)->aio != aio) ++found;
+		if (found == hub->waiting.end()) return;
+		(*found)->pipeHub = nullptr;
+		hub->waiting.erase(found);
+	}
+	::nng_aio_finish(aio, result);
+}
+
+int nngcPipesNotify(uint32_t socket, nngcMetrics* metrics)
+{
+	nngcPipeHub* hub;
+	int result = hubFor(socket, &hub);
+	if (result == 0) hub->metrics.store(metrics, std::memory_order_release);
+	return result;
+}
+
+void nngcPipesForget(nngcAioState* aio)
+{
+	nngcPipeHub* hub = aio->pipeHub;
+	if (hub == nullptr) return;
+	std::lock_guard<std::mutex> lock(hub->lock);
+	for (auto i = hub->waiting.begin(); i != hub->waiting.end(); ++i) {
+		if (*i == aio) {
+			hub->waiting.erase(i);
+			break;
+		}
+	}
+	aio->pipeHub = nullptr;
+}
+
+void nngcPipesClose(uint32_t socket)
+{
+	nngcPipeHub* hub;
+	{
+		std::lock_guard<std::mutex> lock(hubsLock);
+		auto found = hubs.find(socket);
+		if (found == hubs.end()) return;
+		hub = found->second;
+		hubs.erase(found);
+		hub->retired = retiredHubs;
+		retiredHubs = hub;
+	}
+	std::deque<nngcAioState*> waiting;
+	{
+		std::lock_guard<std::mutex> lock(hub->lock);
+		hub->closed = true;
+		hub->pipes.clear();
+		hub->events.clear();
+		waiting.swap(hub->waiting);
+		for (nngcAioState* a : waiting) a->pipeHub = nullptr;
+	}
+	for (nngcAioState* a : waiting) ::nng_aio_finish(a->aio, NNG_ECLOSED);
+}
+
+// after nng_fini, nng calls no hub anymore
+void nngcPipesFini()
+{
+	std::lock_guard<std::mutex> lock(hubsLock);
+	for (auto& h : hubs) delete h.second;
+	hubs.clear();
+	while (retiredHubs != nullptr) {
+		nngcPipeHub* next = retiredHubs->retired;
+		delete retiredHubs;
+		retiredHubs = next;
+	}
+}
+
+// the counters of the "pipe" scopes of the pipes asked for
+static void pipeStats(nng_stat* stat, nngc_pipe_info* pipes, int count)
+{
+	for (nng_stat* s = stat; s != nullptr; s = ::nng_stat_next(s)) {
+		if (::nng_stat_type(s) != NNG_STAT_SCOPE) continue;
+		nng_stat* child = ::nng_stat_child(s);
+		if (std::strcmp(::nng_stat_name(s), "pipe") != 0) {
+			pipeStats(child, pipes, count);
+			continue;
+		}
+		uint32_t id = nngcStatScopeId(s);
+		nngc_pipe_info* info = nullptr;
+		for (int i = 0; i < count && info == nullptr; i++) {
+			if (pipes[i].pipe == id) info = &pipes[i];
+		}
+		if (info == nullptr) continue;
+		for (nng_stat* c = child; c != nullptr; c = ::nng_stat_next(c)) {
+			const char* name = ::nng_stat_name(c);
+			if (std::strcmp(name, "tx_msgs") == 0) info->msgs_sent = ::nng_stat_value(c);
+			else if (std::strcmp(name, "tx_bytes") == 0) info->bytes_sent = ::nng_stat_value(c);
+			else if (std::strcmp(name, "rx_msgs") == 0) info->msgs_received = ::nng_stat_value(c);
+			else if (std::strcmp(name, "rx_bytes") == 0) info->bytes_received = ::nng_stat_value(c);
+		}
+	}
+}
+
+extern "C" {
+
+	int nngc_socket_pipes_watch(nngc_socket socket)
+	{
+		nngcPipeHub* hub;
+		int result = hubFor(socket, &hub);
+		if (result != 0) return result;
+		std::lock_guard<std::mutex> lock(hub->lock);
+		hub->watching = true;
+		return 0;
+	}
+
+	void nngc_pipe_event_recv(nngc_socket socket, nngc_aio aio)
+	{
+		nngcAioState* a = nngcAio(aio);
+		a->metrics = nullptr;
+		a->pipeEvent = nngc_pipe_event();
+		if (!::nng_aio_begin(a->aio)) return; // stopped, nng completes it
+		nngcPipeHub* hub = findHub(socket);
+		int result = 0;
+		if (hub == nullptr) {
+			result = NNG_ESTATE;
+		}
+		else {
+			std::lock_guard<std::mutex> lock(hub->lock);
+			if (!hub->watching) {
+				result = NNG_ESTATE;
+			}
+			else if (hub->closed) {
+				result = NNG_ECLOSED;
+			}
+			else if (!hub->events.empty()) {
+				a->pipeEvent = hub->events.front();
+				a->pipeEvent.dropped = hub->dropped;
+				hub->events.pop_front();
+				hub->dropped = 0;
+			}
+			else {
+				a->pipeHub = hub;
+				hub->waiting.push_back(a);
+				::nng_aio_defer(a->aio, cancelWait, hub);
+				return;
+			}
+		}
+		::nng_aio_finish(a->aio, result);
+	}
+
+	int nngc_aio_pipe_event(nngc_aio aio, nngc_pipe_event* event)
+	{
+		nngcAioState* a = nngcAio(aio);
+		*event = a->pipeEvent;
+		return ::nng_aio_result(a->aio);
+	}
+
+	int nngc_socket_pipes(nngc_socket socket, nngc_pipe_info* pipes, int capacity, int* count)
+	{
+		*count = 0;
+		nngcPipeHub* hub = findHub(socket);
+		if (hub == nullptr) return NNG_ESTATE;
+		int copied = 0;
+		{
+			std::lock_guard<std::mutex> lock(hub->lock);
+			if (!hub->watching) return NNG_ESTATE;
+			*count = static_cast<int>(hub->pipes.size());
+			for (const auto& p : hub->pipes) {
+				if (copied >= capacity) break;
+				nngc_pipe_info& info = pipes[copied++];
+				info = nngc_pipe_info();
+				info.pipe = p.first;
+				info.dialer = p.second.dialer;
+				info.listener = p.second.listener;
+				info.connected = p.second.connected;
+				p.second.address.copy(info.remote_address, sizeof(info.remote_address) - 1);
+			}
+		}
+		// one snapshot for all pipes, without statistics in nng the counters stay 0
+		nng_stat* stats;
+		if (copied > 0 && ::nng_stats_get(&stats) == 0) {
+			pipeStats(stats, pipes, copied);
+			::nng_stats_free(stats);
+		}
+		return (*count > copied) ? NNG_ENOSPC : 0;
+	}
+
+	int nngc_sendmsg_to(nngc_socket socket, nngc_msg msg, uint32_t pipe, int flags)
+	{
+		nng_socket s = nngcFromId<nng_socket>(socket);
+		int protocol;
+		bool polyamorous = false;
+		int result = ::nng_getopt_int(s, NNG_OPT_PROTO, &protocol);
+		if (result != 0) return result;
+		if (protocol != pair1Protocol || ::nng_getopt_bool(s, NNG_OPT_PAIR1_POLY, &polyamorous) != 0 || !polyamorous) {
+			return NNG_ENOTSUP;
+		}
+		nng_msg* m = nngcMsg(msg);
+		size_t bytes = ::nng_msg_len(m);
+		::nng_msg_set_pipe(m, nngcFromId<nng_pipe>(pipe));
+		result = ::nng_sendmsg(s, m, flags);
+		nngcMetrics* metrics = nngcMetricsFind(socket);
+		if (metrics != nullptr) nngcMetricsSent(metrics, result, (result == 0) ? 1 : 0, (result == 0) ? bytes : 0);
+		return result;
+	}
+
+	int nngc_pipe_close(uint32_t pipe)
+	{
+		return ::nng_pipe_close(nngcFromId<nng_pipe>(pipe));
+	}
+}
@@ -0,0 +1,400 @@
+/*
+Nng core
+
+Poller, readiness of many sockets on one thread. nng gives every socket a recv-fd and a send-fd,
+descriptors which are readable while a message can be received or sent. On Linux they go into an
+epoll set, elsewhere (Windows, where they are sockets) the poller keeps a pollfd array for WSAPoll
+or poll. Both are level triggered: a socket stays ready until it has been drained.
+
+poll and WSAPoll can't be interrupted by another thread, so there the wait is done in slices and
+nngc_poller_wake takes effect at the end of the current slice. Their scan starts where the last full
+one stopped, so with more ready sockets than room the later ones get their turn (epoll requeues a
+reported descriptor behind the others by itself).
+
+nng closes the descriptors with the socket and the number may come back for another one, so
+nngc_socket_close takes the socket out of all pollers first, a stale number never reaches epoll_ctl.
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#define NNGC_EPOLL
+#elif defined(_WIN32)
+#include <chrono>
+#include <errno.h>
+#include <thread>
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef WSAPOLLFD nngcPollFd;
+#define nngcPoll WSAPoll
+#else
+#include <chrono>
+#include <errno.h>
+#include <poll.h>
+#include <thread>
+typedef struct pollfd nngcPollFd;
+#define nngcPoll poll
+#endif
+
+#define POLLER(p) reinterpret_cast<nngcPoller*>(static_cast<uintptr_t>(p))
+
+namespace {
+
+	struct Registration {
+		uint32_t events; // NNGC_POLL_
+		int recvFd;
+		int sendFd;
+		uint64_t wait;   // epoll, the wait in which slot was set
+		int slot;        // epoll, entry of the socket in the events of that wait
+	};
+
+#if !defined(NNGC_EPOLL)
+	const int pollSlice = 50; // milliseconds
+#endif
+}
+
+struct nngcPoller {
+	std::mutex lock; // registrations, the wait itself doesn't hold it
+	std::unordered_map<uint32_t, Registration> sockets;
+#if defined(NNGC_EPOLL)
+	int epoll = -1;
+	int wake = -1; // eventfd
+	std::vector<epoll_event> ready;
+	uint64_t waits = 0;
+#else
+	std::atomic<bool> woken{ false };
+	std::atomic<bool> changed{ true };
+	std::vector<nngcPollFd> fds;  // rebuilt by the waiter when changed
+	std::vector<uint64_t> owners; // socket << 1 | 1 for a send-fd, parallel to fds
+	std::vector<size_t> first;    // index of the first descriptor of the socket, parallel to fds
+	std::vector<int> slots;       // entry in the events of the scan, -1 for none, at the first descriptor
+	size_t start = 0;             // where the next scan begins
+#endif
+};
+
+// pollers which nngc_socket_close has to look at
+static std::mutex pollersLock;
+static std::vector<nngcPoller*> pollers;
+
+// recv and send readiness of a socket arrive separately, one entry per socket is handed out. slot is
+// the entry of the socket in events, -1 while it has none. false if there was no room for a new one
+static bool report(nngc_poll_event* events, int* count, int max, uint32_t socket, uint32_t event, int& slot)
+{
+	if (slot >= 0) {
+		events[slot].events |= event;
+		return true;
+	}
+	if (*count == max) return false;
+	slot = *count;
+	events[slot].socket = socket;
+	events[slot].events = event;
+	(*count)++;
+	return true;
+}
+
+#if defined(NNGC_EPOLL)
+
+static int osError()
+{
+	switch (errno) {
+	case ENOMEM: return NNG_ENOMEM;
+	case EEXIST: return NNG_EBUSY;
+	case ENOENT: return NNG_ENOENT;
+	case EBADF: return NNG_ECLOSED;
+	default: return NNG_EINVAL;
+	}
+}
+
+static int watch(nngcPoller* p, int op, int fd, uint64_t owner)
+{
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.u64 = owner;
+	return (::epoll_ctl(p->epoll, op, fd, &ev) == 0) ? 0 : osError();
+}
+
+// only for descriptors of sockets which are still open
+static void unwatch(nngcPoller* p, int fd)
+{
+	epoll_event ev = {};
+	::epoll_ctl(p->epoll, EPOLL_CTL_DEL, fd, &ev);
+}
+
+#else
+
+// poll fails for good only when it wasn't interrupted by a signal
+static inline bool interrupted()
+{
+#if defined(_WIN32)
+	return ::WSAGetLastError() == WSAEINTR;
+#else
+	return errno == EINTR;
+#endif
+}
+
+// the waiter's copy of the registrations. The descriptors of a socket are next to each other
+static void rebuild(nngcPoller* p)
+{
+	std::lock_guard<std::mutex> lock(p->lock);
+	p->changed = false;
+	p->fds.clear();
+	p->owners.clear();
+	p->first.clear();
+	for (const auto& s : p->sockets) {
+		uint64_t owner = static_cast<uint64_t>(s.first) << 1;
+		size_t first = p->fds.size();
+		nngcPollFd fd = {};
+		fd.events = POLLIN;
+		if (s.second.recvFd >= 0) {
+			fd.fd = s.second.recvFd; // a SOCKET on Windows, nng hands it out as an int
+			p->fds.push_back(fd);
+			p->owners.push_back(owner);
+			p->first.push_back(first);
+		}
+		if (s.second.sendFd >= 0) {
+			fd.fd = s.second.sendFd;
+			p->fds.push_back(fd);
+			p->owners.push_back(owner | 1);
+			p->first.push_back(first);
+		}
+	}
+	p->slots.resize(p->fds.size());
+	if (p->start >= p->fds.size()) p->start = 0;
+}
+
+#endif
+
+// takes the socket out of the poller, false if it wasn't in it
+static bool forget(nngcPoller* p, uint32_t socket)
+{
+	std::lock_guard<std::mutex> lock(p->lock);
+	auto found = p->sockets.find(socket);
+	if (found == p->sockets.end()) return false;
+#if defined(NNGC_EPOLL)
+	if (found->second.recvFd >= 0) unwatch(p, found->second.recvFd);
+	if (found->second.sendFd >= 0) unwatch(p, found->second.sendFd);
+#else
+	p->changed = true;
+#endif
+	p->sockets.erase(found);
+	return true;
+}
+
+// before nng closes the socket and its descriptors
+void nngcPollerClose(uint32_t socket)
+{
+	std::lock_guard<std::mutex> lock(pollersLock);
+	for (nngcPoller* p : pollers) forget(p, socket);
+}
+
+void nngcPollerCloseAll()
+{
+	std::lock_guard<std::mutex> lock(pollersLock);
+	for (nngcPoller* p : pollers) {
+		std::lock_guard<std::mutex> registrations(p->lock);
+#if defined(NNGC_EPOLL)
+		for (const auto& s : p->sockets) {
+			if (s.second.recvFd >= 0) unwatch(p, s.second.recvFd);
+			if (s.second.sendFd >= 0) unwatch(p, s.second.sendFd);
+		}
+#else
+		p->changed = true;
+#endif
+		p->sockets.clear();
+	}
+}
+
+extern "C" {
+
+	int nngc_poller_create(nngc_poller* poller)
+	{
+		*poller = 0;
+		auto p = new (std::nothrow) nngcPoller();
+		if (p == nullptr) return NNG_ENOMEM;
+#if defined(NNGC_EPOLL)
+		p->epoll = ::epoll_create1(EPOLL_CLOEXEC);
+		p->wake = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		int result = (p->epoll < 0 || p->wake < 0) ? osError() : 0;
+		if (result == 0) result = watch(p, EPOLL_CTL_ADD, p->wake, UINT64_MAX);
+		if (result != 0) {
+			if (p->epoll >= 0) ::close(p->epoll);
+			if (p->wake >= 0) ::close(p->wake);
+			delete p;
+			return result;
+		}
+#endif
+		{
+			std::lock_guard<std::mutex> lock(pollersLock);
+			pollers.push_back(p);
+		}
+		*poller = static_cast<nngc_poller>(reinterpret_cast<uintptr_t>(p));
+		return 0;
+	}
+
+	void nngc_poller_destroy(nngc_poller poller)
+	{
+		if (poller == 0) return;
+		nngcPoller* p = POLLER(poller);
+		{
+			std::lock_guard<std::mutex> lock(pollersLock);
+			for (size_t i = 0; i < pollers.size(); i++) {
+				if (pollers[i] == p) {
+					pollers[i] = pollers.back();
+					pollers.pop_back();
+					break;
+				}
+			}
+		}
+#if defined(NNGC_EPOLL)
+		::close(p->epoll);
+		::close(p->wake);
+#endif
+		delete p;
+	}
+
+	int nngc_poller_add(nngc_poller poller, nngc_socket socket, uint32_t events)
+	{
+		nngcPoller* p = POLLER(poller);
+		if ((events & ~(NNGC_POLL_RECV | NNGC_POLL_SEND)) != 0 || events == 0) return NNG_EINVAL;
+		nng_socket s = nngcFromId<nng_socket>(socket);
+		Registration r = { events, -1, -1, 0, -1 };
+		int result;
+		// protocols which can't receive (push, pub) or can't send (pull, sub) don't have the descriptor
+		if ((events & NNGC_POLL_RECV) && (result = ::nng_getopt_int(s, NNG_OPT_RECVFD, &r.recvFd)) != 0) return result;
+		if ((events & NNGC_POLL_SEND) && (result = ::nng_getopt_int(s, NNG_OPT_SENDFD, &r.sendFd)) != 0) return result;
+
+		std::lock_guard<std::mutex> lock(p->lock);
+		auto found = p->sockets.find(socket);
+		Registration old = (found != p->sockets.end()) ? found->second : Registration{ 0, -1, -1, 0, -1 };
+#if defined(NNGC_EPOLL)
+		uint64_t owner = static_cast<uint64_t>(socket) << 1;
+		if (r.recvFd >= 0 && old.recvFd < 0 && (result = watch(p, EPOLL_CTL_ADD, r.recvFd, owner)) != 0) return result;
+		if (r.sendFd >= 0 && old.sendFd < 0 && (result = watch(p, EPOLL_CTL_ADD, r.sendFd, owner | 1)) != 0) {
+			if (old.recvFd < 0 && r.recvFd >= 0) unwatch(p, r.recvFd);
+			return result;
+		}
+		if (old.recvFd >= 0 && r.recvFd < 0) unwatch(p, old.recvFd);
+		if (old.sendFd >= 0 && r.sendFd < 0) unwatch(p, old.sendFd);
+#else
+		(void)old;
+		p->changed = true;
+#endif
+		p->sockets[socket] = r;
+		return 0;
+	}
+
+	int nngc_poller_remove(nngc_poller poller, nngc_socket socket)
+	{
+		return forget(POLLER(poller), socket) ? 0 : NNG_ENOENT;
+	}
+
+	int nngc_poller_count(nngc_poller poller)
+	{
+		nngcPoller* p = POLLER(poller);
+		std::lock_guard<std::mutex> lock(p->lock);
+		return static_cast<int>(p->sockets.size());
+	}
+
+	void nngc_poller_wake(nngc_poller poller)
+	{
+		nngcPoller* p = POLLER(poller);
+#if defined(NNGC_EPOLL)
+		uint64_t one = 1;
+		ssize_t written = ::write(p->wake, &one, sizeof(one));
+		(void)written; // a full counter is just as awake
+#else
+		p->woken = true;
+#endif
+	}
+
+#if defined(NNGC_EPOLL)
+
+	int nngc_poller_wait(nngc_poller poller, nngc_poll_event* events, int max, int32_t timeout, int* count)
+	{
+		nngcPoller* p = POLLER(poller);
+		*count = 0;
+		if (max <= 0) return NNG_EINVAL;
+		// a socket can report both descriptors, so room for twice as many plus the wake descriptor
+		size_t room = static_cast<size_t>(max) * 2 + 1;
+		if (p->ready.size() < room) p->ready.resize(room);
+		int n = ::epoll_wait(p->epoll, p->ready.data(), static_cast<int>(room), (timeout < 0) ? -1 : timeout);
+		if (n < 0) return (errno == EINTR) ? 0 : osError();
+
+		std::lock_guard<std::mutex> lock(p->lock); // the registration of a socket holds its entry
+		p->waits++;
+		for (int i = 0; i < n; i++) {
+			uint64_t owner = p->ready[i].data.u64;
+			if (owner == UINT64_MAX) {
+				uint64_t value;
+				ssize_t drained = ::read(p->wake, &value, sizeof(value));
+				(void)drained;
+				continue;
+			}
+			auto found = p->sockets.find(static_cast<uint32_t>(owner >> 1));
+			if (found == p->sockets.end()) continue; // removed while we waited
+			Registration& r = found->second;
+			if (r.wait != p->waits) {
+				r.wait = p->waits;
+				r.slot = -1;
+			}
+			// without room it is left ready, the next wait reports it
+			report(events, count, max, found->first, (owner & 1) ? NNGC_POLL_SEND : NNGC_POLL_RECV, r.slot);
+		}
+		return 0;
+	}
+
+#else
+
+	int nngc_poller_wait(nngc_poller poller, nngc_poll_event* events, int max, int32_t timeout, int* count)
+	{
+		nngcPoller* p = POLLER(poller);
+		*count = 0;
+		if (max <= 0) return NNG_EINVAL;
+
+		int32_t waited = 0;
+		for (;;) {
+			if (p->woken.exchange(false)) return 0;
+			if (p->changed) rebuild(p);
+			int32_t slice = (timeout >= 0 && timeout - waited < pollSlice) ? timeout - waited : pollSlice;
+			int n = 0;
+			if (p->fds.empty()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(slice)); // nothing to wait on
+			}
+			else {
+				n = nngcPoll(p->fds.data(), static_cast<unsigned long>(p->fds.size()), slice);
+				if (n < 0 && !interrupted()) return NNG_EINVAL;
+			}
+			// a socket removed meanwhile may have been closed, its descriptor is another one's now
+			if (n > 0 && !p->changed) {
+				size_t size = p->fds.size();
+				std::fill(p->slots.begin(), p->slots.end(), -1);
+				for (size_t k = 0; k < size; k++) {
+					size_t i = (p->start + k) % size;
+					if ((p->fds[i].revents & (POLLIN | POLLERR | POLLHUP)) == 0) continue;
+					if (!report(events, count, max, static_cast<uint32_t>(p->owners[i] >> 1),
+						(p->owners[i] & 1) ? NNGC_POLL_SEND : NNGC_POLL_RECV, p->slots[p->first[i]])) {
+						p->start = i; // the first one without room is the first of the next scan
+						break;
+					}
+				}
+				if (*count > 0) return 0;
+			}
+			waited += slice;
+			if (timeout >= 0 && waited >= timeout) return 0;
+		}
+	}
+
+#endif
+}
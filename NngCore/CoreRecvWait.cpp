@@ -0,0 +1,247 @@
+/*
+Nng core
+
+Receive wait policies. A blocking receive on a socket with a policy first tries nonblocking receives:
+spins of them with a cpu pause between, then yields of them after giving up the time slice, and
+only then parks in nng's blocking receive. A consumer on its own core picks up a message within
+a spin instead of waiting for nng's condition variable to wake it.
+
+The adaptive policy keeps an average of the time between messages and of how long spinning and
+yielding take when they find nothing. While the next message isn't expected before that is over,
+the receive blocks right away, so a quiet socket doesn't burn its core.
+
+The sockets are found like the ones of CoreMetrics.cpp: a hash table of chains, entries are only
+added and unlinked under a lock and never freed before nngc_fini.
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define cpuRelax() _mm_pause()
+#elif defined(__aarch64__)
+#define cpuRelax() __asm__ __volatile__("yield")
+#else
+#define cpuRelax() std::this_thread::yield()
+#endif
+
+#define SOCKET(s) nngcFromId<nng_socket>(s)
+
+static const unsigned tableSize = 256;
+static const int averageShift = 3; // the averages move by 1/8 of the difference to each new sample
+
+struct alignas(64) nngcRecvWait {
+	// the policy
+	std::atomic<uint32_t> spins;
+	std::atomic<uint32_t> yields;
+	std::atomic<bool> adaptive;
+	// the counters of nngc_recv_wait_stats
+	std::atomic<uint64_t> spinHits;
+	std::atomic<uint64_t> yieldHits;
+	std::atomic<uint64_t> blocks;
+	std::atomic<uint64_t> skips;
+	std::atomic<uint64_t> spinCount;
+	std::atomic<uint64_t> yieldCount;
+	// adaptation, nanoseconds. Several threads may update them at once, losing a sample then is harmless
+	std::atomic<uint64_t> lastArrival;
+	std::atomic<uint64_t> gap;
+	std::atomic<uint64_t> phase;
+
+	uint32_t socket;
+	std::atomic<nngcRecvWait*> next; // chain of the hash table
+	nngcRecvWait* retired;           // list of closed sockets, freed by nngc_fini
+};
+
+static std::atomic<nngcRecvWait*> table[tableSize];
+static std::atomic<int> waiting(0); // sockets in the table, the lookup is skipped while there are none
+static std::mutex tableLock;        // adding and unlinking only
+static nngcRecvWait* retiredList = nullptr;
+
+static inline uint64_t now()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static inline void add(std::atomic<uint64_t>& counter, uint64_t value)
+{
+	if (value != 0) counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+static inline void average(std::atomic<uint64_t>& value, uint64_t sample)
+{
+	uint64_t v = value.load(std::memory_order_relaxed);
+	if (v == 0) v = sample;
+	else if (sample > v) v += (sample - v) >> averageShift;
+	else v -= (v - sample) >> averageShift;
+	value.store(v, std::memory_order_relaxed);
+}
+
+// a message was received at time t
+static void arrived(nngcRecvWait* w, uint64_t t)
+{
+	uint64_t last = w->lastArrival.exchange(t, std::memory_order_relaxed);
+	if (last != 0 && t > last) average(w->gap, t - last);
+}
+
+// whether the next message is expected before spinning and yielding would be over
+static bool worthWaiting(nngcRecvWait* w, uint64_t t)
+{
+	uint64_t gap = w->gap.load(std::memory_order_relaxed);
+	uint64_t phase = w->phase.load(std::memory_order_relaxed);
+	if (gap == 0 || phase == 0) return true; // nothing measured yet
+	uint64_t since = t - w->lastArrival.load(std::memory_order_relaxed);
+	return since >= gap || gap - since <= phase;
+}
+
+static void setPolicy(nngcRecvWait* w, const nngc_recv_wait* policy)
+{
+	w->spins.store(policy->spins, std::memory_order_relaxed);
+	w->yields.store(policy->yields, std::memory_order_relaxed);
+	w->adaptive.store(policy->adaptive != 0, std::memory_order_relaxed);
+	w->phase.store(0, std::memory_order_relaxed); // measured again with the new counts
+}
+
+nngcRecvWait* nngcRecvWaitFind(uint32_t socket)
+{
+	if (waiting.load(std::memory_order_relaxed) == 0) return nullptr;
+	nngcRecvWait* w = table[socket % tableSize].load(std::memory_order_acquire);
+	while (w != nullptr && w->socket != socket) w = w->next.load(std::memory_order_acquire);
+	return w;
+}
+
+int nngcRecvWaitReceive(nngcRecvWait* w, nngcRecvAttempt attempt, void* arg, int flags)
+{
+	// with one core the sender can't run while we spin
+	static const bool multiCore = std::thread::hardware_concurrency() > 1;
+	uint32_t spins = multiCore ? w->spins.load(std::memory_order_relaxed) : 0;
+	uint32_t yields = w->yields.load(std::memory_order_relaxed);
+	uint64_t start = now();
+	int result;
+	if ((spins | yields) != 0 && w->adaptive.load(std::memory_order_relaxed) && !worthWaiting(w, start)) {
+		add(w->skips, 1);
+		spins = yields = 0;
+	}
+
+	for (uint32_t i = 0; i < spins; i++) {
+		if ((result = attempt(arg, flags | NNG_FLAG_NONBLOCK)) != NNG_EAGAIN) {
+			add(w->spinCount, i);
+			if (result == 0) {
+				add(w->spinHits, 1);
+				arrived(w, now());
+			}
+			return result;
+		}
+		cpuRelax();
+	}
+	add(w->spinCount, spins);
+	for (uint32_t i = 0; i < yields; i++) {
+		std::this_thread::yield();
+		if ((result = attempt(arg, flags | NNG_FLAG_NONBLOCK)) != NNG_EAGAIN) {
+			add(w->yieldCount, i + 1);
+			if (result == 0) {
+				add(w->yieldHits, 1);
+				arrived(w, now());
+			}
+			return result;
+		}
+	}
+	add(w->yieldCount, yields);
+	if ((spins | yields) != 0) average(w->phase, now() - start);
+
+	add(w->blocks, 1);
+	result = attempt(arg, flags);
+	if (result == 0) arrived(w, now());
+	return result;
+}
+
+// nng may hand out the id again, so the socket leaves the table
+void nngcRecvWaitClose(uint32_t socket)
+{
+	if (waiting.load(std::memory_order_relaxed) == 0) return;
+	std::lock_guard<std::mutex> lock(tableLock);
+	std::atomic<nngcRecvWait*>* link = &table[socket % tableSize];
+	nngcRecvWait* w;
+	while ((w = link->load(std::memory_order_relaxed)) != nullptr && w->socket != socket) link = &w->next;
+	if (w == nullptr) return;
+	link->store(w->next.load(std::memory_order_relaxed), std::memory_order_release);
+	w->retired = retiredList;
+	retiredList = w;
+	waiting.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// after nng_fini, no thread receives anymore
+void nngcRecvWaitFini()
+{
+	std::lock_guard<std::mutex> lock(tableLock);
+	for (unsigned i = 0; i < tableSize; i++) {
+		nngcRecvWait* w = table[i].exchange(nullptr, std::memory_order_relaxed);
+		while (w != nullptr) {
+			nngcRecvWait* next = w->next.load(std::memory_order_relaxed);
+			delete w;
+			w = next;
+		}
+	}
+	while (retiredList != nullptr) {
+		nngcRecvWait* next = retiredList->retired;
+		delete retiredList;
+		retiredList = next;
+	}
+	waiting.store(0, std::memory_order_relaxed);
+}
+
+extern "C" {
+
+	int nngc_socket_recv_wait_set(nngc_socket socket, const nngc_recv_wait* policy)
+	{
+		if (policy == nullptr) {
+			nngcRecvWaitClose(socket);
+			return 0;
+		}
+		std::lock_guard<std::mutex> lock(tableLock);
+		std::atomic<nngcRecvWait*>& head = table[socket % tableSize];
+		nngcRecvWait* w = head.load(std::memory_order_relaxed);
+		while (w != nullptr && w->socket != socket) w = w->next.load(std::memory_order_relaxed);
+		if (w != nullptr) {
+			setPolicy(w, policy);
+			return 0;
+		}
+
+		// this also tells us whether the socket exists
+		nng_duration timeout;
+		int result = ::nng_getopt_ms(SOCKET(socket), NNG_OPT_RECVTIMEO, &timeout);
+		if (result != 0) return result;
+		w = new (std::nothrow) nngcRecvWait();
+		if (w == nullptr) return NNG_ENOMEM;
+		setPolicy(w, policy);
+		w->socket = socket;
+		w->retired = nullptr;
+		w->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		head.store(w, std::memory_order_release);
+		waiting.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	int nngc_socket_recv_wait_stats(nngc_socket socket, nngc_recv_wait_stats* stats)
+	{
+		*stats = nngc_recv_wait_stats();
+		nngcRecvWait* w = nngcRecvWaitFind(socket);
+		if (w == nullptr) return NNG_ENOENT;
+		stats->spin_hits = w->spinHits.load(std::memory_order_relaxed);
+		stats->yield_hits = w->yieldHits.load(std::memory_order_relaxed);
+		stats->blocks = w->blocks.load(std::memory_order_relaxed);
+		stats->skips = w->skips.load(std::memory_order_relaxed);
+		stats->spins = w->spinCount.load(std::memory_order_relaxed);
+		stats->yields = w->yieldCount.load(std::memory_order_relaxed);
+		stats->gap_ns = w->gap.load(std::memory_order_relaxed);
+		stats->phase_ns = w->phase.load(std::memory_order_relaxed);
+		return 0;
+	}
+}
@@ -0,0 +1,704 @@
+/*
+Nng core
+
+Shared memory channels between two processes on one host. The listener creates a segment named after
+the URL, the dialer maps the same one. It holds a header and two rings, one per direction, each with a
+single producer and a single consumer. A message is a record in the ring, its length (8 bytes with
+padding) and the body, padded to 8 bytes. The sender writes the body once, right into the ring, and the
+receiver reads it in place; the kernel is only involved when one side has to wait.
+
+head and tail of a ring count the bytes ever written and read, so the used part is head - tail. A
+record is never split: if it doesn't fit before the end of the ring, a wrap marker fills the rest and
+the record starts over at offset 0, which is why a message may take half a ring at most.
+
+A side that finds nothing to do spins for a few microseconds before it sleeps on a futex (Linux),
+a named event (Windows) or in short naps (elsewhere). The sleeper sets its waiting flag before it
+looks once more, the other side looks at the flag after it has published, with a full fence on both
+sides, so a wakeup is only a system call when somebody actually sleeps.
+
+An nngc_shm is an id into a table of slots, the slot index and a generation, like nng's socket ids.
+Every call takes a reference on the slot for its duration and close drops the one of the handle, so
+the channel is unmapped by whoever leaves last, and a handle used after close finds its generation
+gone and returns NNG_ECLOSED instead of touching freed memory.
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define NNGC_FUTEX
+#define NNGC_POSIX_SHM
+#elif defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NNGC_POSIX_SHM
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define cpuRelax() _mm_pause()
+#elif defined(__aarch64__)
+#define cpuRelax() __asm__ __volatile__("yield")
+#else
+#define cpuRelax() std::this_thread::yield()
+#endif
+
+
+namespace {
+
+	const uint32_t shmMagic = 0x4e47534d; // "NGSM"
+	const uint32_t shmVersion = 1;
+	const uint32_t wrapMarker = 0xFFFFFFFF;
+	const uint64_t recordHeader = 8;
+	const uint64_t headerSize = 4096;
+	const uint64_t defaultCapacity = 1 << 20;
+	const uint64_t minCapacity = 4096;
+	const uint64_t maxCapacity = 1 << 30;
+	const auto spinTime = std::chrono::microseconds(20);
+	const size_t maxName = 200;
+	const uint32_t slotCount = 1024; // channels open at once in a process
+
+	// the word one side sleeps on, bumped by the other one to wake it
+	struct alignas(64) ShmWaiter {
+		std::atomic<uint32_t> sequence;
+		std::atomic<uint32_t> waiting;
+	};
+
+	struct ShmRing {
+		alignas(64) std::atomic<uint64_t> head; // bytes written, only the producer changes it
+		alignas(64) std::atomic<uint64_t> tail; // bytes read, only the consumer changes it
+		ShmWaiter data;  // the consumer waits for data
+		ShmWaiter space; // the producer waits for space
+	};
+
+	// at the start of the segment, the rings follow at headerSize
+	struct ShmHeader {
+		std::atomic<uint32_t> magic; // set last by the listener
+		uint32_t version;
+		uint64_t capacity;           // bytes per ring, a power of 2
+		std::atomic<uint32_t> dialed;
+		std::atomic<uint32_t> closed[2]; // by side
+		ShmRing rings[2];                // rings[0] from the listener to the dialer, rings[1] back
+	};
+
+	static_assert(sizeof(ShmHeader) <= headerSize, "the rings start after the header");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "atomics in shared memory must be lock free");
+
+	enum ShmSide : int {
+		sideListener = 0,
+		sideDialer = 1
+	};
+}
+
+struct nngcShm {
+	ShmHeader* header;
+	size_t size;
+	int side;
+	ShmRing* out;
+	ShmRing* in;
+	unsigned char* outData;
+	unsigned char* inData;
+	uint64_t capacity;
+	std::atomic<bool> closing{ false };
+	// producer side, one sending thread at a time
+	uint64_t outTail = 0;  // last tail seen, refreshed when the ring looks full
+	uint64_t sendHead = 0; // where the reserved record starts
+	size_t reserved = 0;
+	bool sending = false;
+	// consumer side, one receiving thread at a time
+	uint64_t inHead = 0;   // last head seen, refreshed when the ring looks empty
+	uint64_t recvTail = 0; // where the record being read starts
+	size_t recvSize = 0;
+	bool receiving = false;
+	std::string name;
+#if defined(NNGC_POSIX_SHM)
+	bool owner = false; // the listener removes the name
+#elif defined(_WIN32)
+	HANDLE mapping = nullptr;
+	HANDLE events[4] = {}; // by ring * 2 + (space ? 1 : 0)
+#endif
+};
+
+static inline uint64_t recordSize(uint64_t size)
+{
+	return recordHeader + ((size + 7) & ~uint64_t(7));
+}
+
+static inline int waiterIndex(nngcShm* shm, ShmWaiter& w)
+{
+	const ShmHeader* h = shm->header;
+	for (int r = 0; r < 2; r++) {
+		if (&w == &h->rings[r].data) return r * 2;
+		if (&w == &h->rings[r].space) return r * 2 + 1;
+	}
+	return 0;
+}
+
+static int systemError(int e)
+{
+	return NNG_ESYSERR + e;
+}
+
+// Sleeping and waking
+
+static void sleepOn(nngcShm* shm, ShmWaiter& w, uint32_t seen, int32_t milliseconds)
+{
+#if defined(NNGC_FUTEX)
+	(void)shm;
+	timespec t;
+	t.tv_sec = milliseconds / 1000;
+	t.tv_nsec = (milliseconds % 1000) * 1000000L;
+	// not FUTEX_PRIVATE_FLAG, the word is shared with the other process
+	::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&w.sequence), FUTEX_WAIT, seen, (milliseconds < 0) ? nullptr : &t, nullptr, 0);
+#elif defined(_WIN32)
+	(void)seen;
+	::WaitForSingleObject(shm->events[waiterIndex(shm, w)], (milliseconds < 0) ? INFINITE : static_cast<DWORD>(milliseconds));
+#else
+	(void)shm;
+	(void)milliseconds;
+	if (w.sequence.load(std::memory_order_acquire) == seen) std::this_thread::sleep_for(std::chrono::microseconds(100));
+#endif
+}
+
+static void wakeUp(nngcShm* shm, ShmWaiter& w)
+{
+	w.sequence.fetch_add(1, std::memory_order_release);
+#if defined(NNGC_FUTEX)
+	(void)shm;
+	::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&w.sequence), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+	::SetEvent(shm->events[waiterIndex(shm, w)]);
+#else
+	(void)shm;
+#endif
+}
+
+// after publishing, wakes the other side if it sleeps
+static inline void notify(nngcShm* shm, ShmWaiter& w)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (w.waiting.load(std::memory_order_relaxed) != 0) wakeUp(shm, w);
+}
+
+// waits until ready() holds, it also has to hold once either side is closed. timeout in milliseconds, -1 forever
+template <typename Ready>
+static int await(nngcShm* shm, ShmWaiter& w, int32_t timeout, Ready ready)
+{
+	if (ready()) return 0;
+	if (timeout == 0) return NNG_EAGAIN;
+	static const bool spin = std::thread::hardware_concurrency() > 1; // with one core the peer can't run while we spin
+	auto start = std::chrono::steady_clock::now();
+	// a peer on another core usually answers within microseconds, sleeping and waking take longer
+	while (spin && std::chrono::steady_clock::now() - start < spinTime) {
+		for (int i = 0; i < 64; i++) {
+			if (ready()) return 0;
+			cpuRelax();
+		}
+	}
+	for (;;) {
+		uint32_t seen = w.sequence.load(std::memory_order_acquire);
+		w.waiting.store(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (ready()) {
+			w.waiting.store(0, std::memory_order_relaxed);
+			return 0;
+		}
+		int32_t left = -1;
+		if (timeout > 0) {
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			if (elapsed >= timeout) {
+				w.waiting.store(0, std::memory_order_relaxed);
+				return NNG_ETIMEDOUT;
+			}
+			left = timeout - static_cast<int32_t>(elapsed);
+		}
+		sleepOn(shm, w, seen, left);
+		w.waiting.store(0, std::memory_order_relaxed);
+	}
+}
+
+static inline bool peerClosed(nngcShm* shm)
+{
+	return shm->header->closed[1 - shm->side].load(std::memory_order_acquire) != 0;
+}
+
+// Handles
+
+/*
+state of a slot: the generation in the upper 32 bits, open while the handle is valid, and the
+references, one of the handle while it is open and one per call in progress. Once it is closed and
+the references are gone, the one who dropped the last unmaps the channel and frees the slot.
+*/
+namespace {
+
+	const uint64_t slotOpen = uint64_t(1) << 31;
+	const uint64_t slotRefs = slotOpen - 1;
+
+	struct ShmSlot {
+		std::atomic<uint64_t> state{ 0 };
+		std::atomic<nngcShm*> shm{ nullptr };
+	};
+}
+
+static ShmSlot slots[slotCount];
+static std::mutex slotLock; // taking and freeing slots only
+
+static void destroy(nngcShm* shm);
+
+// NNG_ENOFILES if all slots are taken
+static int shmHandle(nngcShm* shm, nngc_shm* handle)
+{
+	std::lock_guard<std::mutex> lock(slotLock);
+	for (uint32_t i = 0; i < slotCount; i++) {
+		ShmSlot& slot = slots[i];
+		if (slot.shm.load(std::memory_order_acquire) != nullptr) continue;
+		uint64_t generation = (slot.state.load(std::memory_order_relaxed) >> 32) + 1;
+		slot.shm.store(shm, std::memory_order_relaxed);
+		slot.state.store((generation << 32) | slotOpen | 1, std::memory_order_release);
+		*handle = (generation << 32) | (i + 1);
+		return 0;
+	}
+	return NNG_ENOFILES;
+}
+
+static inline ShmSlot* slotOf(nngc_shm handle)
+{
+	uint32_t index = static_cast<uint32_t>(handle);
+	return (index == 0 || index > slotCount) ? nullptr : &slots[index - 1];
+}
+
+static void release(ShmSlot* slot)
+{
+	uint64_t state = slot->state.fetch_sub(1, std::memory_order_acq_rel) - 1;
+	if ((state & (slotOpen | slotRefs)) != 0) return;
+	nngcShm* shm = slot->shm.load(std::memory_order_relaxed);
+	destroy(shm);
+	std::lock_guard<std::mutex> lock(slotLock);
+	slot->shm.store(nullptr, std::memory_order_release);
+}
+
+// holds a reference for a call, shm is nullptr if the handle is closed or wasn't one
+struct ShmCall {
+	ShmSlot* slot;
+	nngcShm* shm = nullptr;
+
+	explicit ShmCall(nngc_shm handle) : slot(slotOf(handle))
+	{
+		if (slot == nullptr) return;
+		uint64_t state = slot->state.load(std::memory_order_acquire);
+		do {
+			if ((state >> 32) != (handle >> 32) || (state & slotOpen) == 0) {
+				slot = nullptr;
+				return;
+			}
+		} while (!slot->state.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel));
+		shm = slot->shm.load(std::memory_order_acquire);
+	}
+
+	~ShmCall()
+	{
+		if (slot != nullptr) release(slot);
+	}
+
+	// seq_cst like the store in nngc_shm_close, a call that misses it is woken by the wakeUp which follows
+	bool closing() const { return shm->closing.load(std::memory_order_seq_cst); }
+};
+
+// Segments
+
+static int parseName(const char* url, size_t urlLength, std::string* name)
+{
+	static const char scheme[] = "shm://";
+	const size_t schemeLength = sizeof(scheme) - 1;
+	if (url == nullptr || urlLength <= schemeLength || std::string(url, schemeLength) != scheme) return NNG_EADDRINVAL;
+	*name = std::string(url + schemeLength, urlLength - schemeLength);
+	if (name->size() > maxName) return NNG_EADDRINVAL;
+	for (char c : *name) {
+		if (c == '/' || c == '\\' || c == '\0') return NNG_EADDRINVAL;
+	}
+	return 0;
+}
+
+static void attach(nngcShm* shm, void* base, int side)
+{
+	shm->header = static_cast<ShmHeader*>(base);
+	shm->side = side;
+	shm->capacity = shm->header->capacity;
+	shm->out = &shm->header->rings[side];
+	shm->in = &shm->header->rings[1 - side];
+	unsigned char* rings = static_cast<unsigned char*>(base) + headerSize;
+	shm->outData = rings + shm->capacity * side;
+	shm->inData = rings + shm->capacity * (1 - side);
+}
+
+#if defined(NNGC_POSIX_SHM)
+// once, by close or by a listener that failed to start
+static void removeName(nngcShm* shm)
+{
+	::shm_unlink(shm->name.c_str());
+	shm->owner = false;
+}
+#endif
+
+static void unmap(nngcShm* shm)
+{
+#if defined(NNGC_POSIX_SHM)
+	if (shm->header != nullptr) ::munmap(shm->header, shm->size);
+	if (shm->owner) removeName(shm);
+#elif defined(_WIN32)
+	if (shm->header != nullptr) ::UnmapViewOfFile(shm->header);
+	if (shm->mapping != nullptr) ::CloseHandle(shm->mapping);
+	for (HANDLE e : shm->events) {
+		if (e != nullptr) ::CloseHandle(e);
+	}
+#endif
+	shm->header = nullptr;
+}
+
+static void destroy(nngcShm* shm)
+{
+	unmap(shm);
+	delete shm;
+}
+
+#if defined(_WIN32)
+static int openEvents(nngcShm* shm, bool create)
+{
+	for (int i = 0; i < 4; i++) {
+		std::string name = shm->name + "-" + std::to_string(i);
+		shm->events[i] = create ? ::CreateEventA(nullptr, FALSE, FALSE, name.c_str()) : ::OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, name.c_str());
+		if (shm->events[i] == nullptr) return systemError(static_cast<int>(::GetLastError()));
+	}
+	return 0;
+}
+#endif
+
+static int createSegment(nngcShm* shm, uint64_t capacity)
+{
+	shm->size = static_cast<size_t>(headerSize + 2 * capacity);
+	void* base;
+#if defined(NNGC_POSIX_SHM)
+	shm->name = "/nngc-" + shm->name;
+	int fd = ::shm_open(shm->name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) return (errno == EEXIST) ? NNG_EADDRINUSE : systemError(errno);
+	shm->owner = true;
+	if (::ftruncate(fd, static_cast<off_t>(shm->size)) != 0) {
+		int e = errno;
+		::close(fd);
+		return systemError(e);
+	}
+	base = ::mmap(nullptr, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (base == MAP_FAILED) return systemError(errno);
+#elif defined(_WIN32)
+	shm->name = "Local\\nngc-" + shm->name;
+	uint64_t size = shm->size;
+	shm->mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), shm->name.c_str());
+	if (shm->mapping == nullptr) return systemError(static_cast<int>(::GetLastError()));
+	if (::GetLastError() == ERROR_ALREADY_EXISTS) return NNG_EADDRINUSE;
+	int result = openEvents(shm, true);
+	if (result != 0) return result;
+	base = ::MapViewOfFile(shm->mapping, FILE_MAP_ALL_ACCESS, 0, 0, shm->size);
+	if (base == nullptr) return systemError(static_cast<int>(::GetLastError()));
+#endif
+	// the new segment is zeroed, which is the initial state of every counter and flag
+	auto header = new (base) ShmHeader();
+	header->version = shmVersion;
+	header->capacity = capacity;
+	attach(shm, base, sideListener);
+	header->magic.store(shmMagic, std::memory_order_release);
+	return 0;
+}
+
+static int openSegment(nngcShm* shm)
+{
+	void* base;
+#if defined(NNGC_POSIX_SHM)
+	shm->name = "/nngc-" + shm->name;
+	int fd = ::shm_open(shm->name.c_str(), O_RDWR, 0);
+	if (fd < 0) return (errno == ENOENT) ? NNG_ECONNREFUSED : systemError(errno);
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < headerSize + 2 * minCapacity) {
+		::close(fd);
+		return NNG_ECONNREFUSED; // still being created
+	}
+	shm->size = static_cast<size_t>(st.st_size);
+	base = ::mmap(nullptr, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (base == MAP_FAILED) return systemError(errno);
+#elif defined(_WIN32)
+	shm->name = "Local\\nngc-" + shm->name;
+	shm->mapping = ::OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, shm->name.c_str());
+	if (shm->mapping == nullptr) return NNG_ECONNREFUSED;
+	int result = openEvents(shm, false);
+	if (result != 0) return NNG_ECONNREFUSED;
+	base = ::MapViewOfFile(shm->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (base == nullptr) return systemError(static_cast<int>(::GetLastError()));
+	MEMORY_BASIC_INFORMATION info;
+	::VirtualQuery(base, &info, sizeof(info));
+	shm->size = info.RegionSize;
+#endif
+	shm->header = static_cast<ShmHeader*>(base);
+	ShmHeader* header = shm->header;
+	if (header->magic.load(std::memory_order_acquire) != shmMagic) return NNG_ECONNREFUSED;
+	if (header->version != shmVersion || shm->size < headerSize + 2 * header->capacity) return NNG_EPROTO;
+	// a listener takes one dialer
+	if (header->dialed.exchange(1, std::memory_order_acq_rel) != 0) return NNG_EBUSY;
+	attach(shm, base, sideDialer);
+	return 0;
+}
+
+// Channels, the calls below hold a reference
+
+static int sendBegin(nngcShm* s, const ShmCall& call, size_t size, void** buffer, int32_t timeout)
+{
+	*buffer = nullptr;
+	if (call.closing()) return NNG_ECLOSED;
+	if (s->sending) return NNG_ESTATE;
+	const uint64_t capacity = s->capacity;
+	if (size > capacity / 2 - recordHeader) return NNG_EMSGSIZE;
+	const uint64_t record = recordSize(size);
+	const uint64_t head = s->out->head.load(std::memory_order_relaxed);
+	const uint64_t offset = head & (capacity - 1);
+	const uint64_t skip = (capacity - offset < record) ? capacity - offset : 0;
+	const uint64_t need = skip + record;
+	if (peerClosed(s)) return NNG_ECLOSED; // nobody would read it
+	auto room = [&] {
+		if (capacity - (head - s->outTail) >= need) return true;
+		s->outTail = s->out->tail.load(std::memory_order_acquire);
+		return capacity - (head - s->outTail) >= need;
+	};
+	int result = await(s, s->out->space, timeout, [&] { return room() || call.closing() || peerClosed(s); });
+	if (result != 0) return result;
+	if (call.closing() || peerClosed(s)) return NNG_ECLOSED;
+	if (skip != 0) {
+		uint32_t marker = wrapMarker;
+		std::memcpy(s->outData + offset, &marker, sizeof(marker));
+	}
+	s->sendHead = head + skip;
+	s->reserved = size;
+	s->sending = true;
+	*buffer = s->outData + (s->sendHead & (capacity - 1)) + recordHeader;
+	return 0;
+}
+
+static int sendEnd(nngcShm* s, size_t size)
+{
+	if (!s->sending) return NNG_ESTATE;
+	if (size > s->reserved) return NNG_EINVAL;
+	unsigned char* record = s->outData + (s->sendHead & (s->capacity - 1));
+	uint32_t length = static_cast<uint32_t>(size);
+	uint32_t reserved = 0;
+	std::memcpy(record, &length, sizeof(length));
+	std::memcpy(record + 4, &reserved, sizeof(reserved));
+	s->sending = false;
+	s->out->head.store(s->sendHead + recordSize(size), std::memory_order_release);
+	notify(s, s->out->data);
+	return 0;
+}
+
+static int recvBegin(nngcShm* s, const ShmCall& call, const void** data, size_t* size, int32_t timeout)
+{
+	*data = nullptr;
+	*size = 0;
+	if (call.closing()) return NNG_ECLOSED;
+	if (s->receiving) return NNG_ESTATE;
+	const uint64_t capacity = s->capacity;
+	uint64_t tail = s->in->tail.load(std::memory_order_relaxed);
+	auto any = [&] {
+		if (s->inHead != tail) return true;
+		s->inHead = s->in->head.load(std::memory_order_acquire);
+		return s->inHead != tail;
+	};
+	int result = await(s, s->in->data, timeout, [&] { return any() || call.closing() || peerClosed(s); });
+	if (result != 0) return result;
+	if (call.closing()) return NNG_ECLOSED;
+	// what the peer sent before it closed is still received
+	if (!any()) return NNG_ECLOSED;
+	uint64_t offset = tail & (capacity - 1);
+	uint32_t length;
+	std::memcpy(&length, s->inData + offset, sizeof(length));
+	if (length == wrapMarker) {
+		tail += capacity - offset;
+		offset = 0;
+		std::memcpy(&length, s->inData, sizeof(length));
+	}
+	s->recvTail = tail;
+	s->recvSize = length;
+	s->receiving = true;
+	*data = s->inData + offset + recordHeader;
+	*size = length;
+	return 0;
+}
+
+static int recvEnd(nngcShm* s)
+{
+	if (!s->receiving) return NNG_ESTATE;
+	s->receiving = false;
+	s->in->tail.store(s->recvTail + recordSize(s->recvSize), std::memory_order_release);
+	notify(s, s->in->space);
+	return 0;
+}
+
+extern "C" {
+
+	int nngc_shm_listen(const char* url, size_t urlLength, uint32_t capacity, nngc_shm* shm)
+	{
+		*shm = 0;
+		uint64_t c = (capacity == 0) ? defaultCapacity : minCapacity;
+		while (c < capacity && c < maxCapacity) c <<= 1;
+		if (capacity > maxCapacity) return NNG_EINVAL;
+		auto s = new (std::nothrow) nngcShm();
+		if (s == nullptr) return NNG_ENOMEM;
+		int result = parseName(url, urlLength, &s->name);
+		if (result == 0) result = createSegment(s, c);
+		if (result == 0) result = shmHandle(s, shm);
+		if (result != 0) destroy(s);
+		return result;
+	}
+
+	int nngc_shm_dial(const char* url, size_t urlLength, nngc_shm* shm)
+	{
+		*shm = 0;
+		auto s = new (std::nothrow) nngcShm();
+		if (s == nullptr) return NNG_ENOMEM;
+		int result = parseName(url, urlLength, &s->name);
+		if (result == 0) result = openSegment(s);
+		if (result == 0) result = shmHandle(s, shm);
+		if (result != 0) destroy(s);
+		return result;
+	}
+
+	int nngc_shm_unlink(const char* url, size_t urlLength)
+	{
+		std::string name;
+		int result = parseName(url, urlLength, &name);
+		if (result != 0) return result;
+#if defined(NNGC_POSIX_SHM)
+		name = "/nngc-" + name;
+		if (::shm_unlink(name.c_str()) != 0) return (errno == ENOENT) ? NNG_ENOENT : systemError(errno);
+		return 0;
+#else
+		// the system removes a segment with its last handle, a crashed listener leaves nothing behind
+		return NNG_ENOENT;
+#endif
+	}
+
+	void nngc_shm_close(nngc_shm shm)
+	{
+		ShmSlot* slot = slotOf(shm);
+		if (slot == nullptr) return;
+		// only one close wins, it takes the open bit and the reference of the handle
+		uint64_t state = slot->state.load(std::memory_order_acquire);
+		do {
+			if ((state >> 32) != (shm >> 32) || (state & slotOpen) == 0) return;
+		} while (!slot->state.compare_exchange_weak(state, (state & ~slotOpen) + 1, std::memory_order_acq_rel));
+		// the open bit is gone, but the reference we took keeps the channel mapped until we are done
+		nngcShm* s = slot->shm.load(std::memory_order_acquire);
+		s->closing.store(true, std::memory_order_seq_cst);
+		s->header->closed[s->side].store(1, std::memory_order_seq_cst);
+#if defined(NNGC_POSIX_SHM)
+		if (s->owner) removeName(s); // a new listener may take the name now
+#endif
+		// both sides of this process and of the peer look at the flags again, then leave and drop their references
+		for (ShmRing& r : s->header->rings) {
+			wakeUp(s, r.data);
+			wakeUp(s, r.space);
+		}
+		release(slot); // ours
+		release(slot); // the handle's
+	}
+
+	size_t nngc_shm_max_size(nngc_shm shm)
+	{
+		ShmCall call(shm);
+		if (call.shm == nullptr) return 0;
+		return static_cast<size_t>(call.shm->capacity / 2 - recordHeader);
+	}
+
+	int nngc_shm_send_begin(nngc_shm shm, size_t size, void** buffer, int32_t timeout)
+	{
+		ShmCall call(shm);
+		if (call.shm == nullptr) {
+			*buffer = nullptr;
+			return NNG_ECLOSED;
+		}
+		return sendBegin(call.shm, call, size, buffer, timeout);
+	}
+
+	int nngc_shm_send_end(nngc_shm shm, size_t size)
+	{
+		ShmCall call(shm);
+		if (call.shm == nullptr) return NNG_ECLOSED;
+		return sendEnd(call.shm, size);
+	}
+
+	int nngc_shm_send(nngc_shm shm, const void* data, size_t size, int32_t timeout)
+	{
+		ShmCall call(shm);
+		if (call.shm == nullptr) return NNG_ECLOSED;
+		void* buffer;
+		int result = sendBegin(call.shm, call, size, &buffer, timeout);
+		if (result != 0) return result;
+		if (size != 0) std::memcpy(buffer, data, size);
+		return sendEnd(call.shm, size);
+	}
+
+	int nngc_shm_recv_begin(nngc_shm shm, const void** data, size_t* size, int32_t timeout)
+	{
+		ShmCall call(shm);
+		if (call.shm == nullptr) {
+			*data = nullptr;
+			*size = 0;
+			return NNG_ECLOSED;
+		}
+		return recvBegin(call.shm, call, data, size, timeout);
+	}
+
+	int nngc_shm_recv_end(nngc_shm shm)
+	{
+		ShmCall call(shm);
+		if (call.shm == nullptr) return NNG_ECLOSED;
+		return recvEnd(call.shm);
+	}
+
+	int nngc_shm_recv_into(nngc_shm shm, void* buffer, size_t capacity, size_t* received, int32_t timeout)
+	{
+		*received = 0;
+		ShmCall call(shm);
+		if (call.shm == nullptr) return NNG_ECLOSED;
+		const void* data;
+		int result = recvBegin(call.shm, call, &data, received, timeout);
+		if (result != 0) return result;
+		if (*received > capacity) {
+			call.shm->receiving = false; // stays in the ring
+			return NNG_EMSGSIZE;
+		}
+		if (*received != 0) std::memcpy(buffer, data, *received);
+		return recvEnd(call.shm);
+	}
+}
@@ -0,0 +1,505 @@
+/*
+Nng core
+
+Sockets, dialers, listeners, options, sending and receiving
+
+
+
+
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+#include "protocol/reqrep0/req.h"
+#include "protocol/reqrep0/rep.h"
+#include "protocol/bus0/bus.h"
+#include "protocol/pair0/pair.h"
+#include "protocol/pair1/pair.h"
+#include "protocol/pipeline0/pull.h"
+#include "protocol/pipeline0/push.h"
+#include "protocol/pubsub0/pub.h"
+#include "protocol/pubsub0/sub.h"
+#include "protocol/survey0/respond.h"
+#include "protocol/survey0/survey.h"
+#include <string>
+
+#define SOCKET(s) nngcFromId<nng_socket>(s)
+
+extern "C" {
+
+	// General
+
+	static const char* const optionNames[NNGC_OPT_COUNT] = {
+		"socket-name",        // NNGC_OPT_SOCKNAME
+		"compat:domain",      // NNGC_OPT_DOMAIN
+		"raw",                // NNGC_OPT_RAW
+		"linger",             // NNGC_OPT_LINGER
+		"recv-buffer",        // NNGC_OPT_RECVBUF
+		"send-buffer",        // NNGC_OPT_SENDBUF
+		"recv-fd",            // NNGC_OPT_RECVFD
+		"send-fd",            // NNGC_OPT_SENDFD
+		"recv-timeout",       // NNGC_OPT_RECVTIMEO
+		"send-timeout",       // NNGC_OPT_SENDTIMEO
+		"local-address",      // NNGC_OPT_LOCADDR
+		"remote-address",     // NNGC_OPT_REMADDR
+		"url",                // NNGC_OPT_URL
+		"ttl-max",            // NNGC_OPT_MAXTTL
+		"protocol",           // NNGC_OPT_PROTOCOL
+		"transport",          // NNGC_OPT_TRANSPORT
+		"recv-size-max",      // NNGC_OPT_RECVMAXSZ
+		"reconnect-time-min", // NNGC_OPT_RECONNMINT
+		"reconnect-time-max"  // NNGC_OPT_RECONNMAXT
+	};
+
+	const char* nngc_option_name(int option)
+	{
+		if (option < 0 || option >= NNGC_OPT_COUNT) return nullptr;
+		return optionNames[option];
+	}
+
+	const char* nngc_strerror(int err)
+	{
+		return ::nng_strerror(err);
+	}
+
+	const char* nngc_version(void)
+	{
+		return ::nng_version();
+	}
+
+	void nngc_fini(void)
+	{
+		nngcPollerCloseAll();
+		::nng_fini();
+		nngcPipesFini();
+		nngcMetricsFini();
+		nngcRecvWaitFini();
+	}
+
+	void nngc_closeall(void)
+	{
+		nngcPollerCloseAll();
+		::nng_closeall();
+	}
+
+	// Sockets, dialers and listeners
+
+	static int pair1PolyOpen(nng_socket* socket)
+	{
+		int result = ::nng_pair1_open(socket);
+		if (result != 0) return result;
+		result = ::nng_setopt_bool(*socket, NNG_OPT_PAIR1_POLY, true);
+		if (result != 0) ::nng_close(*socket);
+		return result;
+	}
+
+	static int(*const protocolOpen[NNGC_PROTO_COUNT])(nng_socket*) = {
+		::nng_bus0_open,        // NNGC_PROTO_BUS0
+		::nng_pair0_open,       // NNGC_PROTO_PAIR0
+		::nng_pub0_open,        // NNGC_PROTO_PUB0
+		::nng_sub0_open,        // NNGC_PROTO_SUB0
+		::nng_pull0_open,       // NNGC_PROTO_PULL0
+		::nng_push0_open,       // NNGC_PROTO_PUSH0
+		::nng_req0_open,        // NNGC_PROTO_REQ0
+		::nng_rep0_open,        // NNGC_PROTO_REP0
+		::nng_surveyor0_open,   // NNGC_PROTO_SURVEYOR0
+		::nng_respondent0_open, // NNGC_PROTO_RESPONDENT0
+		::nng_pair1_open,       // NNGC_PROTO_PAIR1
+		pair1PolyOpen,          // NNGC_PROTO_PAIR1_POLY
+		::nng_req0_open_raw     // NNGC_PROTO_REQ0_RAW
+	};
+
+	int nngc_socket_open(int protocol, nngc_socket* socket)
+	{
+		*socket = 0;
+		if (protocol < 0 || protocol >= NNGC_PROTO_COUNT) return NNG_ENOTSUP;
+		nng_socket s;
+		int result = protocolOpen[protocol](&s);
+		if (result == 0) *socket = nngcToId(s);
+		return result;
+	}
+
+	int nngc_socket_close(nngc_socket socket)
+	{
+		nngcPollerClose(socket);
+		int result = ::nng_close(SOCKET(socket));
+		nngcPipesClose(socket);
+		nngcMetricsClose(socket);
+		nngcRecvWaitClose(socket);
+		return result;
+	}
+
+	// nng wants zero terminated URLs, the ones from .NET come with a length
+
+	int nngc_listen(nngc_socket socket, const char* url, size_t urlLength, nngc_listener* listener, int flags)
+	{
+		std::string u(url, urlLength);
+		nng_listener l = nngcFromId<nng_listener>(0);
+		int result = ::nng_listen(SOCKET(socket), u.c_str(), &l, flags);
+		*listener = nngcToId(l);
+		return result;
+	}
+
+	int nngc_dial(nngc_socket socket, const char* url, size_t urlLength, nngc_dialer* dialer, int flags)
+	{
+		std::string u(url, urlLength);
+		nng_dialer d = nngcFromId<nng_dialer>(0);
+		int result = ::nng_dial(SOCKET(socket), u.c_str(), &d, flags);
+		*dialer = nngcToId(d);
+		return result;
+	}
+
+	int nngc_listener_create(nngc_socket socket, const char* url, size_t urlLength, nngc_listener* listener)
+	{
+		std::string u(url, urlLength);
+		nng_listener l = nngcFromId<nng_listener>(0);
+		int result = ::nng_listener_create(&l, SOCKET(socket), u.c_str());
+		*listener = nngcToId(l);
+		return result;
+	}
+
+	int nngc_dialer_create(nngc_socket socket, const char* url, size_t urlLength, nngc_dialer* dialer)
+	{
+		std::string u(url, urlLength);
+		nng_dialer d = nngcFromId<nng_dialer>(0);
+		int result = ::nng_dialer_create(&d, SOCKET(socket), u.c_str());
+		*dialer = nngcToId(d);
+		return result;
+	}
+
+	int nngc_listener_start(nngc_listener listener, int flags)
+	{
+		return ::nng_listener_start(nngcFromId<nng_listener>(listener), flags);
+	}
+
+	int nngc_dialer_start(nngc_dialer dialer, int flags)
+	{
+		return ::nng_dialer_start(nngcFromId<nng_dialer>(dialer), flags);
+	}
+
+	int nngc_listener_close(nngc_listener listener)
+	{
+		return ::nng_listener_close(nngcFromId<nng_listener>(listener));
+	}
+
+	int nngc_dialer_close(nngc_dialer dialer)
+	{
+		return ::nng_dialer_close(nngcFromId<nng_dialer>(dialer));
+	}
+
+	// Options
+
+#define OPTION(name, option) \
+	const char* name = nngc_option_name(option); \
+	if (name == nullptr) return NNG_ENOTSUP;
+
+	int nngc_socket_set(nngc_socket socket, int option, const void* value, size_t size)
+	{
+		OPTION(name, option);
+		return ::nng_setopt(SOCKET(socket), name, value, size);
+	}
+
+	int nngc_socket_set_bool(nngc_socket socket, int option, int value)
+	{
+		OPTION(name, option);
+		return ::nng_setopt_bool(SOCKET(socket), name, value != 0);
+	}
+
+	int nngc_socket_set_int(nngc_socket socket, int option, int32_t value)
+	{
+		OPTION(name, option);
+		return ::nng_setopt_int(SOCKET(socket), name, value);
+	}
+
+	int nngc_socket_set_ms(nngc_socket socket, int option, int32_t value)
+	{
+		OPTION(name, option);
+		return ::nng_setopt_ms(SOCKET(socket), name, value);
+	}
+
+	int nngc_socket_set_size(nngc_socket socket, int option, uint64_t value)
+	{
+		OPTION(name, option);
+		return ::nng_setopt_size(SOCKET(socket), name, static_cast<size_t>(value));
+	}
+
+	int nngc_socket_set_uint64(nngc_socket socket, int option, uint64_t value)
+	{
+		OPTION(name, option);
+		return ::nng_setopt_uint64(SOCKET(socket), name, value);
+	}
+
+	int nngc_socket_set_string(nngc_socket socket, int option, const char* value, size_t length)
+	{
+		OPTION(name, option);
+		std::string v(value, length);
+		return ::nng_setopt_string(SOCKET(socket), name, v.c_str());
+	}
+
+	int nngc_socket_get(nngc_socket socket, int option, void* value, size_t* size)
+	{
+		OPTION(name, option);
+		return ::nng_getopt(SOCKET(socket), name, value, size);
+	}
+
+	int nngc_socket_get_bool(nngc_socket socket, int option, int* value)
+	{
+		*value = 0;
+		OPTION(name, option);
+		bool b = false;
+		int result = ::nng_getopt_bool(SOCKET(socket), name, &b);
+		*value = b ? 1 : 0;
+		return result;
+	}
+
+	int nngc_socket_get_int(nngc_socket socket, int option, int32_t* value)
+	{
+		*value = 0;
+		OPTION(name, option);
+		int i = 0;
+		int result = ::nng_getopt_int(SOCKET(socket), name, &i);
+		*value = i;
+		return result;
+	}
+
+	int nngc_socket_get_ms(nngc_socket socket, int option, int32_t* value)
+	{
+		*value = 0;
+		OPTION(name, option);
+		nng_duration d = 0;
+		int result = ::nng_getopt_ms(SOCKET(socket), name, &d);
+		*value = d;
+		return result;
+	}
+
+	int nngc_socket_get_size(nngc_socket socket, int option, uint64_t* value)
+	{
+		*value = 0;
+		OPTION(name, option);
+		size_t s = 0;
+		int result = ::nng_getopt_size(SOCKET(socket), name, &s);
+		*value = s;
+		return result;
+	}
+
+	int nngc_socket_get_uint64(nngc_socket socket, int option, uint64_t* value)
+	{
+		*value = 0;
+		OPTION(name, option);
+		return ::nng_getopt_uint64(SOCKET(socket), name, value);
+	}
+
+#undef OPTION
+
+	int nngc_socket_options_apply(nngc_socket socket, const nngc_socket_options* o)
+	{
+		nng_socket s = SOCKET(socket);
+		int result;
+#define APPLY(bit, call) \
+	if ((o->set & bit) && (result = (call)) != 0) return result;
+		APPLY(NNGC_SOCKOPT_SENDBUF, ::nng_setopt_int(s, NNG_OPT_SENDBUF, o->sendbuf));
+		APPLY(NNGC_SOCKOPT_RECVBUF, ::nng_setopt_int(s, NNG_OPT_RECVBUF, o->recvbuf));
+		APPLY(NNGC_SOCKOPT_SENDTIMEO, ::nng_setopt_ms(s, NNG_OPT_SENDTIMEO, o->sendtimeo));
+		APPLY(NNGC_SOCKOPT_RECVTIMEO, ::nng_setopt_ms(s, NNG_OPT_RECVTIMEO, o->recvtimeo));
+		APPLY(NNGC_SOCKOPT_RECVMAXSZ, ::nng_setopt_size(s, NNG_OPT_RECVMAXSZ, static_cast<size_t>(o->recvmaxsz)));
+		APPLY(NNGC_SOCKOPT_RECONNMINT, ::nng_setopt_ms(s, NNG_OPT_RECONNMINT, o->reconnmint));
+		APPLY(NNGC_SOCKOPT_RECONNMAXT, ::nng_setopt_ms(s, NNG_OPT_RECONNMAXT, o->reconnmaxt));
+		APPLY(NNGC_SOCKOPT_MAXTTL, ::nng_setopt_int(s, NNG_OPT_MAXTTL, o->maxttl));
+#undef APPLY
+		return 0;
+	}
+
+	int nngc_socket_options_read(nngc_socket socket, nngc_socket_options* o)
+	{
+		nng_socket s = SOCKET(socket);
+		int result;
+		size_t recvmaxsz = 0;
+		o->set = 0;
+#define READ(bit, call) \
+	result = (call); \
+	if (result == 0) o->set |= bit; \
+	else if (result != NNG_ENOTSUP) return result;
+		READ(NNGC_SOCKOPT_SENDBUF, ::nng_getopt_int(s, NNG_OPT_SENDBUF, &o->sendbuf));
+		READ(NNGC_SOCKOPT_RECVBUF, ::nng_getopt_int(s, NNG_OPT_RECVBUF, &o->recvbuf));
+		READ(NNGC_SOCKOPT_SENDTIMEO, ::nng_getopt_ms(s, NNG_OPT_SENDTIMEO, &o->sendtimeo));
+		READ(NNGC_SOCKOPT_RECVTIMEO, ::nng_getopt_ms(s, NNG_OPT_RECVTIMEO, &o->recvtimeo));
+		READ(NNGC_SOCKOPT_RECVMAXSZ, ::nng_getopt_size(s, NNG_OPT_RECVMAXSZ, &recvmaxsz));
+		o->recvmaxsz = recvmaxsz;
+		READ(NNGC_SOCKOPT_RECONNMINT, ::nng_getopt_ms(s, NNG_OPT_RECONNMINT, &o->reconnmint));
+		READ(NNGC_SOCKOPT_RECONNMAXT, ::nng_getopt_ms(s, NNG_OPT_RECONNMAXT, &o->reconnmaxt));
+		READ(NNGC_SOCKOPT_MAXTTL, ::nng_getopt_int(s, NNG_OPT_MAXTTL, &o->maxttl));
+#undef READ
+		return 0;
+	}
+
+	// Sending and receiving. Each call records into the socket's metrics if it is counted
+
+	// one nng receive, for nngcRecvWaitReceive to try
+	struct RecvCall {
+		nng_socket socket;
+		void* data;       // the buffer, or where nng puts the allocated buffer or the message
+		size_t size;      // of the buffer
+		size_t* received;
+	};
+
+	static int recvBuffer(void* arg, int flags)
+	{
+		auto c = static_cast<RecvCall*>(arg);
+		*c->received = c->size;
+		return ::nng_recv(c->socket, c->data, c->received, flags);
+	}
+
+	static int recvMsg(void* arg, int flags)
+	{
+		auto c = static_cast<RecvCall*>(arg);
+		return ::nng_recvmsg(c->socket, static_cast<nng_msg**>(c->data), flags);
+	}
+
+	// a blocking receive waits by the socket's policy if it has one
+	static inline int recvWaiting(nngc_socket socket, nngcRecvAttempt attempt, RecvCall& call, int flags)
+	{
+		nngcRecvWait* w = (flags & NNG_FLAG_NONBLOCK) ? nullptr : nngcRecvWaitFind(socket);
+		return (w != nullptr) ? nngcRecvWaitReceive(w, attempt, &call, flags) : attempt(&call, flags);
+	}
+
+	int nngc_send(nngc_socket socket, const void* data, size_t size, int flags)
+	{
+		nngcMetrics* m = nngcMetricsFind(socket);
+		int result = ::nng_send(SOCKET(socket), const_cast<void*>(data), size, flags & ~NNG_FLAG_ALLOC);
+		if (m != nullptr) nngcMetricsSent(m, result, (result == 0) ? 1 : 0, (result == 0) ? size : 0);
+		return result;
+	}
+
+	// nng_recv without NNG_FLAG_ALLOC copies straight into the buffer. A message that doesn't fit
+	// is truncated by nng, but the full length is reported back, so we can turn that into msgsize
+	int nngc_recv_into(nngc_socket socket, void* buffer, size_t size, size_t* received, int flags)
+	{
+		size_t size2;
+		RecvCall call{ SOCKET(socket), buffer, size, &size2 };
+		int result = recvWaiting(socket, recvBuffer, call, flags & ~NNG_FLAG_ALLOC);
+		*received = (result == 0) ? size2 : 0;
+		if (result == 0 && size2 > size) result = NNG_EMSGSIZE;
+		nngcMetrics* m = nngcMetricsFind(socket);
+		if (m != nullptr) nngcMetricsReceived(m, result, (result == 0) ? 1 : 0, *received);
+		return result;
+	}
+
+	int nngc_recv_alloc(nngc_socket socket, void** data, size_t* size, int flags)
+	{
+		*data = nullptr;
+		*size = 0;
+		RecvCall call{ SOCKET(socket), data, 0, size };
+		int result = recvWaiting(socket, recvBuffer, call, flags | NNG_FLAG_ALLOC);
+		nngcMetrics* m = nngcMetricsFind(socket);
+		if (m != nullptr) nngcMetricsReceived(m, result, (result == 0) ? 1 : 0, *size);
+		return result;
+	}
+
+	void nngc_free(void* data, size_t size)
+	{
+		::nng_free(data, size);
+	}
+
+	int nngc_sendmsg(nngc_socket socket, nngc_msg msg, int flags)
+	{
+		nngcMetrics* m = nngcMetricsFind(socket);
+		size_t size = (m != nullptr) ? ::nng_msg_len(nngcMsg(msg)) : 0; // the message is gone once sent
+		int result = ::nng_sendmsg(SOCKET(socket), nngcMsg(msg), flags);
+		if (m != nullptr) nngcMetricsSent(m, result, (result == 0) ? 1 : 0, (result == 0) ? size : 0);
+		return result;
+	}
+
+	int nngc_recvmsg(nngc_socket socket, nngc_msg* msg, int flags)
+	{
+		nng_msg* m = nullptr;
+		RecvCall call{ SOCKET(socket), &m, 0, nullptr };
+		int result = recvWaiting(socket, recvMsg, call, flags);
+		*msg = (result == 0) ? nngcMsgHandle(m) : 0;
+		nngcMetrics* metrics = nngcMetricsFind(socket);
+		if (metrics != nullptr) nngcMetricsReceived(metrics, result, (result == 0) ? 1 : 0, (result == 0) ? ::nng_msg_len(m) : 0);
+		return result;
+	}
+
+	// The batch functions do their whole loop in native code, so a batch costs one transition
+	// from .NET instead of one per message
+
+	int nngc_send_many_msgs(nngc_socket socket, const nngc_msg* msgs, int count, int flags, int* sent)
+	{
+		nng_socket s = SOCKET(socket);
+		nngcMetrics* m = nngcMetricsFind(socket);
+		uint64_t bytes = 0;
+		int result = 0;
+		int n;
+		for (n = 0; n < count; n++) {
+			size_t size = (m != nullptr) ? ::nng_msg_len(nngcMsg(msgs[n])) : 0;
+			result = ::nng_sendmsg(s, nngcMsg(msgs[n]), flags);
+			if (result != 0) break;
+			bytes += size;
+		}
+		*sent = n;
+		if (m != nullptr) nngcMetricsSent(m, result, n, bytes);
+		return result;
+	}
+
+	int nngc_send_many_buffers(nngc_socket socket, const void* data, const int32_t* lengths, int count, int flags, int* sent)
+	{
+		nng_socket s = SOCKET(socket);
+		auto p = static_cast<const unsigned char*>(data);
+		int result = 0;
+		int n;
+		for (n = 0; n < count; n++) {
+			result = ::nng_send(s, const_cast<unsigned char*>(p), lengths[n], flags & ~NNG_FLAG_ALLOC);
+			if (result != 0) break;
+			p += lengths[n];
+		}
+		*sent = n;
+		nngcMetrics* m = nngcMetricsFind(socket);
+		if (m != nullptr) nngcMetricsSent(m, result, n, p - static_cast<const unsigned char*>(data));
+		return result;
+	}
+
+	int nngc_recv_many_msgs(nngc_socket socket, nngc_msg* msgs, int max, int timeout, int* received)
+	{
+		nng_socket s = SOCKET(socket);
+		nngcMetrics* m = nngcMetricsFind(socket);
+		nng_msg* msg = nullptr;
+		int result;
+		*received = 0;
+		if (max <= 0) return 0;
+
+		if (timeout == 0) {
+			result = ::nng_recvmsg(s, &msg, NNG_FLAG_NONBLOCK);
+		}
+		else if (timeout < 0) {
+			RecvCall call{ s, &msg, 0, nullptr };
+			result = recvWaiting(socket, recvMsg, call, 0);
+		}
+		else {
+			nng_aio* aio;
+			result = ::nng_aio_alloc(&aio, nullptr, nullptr);
+			if (result != 0) return result;
+			::nng_aio_set_timeout(aio, timeout);
+			::nng_recv_aio(s, aio);
+			::nng_aio_wait(aio);
+			result = ::nng_aio_result(aio);
+			if (result == 0) msg = ::nng_aio_get_msg(aio);
+			::nng_aio_free(aio);
+		}
+		if (result != 0) {
+			if (m != nullptr) nngcMetricsReceived(m, result, 0, 0);
+			return result;
+		}
+		msgs[0] = nngcMsgHandle(msg);
+		uint64_t bytes = (m != nullptr) ? ::nng_msg_len(msg) : 0;
+
+		int n = 1;
+		while (n < max && ::nng_recvmsg(s, &msg, NNG_FLAG_NONBLOCK) == 0) {
+			msgs[n++] = nngcMsgHandle(msg);
+			if (m != nullptr) bytes += ::nng_msg_len(msg);
+		}
+		*received = n;
+		if (m != nullptr) nngcMetricsReceived(m, 0, n, bytes);
+		return 0;
+	}
+}
@@ -0,0 +1,151 @@
+/*
+Nng core
+
+Statistics. A snapshot is nng's own tree of nng_stat, the handles are its pointers. nngc_stats_flatten
+walks the tree once and returns every statistic with a key, so a poller can match the statistics of
+two snapshots without building their paths as strings.
+
+
+
+
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+#include <cstring>
+
+#define STAT(s) reinterpret_cast<nng_stat*>(static_cast<uintptr_t>(s))
+
+static inline nngc_stat statHandle(nng_stat* stat)
+{
+	return static_cast<nngc_stat>(reinterpret_cast<uintptr_t>(stat));
+}
+
+// FNV-1a
+static const uint64_t hashStart = 14695981039346656037ULL;
+
+static inline uint64_t hash(uint64_t h, const void* data, size_t size)
+{
+	auto p = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+uint32_t nngcStatScopeId(nng_stat* scope)
+{
+	for (nng_stat* s = ::nng_stat_child(scope); s != nullptr; s = ::nng_stat_next(s)) {
+		if (::nng_stat_type(s) == NNG_STAT_ID && std::strcmp(::nng_stat_name(s), "id") == 0) {
+			return static_cast<uint32_t>(::nng_stat_value(s));
+		}
+	}
+	return 0;
+}
+
+struct Flattener {
+	nngc_stat_entry* entries;
+	int capacity;
+	int count;
+};
+
+// the key is the hash of the path, scope names followed by '#' and the id if there is one
+static void flatten(nng_stat* stat, int parent, uint64_t parentKey, Flattener& f)
+{
+	for (nng_stat* s = stat; s != nullptr; s = ::nng_stat_next(s)) {
+		int type = ::nng_stat_type(s);
+		uint32_t id = (type == NNG_STAT_SCOPE) ? nngcStatScopeId(s) : 0;
+		const char* name = ::nng_stat_name(s);
+		uint64_t key = hash(parentKey, "/", 1);
+		key = hash(key, name, std::strlen(name));
+		if (id != 0) {
+			key = hash(key, "#", 1);
+			key = hash(key, &id, sizeof(id));
+		}
+
+		int index = f.count++;
+		if (index < f.capacity) {
+			nngc_stat_entry& e = f.entries[index];
+			e.stat = statHandle(s);
+			e.key = key;
+			e.value = (type == NNG_STAT_STRING || type == NNG_STAT_SCOPE) ? 0 : ::nng_stat_value(s);
+			e.type = type;
+			e.unit = ::nng_stat_unit(s);
+			e.parent = parent;
+			e.scope_id = id;
+		}
+		if (type == NNG_STAT_SCOPE) flatten(::nng_stat_child(s), index, key, f);
+	}
+}
+
+extern "C" {
+
+	int nngc_stats_get(nngc_stat* stats)
+	{
+		nng_stat* s = nullptr;
+		int result = ::nng_stats_get(&s);
+		*stats = (result == 0) ? statHandle(s) : 0;
+		return result;
+	}
+
+	void nngc_stats_free(nngc_stat stats)
+	{
+		if (stats != 0) ::nng_stats_free(STAT(stats));
+	}
+
+	nngc_stat nngc_stat_child(nngc_stat stat)
+	{
+		return statHandle(::nng_stat_child(STAT(stat)));
+	}
+
+	nngc_stat nngc_stat_next(nngc_stat stat)
+	{
+		return statHandle(::nng_stat_next(STAT(stat)));
+	}
+
+	const char* nngc_stat_name(nngc_stat stat)
+	{
+		return ::nng_stat_name(STAT(stat));
+	}
+
+	const char* nngc_stat_desc(nngc_stat stat)
+	{
+		return ::nng_stat_desc(STAT(stat));
+	}
+
+	int nngc_stat_type(nngc_stat stat)
+	{
+		return ::nng_stat_type(STAT(stat));
+	}
+
+	int nngc_stat_unit(nngc_stat stat)
+	{
+		return ::nng_stat_unit(STAT(stat));
+	}
+
+	uint64_t nngc_stat_value(nngc_stat stat)
+	{
+		return ::nng_stat_value(STAT(stat));
+	}
+
+	const char* nngc_stat_string(nngc_stat stat)
+	{
+		if (::nng_stat_type(STAT(stat)) != NNG_STAT_STRING) return nullptr;
+		return ::nng_stat_string(STAT(stat));
+	}
+
+	uint64_t nngc_stat_timestamp(nngc_stat stat)
+	{
+		return ::nng_stat_timestamp(STAT(stat));
+	}
+
+	int nngc_stats_flatten(nngc_stat stats, nngc_stat_entry* entries, int capacity, int* count)
+	{
+		Flattener f = { entries, (capacity < 0) ? 0 : capacity, 0 };
+		flatten(STAT(stats), -1, hashStart, f);
+		*count = f.count;
+		return (f.count > f.capacity) ? NNG_ENOSPC : 0;
+	}
+}
@@ -0,0 +1,239 @@
+/*
+Nng core
+
+Streaming, transfers larger than one message or than memory. Every message is a 32 byte frame header
+in front of the body, in network byte order: magic, kind, transfer, reserved, sequence, value.
+It is in the body because pair0 doesn't carry the header of a message to the peer.
+
+The sender announces the transfer with start (sequence = window, value = total size), sends the data
+chunks (sequence = chunk number, value = offset) and end (sequence = number of chunks, value = size).
+The receiver acknowledges start, every window / 2 chunks and end with ack (sequence = chunks received,
+end counts as one more). Either side may give up with abort (value = its error), the other one
+returns NNG_ECONNABORTED then.
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include "CoreInternal.h"
+#include <atomic>
+#include <chrono>
+
+#define SOCKET(s) nngcFromId<nng_socket>(s)
+
+namespace {
+
+	const uint32_t frameMagic = 0x4e475354; // "NGST"
+
+	enum FrameKind : uint32_t {
+		frameStart = 1,
+		frameData = 2,
+		frameEnd = 3,
+		frameAck = 4,
+		frameAbort = 5
+	};
+
+	struct Frame {
+		uint32_t kind;
+		uint32_t transfer;
+		uint64_t sequence;
+		uint64_t value;
+	};
+}
+
+static std::atomic<uint32_t> nextTransfer(static_cast<uint32_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+
+static inline void put32(unsigned char* p, uint32_t v)
+{
+	p[0] = static_cast<unsigned char>(v >> 24);
+	p[1] = static_cast<unsigned char>(v >> 16);
+	p[2] = static_cast<unsigned char>(v >> 8);
+	p[3] = static_cast<unsigned char>(v);
+}
+
+static inline uint32_t get32(const unsigned char* p)
+{
+	return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+static void putFrame(nng_msg* msg, const Frame& f)
+{
+	auto p = static_cast<unsigned char*>(::nng_msg_body(msg));
+	put32(p, frameMagic);
+	put32(p + 4, f.kind);
+	put32(p + 8, f.transfer);
+	put32(p + 12, 0);
+	put32(p + 16, static_cast<uint32_t>(f.sequence >> 32));
+	put32(p + 20, static_cast<uint32_t>(f.sequence));
+	put32(p + 24, static_cast<uint32_t>(f.value >> 32));
+	put32(p + 28, static_cast<uint32_t>(f.value));
+}
+
+// a frame without data
+static int sendControl(nng_socket s, uint32_t kind, uint32_t transfer, uint64_t sequence, uint64_t value, int flags)
+{
+	nng_msg* msg;
+	int result = ::nng_msg_alloc(&msg, NNGC_STREAM_HEADER);
+	if (result != 0) return result;
+	putFrame(msg, Frame{ kind, transfer, sequence, value });
+	result = ::nng_sendmsg(s, msg, flags);
+	if (result != 0) ::nng_msg_free(msg);
+	return result;
+}
+
+// tells the peer, if it can take it right away
+static int abortTransfer(nng_socket s, uint32_t transfer, int error)
+{
+	sendControl(s, frameAbort, transfer, 0, static_cast<uint64_t>(error), NNG_FLAG_NONBLOCK);
+	return error;
+}
+
+// the next frame, messages which aren't frames are dropped
+static int receiveFrame(nng_socket s, nng_msg** msg, Frame* f, int flags)
+{
+	for (;;) {
+		int result = ::nng_recvmsg(s, msg, flags);
+		if (result != 0) return result;
+		auto p = static_cast<const unsigned char*>(::nng_msg_body(*msg));
+		if (::nng_msg_len(*msg) >= NNGC_STREAM_HEADER && get32(p) == frameMagic) {
+			f->kind = get32(p + 4);
+			f->transfer = get32(p + 8);
+			f->sequence = (static_cast<uint64_t>(get32(p + 16)) << 32) | get32(p + 20);
+			f->value = (static_cast<uint64_t>(get32(p + 24)) << 32) | get32(p + 28);
+			return 0;
+		}
+		::nng_msg_free(*msg);
+	}
+}
+
+// the next acknowledgement of the transfer, raises *acked to its sequence
+static int receiveAck(nng_socket s, uint32_t transfer, uint64_t* acked, int flags)
+{
+	for (;;) {
+		nng_msg* msg;
+		Frame f;
+		int result = receiveFrame(s, &msg, &f, flags);
+		if (result != 0) return result;
+		::nng_msg_free(msg);
+		if (f.transfer != transfer) continue; // of an earlier transfer
+		if (f.kind == frameAbort) return NNG_ECONNABORTED;
+		if (f.kind != frameAck) continue;
+		if (f.sequence > *acked) *acked = f.sequence;
+		return 0;
+	}
+}
+
+extern "C" {
+
+	int nngc_stream_send(nngc_socket socket, uint32_t chunkSize, uint32_t window, uint64_t total,
+		nngc_stream_read read, void* arg, uint64_t* sent)
+	{
+		*sent = 0;
+		if (chunkSize == 0 || window == 0 || read == nullptr) return NNG_EINVAL;
+		nng_socket s = SOCKET(socket);
+		uint32_t transfer = nextTransfer.fetch_add(1, std::memory_order_relaxed);
+		int result = sendControl(s, frameStart, transfer, window, total, 0);
+		uint64_t acked = 0;
+		if (result == 0) result = receiveAck(s, transfer, &acked, 0);
+		if (result != 0) return result;
+
+		uint64_t chunks = 0;
+		bool end = false;
+		while (!end) {
+			while (chunks - acked < window) {
+				nng_msg* msg;
+				if ((result = ::nng_msg_alloc(&msg, NNGC_STREAM_HEADER + static_cast<size_t>(chunkSize))) != 0) return abortTransfer(s, transfer, result);
+				size_t size = 0;
+				result = read(arg, static_cast<unsigned char*>(::nng_msg_body(msg)) + NNGC_STREAM_HEADER, chunkSize, &size);
+				if (result == 0 && size > chunkSize) result = NNG_EINVAL;
+				if (result != 0 || size == 0) {
+					::nng_msg_free(msg);
+					if (result != 0) return abortTransfer(s, transfer, result);
+					end = true;
+					break;
+				}
+				if ((result = ::nng_msg_realloc(msg, NNGC_STREAM_HEADER + size)) != 0) {
+					::nng_msg_free(msg);
+					return abortTransfer(s, transfer, result);
+				}
+				putFrame(msg, Frame{ frameData, transfer, chunks, *sent });
+				if ((result = ::nng_sendmsg(s, msg, 0)) != 0) {
+					::nng_msg_free(msg);
+					return abortTransfer(s, transfer, result);
+				}
+				chunks++;
+				*sent += size;
+				// take acknowledgements which are there already, so the window rarely fills up
+				while ((result = receiveAck(s, transfer, &acked, NNG_FLAG_NONBLOCK)) == 0) {}
+				if (result != NNG_EAGAIN) return abortTransfer(s, transfer, result);
+			}
+			if (!end && (result = receiveAck(s, transfer, &acked, 0)) != 0) return abortTransfer(s, transfer, result);
+		}
+
+		if ((result = sendControl(s, frameEnd, transfer, chunks, *sent, 0)) != 0) return abortTransfer(s, transfer, result);
+		while (acked <= chunks) {
+			if ((result = receiveAck(s, transfer, &acked, 0)) != 0) return abortTransfer(s, transfer, result);
+		}
+		return 0;
+	}
+
+	int nngc_stream_recv(nngc_socket socket, nngc_stream_begin begin, nngc_stream_write write, void* arg, uint64_t* received)
+	{
+		*received = 0;
+		if (write == nullptr) return NNG_EINVAL;
+		nng_socket s = SOCKET(socket);
+		nng_msg* msg;
+		Frame f;
+		int result;
+		// frames of an earlier transfer are dropped
+		do {
+			if ((result = receiveFrame(s, &msg, &f, 0)) != 0) return result;
+			::nng_msg_free(msg);
+		} while (f.kind != frameStart);
+		uint32_t transfer = f.transfer;
+		uint64_t total = f.value;
+		uint64_t ackEvery = (f.sequence > 1) ? f.sequence / 2 : 1;
+		if (begin != nullptr && (result = begin(arg, total)) != 0) return abortTransfer(s, transfer, result);
+		if ((result = sendControl(s, frameAck, transfer, 0, 0, 0)) != 0) return result;
+
+		uint64_t expected = 0;
+		uint64_t acked = 0;
+		for (;;) {
+			if ((result = receiveFrame(s, &msg, &f, 0)) != 0) return abortTransfer(s, transfer, result);
+			if (f.transfer != transfer) {
+				::nng_msg_free(msg);
+				continue;
+			}
+			switch (f.kind) {
+			case frameData: {
+				if (f.sequence != expected || f.value != *received) {
+					::nng_msg_free(msg);
+					return abortTransfer(s, transfer, NNG_EPROTO);
+				}
+				size_t size = ::nng_msg_len(msg) - NNGC_STREAM_HEADER;
+				result = write(arg, f.value, static_cast<const unsigned char*>(::nng_msg_body(msg)) + NNGC_STREAM_HEADER, size);
+				::nng_msg_free(msg);
+				if (result != 0) return abortTransfer(s, transfer, result);
+				expected++;
+				*received += size;
+				if (expected - acked >= ackEvery) {
+					if ((result = sendControl(s, frameAck, transfer, expected, 0, 0)) != 0) return result;
+					acked = expected;
+				}
+				break;
+			}
+			case frameEnd:
+				::nng_msg_free(msg);
+				if (f.sequence != expected || f.value != *received || (total != NNGC_STREAM_SIZE_UNKNOWN && total != *received)) {
+					return abortTransfer(s, transfer, NNG_EPROTO);
+				}
+				return sendControl(s, frameAck, transfer, expected + 1, 0, 0);
+			case frameAbort:
+				::nng_msg_free(msg);
+				return NNG_ECONNABORTED;
+			default:
+				::nng_msg_free(msg);
+				break;
+			}
+		}
+	}
+}
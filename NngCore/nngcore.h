@@ -0,0 +1,460 @@
+#pragma once
+
+/*
+Nng core
+
+A flat C interface over nng for the wrapper and for P/Invoke. Everything that crosses it is
+blittable: sockets, dialers and listeners are nng's own integer ids, messages and aios are
+handles (pointers as 64 bit integers), options are numbers instead of strings, callbacks
+are plain C function pointers, and every function returns an nng error code (0 for success).
+Strings only appear where nng needs them anyway, as UTF-8 with an explicit length, and only on
+calls which are not in the hot path (URLs, named options).
+
+The C++/CLI assembly compiles these files in (NNGC_STATIC), .NET Core loads the shared library
+built by CMakeLists.txt in this directory.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(NNGC_STATIC)
+#define NNGC_API
+#elif defined(_WIN32)
+#if defined(NNGC_BUILD)
+#define NNGC_API __declspec(dllexport)
+#else
+#define NNGC_API __declspec(dllimport)
+#endif
+#else
+#define NNGC_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	typedef uint32_t nngc_socket;
+	typedef uint32_t nngc_dialer;
+	typedef uint32_t nngc_listener;
+	typedef uint64_t nngc_msg;
+	typedef uint64_t nngc_aio;
+	typedef uint64_t nngc_stat; // a statistics snapshot is its root nngc_stat
+	typedef uint64_t nngc_poller;
+	typedef uint64_t nngc_shm;
+
+	// called on an nng thread when an aio completes, with the arg given to nngc_aio_alloc
+	typedef void (*nngc_callback)(void* arg);
+
+	// called by nngc_stream_send and nngc_stream_recv on the calling thread, a result other than 0 aborts the transfer.
+	// read fills up to capacity bytes, *size 0 is the end. begin is told the total size, write gets the chunks in order
+	typedef int (*nngc_stream_read)(void* arg, void* buffer, size_t capacity, size_t* size);
+	typedef int (*nngc_stream_begin)(void* arg, uint64_t total);
+	typedef int (*nngc_stream_write)(void* arg, uint64_t offset, const void* data, size_t size);
+
+	// protocols for nngc_socket_open
+	enum {
+		NNGC_PROTO_BUS0,
+		NNGC_PROTO_PAIR0,
+		NNGC_PROTO_PUB0,
+		NNGC_PROTO_SUB0,
+		NNGC_PROTO_PULL0,
+		NNGC_PROTO_PUSH0,
+		NNGC_PROTO_REQ0,
+		NNGC_PROTO_REP0,
+		NNGC_PROTO_SURVEYOR0,
+		NNGC_PROTO_RESPONDENT0,
+		NNGC_PROTO_PAIR1,
+		NNGC_PROTO_PAIR1_POLY, // pair1 with pair1:polyamorous, many peers, sends can pick one
+		NNGC_PROTO_REQ0_RAW,   // raw mode can only be chosen when opening since nng 1.0
+		NNGC_PROTO_COUNT
+	};
+
+	// same values as Nng::Option
+	enum {
+		NNGC_OPT_SOCKNAME,
+		NNGC_OPT_DOMAIN,
+		NNGC_OPT_RAW,
+		NNGC_OPT_LINGER,
+		NNGC_OPT_RECVBUF,
+		NNGC_OPT_SENDBUF,
+		NNGC_OPT_RECVFD,
+		NNGC_OPT_SENDFD,
+		NNGC_OPT_RECVTIMEO,
+		NNGC_OPT_SENDTIMEO,
+		NNGC_OPT_LOCADDR,
+		NNGC_OPT_REMADDR,
+		NNGC_OPT_URL,
+		NNGC_OPT_MAXTTL,
+		NNGC_OPT_PROTOCOL,
+		NNGC_OPT_TRANSPORT,
+		NNGC_OPT_RECVMAXSZ,
+		NNGC_OPT_RECONNMINT,
+		NNGC_OPT_RECONNMAXT,
+		NNGC_OPT_COUNT
+	};
+
+	// Bits of nngc_socket_options::set
+	enum {
+		NNGC_SOCKOPT_SENDBUF = 1 << 0,
+		NNGC_SOCKOPT_RECVBUF = 1 << 1,
+		NNGC_SOCKOPT_SENDTIMEO = 1 << 2,
+		NNGC_SOCKOPT_RECVTIMEO = 1 << 3,
+		NNGC_SOCKOPT_RECVMAXSZ = 1 << 4,
+		NNGC_SOCKOPT_RECONNMINT = 1 << 5,
+		NNGC_SOCKOPT_RECONNMAXT = 1 << 6,
+		NNGC_SOCKOPT_MAXTTL = 1 << 7
+	};
+
+	// A socket configuration, blittable with a fixed layout. Only the fields named in set are used
+	typedef struct nngc_socket_options {
+		uint32_t set;
+		int32_t sendbuf;
+		int32_t recvbuf;
+		int32_t sendtimeo;
+		int32_t recvtimeo;
+		int32_t reconnmint;
+		int32_t reconnmaxt;
+		int32_t maxttl;
+		uint64_t recvmaxsz;
+	} nngc_socket_options;
+
+	// same values as nng's NNG_STAT_ and NNG_UNIT_
+	enum {
+		NNGC_STAT_SCOPE,
+		NNGC_STAT_LEVEL,
+		NNGC_STAT_COUNTER,
+		NNGC_STAT_STRING,
+		NNGC_STAT_BOOLEAN,
+		NNGC_STAT_ID
+	};
+	enum {
+		NNGC_UNIT_NONE,
+		NNGC_UNIT_BYTES,
+		NNGC_UNIT_MESSAGES,
+		NNGC_UNIT_MILLIS,
+		NNGC_UNIT_EVENTS
+	};
+
+	// One statistic of a snapshot walked depth first, see nngc_stats_flatten
+	typedef struct nngc_stat_entry {
+		nngc_stat stat;    // valid until the snapshot is freed
+		uint64_t key;      // hash of the path, the same for the same statistic in every snapshot
+		uint64_t value;    // of levels, counters, booleans and ids
+		int32_t type;      // NNGC_STAT_
+		int32_t unit;      // NNGC_UNIT_
+		int32_t parent;    // index of the enclosing scope, -1 for the root
+		uint32_t scope_id; // the "id" statistic of a scope (socket, dialer, listener, pipe), 0 if it has none
+	} nngc_stat_entry;
+
+	// readiness for nngc_poller_add and nngc_poll_event
+	enum {
+		NNGC_POLL_RECV = 1,
+		NNGC_POLL_SEND = 2
+	};
+
+	typedef struct nngc_poll_event {
+		nngc_socket socket;
+		uint32_t events; // NNGC_POLL_
+	} nngc_poll_event;
+
+	enum {
+		NNGC_STREAM_HEADER = 32 // bytes in front of every chunk
+	};
+#define NNGC_STREAM_SIZE_UNKNOWN UINT64_MAX
+
+	enum {
+		NNGC_PIPE_ADDED = 1,
+		NNGC_PIPE_REMOVED = 2
+	};
+
+	typedef struct nngc_pipe_event {
+		uint32_t pipe;
+		int32_t event;    // NNGC_PIPE_
+		uint64_t time;    // milliseconds since 1970
+		uint32_t dropped; // events lost before this one because nobody took them
+		uint32_t reserved;
+	} nngc_pipe_event;
+
+	typedef struct nngc_pipe_info {
+		uint32_t pipe;
+		uint32_t dialer;   // 0 if a listener accepted it
+		uint32_t listener; // 0 if a dialer made it
+		uint32_t reserved;
+		uint64_t connected; // milliseconds since 1970
+		// from nng's statistics, 0 without NNG_ENABLE_STATS
+		uint64_t msgs_sent;
+		uint64_t bytes_sent;
+		uint64_t msgs_received;
+		uint64_t bytes_received;
+		char remote_address[128]; // zero terminated text, empty if the transport has none
+	} nngc_pipe_info;
+
+	enum {
+		NNGC_METRICS_ERRORS = 32, // errors are counted by number, the last entry takes the larger ones
+		NNGC_METRICS_BUCKETS = 32 // latency buckets, see nngc_socket_metrics
+	};
+
+	// Counters of one socket, summed over all threads when read. Bytes are message bodies
+	typedef struct nngc_socket_metrics {
+		uint64_t msgs_sent;
+		uint64_t bytes_sent;
+		uint64_t msgs_received;
+		uint64_t bytes_received;
+		uint64_t dialer_connects;   // pipes added by a dialer of the socket
+		uint64_t listener_connects; // pipes added by a listener of the socket
+		uint64_t disconnects;       // pipes removed
+		uint64_t aio_completions;
+		// failed calls and aio operations by nng error, NNG_EAGAIN and NNG_ETIMEDOUT included
+		uint64_t errors[NNGC_METRICS_ERRORS];
+		// aio operations by time from start to completion. Bucket 0 took less than a microsecond,
+		// bucket i from 2^(i - 1) up to 2^i microseconds, the last one everything longer
+		uint64_t aio_latency[NNGC_METRICS_BUCKETS];
+	} nngc_socket_metrics;
+
+	// How a blocking receive waits, see nngc_socket_recv_wait_set
+	typedef struct nngc_recv_wait {
+		uint32_t spins;   // nonblocking tries with a cpu pause between, skipped on a single core
+		uint32_t yields;  // then tries after giving up the time slice, then nng's blocking receive
+		int32_t adaptive; // nonzero: block right away while the next message isn't expected before spinning and yielding are over
+	} nngc_recv_wait;
+
+	// Counters of the receive wait policy of a socket
+	typedef struct nngc_recv_wait_stats {
+		uint64_t spin_hits;  // receives which got their message while spinning, the first try included
+		uint64_t yield_hits; // receives which got it while yielding
+		uint64_t blocks;     // receives which went on to nng's blocking receive
+		uint64_t skips;      // of those, the ones the adaptive policy sent there right away
+		uint64_t spins;      // tries while spinning, all receives
+		uint64_t yields;     // tries while yielding, all receives
+		uint64_t gap_ns;     // average time between messages, recent ones weigh most
+		uint64_t phase_ns;   // average time spinning and yielding take when they find nothing
+	} nngc_recv_wait_stats;
+
+	// General
+
+	NNGC_API const char* nngc_strerror(int err);
+	NNGC_API const char* nngc_version(void);
+	// UTF-8 name of an NNGC_OPT_ option, nullptr if there is none
+	NNGC_API const char* nngc_option_name(int option);
+	NNGC_API void nngc_fini(void);
+	NNGC_API void nngc_closeall(void);
+
+	// Sockets, dialers and listeners. CoreSocket.cpp
+
+	NNGC_API int nngc_socket_open(int protocol, nngc_socket* socket);
+	NNGC_API int nngc_socket_close(nngc_socket socket);
+
+	NNGC_API int nngc_listen(nngc_socket socket, const char* url, size_t urlLength, nngc_listener* listener, int flags);
+	NNGC_API int nngc_dial(nngc_socket socket, const char* url, size_t urlLength, nngc_dialer* dialer, int flags);
+	NNGC_API int nngc_listener_create(nngc_socket socket, const char* url, size_t urlLength, nngc_listener* listener);
+	NNGC_API int nngc_dialer_create(nngc_socket socket, const char* url, size_t urlLength, nngc_dialer* dialer);
+	NNGC_API int nngc_listener_start(nngc_listener listener, int flags);
+	NNGC_API int nngc_dialer_start(nngc_dialer dialer, int flags);
+	NNGC_API int nngc_listener_close(nngc_listener listener);
+	NNGC_API int nngc_dialer_close(nngc_dialer dialer);
+
+	// options by NNGC_OPT_ number, NNG_ENOTSUP for an unknown one
+	NNGC_API int nngc_socket_set(nngc_socket socket, int option, const void* value, size_t size);
+	NNGC_API int nngc_socket_set_bool(nngc_socket socket, int option, int value);
+	NNGC_API int nngc_socket_set_int(nngc_socket socket, int option, int32_t value);
+	NNGC_API int nngc_socket_set_ms(nngc_socket socket, int option, int32_t value);
+	NNGC_API int nngc_socket_set_size(nngc_socket socket, int option, uint64_t value);
+	NNGC_API int nngc_socket_set_uint64(nngc_socket socket, int option, uint64_t value);
+	NNGC_API int nngc_socket_set_string(nngc_socket socket, int option, const char* value, size_t length);
+	// *size is the capacity of value on entry and the full size of the option on return, which may be larger
+	NNGC_API int nngc_socket_get(nngc_socket socket, int option, void* value, size_t* size);
+	NNGC_API int nngc_socket_get_bool(nngc_socket socket, int option, int* value);
+	NNGC_API int nngc_socket_get_int(nngc_socket socket, int option, int32_t* value);
+	NNGC_API int nngc_socket_get_ms(nngc_socket socket, int option, int32_t* value);
+	NNGC_API int nngc_socket_get_size(nngc_socket socket, int option, uint64_t* value);
+	NNGC_API int nngc_socket_get_uint64(nngc_socket socket, int option, uint64_t* value);
+
+	// stops at the first failure
+	NNGC_API int nngc_socket_options_apply(nngc_socket socket, const nngc_socket_options* options);
+	// options the socket doesn't have are left out of options->set, any other failure ends the read
+	NNGC_API int nngc_socket_options_read(nngc_socket socket, nngc_socket_options* options);
+
+	// Sending and receiving. CoreSocket.cpp
+
+	NNGC_API int nngc_send(nngc_socket socket, const void* data, size_t size, int flags);
+	// copies into buffer. A message that doesn't fit is NNG_EMSGSIZE, *received is its full length then
+	NNGC_API int nngc_recv_into(nngc_socket socket, void* buffer, size_t size, size_t* received, int flags);
+	// a buffer allocated by nng, give it back with nngc_free
+	NNGC_API int nngc_recv_alloc(nngc_socket socket, void** data, size_t* size, int flags);
+	NNGC_API void nngc_free(void* data, size_t size);
+
+	NNGC_API int nngc_sendmsg(nngc_socket socket, nngc_msg msg, int flags);
+	NNGC_API int nngc_recvmsg(nngc_socket socket, nngc_msg* msg, int flags);
+
+	// Batches, one call for many messages. *sent is how many went out before a failure
+	NNGC_API int nngc_send_many_msgs(nngc_socket socket, const nngc_msg* msgs, int count, int flags, int* sent);
+	// buffer i starts after the lengths[0 .. i - 1] bytes before it in data
+	NNGC_API int nngc_send_many_buffers(nngc_socket socket, const void* data, const int32_t* lengths, int count, int flags, int* sent);
+	// the first message may wait for timeout milliseconds (-1 forever), the rest is only what is already queued
+	NNGC_API int nngc_recv_many_msgs(nngc_socket socket, nngc_msg* msgs, int max, int timeout, int* received);
+
+	// Messages. CoreMessage.cpp
+
+	NNGC_API int nngc_msg_alloc(nngc_msg* msg, size_t size);
+	NNGC_API void nngc_msg_free(nngc_msg msg);
+	NNGC_API int nngc_msg_realloc(nngc_msg msg, size_t size);
+	NNGC_API int nngc_msg_dup(nngc_msg* dup, nngc_msg msg);
+	NNGC_API void* nngc_msg_body(nngc_msg msg);
+	NNGC_API size_t nngc_msg_len(nngc_msg msg);
+	NNGC_API void* nngc_msg_header(nngc_msg msg);
+	NNGC_API size_t nngc_msg_header_len(nngc_msg msg);
+	NNGC_API int nngc_msg_append(nngc_msg msg, const void* data, size_t size);
+	NNGC_API int nngc_msg_insert(nngc_msg msg, const void* data, size_t size);
+	NNGC_API int nngc_msg_trim(nngc_msg msg, size_t size);
+	NNGC_API int nngc_msg_chop(nngc_msg msg, size_t size);
+	NNGC_API int nngc_msg_append_u32(nngc_msg msg, uint32_t value);
+	NNGC_API int nngc_msg_insert_u32(nngc_msg msg, uint32_t value);
+	NNGC_API int nngc_msg_trim_u32(nngc_msg msg, uint32_t* value);
+	NNGC_API int nngc_msg_chop_u32(nngc_msg msg, uint32_t* value);
+	NNGC_API void nngc_msg_clear(nngc_msg msg);
+	NNGC_API int nngc_msg_header_append(nngc_msg msg, const void* data, size_t size);
+	NNGC_API int nngc_msg_header_insert(nngc_msg msg, const void* data, size_t size);
+	NNGC_API int nngc_msg_header_trim(nngc_msg msg, size_t size);
+	NNGC_API int nngc_msg_header_chop(nngc_msg msg, size_t size);
+	NNGC_API int nngc_msg_header_append_u32(nngc_msg msg, uint32_t value);
+	NNGC_API int nngc_msg_header_insert_u32(nngc_msg msg, uint32_t value);
+	NNGC_API int nngc_msg_header_trim_u32(nngc_msg msg, uint32_t* value);
+	NNGC_API int nngc_msg_header_chop_u32(nngc_msg msg, uint32_t* value);
+	NNGC_API void nngc_msg_header_clear(nngc_msg msg);
+	NNGC_API uint32_t nngc_msg_get_pipe(nngc_msg msg);
+	NNGC_API void nngc_msg_set_pipe(nngc_msg msg, uint32_t pipe);
+	// copies the body into buffer, NNG_EMSGSIZE if it doesn't fit. *size is the body length on return
+	NNGC_API int nngc_msg_copy_body(nngc_msg msg, void* buffer, size_t capacity, size_t* size);
+
+	// Aio. CoreAio.cpp
+
+	NNGC_API int nngc_aio_alloc(nngc_callback callback, void* arg, nngc_aio* aio);
+	NNGC_API void nngc_aio_free(nngc_aio aio);
+	NNGC_API void nngc_aio_stop(nngc_aio aio);
+	NNGC_API void nngc_aio_cancel(nngc_aio aio);
+	NNGC_API void nngc_aio_wait(nngc_aio aio);
+	NNGC_API int nngc_aio_result(nngc_aio aio);
+	NNGC_API void nngc_aio_set_timeout(nngc_aio aio, int32_t timeout);
+	// 0 if there is no message
+	NNGC_API nngc_msg nngc_aio_get_msg(nngc_aio aio);
+	NNGC_API void nngc_aio_set_msg(nngc_aio aio, nngc_msg msg);
+	NNGC_API void nngc_send_aio(nngc_socket socket, nngc_aio aio);
+	NNGC_API void nngc_recv_aio(nngc_socket socket, nngc_aio aio);
+	// nng's own nng_aio*, for calls the core doesn't cover. Its callback is still the one of nngc_aio_alloc
+	NNGC_API void* nngc_aio_native(nngc_aio aio);
+
+	// Metrics. CoreMetrics.cpp
+	// Counting starts with nngc_socket_metrics_enable and ends when the socket is closed. Each thread
+	// counts into its own cache line, reading adds them up without locking out senders or receivers.
+	// Built with NNGC_NO_METRICS nothing is counted, and both functions return NNG_ENOTSUP
+
+	NNGC_API int nngc_socket_metrics_enable(nngc_socket socket);
+	// NNG_ENOENT if counting wasn't enabled for the socket
+	NNGC_API int nngc_socket_metrics_read(nngc_socket socket, nngc_socket_metrics* metrics);
+
+	// Receive waiting. CoreRecvWait.cpp
+	// With a policy, nngc_recv_into, nngc_recv_alloc, nngc_recvmsg and nngc_recv_many_msgs without a timeout
+	// spin and yield on nonblocking receives before they block, for consumers on a core of their own.
+	// Nonblocking receives and aio are not affected. The recv-timeout of the socket starts when they block
+
+	// replaces the socket's policy, nullptr removes it. Its counters are kept until then
+	NNGC_API int nngc_socket_recv_wait_set(nngc_socket socket, const nngc_recv_wait* policy);
+	// NNG_ENOENT if the socket has no policy
+	NNGC_API int nngc_socket_recv_wait_stats(nngc_socket socket, nngc_recv_wait_stats* stats);
+
+	// Pipes. CorePipes.cpp
+	// nngc_socket_pipes_watch starts tracking the pipes of a socket and queueing their added and removed
+	// events, call it before dialing or listening. nngc_pipe_event_recv completes the aio with the next
+	// event, which nngc_aio_pipe_event reads in its callback
+
+	NNGC_API int nngc_socket_pipes_watch(nngc_socket socket);
+	// NNG_ESTATE if the socket isn't watched
+	NNGC_API void nngc_pipe_event_recv(nngc_socket socket, nngc_aio aio);
+	NNGC_API int nngc_aio_pipe_event(nngc_aio aio, nngc_pipe_event* event);
+	// the connected pipes, *count is their number. NNG_ENOSPC if that is more than capacity
+	NNGC_API int nngc_socket_pipes(nngc_socket socket, nngc_pipe_info* pipes, int capacity, int* count);
+	// sends to one pipe, on NNGC_PROTO_PAIR1_POLY sockets. NNG_ENOTSUP for the others, where nng picks the pipe
+	NNGC_API int nngc_sendmsg_to(nngc_socket socket, nngc_msg msg, uint32_t pipe, int flags);
+	NNGC_API int nngc_pipe_close(uint32_t pipe);
+
+	// Streaming. CoreStream.cpp
+	// A transfer of any size over a Pair0 or (not polyamorous) Pair1 socket, in chunks of chunk_size bytes. The receiver
+	// acknowledges them, the sender has at most window chunks on the way, so neither side holds more than
+	// window * chunk_size bytes however large the transfer is. Both wait as long as the recv-timeout of the socket.
+	// NNGC_STREAM_HEADER + chunk_size has to fit the recv-size-max of the receiver, nng drops larger chunks
+
+	// total is announced to the receiver, NNGC_STREAM_SIZE_UNKNOWN if the source doesn't know. *sent counts the bytes read
+	NNGC_API int nngc_stream_send(nngc_socket socket, uint32_t chunk_size, uint32_t window, uint64_t total,
+		nngc_stream_read read, void* arg, uint64_t* sent);
+	// waits for the next transfer, begin may be nullptr. NNG_EPROTO if chunks are missing, NNG_ECONNABORTED if the sender gave up
+	NNGC_API int nngc_stream_recv(nngc_socket socket, nngc_stream_begin begin, nngc_stream_write write, void* arg, uint64_t* received);
+
+	// Shared memory. CoreShm.cpp
+	// A channel between two processes on one host through a mapped segment, one ring per direction. The sender writes
+	// a message right into the ring and the receiver reads it there, no copy goes through the kernel. The url is
+	// shm://name, the listener creates the segment and removes the name again on close, one dialer maps it.
+	// One thread sends and one receives at a time. timeout is in milliseconds, -1 waits forever, 0 not at all (NNG_EAGAIN)
+
+	// capacity in bytes per direction, rounded up to a power of 2, 0 for 1 MB. NNG_EADDRINUSE if the name is taken
+	NNGC_API int nngc_shm_listen(const char* url, size_t urlLength, uint32_t capacity, nngc_shm* shm);
+	// NNG_ECONNREFUSED if nobody listens on the name, NNG_EBUSY if another dialer got there first
+	NNGC_API int nngc_shm_dial(const char* url, size_t urlLength, nngc_shm* shm);
+	// removes the name of a segment, for one left behind by a listener that crashed (NNG_EADDRINUSE on listen
+	// ever after). Processes which have it mapped keep it. NNG_ENOENT if there is none; on Windows the system
+	// removes a segment with its last handle, so there never is one
+	NNGC_API int nngc_shm_unlink(const char* url, size_t urlLength);
+	// ends the calls in progress with NNG_ECLOSED, the peer receives what was sent before. Calls with the
+	// handle after close return NNG_ECLOSED, the segment is unmapped when the last call in progress returns
+	NNGC_API void nngc_shm_close(nngc_shm shm);
+	// the largest message, half the capacity less 8 bytes. Larger ones are NNG_EMSGSIZE
+	NNGC_API size_t nngc_shm_max_size(nngc_shm shm);
+	NNGC_API int nngc_shm_send(nngc_shm shm, const void* data, size_t size, int32_t timeout);
+	// reserves size bytes in the ring for the caller to write into, send_end publishes size bytes of them at most
+	NNGC_API int nngc_shm_send_begin(nngc_shm shm, size_t size, void** buffer, int32_t timeout);
+	NNGC_API int nngc_shm_send_end(nngc_shm shm, size_t size);
+	// the next message in place, valid until recv_end gives its room back to the sender
+	NNGC_API int nngc_shm_recv_begin(nngc_shm shm, const void** data, size_t* size, int32_t timeout);
+	NNGC_API int nngc_shm_recv_end(nngc_shm shm);
+	// copies the next message. NNG_EMSGSIZE if it doesn't fit, it stays in the ring then and *received is its length
+	NNGC_API int nngc_shm_recv_into(nngc_shm shm, void* buffer, size_t capacity, size_t* received, int32_t timeout);
+
+	// Statistics. CoreStats.cpp
+	// nng's statistics of sockets, dialers, listeners and pipes, as a snapshot tree
+
+	NNGC_API int nngc_stats_get(nngc_stat* stats);
+	NNGC_API void nngc_stats_free(nngc_stat stats);
+	// 0 if there is none
+	NNGC_API nngc_stat nngc_stat_child(nngc_stat stat);
+	NNGC_API nngc_stat nngc_stat_next(nngc_stat stat);
+	NNGC_API const char* nngc_stat_name(nngc_stat stat);
+	NNGC_API const char* nngc_stat_desc(nngc_stat stat);
+	NNGC_API int nngc_stat_type(nngc_stat stat);
+	NNGC_API int nngc_stat_unit(nngc_stat stat);
+	NNGC_API uint64_t nngc_stat_value(nngc_stat stat);
+	// of NNGC_STAT_STRING, nullptr for the others
+	NNGC_API const char* nngc_stat_string(nngc_stat stat);
+	// milliseconds, when the value was taken
+	NNGC_API uint64_t nngc_stat_timestamp(nngc_stat stat);
+	// The whole tree in one call, for polling without a call per statistic. *count is the number of
+	// statistics, if that is more than capacity the result is NNG_ENOSPC and entries holds the first ones
+	NNGC_API int nngc_stats_flatten(nngc_stat stats, nngc_stat_entry* entries, int capacity, int* count);
+
+	// Poller. CorePoller.cpp
+	// Waits on the recv-fd and send-fd of many sockets at once, with epoll on Linux and (WSA)poll elsewhere.
+	// Readiness is level triggered, a socket is reported until a nonblocking receive or send would fail.
+	// One thread waits at a time, sockets may be added and removed from others
+
+	NNGC_API int nngc_poller_create(nngc_poller* poller);
+	NNGC_API void nngc_poller_destroy(nngc_poller poller);
+	// adds the socket or changes its events. nngc_socket_close removes it from all pollers
+	NNGC_API int nngc_poller_add(nngc_poller poller, nngc_socket socket, uint32_t events);
+	NNGC_API int nngc_poller_remove(nngc_poller poller, nngc_socket socket);
+	NNGC_API int nngc_poller_count(nngc_poller poller);
+	// up to max ready sockets, one entry each. timeout in milliseconds, -1 forever. *count is 0 on timeout or wake
+	NNGC_API int nngc_poller_wait(nngc_poller poller, nngc_poll_event* events, int max, int32_t timeout, int* count);
+	// ends a wait in progress, or the next one
+	NNGC_API void nngc_poller_wake(nngc_poller poller);
+
+#ifdef __cplusplus
+}
+#endif
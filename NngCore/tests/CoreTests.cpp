@@ -0,0 +1,731 @@
+/*
+Nng core
+
+Native tests of the C interface, the counterpart of NngTests for the shared library.
+Every test gets fresh sockets on its own inproc URLs, a failed check ends only that test.
+
+
+
+
+*/
+
+#include "nngcore.h"
+#include "nng.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+struct CheckFailed {};
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			throw CheckFailed(); \
+		} \
+	} while (0)
+
+#define CHECK_OK(call) \
+	do { \
+		int rv_ = (call); \
+		if (rv_ != 0) { \
+			std::fprintf(stderr, "%s:%d: %s returned %d (%s)\n", __FILE__, __LINE__, #call, rv_, nngc_strerror(rv_)); \
+			throw CheckFailed(); \
+		} \
+	} while (0)
+
+static int listen(nngc_socket socket, const std::string& url)
+{
+	nngc_listener l;
+	return nngc_listen(socket, url.data(), url.size(), &l, 0);
+}
+
+static int dial(nngc_socket socket, const std::string& url)
+{
+	nngc_dialer d;
+	return nngc_dial(socket, url.data(), url.size(), &d, 0);
+}
+
+// a connected Pair0 pair, closed on scope exit
+struct Pair {
+	nngc_socket a = 0, b = 0;
+
+	explicit Pair(const std::string& url)
+	{
+		CHECK_OK(nngc_socket_open(NNGC_PROTO_PAIR0, &a));
+		CHECK_OK(nngc_socket_open(NNGC_PROTO_PAIR0, &b));
+		CHECK_OK(nngc_socket_set_ms(a, NNGC_OPT_RECVTIMEO, 1000));
+		CHECK_OK(nngc_socket_set_ms(b, NNGC_OPT_RECVTIMEO, 1000));
+		CHECK_OK(listen(a, url));
+		CHECK_OK(dial(b, url));
+	}
+
+	~Pair()
+	{
+		if (a != 0) nngc_socket_close(a);
+		if (b != 0) nngc_socket_close(b);
+	}
+};
+
+static void testOptionNames()
+{
+	CHECK(std::strcmp(nngc_option_name(NNGC_OPT_RECVMAXSZ), "recv-size-max") == 0);
+	CHECK(std::strcmp(nngc_option_name(NNGC_OPT_RECONNMAXT), "reconnect-time-max") == 0);
+	CHECK(nngc_option_name(-1) == nullptr);
+	CHECK(nngc_option_name(NNGC_OPT_COUNT) == nullptr);
+	CHECK(nngc_version() != nullptr);
+}
+
+static void testOpenEveryProtocol()
+{
+	for (int p = 0; p < NNGC_PROTO_COUNT; p++) {
+		nngc_socket s;
+		CHECK_OK(nngc_socket_open(p, &s));
+		CHECK(s != 0);
+		CHECK_OK(nngc_socket_close(s));
+	}
+	nngc_socket s;
+	CHECK(nngc_socket_open(NNGC_PROTO_COUNT, &s) == NNG_ENOTSUP);
+	CHECK(s == 0);
+
+	int raw = 0;
+	CHECK_OK(nngc_socket_open(NNGC_PROTO_REQ0_RAW, &s));
+	CHECK_OK(nngc_socket_get_bool(s, NNGC_OPT_RAW, &raw));
+	CHECK(raw != 0);
+	CHECK_OK(nngc_socket_close(s));
+}
+
+static void testOptions()
+{
+	nngc_socket s;
+	CHECK_OK(nngc_socket_open(NNGC_PROTO_REQ0, &s));
+	CHECK_OK(nngc_socket_set_size(s, NNGC_OPT_RECVMAXSZ, 12345));
+	uint64_t size;
+	CHECK_OK(nngc_socket_get_size(s, NNGC_OPT_RECVMAXSZ, &size));
+	CHECK(size == 12345);
+	CHECK(nngc_socket_set_int(s, NNGC_OPT_COUNT, 1) == NNG_ENOTSUP);
+
+	nngc_socket_options o = {};
+	o.set = NNGC_SOCKOPT_SENDTIMEO | NNGC_SOCKOPT_RECVBUF | NNGC_SOCKOPT_RECONNMINT;
+	o.sendtimeo = 250;
+	o.recvbuf = 16;
+	o.reconnmint = 20;
+	CHECK_OK(nngc_socket_options_apply(s, &o));
+	nngc_socket_options read = {};
+	CHECK_OK(nngc_socket_options_read(s, &read));
+	CHECK((read.set & o.set) == o.set);
+	CHECK(read.sendtimeo == 250);
+	CHECK(read.recvbuf == 16);
+	CHECK(read.reconnmint == 20);
+	CHECK(read.recvmaxsz == 12345);
+	nngc_socket_close(s);
+}
+
+static void testSendReceiveBuffers()
+{
+	Pair pair("inproc://nngcore-buffers");
+	const char text[] = "hello world";
+	CHECK_OK(nngc_send(pair.a, text, 5, 0)); // only "hello"
+	char buffer[16];
+	size_t received;
+	CHECK_OK(nngc_recv_into(pair.b, buffer, sizeof(buffer), &received, 0));
+	CHECK(received == 5);
+	CHECK(std::memcmp(buffer, "hello", 5) == 0);
+
+	CHECK_OK(nngc_send(pair.a, text, sizeof(text), 0));
+	CHECK(nngc_recv_into(pair.b, buffer, 4, &received, 0) == NNG_EMSGSIZE);
+	CHECK(received == sizeof(text));
+
+	CHECK_OK(nngc_send(pair.b, text, sizeof(text), 0));
+	void* data;
+	size_t size;
+	CHECK_OK(nngc_recv_alloc(pair.a, &data, &size, 0));
+	CHECK(size == sizeof(text));
+	CHECK(std::memcmp(data, text, size) == 0);
+	nngc_free(data, size);
+
+	CHECK(nngc_recv_into(pair.a, buffer, sizeof(buffer), &received, NNG_FLAG_NONBLOCK) == NNG_EAGAIN);
+}
+
+static void testMessages()
+{
+	nngc_msg msg;
+	CHECK_OK(nngc_msg_alloc(&msg, 0));
+	CHECK_OK(nngc_msg_append(msg, "abc", 3));
+	CHECK_OK(nngc_msg_append_u32(msg, 0x01020304));
+	CHECK_OK(nngc_msg_insert(msg, "x", 1));
+	CHECK(nngc_msg_len(msg) == 8);
+	uint32_t value;
+	CHECK_OK(nngc_msg_chop_u32(msg, &value));
+	CHECK(value == 0x01020304);
+	CHECK_OK(nngc_msg_trim(msg, 1));
+	char body[8];
+	size_t size;
+	CHECK_OK(nngc_msg_copy_body(msg, body, sizeof(body), &size));
+	CHECK(size == 3 && std::memcmp(body, "abc", 3) == 0);
+	CHECK(nngc_msg_copy_body(msg, body, 2, &size) == NNG_EMSGSIZE);
+	CHECK(size == 3);
+
+	CHECK_OK(nngc_msg_header_append_u32(msg, 0x80000001u));
+	CHECK(nngc_msg_header_len(msg) == 4);
+	nngc_msg dup;
+	CHECK_OK(nngc_msg_dup(&dup, msg));
+	CHECK(dup != msg);
+	CHECK_OK(nngc_msg_header_trim_u32(dup, &value));
+	CHECK(value == 0x80000001u);
+	CHECK(nngc_msg_header_len(msg) == 4); // the original is untouched
+	nngc_msg_header_clear(msg);
+	CHECK(nngc_msg_header_len(msg) == 0);
+	nngc_msg_clear(msg);
+	CHECK(nngc_msg_len(msg) == 0);
+	nngc_msg_free(dup);
+	nngc_msg_free(msg);
+	nngc_msg_free(0); // ignored
+}
+
+static void testSendReceiveMsgs()
+{
+	Pair pair("inproc://nngcore-msgs");
+	nngc_msg msg;
+	CHECK_OK(nngc_msg_alloc(&msg, 0));
+	CHECK_OK(nngc_msg_append_u32(msg, 42));
+	CHECK_OK(nngc_sendmsg(pair.a, msg, 0)); // nng owns it now
+	nngc_msg in;
+	CHECK_OK(nngc_recvmsg(pair.b, &in, 0));
+	uint32_t value;
+	CHECK_OK(nngc_msg_trim_u32(in, &value));
+	CHECK(value == 42);
+	CHECK(nngc_msg_get_pipe(in) != 0);
+	nngc_msg_free(in);
+}
+
+static void testBatches()
+{
+	Pair pair("inproc://nngcore-batches");
+	CHECK_OK(nngc_socket_set_int(pair.b, NNGC_OPT_RECVBUF, 64));
+	CHECK_OK(nngc_socket_set_int(pair.a, NNGC_OPT_SENDBUF, 64));
+
+	const char data[] = "onetwothree";
+	int32_t lengths[] = { 3, 3, 5 };
+	int sent;
+	CHECK_OK(nngc_send_many_buffers(pair.a, data, lengths, 3, 0, &sent));
+	CHECK(sent == 3);
+
+	nngc_msg msgs[2];
+	CHECK_OK(nngc_msg_alloc(&msgs[0], 0));
+	CHECK_OK(nngc_msg_append(msgs[0], "four", 4));
+	CHECK_OK(nngc_msg_alloc(&msgs[1], 0));
+	CHECK_OK(nngc_msg_append(msgs[1], "five", 4));
+	CHECK_OK(nngc_send_many_msgs(pair.a, msgs, 2, 0, &sent));
+	CHECK(sent == 2);
+
+	// the batch takes only what is queued, wait until it all arrived
+	std::vector<nngc_msg> in(8);
+	int received = 0;
+	int total = 0;
+	std::vector<std::string> bodies;
+	for (int tries = 0; total < 5 && tries < 100; tries++) {
+		CHECK_OK(nngc_recv_many_msgs(pair.b, in.data(), static_cast<int>(in.size()), 1000, &received));
+		for (int i = 0; i < received; i++) {
+			bodies.emplace_back(static_cast<char*>(nngc_msg_body(in[i])), nngc_msg_len(in[i]));
+			nngc_msg_free(in[i]);
+		}
+		total += received;
+	}
+	CHECK(total == 5);
+	CHECK(bodies[0] == "one" && bodies[2] == "three" && bodies[4] == "five");
+	CHECK(nngc_recv_many_msgs(pair.b, in.data(), 8, 0, &received) == NNG_EAGAIN);
+	CHECK(received == 0);
+}
+
+struct AioState {
+	nngc_aio aio = 0;
+	std::atomic<int> calls{ 0 };
+	std::atomic<int> result{ -1 };
+};
+
+static void aioCallback(void* arg)
+{
+	auto state = static_cast<AioState*>(arg);
+	state->result = nngc_aio_result(state->aio);
+	state->calls++;
+}
+
+static void testAioCallback()
+{
+	Pair pair("inproc://nngcore-aio");
+	AioState state;
+	CHECK_OK(nngc_aio_alloc(aioCallback, &state, &state.aio));
+	nngc_aio_set_timeout(state.aio, 2000);
+	nngc_recv_aio(pair.b, state.aio);
+
+	nngc_aio sender;
+	CHECK_OK(nngc_aio_alloc(nullptr, nullptr, &sender));
+	nngc_msg msg;
+	CHECK_OK(nngc_msg_alloc(&msg, 0));
+	CHECK_OK(nngc_msg_append(msg, "aio", 3));
+	nngc_aio_set_msg(sender, msg);
+	nngc_send_aio(pair.a, sender);
+	nngc_aio_wait(sender);
+	CHECK_OK(nngc_aio_result(sender));
+	nngc_aio_free(sender);
+
+	nngc_aio_wait(state.aio);
+	for (int i = 0; i < 100 && state.calls.load() == 0; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	CHECK(state.calls.load() == 1);
+	CHECK(state.result.load() == 0);
+	nngc_msg in = nngc_aio_get_msg(state.aio);
+	CHECK(in != 0);
+	CHECK(nngc_msg_len(in) == 3);
+	nngc_msg_free(in);
+
+	// a cancelled receive completes with NNG_ECANCELED
+	nngc_recv_aio(pair.b, state.aio);
+	nngc_aio_cancel(state.aio);
+	nngc_aio_wait(state.aio);
+	for (int i = 0; i < 100 && state.calls.load() == 1; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	CHECK(state.calls.load() == 2);
+	CHECK(state.result.load() == NNG_ECANCELED);
+	nngc_aio_free(state.aio);
+}
+
+static void testReqRep()
+{
+	nngc_socket req, rep;
+	CHECK_OK(nngc_socket_open(NNGC_PROTO_REP0, &rep));
+	CHECK_OK(nngc_socket_open(NNGC_PROTO_REQ0, &req));
+	CHECK_OK(listen(rep, "inproc://nngcore-reqrep"));
+	CHECK_OK(dial(req, "inproc://nngcore-reqrep"));
+	CHECK_OK(nngc_send(req, "ping", 4, 0));
+	nngc_msg msg;
+	CHECK_OK(nngc_recvmsg(rep, &msg, 0));
+	CHECK_OK(nngc_sendmsg(rep, msg, 0)); // echo, the header routes it back
+	char buffer[8];
+	size_t received;
+	CHECK_OK(nngc_recv_into(req, buffer, sizeof(buffer), &received, 0));
+	CHECK(received == 4 && std::memcmp(buffer, "ping", 4) == 0);
+	nngc_socket_close(req);
+	nngc_socket_close(rep);
+}
+
+static void testMetrics()
+{
+	nngc_socket a, b;
+	CHECK_OK(nngc_socket_open(NNGC_PROTO_PAIR0, &a));
+	CHECK_OK(nngc_socket_open(NNGC_PROTO_PAIR0, &b));
+	int enabled = nngc_socket_metrics_enable(a);
+	if (enabled == NNG_ENOTSUP) { // built with NNGC_NO_METRICS
+		nngc_socket_close(a);
+		nngc_socket_close(b);
+		return;
+	}
+	CHECK_OK(enabled);
+	CHECK_OK(nngc_socket_metrics_enable(b));
+	CHECK_OK(listen(a, "inproc://nngcore-metrics"));
+	CHECK_OK(dial(b, "inproc://nngcore-metrics"));
+
+	CHECK_OK(nngc_send(b, "12345", 5, 0));
+	char buffer[8];
+	size_t received;
+	CHECK_OK(nngc_recv_into(a, buffer, sizeof(buffer), &received, 0));
+	CHECK(nngc_recv_into(a, buffer, sizeof(buffer), &received, NNG_FLAG_NONBLOCK) == NNG_EAGAIN);
+
+	AioState state;
+	CHECK_OK(nngc_aio_alloc(aioCallback, &state, &state.aio));
+	nngc_recv_aio(a, state.aio);
+	CHECK_OK(nngc_send(b, "123", 3, 0));
+	nngc_aio_wait(state.aio);
+	CHECK_OK(nngc_aio_result(state.aio));
+	nngc_msg_free(nngc_aio_get_msg(state.aio));
+	nngc_aio_free(state.aio);
+
+	nngc_socket_metrics sent, got;
+	CHECK_OK(nngc_socket_metrics_read(b, &sent));
+	CHECK_OK(nngc_socket_metrics_read(a, &got));
+	CHECK(sent.msgs_sent == 2 && sent.bytes_sent == 8);
+	CHECK(sent.dialer_connects == 1);
+	CHECK(got.msgs_received == 2 && got.bytes_received == 8);
+	CHECK(got.listener_connects == 1);
+	CHECK(got.errors[NNG_EAGAIN] == 1);
+	CHECK(got.aio_completions == 1);
+	uint64_t buckets = 0;
+	for (uint64_t count : got.aio_latency) buckets += count;
+	CHECK(buckets == 1);
+
+	nngc_socket_close(a);
+	nngc_socket_close(b);
+	CHECK(nngc_socket_metrics_read(a, &got) == NNG_ENOENT);
+}
+
+static void testPipes()
+{
+	const std::string url = "inproc://nngcore-pipes";
+	nngc_socket hub, one, two;
+	CHECK_OK(nngc_socket_open(NNGC_PROTO_PAIR1_POLY, &hub));
+	CHECK_OK(nngc_socket_open(NNGC_PROTO_PAIR1, &one));
+	CHECK_OK(nngc_socket_open(NNGC_PROTO_PAIR1, &two));
+	CHECK_OK(nngc_socket_set_ms(hub, NNGC_OPT_RECVTIMEO, 1000));
+	CHECK_OK(nngc_socket_set_ms(one, NNGC_OPT_RECVTIMEO, 1000));
+	CHECK_OK(nngc_socket_set_ms(two, NNGC_OPT_RECVTIMEO, 1000));
+	AioState state;
+	CHECK_OK(nngc_aio_alloc(aioCallback, &state, &state.aio));
+	nngc_aio_set_timeout(state.aio, 2000);
+	nngc_pipe_event_recv(one, state.aio);
+	nngc_aio_wait(state.aio);
+	CHECK(nngc_aio_result(state.aio) == NNG_ESTATE);
+
+	CHECK_OK(nngc_socket_pipes_watch(hub));
+	CHECK_OK(listen(hub, url));
+	CHECK_OK(dial(one, url));
+	CHECK_OK(dial(two, url));
+	nngc_pipe_event event;
+	for (int i = 0; i < 2; i++) {
+		nngc_pipe_event_recv(hub, state.aio);
+		nngc_aio_wait(state.aio);
+		CHECK_OK(nngc_aio_pipe_event(state.aio, &event));
+		CHECK(event.event == NNGC_PIPE_ADDED && event.pipe != 0 && event.dropped == 0);
+	}
+	nngc_pipe_info pipes[2];
+	int count;
+	CHECK(nngc_socket_pipes(hub, pipes, 1, &count) == NNG_ENOSPC && count == 2);
+	CHECK_OK(nngc_socket_pipes(hub, pipes, 2, &count));
+	CHECK(count == 2 && pipes[0].listener != 0 && pipes[0].dialer == 0 && pipes[0].connected != 0);
+
+	// answer each client on the pipe its message came from
+	CHECK_OK(nngc_send(two, "two", 3, 0));
+	nngc_msg msg;
+	CHECK_OK(nngc_recvmsg(hub, &msg, 0));
+	uint32_t pipe = nngc_msg_get_pipe(msg);
+	CHECK_OK(nngc_sendmsg_to(hub, msg, pipe, 0));
+	char buffer[8];
+	size_t received;
+	CHECK_OK(nngc_recv_into(two, buffer, sizeof(buffer), &received, 0));
+	CHECK(received == 3 && std::memcmp(buffer, "two", 3) == 0);
+	CHECK(nngc_recv_into(one, buffer, sizeof(buffer), &received, NNG_FLAG_NONBLOCK) == NNG_EAGAIN);
+	CHECK_OK(nngc_msg_alloc(&msg, 0));
+	CHECK(nngc_sendmsg_to(one, msg, pipe, 0) == NNG_ENOTSUP);
+	nngc_msg_free(msg);
+
+	CHECK_OK(nngc_pipe_close(pipe));
+	nngc_pipe_event_recv(hub, state.aio);
+	nngc_aio_wait(state.aio);
+	CHECK_OK(nngc_aio_pipe_event(state.aio, &event));
+	CHECK(event.event == NNGC_PIPE_REMOVED && event.pipe == pipe);
+
+	// a pending receive ends with the socket
+	nngc_socket_close(one);
+	nngc_socket_close(two);
+	do {
+		nngc_aio_set_timeout(state.aio, 100);
+		nngc_pipe_event_recv(hub, state.aio);
+		nngc_aio_wait(state.aio);
+	} while (nngc_aio_result(state.aio) == 0); // two redialing, then both going away
+	CHECK(nngc_aio_result(state.aio) == NNG_ETIMEDOUT);
+	nngc_aio_set_timeout(state.aio, 2000);
+	nngc_pipe_event_recv(hub, state.aio);
+	nngc_socket_close(hub);
+	nngc_aio_wait(state.aio);
+	CHECK(nngc_aio_result(state.aio) == NNG_ECLOSED);
+	nngc_aio_free(state.aio);
+}
+
+struct StreamSource {
+	uint64_t position;
+	uint64_t total;
+};
+
+static int streamRead(void* arg, void* buffer, size_t capacity, size_t* size)
+{
+	auto source = static_cast<StreamSource*>(arg);
+	uint64_t left = source->total - source->position;
+	*size = (left < capacity) ? static_cast<size_t>(left) : capacity;
+	for (size_t i = 0; i < *size; i++) static_cast<unsigned char*>(buffer)[i] = static_cast<unsigned char>((source->position + i) * 7);
+	source->position += *size;
+	return 0;
+}
+
+struct StreamTarget {
+	uint64_t total = 0;
+	uint64_t written = 0;
+	bool wrong = false;
+};
+
+static int streamBegin(void* arg, uint64_t total)
+{
+	static_cast<StreamTarget*>(arg)->total = total;
+	return 0;
+}
+
+static int streamWrite(void* arg, uint64_t offset, const void* data, size_t size)
+{
+	auto target = static_cast<StreamTarget*>(arg);
+	if (offset != target->written) target->wrong = true;
+	for (size_t i = 0; i < size; i++) {
+		if (static_cast<const unsigned char*>(data)[i] != static_cast<unsigned char>((offset + i) * 7)) target->wrong = true;
+	}
+	target->written += size;
+	return 0;
+}
+
+static int streamRefuse(void*, uint64_t)
+{
+	return NNG_ENOSPC;
+}
+
+static void testStream()
+{
+	Pair pair("inproc://nngcore-stream");
+	// more chunks than the window, the last one short
+	StreamSource source = { 0, 3 * 1000 * 1000 + 17 };
+	StreamTarget target;
+	uint64_t sent, received;
+	int receiveResult = -1;
+	std::thread receiver([&] { receiveResult = nngc_stream_recv(pair.b, streamBegin, streamWrite, &target, &received); });
+	int sendResult = nngc_stream_send(pair.a, 64 * 1024, 4, source.total, streamRead, &source, &sent);
+	receiver.join();
+	CHECK_OK(sendResult);
+	CHECK_OK(receiveResult);
+	CHECK(sent == source.total && received == source.total);
+	CHECK(target.total == source.total && target.written == source.total && !target.wrong);
+
+	// the receiver gives up, the sender is told
+	source.position = 0;
+	receiver = std::thread([&] { receiveResult = nngc_stream_recv(pair.b, streamRefuse, streamWrite, &target, &received); });
+	sendResult = nngc_stream_send(pair.a, 64 * 1024, 4, source.total, streamRead, &source, &sent);
+	receiver.join();
+	CHECK(receiveResult == NNG_ENOSPC);
+	CHECK(sendResult == NNG_ECONNABORTED);
+	CHECK(nngc_stream_send(pair.a, 0, 4, 0, streamRead, &source, &sent) == NNG_EINVAL);
+}
+
+static void testShm()
+{
+	// a name of its own, a crashed run may have left the last one behind
+	std::string url = "shm://nngcore-test-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+	nngc_shm listener, dialer;
+	CHECK(nngc_shm_dial(url.data(), url.size(), &dialer) == NNG_ECONNREFUSED);
+	CHECK_OK(nngc_shm_listen(url.data(), url.size(), 4096, &listener));
+	CHECK(nngc_shm_listen(url.data(), url.size(), 4096, &dialer) == NNG_EADDRINUSE);
+	CHECK_OK(nngc_shm_dial(url.data(), url.size(), &dialer));
+	nngc_shm second;
+	CHECK(nngc_shm_dial(url.data(), url.size(), &second) == NNG_EBUSY);
+	CHECK(nngc_shm_max_size(listener) == 2040);
+
+	// many times around the ring, with every record size
+	const int count = 20000;
+	std::atomic<bool> wrong{ false };
+	std::thread receiver([&] {
+		std::vector<unsigned char> buffer(2040);
+		for (int i = 0; i < count; i++) {
+			size_t size;
+			if (nngc_shm_recv_into(dialer, buffer.data(), buffer.size(), &size, 5000) != 0 ||
+				size != static_cast<size_t>(i % 2041) || (size > 0 && buffer[size - 1] != static_cast<unsigned char>(i))) {
+				wrong = true;
+				return;
+			}
+		}
+	});
+	for (int i = 0; i < count; i++) {
+		void* buffer;
+		size_t size = i % 2041;
+		CHECK_OK(nngc_shm_send_begin(listener, size, &buffer, 5000));
+		std::memset(buffer, static_cast<unsigned char>(i), size);
+		CHECK_OK(nngc_shm_send_end(listener, size));
+	}
+	receiver.join();
+	CHECK(!wrong);
+
+	// the other way, read in place
+	CHECK_OK(nngc_shm_send(dialer, "hello", 5, 0));
+	const void* data;
+	size_t size;
+	CHECK_OK(nngc_shm_recv_begin(listener, &data, &size, 0));
+	CHECK(size == 5 && std::memcmp(data, "hello", 5) == 0);
+	CHECK(nngc_shm_recv_begin(listener, &data, &size, 0) == NNG_ESTATE);
+	CHECK_OK(nngc_shm_recv_end(listener));
+	CHECK(nngc_shm_recv_begin(listener, &data, &size, 0) == NNG_EAGAIN);
+	CHECK(nngc_shm_recv_begin(listener, &data, &size, 20) == NNG_ETIMEDOUT);
+
+	// too large for the buffer, the message stays
+	char small[4];
+	CHECK_OK(nngc_shm_send(dialer, "too large", 9, 0));
+	CHECK(nngc_shm_recv_into(listener, small, sizeof(small), &size, 0) == NNG_EMSGSIZE && size == 9);
+	char large[16];
+	CHECK_OK(nngc_shm_recv_into(listener, large, sizeof(large), &size, 0));
+	CHECK(size == 9 && std::memcmp(large, "too large", 9) == 0);
+	CHECK(nngc_shm_send(dialer, large, 2041, 0) == NNG_EMSGSIZE);
+
+	// the full ring makes the sender wait
+	while (nngc_shm_send(listener, large, 16, 0) == 0) {}
+	CHECK(nngc_shm_send(listener, large, 16, 0) == NNG_EAGAIN);
+
+	// what was sent before the close is still received, then the channel is closed
+	CHECK_OK(nngc_shm_send(dialer, "last", 4, 0));
+	int lastResult = -1, waitResult = -1;
+	std::thread waiter([&] {
+		lastResult = nngc_shm_recv_into(listener, large, sizeof(large), &size, 5000);
+		waitResult = nngc_shm_recv_into(listener, large, sizeof(large), &size, 5000);
+	});
+	nngc_shm_close(dialer);
+	waiter.join();
+	CHECK(lastResult == 0 && waitResult == NNG_ECLOSED);
+	CHECK(nngc_shm_send(listener, large, 1, 0) == NNG_ECLOSED);
+	nngc_shm_close(listener);
+	CHECK(nngc_shm_dial(url.data(), url.size(), &dialer) == NNG_ECONNREFUSED);
+	// a closed handle is refused, not used
+	CHECK(nngc_shm_send(listener, large, 1, 0) == NNG_ECLOSED);
+	CHECK(nngc_shm_max_size(listener) == 0);
+	nngc_shm_close(listener);
+
+	// closed by another thread while waiting on its own side
+	CHECK_OK(nngc_shm_listen(url.data(), url.size(), 4096, &listener));
+	int closedResult = -1;
+	std::thread blocked([&] { closedResult = nngc_shm_recv_into(listener, large, sizeof(large), &size, -1); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	nngc_shm_close(listener);
+	blocked.join();
+	CHECK(closedResult == NNG_ECLOSED);
+
+	// a name left behind by a listener that crashed is taken back with nngc_shm_unlink
+	CHECK_OK(nngc_shm_listen(url.data(), url.size(), 4096, &listener));
+	int unlinked = nngc_shm_unlink(url.data(), url.size());
+	CHECK(unlinked == 0 || unlinked == NNG_ENOENT); // NNG_ENOENT where the system removes it by itself
+	if (unlinked == 0) {
+		CHECK_OK(nngc_shm_listen(url.data(), url.size(), 4096, &second));
+		nngc_shm_close(second);
+	}
+	nngc_shm_close(listener);
+	CHECK(nngc_shm_unlink(url.data(), url.size()) == NNG_ENOENT);
+}
+
+static void testRecvWait()
+{
+	Pair pair("inproc://nngcore-recvwait");
+	nngc_recv_wait policy = { 2000, 10, 1 };
+	nngc_recv_wait_stats stats;
+	CHECK(nngc_socket_recv_wait_stats(pair.b, &stats) == NNG_ENOENT);
+	CHECK_OK(nngc_socket_recv_wait_set(pair.b, &policy));
+	CHECK(nngc_socket_recv_wait_set(0xffffff, &policy) != 0);
+
+	const int count = 200;
+	std::atomic<int> sendFailures(0);
+	std::thread sender([&] {
+		for (int i = 0; i < count; i++) {
+			if (nngc_send(pair.a, &i, sizeof(i), 0) != 0) sendFailures++;
+			if (i % 50 == 49) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+	});
+	int n;
+	size_t received;
+	for (int i = 0; i < count; i++) {
+		CHECK_OK(nngc_recv_into(pair.b, &n, sizeof(n), &received, 0));
+		CHECK(received == sizeof(n) && n == i);
+	}
+	sender.join();
+	CHECK(sendFailures == 0);
+	// nonblocking receives don't wait
+	CHECK(nngc_recv_into(pair.b, &n, sizeof(n), &received, NNG_FLAG_NONBLOCK) == NNG_EAGAIN);
+
+	CHECK_OK(nngc_socket_recv_wait_stats(pair.b, &stats));
+	CHECK(stats.spin_hits + stats.yield_hits + stats.blocks == count);
+	CHECK(stats.skips <= stats.blocks);
+	CHECK(stats.gap_ns > 0);
+
+	// the receive times out as before when nothing comes
+	CHECK_OK(nngc_socket_set_ms(pair.b, NNGC_OPT_RECVTIMEO, 10));
+	CHECK(nngc_recv_into(pair.b, &n, sizeof(n), &received, 0) == NNG_ETIMEDOUT);
+
+	CHECK_OK(nngc_socket_recv_wait_set(pair.b, nullptr));
+	CHECK(nngc_socket_recv_wait_stats(pair.b, &stats) == NNG_ENOENT);
+}
+
+static void testPoller()
+{
+	Pair one("inproc://nngcore-poller1");
+	Pair two("inproc://nngcore-poller2");
+	nngc_poller poller;
+	CHECK_OK(nngc_poller_create(&poller));
+	CHECK_OK(nngc_poller_add(poller, one.b, NNGC_POLL_RECV));
+	CHECK_OK(nngc_poller_add(poller, two.b, NNGC_POLL_RECV | NNGC_POLL_SEND));
+	CHECK(nngc_poller_count(poller) == 2);
+
+	nngc_poll_event events[4];
+	int count;
+	CHECK_OK(nngc_send(one.a, "x", 1, 0));
+	CHECK_OK(nngc_poller_wait(poller, events, 4, 1000, &count));
+	bool oneReady = false;
+	for (int i = 0; i < count; i++) {
+		if (events[i].socket == one.b) oneReady = (events[i].events & NNGC_POLL_RECV) != 0;
+		if (events[i].socket == two.b) CHECK(events[i].events == NNGC_POLL_SEND);
+	}
+	CHECK(oneReady);
+
+	char buffer[4];
+	size_t received;
+	CHECK_OK(nngc_recv_into(one.b, buffer, sizeof(buffer), &received, NNG_FLAG_NONBLOCK));
+	CHECK_OK(nngc_poller_remove(poller, two.b));
+	CHECK_OK(nngc_poller_wait(poller, events, 4, 10, &count));
+	CHECK(count == 0);
+
+	std::thread waker([poller] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		nngc_poller_wake(poller);
+	});
+	int woken = nngc_poller_wait(poller, events, 4, -1, &count);
+	waker.join(); // before a failed check leaves the test
+	CHECK_OK(woken);
+	CHECK(count == 0);
+
+	// closing a socket takes it out, its descriptors may be reused right away
+	CHECK_OK(nngc_socket_close(one.b));
+	one.b = 0;
+	CHECK(nngc_poller_count(poller) == 0);
+	nngc_poller_destroy(poller);
+}
+
+int main()
+{
+	struct Test {
+		const char* name;
+		void(*run)();
+	};
+	const Test tests[] = {
+		{ "OptionNames", testOptionNames },
+		{ "OpenEveryProtocol", testOpenEveryProtocol },
+		{ "Options", testOptions },
+		{ "SendReceiveBuffers", testSendReceiveBuffers },
+		{ "Messages", testMessages },
+		{ "SendReceiveMsgs", testSendReceiveMsgs },
+		{ "Batches", testBatches },
+		{ "AioCallback", testAioCallback },
+		{ "ReqRep", testReqRep },
+		{ "Metrics", testMetrics },
+		{ "Poller", testPoller },
+		{ "Pipes", testPipes },
+		{ "Stream", testStream },
+		{ "Shm", testShm },
+		{ "RecvWait", testRecvWait },
+	};
+	for (const Test& test : tests) {
+		try {
+			test.run();
+			std::printf("ok   %s\n", test.name);
+		}
+		catch (const CheckFailed&) {
+			std::printf("FAIL %s\n", test.name);
+			failures++;
+		}
+	}
+	nngc_fini();
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,409 @@
+﻿using System;
+using System.Diagnostics;
+using System.Linq;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+using Nng;
+
+namespace NngTests
+{
+    /// <summary>
+    /// Throughput measurements. They don't assert much, the numbers are written to the test output
+    /// </summary>
+    [TestClass]
+    public class Benchmarks
+    {
+        const int iterations = 1000000;
+
+        static double MsgAllocLoop(int size)
+        {
+            var watch = Stopwatch.StartNew();
+            for (int i = 0; i < iterations; i++)
+            {
+                Msg msg = new Msg((ulong)size);
+                msg.Free();
+            }
+            watch.Stop();
+            return iterations / watch.Elapsed.TotalSeconds;
+        }
+
+        [TestMethod, TestCategory("Benchmark")]
+        public void MsgPoolAllocation()
+        {
+            foreach (int size in new int[] { 64, 512, 4096 })
+            {
+                MsgPool.Disable();
+                double plain = MsgAllocLoop(size);
+
+                MsgPool.ResetCounters();
+                MsgPool.Enable();
+                double pooled = MsgAllocLoop(size);
+                MsgPool.Disable();
+
+                Console.WriteLine("Msg({0}) alloc+free: {1:F0} msg/s without pool, {2:F0} msg/s with pool, hits {3} misses {4}",
+                    size, plain, pooled, MsgPool.Hits, MsgPool.Misses);
+                Assert.IsTrue(MsgPool.Hits > MsgPool.Misses);
+            }
+        }
+
+        static void OpenPushPull(string url, out Socket push0, out Socket pull0)
+        {
+            Assert.IsTrue(Protocols.Push0(out push0) == Errno.ok);
+            Assert.IsTrue(Protocols.Pull0(out pull0) == Errno.ok);
+            Assert.IsTrue(push0.SetOptInt(Constants.Option(Option.sendbuf), 1024) == Errno.ok);
+            Assert.IsTrue(pull0.SetOptInt(Constants.Option(Option.recvbuf), 1024) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pull0, url, out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(push0, url, out dialer, 0) == Errno.ok);
+        }
+
+        [TestMethod, TestCategory("Benchmark")]
+        public void SendReceiveMany()
+        {
+            const int count = 200000;
+            const int batch = 64;
+            byte[] payload = new byte[16];
+
+            // one message per call
+            Socket push0, pull0;
+            OpenPushPull("inproc://benchSingle", out push0, out pull0);
+            var watch = Stopwatch.StartNew();
+            var receiver = System.Threading.Tasks.Task.Run(() =>
+            {
+                byte[] buffer = new byte[64];
+                int received;
+                for (int i = 0; i < count; i++) pull0.Receive(buffer, 0, buffer.Length, out received, Flag.none);
+            });
+            for (int i = 0; i < count; i++) push0.Send(payload, Flag.none);
+            receiver.Wait();
+            watch.Stop();
+            double single = count / watch.Elapsed.TotalSeconds;
+            push0.Close();
+            pull0.Close();
+
+            // batches
+            OpenPushPull("inproc://benchMany", out push0, out pull0);
+            byte[][] payloads = new byte[batch][];
+            for (int i = 0; i < batch; i++) payloads[i] = payload;
+            watch = Stopwatch.StartNew();
+            receiver = System.Threading.Tasks.Task.Run(() =>
+            {
+                Msg[] msgs = new Msg[batch];
+                int received;
+                for (int total = 0; total < count; total += received)
+                {
+                    Assert.IsTrue(pull0.ReceiveMany(msgs, -1, out received) == Errno.ok);
+                    for (int i = 0; i < received; i++) msgs[i].Free();
+                }
+            });
+            for (int total = 0; total < count;)
+            {
+                int sent;
+                push0.SendMany(payloads, out sent);
+                if (sent == 0) System.Threading.Thread.Yield();
+                total += sent;
+                if (count - total < batch) Array.Resize(ref payloads, Math.Max(0, count - total));
+            }
+            receiver.Wait();
+            watch.Stop();
+            double many = count / watch.Elapsed.TotalSeconds;
+            push0.Close();
+            pull0.Close();
+
+            Console.WriteLine("16 byte messages over inproc: {0:F0} msg/s single, {1:F0} msg/s in batches of {2}", single, many, batch);
+        }
+
+        class PingPong
+        {
+            public Socket ping, pong;
+            public Aio pingAio, pongAio;
+            public int remaining;
+            public long started;
+            public long latencyTicks;
+            public System.Threading.ManualResetEventSlim done = new System.Threading.ManualResetEventSlim();
+
+            public void PingReceived(object o)
+            {
+                if (pingAio.Result() != Errno.ok) return;
+                Msg msg = pingAio.GetMsg();
+                latencyTicks += Stopwatch.GetTimestamp() - started;
+                if (--remaining == 0)
+                {
+                    msg.Free();
+                    done.Set();
+                    return;
+                }
+                ping.Receive(pingAio);
+                started = Stopwatch.GetTimestamp();
+                ping.Send(msg, Flag.none);
+            }
+
+            public void PongReceived(object o)
+            {
+                if (pongAio.Result() != Errno.ok) return;
+                Msg msg = pongAio.GetMsg();
+                pong.Receive(pongAio);
+                pong.Send(msg, Flag.none);
+            }
+        }
+
+        static void AioPingPong(string url, AioCompletionQueue queue, int count, out double roundTrips, out double latencyUs)
+        {
+            var p = new PingPong();
+            p.remaining = count;
+            Assert.IsTrue(Protocols.Pair0(out p.ping) == Errno.ok);
+            Assert.IsTrue(Protocols.Pair0(out p.pong) == Errno.ok);
+            p.ping.CompletionQueue = queue;
+            p.pong.CompletionQueue = queue;
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(p.pong, url, out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(p.ping, url, out dialer, 0) == Errno.ok);
+            Assert.IsTrue(Aio.Alloc(out p.pingAio, p.PingReceived, null) == Errno.ok);
+            Assert.IsTrue(Aio.Alloc(out p.pongAio, p.PongReceived, null) == Errno.ok);
+            p.ping.Receive(p.pingAio);
+            p.pong.Receive(p.pongAio);
+
+            var watch = Stopwatch.StartNew();
+            Msg msg = new Msg(0);
+            msg.AppendU32(0);
+            p.started = Stopwatch.GetTimestamp();
+            p.ping.Send(msg, Flag.none);
+            Assert.IsTrue(p.done.Wait(60000));
+            watch.Stop();
+
+            roundTrips = count / watch.Elapsed.TotalSeconds;
+            latencyUs = p.latencyTicks * 1000000.0 / Stopwatch.Frequency / count;
+            p.ping.Close();
+            p.pong.Close();
+            p.pingAio.Free();
+            p.pongAio.Free();
+        }
+
+        [TestMethod, TestCategory("Benchmark")]
+        public void AioCompletionQueueThroughput()
+        {
+            const int count = 100000;
+            double direct, directLatency, queued, queuedLatency;
+            AioPingPong("inproc://benchAioDirect", null, count, out direct, out directLatency);
+            using (var queue = new AioCompletionQueue(1))
+            {
+                AioPingPong("inproc://benchAioQueue", queue, count, out queued, out queuedLatency);
+                Console.WriteLine("{0} completions in {1} batches", queue.Completions, queue.Batches);
+            }
+            Console.WriteLine("aio ping-pong: callbacks {0:F0} round trips/s {1:F1} us, completion queue {2:F0} round trips/s {3:F1} us",
+                direct, directLatency, queued, queuedLatency);
+        }
+
+        [TestMethod, TestCategory("Benchmark")]
+        public void OptionPolling()
+        {
+            Socket pair0;
+            Assert.IsTrue(Protocols.Pair0(out pair0) == Errno.ok);
+            string name = Constants.Option(Option.recvtimeo);
+            int ms;
+
+            var watch = Stopwatch.StartNew();
+            for (int i = 0; i < iterations; i++) pair0.GetOptMs(name, out ms);
+            double byName = iterations / watch.Elapsed.TotalSeconds;
+
+            watch.Restart();
+            for (int i = 0; i < iterations; i++) pair0.GetOptMs(Option.recvtimeo, out ms);
+            double byOption = iterations / watch.Elapsed.TotalSeconds;
+
+            Console.WriteLine("GetOptMs: {0:F0} calls/s by name, {1:F0} calls/s by Option", byName, byOption);
+            pair0.Close();
+        }
+
+        [TestMethod, TestCategory("Benchmark")]
+        public void MsgEncoding()
+        {
+            const int count = 100000;
+            const int fields = 100;
+
+            var watch = Stopwatch.StartNew();
+            for (int i = 0; i < count; i++)
+            {
+                Msg msg = new Msg(0);
+                for (uint f = 0; f < fields; f++) msg.AppendU32(f);
+                msg.Free();
+            }
+            double appended = count / watch.Elapsed.TotalSeconds;
+
+            watch.Restart();
+            for (int i = 0; i < count; i++)
+            {
+                Msg msg = new Msg(0);
+                var writer = new MsgWriter(msg, fields * 4);
+                for (uint f = 0; f < fields; f++) writer.WriteU32(f);
+                writer.Commit();
+                msg.Free();
+            }
+            double written = count / watch.Elapsed.TotalSeconds;
+
+            Console.WriteLine("{0} x u32: {1:F0} msg/s with AppendU32, {2:F0} msg/s with MsgWriter", fields, appended, written);
+        }
+
+        [TestMethod, TestCategory("Benchmark")]
+        public void MsgDecoding()
+        {
+            const int count = 100000;
+            const int fields = 100;
+            Msg original = new Msg(0);
+            var writer = new MsgWriter(original, fields * 4);
+            for (uint f = 0; f < fields; f++) writer.WriteU32(f);
+            writer.Commit();
+
+            // TrimU32 changes the message, so every round needs its own copy
+            var copies = new Msg[count];
+            for (int i = 0; i < count; i++) original.Dup(out copies[i]);
+            uint value, sum = 0;
+            var watch = Stopwatch.StartNew();
+            for (int i = 0; i < count; i++)
+            {
+                for (int f = 0; f < fields; f++)
+                {
+                    copies[i].TrimU32(out value);
+                    sum += value;
+                }
+            }
+            double trimmed = count / watch.Elapsed.TotalSeconds;
+            foreach (var copy in copies) copy.Free();
+
+            watch.Restart();
+            for (int i = 0; i < count; i++)
+            {
+                var reader = new MsgReader(original);
+                for (int f = 0; f < fields; f++)
+                {
+                    reader.ReadU32(out value);
+                    sum += value;
+                }
+            }
+            double read = count / watch.Elapsed.TotalSeconds;
+            original.Free();
+
+            Console.WriteLine("{0} x u32: {1:F0} msg/s with TrimU32, {2:F0} msg/s with MsgReader ({3})", fields, trimmed, read, sum);
+        }
+
+        delegate Errno Duplicate(Msg msg, out Msg copy);
+
+        // private bytes of the process above before
+        static long Held(Process process, long before)
+        {
+            process.Refresh();
+            return process.PrivateMemorySize64 - before;
+        }
+
+        // a publisher building one snapshot per round and sending it to every destination
+        static void FanOut(Socket[] push0, Socket[] pull0, int fanOut, int rounds, Msg source, Duplicate dup,
+            out double rate, out long peakBytes)
+        {
+            peakBytes = 0;
+            var copies = new Msg[fanOut];
+            var process = Process.GetCurrentProcess();
+            var watch = new Stopwatch();
+            // round 0 samples the memory held after every step, the others are timed without it
+            for (int r = 0; r <= rounds; r++)
+            {
+                bool sample = r == 0;
+                long before = sample ? Held(process, 0) : 0;
+                if (r == 1) watch.Start();
+                source.Dup(out copies[0]);
+                for (int i = 1; i < fanOut; i++) dup(copies[0], out copies[i]);
+                if (sample) peakBytes = Math.Max(peakBytes, Held(process, before));
+                for (int i = 0; i < fanOut; i++)
+                {
+                    push0[i].Send(copies[i], Flag.none);
+                    if (sample) peakBytes = Math.Max(peakBytes, Held(process, before));
+                }
+                for (int i = 0; i < fanOut; i++)
+                {
+                    Msg received;
+                    pull0[i].Receive(out received, Flag.none);
+                    if (sample) peakBytes = Math.Max(peakBytes, Held(process, before));
+                    received.Free();
+                }
+            }
+            rate = rounds * (double)fanOut / watch.Elapsed.TotalSeconds;
+        }
+
+        [TestMethod, TestCategory("Benchmark")]
+        public void SharedFanOut()
+        {
+            const int size = 1 << 20;
+            const int rounds = 50;
+            var push0 = new Socket[64];
+            var pull0 = new Socket[64];
+            for (int i = 0; i < push0.Length; i++) OpenPushPull("inproc://benchFanOut" + i, out push0[i], out pull0[i]);
+            Msg snapshot = new Msg(size);
+
+            foreach (int fanOut in new int[] { 1, 4, 16, 64 })
+            {
+                double deepRate, sharedRate;
+                long deepBytes, sharedBytes;
+                FanOut(push0, pull0, fanOut, rounds, snapshot, (Msg m, out Msg c) => m.Dup(out c), out deepRate, out deepBytes);
+                FanOut(push0, pull0, fanOut, rounds, snapshot, (Msg m, out Msg c) => m.DupShared(out c), out sharedRate, out sharedBytes);
+                Console.WriteLine("fan-out {0}: Dup {1:F0} msg/s {2} KB held, DupShared {3:F0} msg/s {4} KB held",
+                    fanOut, deepRate, deepBytes / 1024, sharedRate, sharedBytes / 1024);
+            }
+            snapshot.Free();
+            for (int i = 0; i < push0.Length; i++)
+            {
+                push0[i].Close();
+                pull0[i].Close();
+            }
+        }
+
+        static bool LinearMatch(byte[][] subscriptions, byte[] body)
+        {
+            foreach (var topic in subscriptions)
+            {
+                if (topic.Length > body.Length) continue;
+                int i = 0;
+                while (i < topic.Length && topic[i] == body[i]) i++;
+                if (i == topic.Length) return true;
+            }
+            return false;
+        }
+
+        [TestMethod, TestCategory("Benchmark")]
+        public void TopicFilter()
+        {
+            const int messages = 1000;
+            var random = new Random(1);
+            foreach (int count in new int[] { 10, 1000, 100000 })
+            {
+                var topics = new string[count];
+                for (int i = 0; i < count; i++) topics[i] = "instrument." + i.ToString("D6") + ".";
+                var bytes = topics.Select(t => System.Text.Encoding.UTF8.GetBytes(t)).ToArray();
+                var msgs = new Msg[messages];
+                var bodies = new byte[messages][];
+                for (int i = 0; i < messages; i++)
+                {
+                    msgs[i] = new Msg(0);
+                    msgs[i].Append(System.Text.Encoding.UTF8.GetBytes(topics[random.Next(count)] + "price=100.25"));
+                    bodies[i] = msgs[i].Body();
+                }
+                int rounds = Math.Max(1, 1000000 / (messages * Math.Max(1, count / 100)));
+
+                var watch = Stopwatch.StartNew();
+                int matched = 0;
+                for (int r = 0; r < rounds; r++)
+                    for (int i = 0; i < messages; i++) if (LinearMatch(bytes, bodies[i])) matched++;
+                double linear = rounds * messages / watch.Elapsed.TotalSeconds;
+
+                using (var subscriber = new Subscriber(topics))
+                {
+                    rounds = 1000;
+                    watch.Restart();
+                    for (int r = 0; r < rounds; r++)
+                        for (int i = 0; i < messages; i++) if (subscriber.Match(msgs[i])) matched++;
+                    double trie = rounds * messages / watch.Elapsed.TotalSeconds;
+                    Console.WriteLine("{0} subscriptions: linear scan {1:F0} msg/s, trie {2:F0} msg/s ({3})", count, linear, trie, matched);
+                }
+                foreach (var msg in msgs) msg.Free();
+            }
+        }
+    }
+}
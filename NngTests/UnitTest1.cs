@@ -423,4 +423,1432 @@ namespace NngTests
             }
         }
     }
+    /// <summary>
+    /// Receive into a caller supplied buffer
+    /// </summary>
+    [TestClass]
+    public class UnitTest4
+    {
+        [TestMethod]
+        public void ReceiveIntoBuffer()
+        {
+            Socket push0, pull0;
+            Assert.IsTrue(Protocols.Push0(out push0) == Errno.ok);
+            Assert.IsTrue(Protocols.Pull0(out pull0) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pull0, "inproc://receiveIntoBuffer", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(push0, "inproc://receiveIntoBuffer", out dialer, 0) == Errno.ok);
+
+            byte[] buffer = new byte[16];
+            int received;
+            Assert.IsTrue(push0.Send(new byte[] { 1, 2, 3, 4 }, Flag.none) == Errno.ok);
+            Assert.IsTrue(pull0.Receive(buffer, 2, 8, out received, 0) == Errno.ok);
+            Assert.AreEqual(4, received);
+            Assert.IsTrue(buffer.Skip(2).Take(4).SequenceEqual(new byte[] { 1, 2, 3, 4 }));
+
+            // too small, the message is reported but lost
+            Assert.IsTrue(push0.Send(new byte[] { 1, 2, 3, 4, 5, 6 }, Flag.none) == Errno.ok);
+            Assert.IsTrue(pull0.Receive(buffer, 0, 3, out received, 0) == Errno.msgsize);
+            Assert.AreEqual(6, received);
+
+            Assert.IsTrue(pull0.Receive(buffer, 10, 8, out received, 0) == Errno.inval);
+
+            var handle = System.Runtime.InteropServices.GCHandle.Alloc(buffer, System.Runtime.InteropServices.GCHandleType.Pinned);
+            try
+            {
+                ulong received2;
+                Assert.IsTrue(push0.Send(new byte[] { 9, 8, 7 }, Flag.none) == Errno.ok);
+                Assert.IsTrue(pull0.Receive(handle.AddrOfPinnedObject(), (ulong)buffer.Length, out received2, 0) == Errno.ok);
+                Assert.AreEqual(3UL, received2);
+                Assert.IsTrue(buffer.Take(3).SequenceEqual(new byte[] { 9, 8, 7 }));
+            }
+            finally
+            {
+                handle.Free();
+            }
+            Assert.IsTrue(push0.Close() == 0);
+            Assert.IsTrue(pull0.Close() == 0);
+        }
+    }
+    /// <summary>
+    /// Non copying views on the message body and header
+    /// </summary>
+    [TestClass]
+    public class UnitTest5
+    {
+        [TestMethod]
+        public void MsgViews()
+        {
+            Msg msg = new Msg(0);
+            Assert.IsTrue(msg.Append(new byte[] { 1, 2, 3, 4, 5 }) == Errno.ok);
+            Assert.IsTrue(msg.HeaderAppendU32(0x01020304) == Errno.ok);
+
+            IntPtr data;
+            ulong size;
+            Assert.IsTrue(msg.BodyView(out data, out size) == Errno.ok);
+            Assert.AreEqual(5UL, size);
+            Assert.AreEqual(3, System.Runtime.InteropServices.Marshal.ReadByte(data, 2));
+
+            var stream = msg.HeaderStream();
+            Assert.AreEqual(4, stream.Length);
+            Assert.AreEqual(1, stream.ReadByte());
+
+            byte[] dest = new byte[8];
+            Assert.IsTrue(msg.CopyTo(dest, 3) == Errno.ok);
+            Assert.IsTrue(dest.Skip(3).SequenceEqual(new byte[] { 1, 2, 3, 4, 5 }));
+            Assert.IsTrue(msg.CopyTo(dest, 4) == Errno.msgsize);
+
+            msg.Free();
+            Assert.ThrowsException<ObjectDisposedException>(() => stream.ReadByte());
+            Assert.IsTrue(msg.BodyView(out data, out size) == Errno.inval);
+            Assert.IsNull(msg.BodyStream());
+        }
+    }
+    /// <summary>
+    /// Task based send and receive
+    /// </summary>
+    [TestClass]
+    public class UnitTest6
+    {
+        [TestMethod]
+        public void SendReceiveAsync()
+        {
+            Socket pair0a, pair0b;
+            Assert.IsTrue(Protocols.Pair0(out pair0a) == Errno.ok);
+            Assert.IsTrue(Protocols.Pair0(out pair0b) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pair0a, "inproc://sendReceiveAsync", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(pair0b, "inproc://sendReceiveAsync", out dialer, 0) == Errno.ok);
+
+            for (uint i = 0; i < 1000; i++)
+            {
+                var receive = pair0a.ReceiveAsync();
+                Msg msg = new Msg(0);
+                msg.AppendU32(i);
+                Assert.AreEqual(Errno.ok, pair0b.SendAsync(msg).Result);
+                Msg received = receive.Result;
+                uint value;
+                Assert.IsTrue(received.TrimU32(out value) == Errno.ok);
+                Assert.AreEqual(i, value);
+                received.Free();
+            }
+
+            var timedOut = pair0a.ReceiveAsync(50);
+            var exception = Assert.ThrowsException<AggregateException>(() => timedOut.Wait());
+            Assert.AreEqual(Errno.timedout, ((NngException)exception.InnerException).errno);
+
+            using (var cancellation = new System.Threading.CancellationTokenSource())
+            {
+                var canceled = pair0a.ReceiveAsync(null, cancellation.Token);
+                cancellation.Cancel();
+                Assert.ThrowsException<AggregateException>(() => canceled.Wait());
+                Assert.IsTrue(canceled.IsCanceled);
+            }
+
+            // more operations complete at once than the pool keeps, the rest are freed from their callbacks
+            using (var cancellation = new System.Threading.CancellationTokenSource())
+            {
+                var many = new System.Threading.Tasks.Task<Msg>[300];
+                for (int i = 0; i < many.Length; i++) many[i] = pair0a.ReceiveAsync(null, cancellation.Token);
+                cancellation.Cancel();
+                foreach (var task in many)
+                {
+                    Assert.ThrowsException<AggregateException>(() => task.Wait(5000));
+                    Assert.IsTrue(task.IsCanceled);
+                }
+            }
+            Assert.IsTrue(pair0a.Close() == 0);
+            Assert.IsTrue(pair0b.Close() == 0);
+        }
+    }
+    /// <summary>
+    /// Aio pool
+    /// </summary>
+    [TestClass]
+    public class UnitTest7
+    {
+        int received = 0;
+
+        [TestMethod]
+        public void AioPoolRentReturn()
+        {
+            using (var pool = new AioPool(2, 4))
+            {
+                Assert.AreEqual(2, pool.Available);
+                Socket push0, pull0;
+                Assert.IsTrue(Protocols.Push0(out push0) == Errno.ok);
+                Assert.IsTrue(Protocols.Pull0(out pull0) == Errno.ok);
+                Listener listener;
+                Assert.IsTrue(Listener.Listen(pull0, "inproc://aioPool", out listener, 0) == Errno.ok);
+                Dialer dialer;
+                Assert.IsTrue(Dialer.Dial(push0, "inproc://aioPool", out dialer, 0) == Errno.ok);
+
+                var done = new System.Threading.ManualResetEventSlim();
+                Aio aio = null;
+                Assert.IsTrue(pool.Rent(out aio, o =>
+                {
+                    if (aio.Result() == Errno.ok) aio.GetMsg().Free();
+                    System.Threading.Interlocked.Increment(ref received);
+                    Assert.IsTrue(pool.Return(aio) == Errno.ok); // from its own callback
+                    done.Set();
+                }, null) == Errno.ok);
+                Assert.AreEqual(1, pool.Available);
+                pull0.Receive(aio);
+                Assert.IsTrue(push0.Send(new byte[] { 1 }, Flag.none) == Errno.ok);
+                Assert.IsTrue(done.Wait(5000));
+                Assert.AreEqual(2, pool.Available);
+
+                // a burst beyond the maximum doesn't grow the pool
+                var rented = new Aio[6];
+                for (int i = 0; i < rented.Length; i++) Assert.IsTrue(pool.Rent(out rented[i], null, null) == Errno.ok);
+                Assert.AreEqual(4L, pool.Misses);
+                foreach (var a in rented) Assert.IsTrue(pool.Return(a) == Errno.ok);
+                Assert.AreEqual(4, pool.Available);
+
+                // a second Return is refused, the Aio would be rented out twice
+                Assert.IsTrue(pool.Return(rented[0]) == Errno.state);
+                Assert.AreEqual(4, pool.Available);
+
+                // a pending receive is stopped, it doesn't complete on the next renter
+                Aio pending;
+                Assert.IsTrue(pool.Rent(out pending, o => { }, null) == Errno.ok);
+                pull0.Receive(pending);
+                Assert.IsTrue(pool.Return(pending) == Errno.ok);
+                Assert.IsTrue(pending.Result() == Errno.canceled);
+
+                push0.Close();
+                pull0.Close();
+            }
+        }
+
+        [TestMethod]
+        public void AioPoolReturnFromCallbackIntoFullPool()
+        {
+            // maximum 0, so Return frees the Aio, here from its own callback on an nng thread
+            using (var pool = new AioPool(0, 0))
+            {
+                Socket push0, pull0;
+                Assert.IsTrue(Protocols.Push0(out push0) == Errno.ok);
+                Assert.IsTrue(Protocols.Pull0(out pull0) == Errno.ok);
+                Listener listener;
+                Assert.IsTrue(Listener.Listen(pull0, "inproc://aioPoolFull", out listener, 0) == Errno.ok);
+                Dialer dialer;
+                Assert.IsTrue(Dialer.Dial(push0, "inproc://aioPoolFull", out dialer, 0) == Errno.ok);
+
+                var done = new System.Threading.ManualResetEventSlim();
+                Errno returned = Errno.internal;
+                Aio aio = null;
+                Assert.IsTrue(pool.Rent(out aio, o =>
+                {
+                    if (aio.Result() == Errno.ok) aio.GetMsg().Free();
+                    returned = pool.Return(aio);
+                    done.Set();
+                }, null) == Errno.ok);
+                pull0.Receive(aio);
+                Assert.IsTrue(push0.Send(new byte[] { 1 }, Flag.none) == Errno.ok);
+                Assert.IsTrue(done.Wait(5000));
+                Assert.IsTrue(returned == Errno.ok);
+                Assert.AreEqual(0, pool.Available);
+
+                push0.Close();
+                pull0.Close();
+            }
+        }
+    }
+    /// <summary>
+    /// Multiplexed RPC client
+    /// </summary>
+    [TestClass]
+    public class UnitTest8
+    {
+        [TestMethod]
+        public void RpcClientConcurrent()
+        {
+            const int count = 1000;
+            Socket rep0;
+            Assert.IsTrue(Protocols.Rep0(out rep0) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(rep0, "inproc://rpcClient", out listener, 0) == Errno.ok);
+            var server = System.Threading.Tasks.Task.Run(() =>
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    Msg msg;
+                    Assert.IsTrue(rep0.Receive(out msg, Flag.none) == Errno.ok);
+                    uint value;
+                    msg.TrimU32(out value);
+                    msg.AppendU32(value * 2);
+                    Assert.IsTrue(rep0.Send(msg, Flag.none) == Errno.ok);
+                }
+            });
+
+            using (var client = new RpcClient(1))
+            {
+                Dialer dialer;
+                Assert.IsTrue(Dialer.Dial(client.RequestSocket, "inproc://rpcClient", out dialer, 0) == Errno.ok);
+                var replies = new System.Threading.Tasks.Task<Msg>[count];
+                System.Threading.Tasks.Parallel.For(0, count, i =>
+                {
+                    Msg msg = new Msg(0);
+                    msg.AppendU32((uint)i);
+                    replies[i] = client.RequestAsync(msg, 10000);
+                });
+                for (int i = 0; i < count; i++)
+                {
+                    uint value;
+                    Assert.IsTrue(replies[i].Result.TrimU32(out value) == Errno.ok);
+                    Assert.AreEqual((uint)i * 2, value);
+                    replies[i].Result.Free();
+                }
+                server.Wait();
+
+                // nobody answers this one
+                Msg late = new Msg(0);
+                var timedOut = client.RequestAsync(late, 50);
+                var exception = Assert.ThrowsException<AggregateException>(() => timedOut.Wait());
+                Assert.AreEqual(Errno.timedout, ((NngException)exception.InnerException).errno);
+                Assert.AreEqual(0, client.Pending);
+
+                // canceled before it was sent, the message stays with the caller as it was
+                Msg unsent = new Msg(0);
+                using (var cancellation = new System.Threading.CancellationTokenSource())
+                {
+                    cancellation.Cancel();
+                    var canceled = client.RequestAsync(unsent, 1000, cancellation.Token);
+                    Assert.ThrowsException<AggregateException>(() => canceled.Wait());
+                    Assert.IsTrue(canceled.IsCanceled);
+                }
+                Assert.AreEqual(0, unsent.Header().Length);
+                unsent.Free();
+                Assert.AreEqual(0, client.Pending);
+            }
+            rep0.Close();
+        }
+    }
+    /// <summary>
+    /// Rep0 server on several contexts
+    /// </summary>
+    [TestClass]
+    public class UnitTest9
+    {
+        [TestMethod]
+        public void RepServerConcurrent()
+        {
+            const int count = 8;
+            RequestHandler slow = request =>
+            {
+                System.Threading.Thread.Sleep(200);
+                uint value;
+                request.TrimU32(out value);
+                request.AppendU32(value + 1);
+                return request;
+            };
+            using (var server = new RepServer(slow, count, count))
+            using (var client = new RpcClient(1))
+            {
+                Listener listener;
+                Assert.IsTrue(Listener.Listen(server.ReplySocket, "inproc://repServer", out listener, 0) == Errno.ok);
+                Dialer dialer;
+                Assert.IsTrue(Dialer.Dial(client.RequestSocket, "inproc://repServer", out dialer, 0) == Errno.ok);
+
+                var watch = System.Diagnostics.Stopwatch.StartNew();
+                var replies = new System.Threading.Tasks.Task<Msg>[count];
+                for (int i = 0; i < count; i++)
+                {
+                    Msg msg = new Msg(0);
+                    msg.AppendU32((uint)i);
+                    replies[i] = client.RequestAsync(msg, 10000);
+                }
+                for (int i = 0; i < count; i++)
+                {
+                    uint value;
+                    Assert.IsTrue(replies[i].Result.TrimU32(out value) == Errno.ok);
+                    Assert.AreEqual((uint)i + 1, value);
+                    replies[i].Result.Free();
+                }
+                // one context would need count * 200 ms
+                Assert.IsTrue(watch.ElapsedMilliseconds < count * 200 / 2);
+
+                long handled = 0;
+                foreach (var stats in server.ContextStats())
+                {
+                    handled += stats.Requests;
+                    Assert.IsTrue(stats.Utilization >= 0.0 && stats.Utilization <= 1.0);
+                }
+                Assert.AreEqual((long)count, handled);
+                Assert.AreEqual(0L, server.HandlerErrors);
+                Assert.AreEqual(0, server.QueueDepth);
+            }
+        }
+    }
+    /// <summary>
+    /// Options by enum and by interned name
+    /// </summary>
+    [TestClass]
+    public class UnitTest10
+    {
+        [TestMethod]
+        public void OptionOverloads()
+        {
+            Socket pair0;
+            Assert.IsTrue(Protocols.Pair0(out pair0) == Errno.ok);
+
+            Assert.IsTrue(pair0.SetOptMs(Option.recvtimeo, 1234) == Errno.ok);
+            int ms;
+            Assert.IsTrue(pair0.GetOptMs(Constants.Option(Option.recvtimeo), out ms) == Errno.ok);
+            Assert.AreEqual(1234, ms);
+            Assert.IsTrue(pair0.SetOptMs(Constants.Option(Option.recvtimeo), 99) == Errno.ok);
+            Assert.IsTrue(pair0.GetOptMs(Option.recvtimeo, out ms) == Errno.ok);
+            Assert.AreEqual(99, ms);
+
+            Assert.IsTrue(pair0.SetOptSize(Option.recvmaxsz, 4096) == Errno.ok);
+            ulong size;
+            Assert.IsTrue(pair0.GetOptSize(Option.recvmaxsz, out size) == Errno.ok);
+            Assert.AreEqual(4096UL, size);
+            Assert.IsTrue(pair0.SetOptString(Option.sockname, "überall") == Errno.ok);
+
+            Assert.IsTrue(pair0.GetOptInt((Option)1000, out ms) == Errno.notsup);
+
+            // the same url twice goes through the interned table
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pair0, "inproc://optionOverloads", out listener, 0) == Errno.ok);
+            listener.Close();
+            Assert.IsTrue(Listener.Listen(pair0, "inproc://optionOverloads", out listener, 0) == Errno.ok);
+            pair0.Close();
+        }
+    }
+    /// <summary>
+    /// Bulk socket configuration and binary options
+    /// </summary>
+    [TestClass]
+    public class UnitTest11
+    {
+        [TestMethod]
+        public void SocketOptionsRoundTrip()
+        {
+            Socket req0;
+            Assert.IsTrue(Protocols.Req0(out req0) == Errno.ok);
+            var options = new SocketOptions
+            {
+                SendBuffer = 16,
+                RecvBuffer = 32,
+                SendTimeout = 100,
+                RecvTimeout = 200,
+                RecvMaxSize = 65536,
+                ReconnectMin = 10,
+                ReconnectMax = 1000,
+                MaxTtl = 4
+            };
+            Assert.IsTrue(req0.SetOptions(options) == Errno.ok);
+            SocketOptions read;
+            Assert.IsTrue(req0.GetOptions(out read) == Errno.ok);
+            Assert.AreEqual(options, read);
+
+            // only the given fields are touched
+            Assert.IsTrue(req0.SetOptions(new SocketOptions { RecvTimeout = 300 }) == Errno.ok);
+            Assert.IsTrue(req0.GetOptions(out read) == Errno.ok);
+            Assert.AreEqual(300, read.RecvTimeout);
+            Assert.AreEqual(100, read.SendTimeout);
+
+            // a bad value stops there
+            Assert.IsTrue(req0.SetOptions(new SocketOptions { MaxTtl = 1000 }) == Errno.inval);
+
+            byte[] value;
+            Assert.IsTrue(req0.GetOpt(Option.recvtimeo, out value) == Errno.ok);
+            Assert.AreEqual(4, value.Length);
+            Assert.AreEqual(300, BitConverter.ToInt32(value, 0));
+            Assert.IsTrue(req0.SetOptString(Option.sockname, "bulk") == Errno.ok);
+            Assert.IsTrue(req0.GetOpt(Constants.Option(Option.sockname), out value) == Errno.ok);
+            Assert.AreEqual("bulk", System.Text.Encoding.UTF8.GetString(value).TrimEnd('\0'));
+            req0.Close();
+        }
+    }
+    /// <summary>
+    /// MsgWriter
+    /// </summary>
+    [TestClass]
+    public class UnitTest12
+    {
+        [TestMethod]
+        public void MsgWriterFields()
+        {
+            Msg msg = new Msg(0);
+            Assert.IsTrue(msg.Append(new byte[] { 0xAA }) == Errno.ok);
+            MsgWriter writer;
+            Assert.IsTrue(MsgWriter.Begin(out writer, msg, 4) == Errno.ok);
+            Assert.IsTrue(writer.WriteU16(0x0102) == Errno.ok);
+            Assert.IsTrue(writer.WriteU32(0x03040506) == Errno.ok);  // beyond the reserve
+            writer.LittleEndian = true;
+            Assert.IsTrue(writer.WriteU32(0x0708090A) == Errno.ok);
+            Assert.IsTrue(writer.WriteVarint(300) == Errno.ok);
+            Assert.IsTrue(writer.WriteVarintSigned(-1) == Errno.ok);
+            Assert.IsTrue(writer.WriteString("hé") == Errno.ok);
+            Assert.IsTrue(writer.Write(new byte[] { 0, 1, 2, 3 }, 1, 2) == Errno.ok);
+            Assert.AreEqual(19UL, writer.Written);
+            Assert.IsTrue(writer.Commit() == Errno.ok);
+            Assert.IsTrue(writer.Commit() == Errno.state);
+
+            byte[] expected = { 0xAA, 1, 2, 3, 4, 5, 6, 0x0A, 9, 8, 7, 0xAC, 0x02, 0x01, 3, (byte)'h', 0xC3, 0xA9, 1, 2 };
+            CollectionAssert.AreEqual(expected, msg.Body());
+
+            Assert.IsTrue(MsgWriter.Begin(out writer, msg, 64) == Errno.ok);
+            Assert.IsTrue(writer.WriteDouble(1.5) == Errno.ok);
+            Assert.IsTrue(writer.Commit() == Errno.ok);
+            byte[] body = msg.Body();
+            Assert.AreEqual(expected.Length + 8, body.Length);
+            Array.Reverse(body, expected.Length, 8);
+            Assert.AreEqual(1.5, BitConverter.ToDouble(body, expected.Length));
+            msg.Free();
+        }
+    }
+    /// <summary>
+    /// MsgReader
+    /// </summary>
+    [TestClass]
+    public class UnitTest13
+    {
+        [TestMethod]
+        public void MsgReaderFields()
+        {
+            Msg msg = new Msg(0);
+            var writer = new MsgWriter(msg, 64);
+            writer.WriteU16(0x0102);
+            writer.WriteU32(0x03040506);
+            writer.WriteVarintSigned(-1000);
+            writer.WriteString("grüße");
+            writer.WriteDouble(2.25);
+            writer.Write(new byte[] { 7, 8, 9 }, 0, 3);
+            Assert.IsTrue(writer.Commit() == Errno.ok);
+            Assert.IsTrue(msg.HeaderAppendU32(42) == Errno.ok);
+            byte[] before = msg.Body();
+
+            var reader = new MsgReader(msg);
+            ushort u16;
+            uint u32;
+            long varint;
+            string text;
+            double d;
+            Assert.IsTrue(reader.ReadU16(out u16) == Errno.ok);
+            Assert.AreEqual((ushort)0x0102, u16);
+            Assert.IsTrue(reader.ReadU32(out u32) == Errno.ok);
+            Assert.AreEqual(0x03040506u, u32);
+            Assert.IsTrue(reader.ReadVarintSigned(out varint) == Errno.ok);
+            Assert.AreEqual(-1000L, varint);
+            Assert.IsTrue(reader.ReadString(out text) == Errno.ok);
+            Assert.AreEqual("grüße", text);
+            Assert.IsTrue(reader.ReadDouble(out d) == Errno.ok);
+            Assert.AreEqual(2.25, d);
+            IntPtr slice;
+            Assert.IsTrue(reader.Slice(2, out slice) == Errno.ok);
+            Assert.AreEqual((byte)8, System.Runtime.InteropServices.Marshal.ReadByte(slice, 1));
+            Assert.AreEqual(1UL, reader.Remaining);
+            Assert.IsTrue(reader.ReadU32(out u32) == Errno.inval);
+            Assert.AreEqual(1UL, reader.Remaining);
+            reader.Position = 0;
+            Assert.IsTrue(reader.ReadU16(out u16) == Errno.ok);
+            Assert.AreEqual((ushort)0x0102, u16);
+
+            MsgReader header;
+            Assert.IsTrue(MsgReader.Open(out header, msg, true) == Errno.ok);
+            Assert.IsTrue(header.ReadU32(out u32) == Errno.ok);
+            Assert.AreEqual(42u, u32);
+
+            CollectionAssert.AreEqual(before, msg.Body()); // untouched
+
+            // changed, freed or sent, the reader doesn't touch the old memory anymore
+            reader.Position = 0;
+            Assert.IsTrue(msg.AppendU32(1) == Errno.ok);
+            Assert.IsTrue(reader.ReadU16(out u16) == Errno.state);
+            reader = new MsgReader(msg);
+            msg.Free();
+            Assert.IsTrue(reader.ReadU16(out u16) == Errno.state);
+            Assert.IsTrue(reader.ReadVarintSigned(out varint) == Errno.state);
+
+            Socket push0, pull0;
+            Assert.IsTrue(Protocols.Push0(out push0) == Errno.ok);
+            Assert.IsTrue(Protocols.Pull0(out pull0) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pull0, "inproc://msgReader", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(push0, "inproc://msgReader", out dialer, 0) == Errno.ok);
+            Msg sent = new Msg(0);
+            Assert.IsTrue(sent.AppendU32(7) == Errno.ok);
+            var sentReader = new MsgReader(sent);
+            Assert.IsTrue(push0.Send(sent, Flag.none) == Errno.ok);
+            Assert.IsTrue(sentReader.ReadU32(out u32) == Errno.state);
+            Msg received;
+            Assert.IsTrue(pull0.Receive(out received, Flag.none) == Errno.ok);
+            received.Free();
+            push0.Close();
+            pull0.Close();
+        }
+    }
+    /// <summary>
+    /// Shared duplicates
+    /// </summary>
+    [TestClass]
+    public class UnitTest14
+    {
+        [TestMethod]
+        public void DupSharedCopyOnWrite()
+        {
+            Msg original = new Msg(0);
+            Assert.IsTrue(original.Append(new byte[] { 1, 2, 3 }) == Errno.ok);
+            Msg copy1, copy2;
+            Assert.IsTrue(original.DupShared(out copy1) == Errno.ok);
+            Assert.IsTrue(copy1.DupShared(out copy2) == Errno.ok);
+            Assert.IsTrue(original.IsShared && copy1.IsShared && copy2.IsShared);
+
+            IntPtr a, b;
+            ulong size;
+            original.BodyView(out a, out size);
+            copy2.BodyView(out b, out size);
+            Assert.AreEqual(a, b); // one payload
+
+            // a change copies, the others keep the original
+            Assert.IsTrue(copy1.Append(new byte[] { 4 }) == Errno.ok);
+            Assert.IsFalse(copy1.IsShared);
+            CollectionAssert.AreEqual(new byte[] { 1, 2, 3, 4 }, copy1.Body());
+            CollectionAssert.AreEqual(new byte[] { 1, 2, 3 }, original.Body());
+
+            Socket push0, pull0;
+            Assert.IsTrue(Protocols.Push0(out push0) == Errno.ok);
+            Assert.IsTrue(Protocols.Pull0(out pull0) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pull0, "inproc://dupShared", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(push0, "inproc://dupShared", out dialer, 0) == Errno.ok);
+            Assert.IsTrue(push0.Send(copy2, Flag.none) == Errno.ok);
+            Assert.IsFalse(original.IsShared); // the last holder owns the payload now
+            original.BodyView(out b, out size);
+            Assert.AreEqual(a, b);
+            Assert.IsTrue(push0.Send(original, Flag.none) == Errno.ok);
+
+            for (int i = 0; i < 2; i++)
+            {
+                Msg received;
+                Assert.IsTrue(pull0.Receive(out received, Flag.none) == Errno.ok);
+                CollectionAssert.AreEqual(new byte[] { 1, 2, 3 }, received.Body());
+                received.Free();
+            }
+            copy1.Free();
+            push0.Close();
+            pull0.Close();
+        }
+    }
+    /// <summary>
+    /// Subscriber with bulk topics
+    /// </summary>
+    [TestClass]
+    public class UnitTest15
+    {
+        [TestMethod]
+        public void SubscriberTopics()
+        {
+            Socket pub0;
+            Assert.IsTrue(Protocols.Pub0(out pub0) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pub0, "inproc://subscriber", out listener, 0) == Errno.ok);
+            using (var subscriber = new Subscriber(new string[] { "a.", "b.x" }))
+            {
+                int added;
+                Assert.IsTrue(subscriber.Subscribe(new byte[][] { new byte[] { (byte)'c' }, new byte[] { (byte)'a', (byte)'.' } }, out added) == Errno.ok);
+                Assert.AreEqual(1, added);
+                Assert.AreEqual(3, subscriber.Count);
+                Dialer dialer;
+                Assert.IsTrue(Dialer.Dial(subscriber.SubscribeSocket, "inproc://subscriber", out dialer, 0) == Errno.ok);
+                Assert.IsTrue(subscriber.SubscribeSocket.SetOptMs(Option.recvtimeo, 1000) == Errno.ok);
+                System.Threading.Thread.Sleep(100); // let the pipe connect, pub0 drops otherwise
+
+                foreach (var topic in new string[] { "a.1", "b.y", "b.x1", "d", "c" })
+                {
+                    Assert.IsTrue(pub0.Send(System.Text.Encoding.UTF8.GetBytes(topic), Flag.none) == Errno.ok);
+                }
+                foreach (var expected in new string[] { "a.1", "b.x1", "c" })
+                {
+                    Msg msg;
+                    Assert.IsTrue(subscriber.Receive(out msg, Flag.none) == Errno.ok);
+                    Assert.AreEqual(expected, System.Text.Encoding.UTF8.GetString(msg.Body()));
+                    msg.Free();
+                }
+                Assert.AreEqual(2L, subscriber.Dropped);
+                Assert.AreEqual(1L, subscriber.MatchCount("a."));
+                Assert.AreEqual(1L, subscriber.MatchCount("b.x"));
+                Assert.AreEqual(-1L, subscriber.MatchCount("d"));
+
+                int removed;
+                Assert.IsTrue(subscriber.Unsubscribe(new string[] { "a.", "zzz" }, out removed) == Errno.ok);
+                Assert.AreEqual(1, removed);
+                Msg local = new Msg(0);
+                local.Append(System.Text.Encoding.UTF8.GetBytes("a.2"));
+                Assert.IsFalse(subscriber.Match(local));
+                local.Free();
+            }
+            pub0.Close();
+        }
+
+        [TestMethod]
+        public void SubscriberCloseWhileMatching()
+        {
+            var subscriber = new Subscriber(new string[] { "a." });
+            Msg local = new Msg(0);
+            local.Append(System.Text.Encoding.UTF8.GetBytes("a.1"));
+            var matching = new System.Threading.Thread(() =>
+            {
+                while (subscriber.Match(local)) { } // false once closed
+            });
+            matching.Start();
+            System.Threading.Thread.Sleep(20);
+            subscriber.Close();
+            Assert.IsTrue(matching.Join(1000));
+            Assert.IsFalse(subscriber.Match(local));
+            Assert.AreEqual(0, subscriber.Count);
+            int added;
+            Assert.IsTrue(subscriber.Subscribe(new string[] { "b." }, out added) == Errno.closed);
+            subscriber.Close();
+            local.Free();
+        }
+    }
+    /// <summary>
+    /// Socket metrics
+    /// </summary>
+    [TestClass]
+    public class UnitTest16
+    {
+        [TestMethod]
+        public void SocketMetricsCount()
+        {
+            Socket push0, pull0;
+            Assert.IsTrue(Protocols.Push0(out push0) == Errno.ok);
+            Assert.IsTrue(Protocols.Pull0(out pull0) == Errno.ok);
+            SocketMetrics none;
+            Assert.IsTrue(pull0.GetMetrics(out none) == Errno.noent);
+            Assert.IsTrue(push0.EnableMetrics() == Errno.ok);
+            Assert.IsTrue(pull0.EnableMetrics() == Errno.ok);
+
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pull0, "inproc://metrics", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(push0, "inproc://metrics", out dialer, 0) == Errno.ok);
+            SocketMetrics before;
+            Assert.IsTrue(pull0.GetMetrics(out before) == Errno.ok);
+
+            for (int i = 0; i < 3; i++)
+            {
+                Assert.IsTrue(push0.Send(new byte[10], Flag.none) == Errno.ok);
+            }
+            byte[] data;
+            for (int i = 0; i < 2; i++)
+            {
+                Assert.IsTrue(pull0.Receive(out data, Flag.none) == Errno.ok);
+            }
+            using (var aio = new Aio(o => { }, null))
+            {
+                pull0.Receive(aio);
+                aio.Wait();
+                Assert.IsTrue(aio.Result() == Errno.ok);
+                aio.GetMsg().Free();
+            }
+            Assert.IsTrue(pull0.Receive(out data, Flag.nonblock) == Errno.again);
+
+            SocketMetrics sent, received;
+            Assert.IsTrue(push0.GetMetrics(out sent) == Errno.ok);
+            Assert.IsTrue(pull0.GetMetrics(out received) == Errno.ok);
+            Assert.AreEqual(3UL, sent.MessagesSent);
+            Assert.AreEqual(30UL, sent.BytesSent);
+            Assert.AreEqual(1UL, sent.DialerConnects);
+            Assert.AreEqual(1UL, received.ListenerConnects);
+            var delta = received - before;
+            Assert.AreEqual(3UL, delta.MessagesReceived);
+            Assert.AreEqual(30UL, delta.BytesReceived);
+            Assert.AreEqual(1UL, delta.Again);
+            Assert.AreEqual(1UL, delta.AioCompletions);
+            Assert.AreEqual(1UL, delta.AioLatency.Aggregate(0UL, (a, b) => a + b));
+            Assert.IsTrue(delta.AioLatencyPercentile(0.5) >= 1);
+
+            push0.Close();
+            pull0.Close();
+            Assert.IsTrue(pull0.GetMetrics(out received) == Errno.noent);
+        }
+    }
+    /// <summary>
+    /// nng statistics, SnapShot and StatPoller
+    /// </summary>
+    [TestClass]
+    public class UnitTest17
+    {
+        [TestMethod]
+        public void SnapShotWalkAndDiff()
+        {
+            Socket push0, pull0;
+            Assert.IsTrue(Protocols.Push0(out push0) == Errno.ok);
+            Assert.IsTrue(Protocols.Pull0(out pull0) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pull0, "inproc://stats", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(push0, "inproc://stats", out dialer, 0) == Errno.ok);
+
+            SnapShot before;
+            Assert.IsTrue(SnapShot.Take(out before) == Errno.ok);
+            Assert.IsNotNull(before.Root);
+            Assert.IsNull(before.Root.Parent);
+            var scope = before.Find(pull0);
+            Assert.IsNotNull(scope);
+            Assert.IsTrue(scope.Type == StatType.scope);
+            Assert.AreEqual("socket#" + scope.ScopeId, scope.Path);
+            Assert.AreSame(scope, before.Find(scope.Path));
+            var id = scope.Child("id");
+            Assert.IsNotNull(id);
+            Assert.AreEqual((ulong)scope.ScopeId, id.Value);
+            Assert.AreSame(scope, id.Parent);
+            Assert.IsTrue(before.All().Length > scope.Children().Length);
+
+            byte[] data;
+            Assert.IsTrue(push0.Send(new byte[10], Flag.none) == Errno.ok);
+            Assert.IsTrue(pull0.Receive(out data, Flag.none) == Errno.ok);
+            using (var after = new SnapShot())
+            {
+                var same = after.Find(pull0);
+                Assert.AreEqual(scope.Key, same.Key);
+                var deltas = SnapShot.Diff(before, after);
+                Assert.IsNotNull(deltas);
+                foreach (var d in deltas)
+                {
+                    Assert.AreEqual((long)(d.After - d.Before), d.Delta);
+                    Assert.IsTrue(d.Type == StatType.counter || d.Type == StatType.level);
+                }
+            }
+            before.Free();
+            Assert.IsNull(before.Root);
+            Assert.IsNull(scope.Name);
+
+            push0.Close();
+            pull0.Close();
+        }
+
+        [TestMethod]
+        public void StatPollerPublishes()
+        {
+            int calls = 0;
+            using (var poller = new StatPoller(10, (deltas, count) =>
+            {
+                Assert.IsTrue(count <= deltas.Length);
+                System.Threading.Interlocked.Increment(ref calls);
+            }))
+            {
+                for (int i = 0; i < 100 && System.Threading.Volatile.Read(ref calls) < 2; i++)
+                {
+                    System.Threading.Thread.Sleep(10);
+                }
+                Assert.IsTrue(poller.LastError == Errno.ok);
+                Assert.IsTrue(poller.Polls >= 3); // the first one is the baseline
+                Assert.AreEqual(0L, poller.HandlerErrors);
+            }
+            StatPoller invalid;
+            Assert.IsTrue(StatPoller.Open(out invalid, 0, (deltas, count) => { }) == Errno.inval);
+        }
+    }
+    /// <summary>
+    /// Poller, many sockets on one thread
+    /// </summary>
+    [TestClass]
+    public class UnitTest18
+    {
+        [TestMethod]
+        public void PollerReadyBatches()
+        {
+            const int n = 4;
+            var pulls = new Socket[n];
+            var pushes = new Socket[n];
+            using (var poller = new Poller(n))
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    Assert.IsTrue(Protocols.Pull0(out pulls[i]) == Errno.ok);
+                    Assert.IsTrue(Protocols.Push0(out pushes[i]) == Errno.ok);
+                    Listener listener;
+                    Assert.IsTrue(Listener.Listen(pulls[i], "inproc://poller" + i, out listener, 0) == Errno.ok);
+                    Dialer dialer;
+                    Assert.IsTrue(Dialer.Dial(pushes[i], "inproc://poller" + i, out dialer, 0) == Errno.ok);
+                    Assert.IsTrue(poller.Add(pulls[i], PollEvents.receive) == Errno.ok);
+                }
+                Assert.IsTrue(poller.Add(pushes[0], PollEvents.receive) == Errno.notsup);
+                Assert.AreEqual(n, poller.Count);
+
+                int count;
+                Assert.IsTrue(poller.Wait(0, out count) == Errno.ok);
+                Assert.AreEqual(0, count);
+
+                Assert.IsTrue(pushes[2].Send(new byte[] { 2 }, Flag.none) == Errno.ok);
+                Assert.IsTrue(poller.Wait(1000, out count) == Errno.ok);
+                Assert.AreEqual(1, count);
+                Assert.AreSame(pulls[2], poller.Ready[0]);
+                Assert.IsTrue(poller.ReadyEvents[0] == PollEvents.receive);
+                byte[] data;
+                Assert.IsTrue(poller.Ready[0].Receive(out data, Flag.nonblock) == Errno.ok);
+                Assert.IsTrue(pulls[2].Receive(out data, Flag.nonblock) == Errno.again);
+
+                for (int i = 0; i < n; i++)
+                {
+                    Assert.IsTrue(pushes[i].Send(new byte[] { (byte)i }, Flag.none) == Errno.ok);
+                }
+                Assert.IsTrue(poller.WaitAll(pulls, PollEvents.receive, 1000) == Errno.ok);
+                Socket[] ready;
+                Assert.IsTrue(poller.WaitAny(1000, out ready) == Errno.ok);
+                Assert.AreEqual(n, ready.Length);
+                foreach (var socket in ready)
+                {
+                    Assert.IsTrue(socket.Receive(out data, Flag.nonblock) == Errno.ok);
+                }
+                Assert.IsTrue(poller.WaitAll(new Socket[] { pulls[0] }, PollEvents.receive, 50) == Errno.timedout);
+
+                var waker = new System.Threading.Thread(() => { System.Threading.Thread.Sleep(50); poller.Wake(); });
+                waker.Start();
+                Assert.IsTrue(poller.Wait(-1, out count) == Errno.ok);
+                Assert.AreEqual(0, count);
+                waker.Join();
+
+                for (int i = 0; i < n; i++)
+                {
+                    Assert.IsTrue(poller.Remove(pulls[i]) == Errno.ok);
+                    pulls[i].Close();
+                    pushes[i].Close();
+                }
+                Assert.AreEqual(0, poller.Count);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Pipe events, the table of connected pipes and sending to one pipe of a polyamorous Pair1
+    /// </summary>
+    [TestClass]
+    public class UnitTest19
+    {
+        [TestMethod]
+        public void PipeEventsAndSendTo()
+        {
+            Socket hub, one, two;
+            Assert.IsTrue(Protocols.Pair1(out hub, true) == Errno.ok);
+            Assert.IsTrue(Protocols.Pair1(out one) == Errno.ok);
+            Assert.IsTrue(Protocols.Pair1(out two) == Errno.ok);
+            Assert.IsTrue(hub.SetOptMs(Option.recvtimeo, 1000) == Errno.ok);
+            Assert.IsTrue(two.SetOptMs(Option.recvtimeo, 1000) == Errno.ok);
+            PipeInfo[] pipes;
+            Assert.IsTrue(hub.GetPipes(out pipes) == Errno.state);
+            Assert.IsTrue(hub.WatchPipes() == Errno.ok);
+
+            using (var done = new System.Threading.AutoResetEvent(false))
+            using (var aio = new Aio(o => done.Set(), null))
+            {
+                Listener listener;
+                Assert.IsTrue(Listener.Listen(hub, "inproc://pipes", out listener, 0) == Errno.ok);
+                Dialer dialer;
+                Assert.IsTrue(Dialer.Dial(one, "inproc://pipes", out dialer, 0) == Errno.ok);
+                Assert.IsTrue(Dialer.Dial(two, "inproc://pipes", out dialer, 0) == Errno.ok);
+                PipeEvent pipeEvent;
+                for (int i = 0; i < 2; i++)
+                {
+                    aio.SetTimeout(1000);
+                    hub.ReceivePipeEvent(aio);
+                    Assert.IsTrue(done.WaitOne(2000));
+                    Assert.IsTrue(aio.GetPipeEvent(out pipeEvent) == Errno.ok);
+                    Assert.IsTrue(pipeEvent.Type == PipeEventType.added);
+                }
+                Assert.IsTrue(hub.GetPipes(out pipes) == Errno.ok);
+                Assert.AreEqual(2, pipes.Length);
+                Assert.IsTrue(pipes.All(p => p.Listener != 0 && p.Dialer == 0));
+
+                Assert.IsTrue(two.Send(new byte[] { 2 }, Flag.none) == Errno.ok);
+                Msg msg;
+                Assert.IsTrue(hub.Receive(out msg, Flag.none) == Errno.ok);
+                uint pipe = (uint)msg.GetPipe();
+                Assert.IsTrue(pipes.Any(p => p.Pipe == pipe));
+                Assert.IsTrue(hub.SendTo(msg, pipe, Flag.none) == Errno.ok);
+                byte[] data;
+                Assert.IsTrue(two.Receive(out data, Flag.none) == Errno.ok);
+                Assert.IsTrue(one.Receive(out data, Flag.nonblock) == Errno.again);
+                using (var other = new Msg(0))
+                {
+                    Assert.IsTrue(one.SendTo(other, pipe, Flag.none) == Errno.notsup);
+                }
+
+                Assert.IsTrue(Socket.ClosePipe(pipe) == Errno.ok);
+                aio.SetTimeout(1000);
+                hub.ReceivePipeEvent(aio);
+                Assert.IsTrue(done.WaitOne(2000));
+                Assert.IsTrue(aio.GetPipeEvent(out pipeEvent) == Errno.ok);
+                Assert.IsTrue(pipeEvent.Type == PipeEventType.removed && pipeEvent.Pipe == pipe);
+
+                one.Close();
+                two.Close();
+                hub.Close();
+                aio.Wait();
+            }
+        }
+    }
+
+    /// <summary>
+    /// Chunked transfers with flow control, from and into Streams and files
+    /// </summary>
+    [TestClass]
+    public class UnitTest20
+    {
+        private static byte[] Pattern(int size)
+        {
+            var data = new byte[size];
+            for (int i = 0; i < size; i++) data[i] = (byte)(i * 7);
+            return data;
+        }
+
+        [TestMethod]
+        public void StreamTransferInChunks()
+        {
+            Socket a, b;
+            Assert.IsTrue(Protocols.Pair0(out a) == Errno.ok);
+            Assert.IsTrue(Protocols.Pair0(out b) == Errno.ok);
+            Assert.IsTrue(a.SetOptMs(Option.recvtimeo, 2000) == Errno.ok);
+            Assert.IsTrue(b.SetOptMs(Option.recvtimeo, 2000) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(a, "inproc://stream", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(b, "inproc://stream", out dialer, 0) == Errno.ok);
+
+            var sender = new StreamTransfer(a, 4096, 4);
+            StreamTransfer receiver;
+            Assert.IsTrue(StreamTransfer.Open(out receiver, b, 1000, 8) == Errno.ok);
+
+            // chunk and header have to fit recvmaxsz
+            StreamTransfer tooLarge;
+            Assert.IsTrue(b.SetOptSize(Option.recvmaxsz, 1024) == Errno.ok);
+            Assert.IsTrue(StreamTransfer.Open(out tooLarge, b, 1000, 8) == Errno.msgsize);
+            Assert.IsNull(tooLarge);
+            Assert.IsTrue(b.SetOptSize(Option.recvmaxsz, 0) == Errno.ok);
+            Assert.AreEqual(16384L, sender.MemoryBound);
+            var data = Pattern(1000 * 1000 + 3);
+
+            // the receiver's buffer is smaller than the sender's chunks
+            var target = new System.IO.MemoryStream();
+            ulong received = 0;
+            Errno receiveErr = Errno.internal;
+            var thread = new System.Threading.Thread(() => receiveErr = receiver.Receive(target, out received));
+            thread.Start();
+            ulong sent;
+            Assert.IsTrue(sender.Send(new System.IO.MemoryStream(data), out sent) == Errno.ok);
+            thread.Join();
+            Assert.IsTrue(receiveErr == Errno.ok);
+            Assert.AreEqual((ulong)data.Length, sent);
+            Assert.AreEqual((ulong)data.Length, received);
+            Assert.IsTrue(target.ToArray().SequenceEqual(data));
+
+            var source = System.IO.Path.GetTempFileName();
+            var copy = System.IO.Path.GetTempFileName();
+            try
+            {
+                System.IO.File.WriteAllBytes(source, data);
+                thread = new System.Threading.Thread(() => receiveErr = receiver.ReceiveFile(copy, out received));
+                thread.Start();
+                Assert.IsTrue(sender.SendFile(source, out sent) == Errno.ok);
+                thread.Join();
+                Assert.IsTrue(receiveErr == Errno.ok);
+                Assert.IsTrue(System.IO.File.ReadAllBytes(copy).SequenceEqual(data));
+
+                // a file needs the size up front, a Stream which can't seek doesn't announce it
+                thread = new System.Threading.Thread(() => receiveErr = receiver.ReceiveFile(copy, out received));
+                thread.Start();
+                Assert.IsTrue(sender.Send(new System.IO.Compression.GZipStream(new System.IO.MemoryStream(), System.IO.Compression.CompressionMode.Decompress), out sent) == Errno.connaborted);
+                thread.Join();
+                Assert.IsTrue(receiveErr == Errno.notsup);
+            }
+            finally
+            {
+                System.IO.File.Delete(source);
+                System.IO.File.Delete(copy);
+            }
+            a.Close();
+            b.Close();
+        }
+    }
+
+    /// <summary>
+    /// Shared memory channels, copied and in place
+    /// </summary>
+    [TestClass]
+    public class UnitTest21
+    {
+        [TestMethod]
+        public void ShmChannelBothWays()
+        {
+            var url = "shm://nngtests-" + System.Diagnostics.Process.GetCurrentProcess().Id;
+            ShmChannel dialer;
+            Assert.IsTrue(ShmChannel.Dial(out dialer, url) == Errno.connrefused);
+            var listener = new ShmChannel(url, true, 64 * 1024);
+            Assert.IsTrue(ShmChannel.Dial(out dialer, url) == Errno.ok);
+            Assert.AreEqual(32 * 1024 - 8, listener.MaxMessageSize);
+
+            var data = new byte[1000];
+            for (int i = 0; i < data.Length; i++) data[i] = (byte)i;
+            Errno receiveErr = Errno.internal;
+            var thread = new System.Threading.Thread(() =>
+            {
+                byte[] got;
+                for (int i = 0; i < 1000 && (receiveErr = dialer.Receive(out got, 2000)) == Errno.ok; i++)
+                {
+                    if (got.Length != i || (i > 0 && got[i - 1] != (byte)(i - 1))) receiveErr = Errno.proto;
+                }
+            });
+            thread.Start();
+            for (int i = 0; i < 1000; i++) Assert.IsTrue(listener.Send(data, 0, i, 2000) == Errno.ok);
+            thread.Join();
+            Assert.IsTrue(receiveErr == Errno.ok);
+
+            // written into the ring and read there
+            IntPtr buffer;
+            Assert.IsTrue(dialer.SendBegin(16, out buffer) == Errno.ok);
+            System.Runtime.InteropServices.Marshal.WriteInt32(buffer, 0x01020304);
+            Assert.IsTrue(dialer.SendEnd(4) == Errno.ok);
+            IntPtr view;
+            int size;
+            Assert.IsTrue(listener.ReceiveBegin(out view, out size, 0) == Errno.ok);
+            Assert.AreEqual(4, size);
+            Assert.AreEqual(0x01020304, System.Runtime.InteropServices.Marshal.ReadInt32(view));
+            Assert.IsTrue(listener.ReceiveEnd() == Errno.ok);
+            byte[] none;
+            Assert.IsTrue(listener.Receive(out none, 0) == Errno.again);
+
+            // too large for the buffer, it stays
+            Assert.IsTrue(dialer.Send(data) == Errno.ok);
+            var small = new byte[10];
+            int received;
+            Assert.IsTrue(listener.Receive(small, 0, small.Length, out received, 0) == Errno.msgsize);
+            Assert.AreEqual(data.Length, received);
+            var large = new byte[2000];
+            Assert.IsTrue(listener.Receive(large, 0, large.Length, out received, 0) == Errno.ok);
+            Assert.AreEqual(data.Length, received);
+
+            dialer.Close();
+            Assert.IsTrue(listener.Receive(out none, 1000) == Errno.closed);
+            listener.Close();
+            Assert.IsTrue(ShmChannel.Dial(out dialer, url) == Errno.connrefused);
+        }
+    }
+
+    /// <summary>
+    /// Value types straight into and out of message bodies
+    /// </summary>
+    [TestClass]
+    public class UnitTest22
+    {
+        [System.Runtime.InteropServices.StructLayout(System.Runtime.InteropServices.LayoutKind.Sequential, Pack = 1)]
+        public struct Cookie
+        {
+            public int Id;
+            public long Time;
+            public short Flags;
+            public double Value;
+        }
+
+        public struct Named
+        {
+            public int Id;
+            public string Name;
+        }
+
+        [TestMethod]
+        public void MsgWriteReadValues()
+        {
+            var cookie = new Cookie { Id = 0x01020304, Time = 5, Flags = 6, Value = 7.5 };
+            var msg = new Msg(0);
+            Assert.IsTrue(msg.Write(cookie) == Errno.ok);
+            Assert.IsTrue(msg.Write(cookie, true) == Errno.ok);
+            Assert.AreEqual(2 * 22, msg.Body().Length);
+            // the first one as in memory, the second one big endian
+            Assert.AreEqual(0x04, msg.Body()[0]);
+            Assert.AreEqual(0x01, msg.Body()[22]);
+            Cookie read;
+            Assert.IsTrue(msg.Read(out read) == Errno.ok);
+            Assert.AreEqual(cookie, read);
+            Assert.IsTrue(msg.Read(out read, true) == Errno.ok);
+            Assert.AreEqual(cookie, read);
+            Assert.IsTrue(msg.Read(out read) == Errno.inval);
+
+            var values = new[] { 1u, 2u, 3u, 0xA0B0C0D0u };
+            Assert.IsTrue(msg.Write(values, 1, 3, true) == Errno.ok);
+            Assert.AreEqual(0xA0, msg.Body()[8]);
+            var back = new uint[4];
+            Assert.IsTrue(msg.Read(back, 0, 3, true) == Errno.ok);
+            Assert.IsTrue(back.Take(3).SequenceEqual(values.Skip(1)));
+
+            Assert.IsTrue(msg.Write(new Named { Id = 1, Name = "x" }) == Errno.notsup);
+            msg.Free();
+        }
+
+        [TestMethod]
+        public void SocketSendReceiveValues()
+        {
+            Socket a, b;
+            Assert.IsTrue(Protocols.Pair0(out a) == Errno.ok);
+            Assert.IsTrue(Protocols.Pair0(out b) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(a, "inproc://values", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(b, "inproc://values", out dialer, 0) == Errno.ok);
+
+            var cookie = new Cookie { Id = 42, Time = System.DateTime.UtcNow.Ticks, Flags = -1, Value = 0.25 };
+            Assert.IsTrue(a.Send(cookie, Flag.none, true) == Errno.ok);
+            Cookie got;
+            Assert.IsTrue(b.Receive(out got, Flag.none, true) == Errno.ok);
+            Assert.AreEqual(cookie, got);
+
+            var values = new double[] { 1.5, 2.5, 3.5 };
+            Assert.IsTrue(a.Send(values, 0, values.Length, Flag.none) == Errno.ok);
+            var into = new double[8];
+            int received;
+            Assert.IsTrue(b.Receive(into, 2, 6, out received, Flag.none) == Errno.ok);
+            Assert.AreEqual(3, received);
+            Assert.AreEqual(2.5, into[3]);
+
+            // a long is not a Cookie
+            Assert.IsTrue(a.Send(5L, Flag.none) == Errno.ok);
+            Assert.IsTrue(b.Receive(out got, Flag.none) == Errno.msgsize);
+            a.Close();
+            b.Close();
+        }
+    }
+
+    /// <summary>
+    /// Spinning and yielding before a blocking receive
+    /// </summary>
+    [TestClass]
+    public class UnitTest23
+    {
+        [TestMethod]
+        public void ReceiveWaitPolicy()
+        {
+            Socket a, b;
+            Assert.IsTrue(Protocols.Pair0(out a) == Errno.ok);
+            Assert.IsTrue(Protocols.Pair0(out b) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(a, "inproc://recvwait", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(b, "inproc://recvwait", out dialer, 0) == Errno.ok);
+            ReceiveWaitStats stats;
+            Assert.IsTrue(b.GetReceiveWaitStats(out stats) == Errno.noent);
+            Assert.IsTrue(b.SetReceiveWait(new ReceiveWaitPolicy { Spins = 2000, Yields = 10, Adaptive = true }) == Errno.ok);
+
+            const int count = 100;
+            var sender = System.Threading.Tasks.Task.Run(() =>
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    a.Send(new byte[] { (byte)i }, Flag.none);
+                }
+            });
+            byte[] data;
+            for (int i = 0; i < count; i++)
+            {
+                Assert.IsTrue(b.Receive(out data, Flag.none) == Errno.ok);
+                Assert.AreEqual((byte)i, data[0]);
+            }
+            sender.Wait();
+            Assert.IsTrue(b.Receive(out data, Flag.nonblock) == Errno.again);
+
+            Assert.IsTrue(b.GetReceiveWaitStats(out stats) == Errno.ok);
+            Assert.AreEqual((ulong)count, stats.SpinHits + stats.YieldHits + stats.Blocks);
+            Assert.IsTrue(stats.Skips <= stats.Blocks);
+            Assert.IsTrue(stats.Gap > 0);
+
+            Assert.IsTrue(b.SetReceiveWait(null) == Errno.ok);
+            Assert.IsTrue(b.GetReceiveWaitStats(out stats) == Errno.noent);
+            a.Close();
+            b.Close();
+        }
+    }
+
+    /// <summary>
+    /// Aio completion queues
+    /// </summary>
+    [TestClass]
+    public class UnitTest24
+    {
+        [TestMethod]
+        public void CloseQueueWithBoundAio()
+        {
+            Socket a, b;
+            Assert.IsTrue(Protocols.Pair0(out a) == Errno.ok);
+            Assert.IsTrue(Protocols.Pair0(out b) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(a, "inproc://queueclose", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(b, "inproc://queueclose", out dialer, 0) == Errno.ok);
+            var completed = new System.Threading.AutoResetEvent(false);
+            Aio aio;
+            Assert.IsTrue(Aio.Alloc(out aio, o => completed.Set(), null) == Errno.ok);
+            var queue = new AioCompletionQueue(1);
+            aio.CompletionQueue = queue;
+            b.Receive(aio);
+            queue.Close();
+
+            // completes after the queue is gone, the callback comes directly from nng
+            Assert.IsTrue(a.Send(new byte[] { 1 }, Flag.none) == Errno.ok);
+            Assert.IsTrue(completed.WaitOne(5000));
+            Assert.IsTrue(aio.Result() == Errno.ok);
+            aio.GetMsg().Free();
+
+            // so does an Aio bound after Close
+            aio.CompletionQueue = queue;
+            b.Receive(aio);
+            Assert.IsTrue(a.Send(new byte[] { 2 }, Flag.none) == Errno.ok);
+            Assert.IsTrue(completed.WaitOne(5000));
+            Assert.IsTrue(aio.Result() == Errno.ok);
+            aio.GetMsg().Free();
+            Assert.AreEqual(0L, queue.Completions);
+
+            aio.Free();
+            a.Close();
+            b.Close();
+        }
+    }
+    /// <summary>
+    /// Message pool
+    /// </summary>
+    [TestClass]
+    public class UnitTest25
+    {
+        [TestMethod]
+        public void MsgPoolEnableAllocFreeDisable()
+        {
+            Assert.IsTrue(MsgPool.Configure(new int[] { 64, 256 }, 4, 16) == Errno.ok);
+            MsgPool.Enable();
+            try
+            {
+                Assert.IsTrue(MsgPool.Enabled);
+                Assert.IsTrue(MsgPool.Configure(null, 4, 16) == Errno.busy);
+                MsgPool.ResetCounters();
+
+                var msg = new Msg(100);
+                Assert.AreEqual(1L, MsgPool.Misses);
+                msg.Free();
+                Assert.AreEqual(1L, MsgPool.Returns);
+                msg = new Msg(200); // the same class, from the cache of this thread
+                Assert.AreEqual(1L, MsgPool.Hits);
+                Assert.AreEqual(200, msg.Body().Length);
+                msg.Free();
+
+                // a message freed on another thread stays in that thread's cache, Disable frees it too
+                var other = new System.Threading.Thread(() => new Msg(10).Free());
+                other.Start();
+                other.Join();
+                Assert.AreEqual(3L, MsgPool.Returns);
+            }
+            finally
+            {
+                MsgPool.Disable();
+            }
+            Assert.IsFalse(MsgPool.Enabled);
+
+            // not pooled anymore
+            MsgPool.ResetCounters();
+            var plain = new Msg(100);
+            plain.Free();
+            Assert.AreEqual(0L, MsgPool.Misses + MsgPool.Hits + MsgPool.Returns);
+            Assert.IsTrue(MsgPool.Configure(new int[] { 64, 128, 256, 512, 1024, 2048, 4096 }, 32, 1024) == Errno.ok);
+        }
+    }
+    /// <summary>
+    /// Batch send and receive
+    /// </summary>
+    [TestClass]
+    public class UnitTest26
+    {
+        [TestMethod]
+        public void SendManyReceiveMany()
+        {
+            Socket push0, pull0;
+            Assert.IsTrue(Protocols.Push0(out push0) == Errno.ok);
+            Assert.IsTrue(Protocols.Pull0(out pull0) == Errno.ok);
+            Assert.IsTrue(push0.SetOptInt(Constants.Option(Option.sendbuf), 1) == Errno.ok);
+            Assert.IsTrue(pull0.SetOptInt(Constants.Option(Option.recvbuf), 1) == Errno.ok);
+            Listener listener;
+            Assert.IsTrue(Listener.Listen(pull0, "inproc://batch", out listener, 0) == Errno.ok);
+            Dialer dialer;
+            Assert.IsTrue(Dialer.Dial(push0, "inproc://batch", out dialer, 0) == Errno.ok);
+
+            // null entries are rejected before anything is sent
+            int sent;
+            Msg first = new Msg(0);
+            Assert.IsTrue(push0.SendMany(new Msg[] { first, null }, out sent) == Errno.inval);
+            Assert.AreEqual(0, sent);
+            Assert.IsTrue(push0.SendMany(new byte[][] { new byte[] { 1 }, null }, out sent) == Errno.inval);
+            Assert.AreEqual(0, sent);
+            first.Free();
+
+            // nobody receives, so the buffers fill up and the rest stays with the caller
+            var msgs = new Msg[64];
+            for (int i = 0; i < msgs.Length; i++)
+            {
+                msgs[i] = new Msg(0);
+                Assert.IsTrue(msgs[i].AppendU32((uint)i) == Errno.ok);
+            }
+            Assert.IsTrue(push0.SendMany(msgs, out sent) == Errno.again);
+            Assert.IsTrue(sent > 0 && sent < msgs.Length);
+            MsgReader reader;
+            for (int i = 0; i < msgs.Length; i++)
+            {
+                // sent ones belong to nng and are gone for the Msg, like after Send
+                Assert.IsTrue(MsgReader.Open(out reader, msgs[i], false) == (i < sent ? Errno.inval : Errno.ok));
+            }
+            for (int i = sent; i < msgs.Length; i++)
+            {
+                uint value;
+                Assert.IsTrue(new MsgReader(msgs[i]).ReadU32(out value) == Errno.ok);
+                Assert.AreEqual((uint)i, value);
+                msgs[i].Free();
+            }
+
+            // -1 waits for the first, the rest only if already there
+            var received = new Msg[msgs.Length];
+            int count, total = 0;
+            while (total < sent)
+            {
+                Assert.IsTrue(pull0.ReceiveMany(received, -1, out count) == Errno.ok);
+                Assert.IsTrue(count > 0 && total + count <= sent);
+                for (int i = 0; i < count; i++)
+                {
+                    uint value;
+                    Assert.IsTrue(new MsgReader(received[i]).ReadU32(out value) == Errno.ok);
+                    Assert.AreEqual((uint)(total + i), value);
+                    received[i].Free();
+                }
+                total += count;
+            }
+
+            // 0 doesn't wait, > 0 waits that long
+            Assert.IsTrue(pull0.ReceiveMany(received, 0, out count) == Errno.again);
+            Assert.AreEqual(0, count);
+            var watch = System.Diagnostics.Stopwatch.StartNew();
+            Assert.IsTrue(pull0.ReceiveMany(received, 100, out count) == Errno.timedout);
+            Assert.AreEqual(0, count);
+            Assert.IsTrue(watch.ElapsedMilliseconds >= 90);
+            Msg[] batch;
+            Assert.IsTrue(pull0.ReceiveMany(-1, 0, out batch) == Errno.inval);
+            Assert.IsNull(batch);
+            Assert.IsTrue(pull0.ReceiveMany(4, 0, out batch) == Errno.again);
+            Assert.IsNull(batch);
+
+            Assert.IsTrue(push0.SendMany(new byte[][] { new byte[] { 1 }, new byte[] { 2, 3 } }, out sent) == Errno.ok);
+            Assert.AreEqual(2, sent);
+            for (total = 0; total < 2; total += batch.Length)
+            {
+                Assert.IsTrue(pull0.ReceiveMany(4, 1000, out batch) == Errno.ok);
+                Assert.IsTrue(batch.Length >= 1);
+                foreach (var msg in batch) msg.Free();
+            }
+            Assert.AreEqual(2, total);
+            push0.Close();
+            pull0.Close();
+        }
+    }
 }